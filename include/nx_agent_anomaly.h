@@ -6,13 +6,21 @@
 #include <map>
 #include <memory>
 #include <mutex>
-#include <deque>
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstddef>
 #include <opencv2/opencv.hpp>
 
+#include "nx_agent_snapshot.h"
+#include "nx_agent_window.h"
+
 namespace nx_agent {
 
 // Forward declarations
 class DeviceConfig;
+class Gauge;
+class FeatureLog;
 struct FrameAnalysisResult;
 
 /**
@@ -28,11 +36,30 @@ struct FeatureVector {
     int vehicleCount;
     std::vector<float> additionalFeatures;  // For extensibility
     
+    // Length of the vectors AnomalyDetector::extractFeatures produces;
+    // stored models of another length are not loaded
+    static constexpr int kExtractedFeatureCount = 9;
+    
+    // Flat, normalized model input without building a Mat
+    int featureCount() const { return 5 + static_cast<int>(additionalFeatures.size()); }
+    float featureAt(int index) const;
+    
     // Convert to/from OpenCV Mat for model input
     cv::Mat toMat() const;
     static FeatureVector fromMat(const cv::Mat& mat);
 };
 
+/**
+ * Anomaly model a device learns its baseline with
+ */
+enum class AnomalyModelType {
+    Diagonal,        // Independent features (OnlineGaussianModel)
+    FullCovariance   // Correlated features (CovarianceGaussianModel)
+};
+
+// Parse a model name from configuration ("diagonal"/"fullCovariance")
+AnomalyModelType parseAnomalyModelType(const std::string& name);
+
 /**
  * Abstract base class for anomaly detection models
  */
@@ -43,9 +70,15 @@ public:
     // Train the model with new data
     virtual void train(const std::vector<FeatureVector>& normalFeatures) = 0;
     
+    // Fold a single sample into the model; batch-only models ignore it
+    virtual void update(const FeatureVector& /*features*/) {}
+    
     // Score a feature vector (higher score = more anomalous)
     virtual float scoreAnomaly(const FeatureVector& features) = 0;
     
+    // Score count samples into scores[0, count); models may evaluate them together
+    virtual void scoreBatch(const FeatureVector* features, size_t count, float* scores);
+    
     // Save model to file
     virtual bool saveToFile(const std::string& filePath) = 0;
     
@@ -54,6 +87,13 @@ public:
     
     // Check if the model has been trained
     virtual bool isTrained() const = 0;
+    
+    // Running state for binary snapshots; models without one return false
+    virtual bool exportState(SnapshotEntry& /*entry*/) const { return false; }
+    virtual bool importState(const SnapshotEntry& /*entry*/) { return false; }
+    
+    // Approximate memory held by the model, for the model cache budget
+    virtual size_t memoryBytes() const { return sizeof(*this); }
 };
 
 /**
@@ -68,6 +108,7 @@ public:
     bool saveToFile(const std::string& filePath) override;
     bool loadFromFile(const std::string& filePath) override;
     bool isTrained() const override { return m_trained; }
+    size_t memoryBytes() const override;
     
 private:
     cv::Mat m_mean;        // Mean vector for each feature
@@ -75,8 +116,113 @@ private:
     bool m_trained = false;
 };
 
+/**
+ * Streaming Gaussian model using Welford's running mean/variance.
+ *
+ * Each update costs O(features) and the model keeps no samples. With a
+ * non-zero decay older samples are forgotten exponentially, so the model
+ * follows gradual changes in the scene (decay 0 weights all samples equally).
+ */
+class OnlineGaussianModel : public AnomalyModel {
+public:
+    explicit OnlineGaussianModel(double decay = 0.0, uint64_t minSamples = 100);
+    
+    void train(const std::vector<FeatureVector>& normalFeatures) override;
+    void update(const FeatureVector& features) override;
+    float scoreAnomaly(const FeatureVector& features) override;
+    bool saveToFile(const std::string& filePath) override;
+    bool loadFromFile(const std::string& filePath) override;
+    bool isTrained() const override { return m_sampleCount >= m_minSamples; }
+    bool exportState(SnapshotEntry& entry) const override;
+    bool importState(const SnapshotEntry& entry) override;
+    size_t memoryBytes() const override;
+    
+    uint64_t sampleCount() const { return m_sampleCount; }
+    
+private:
+    double m_decay;
+    uint64_t m_minSamples;
+    uint64_t m_sampleCount = 0;
+    double m_weight = 0.0;         // Effective (decayed) number of samples
+    std::vector<double> m_mean;
+    std::vector<double> m_m2;      // Weighted sum of squared deviations
+};
+
+/**
+ * Streaming Gaussian model over the full feature covariance.
+ *
+ * Samples are folded in one at a time with the same decayed Welford update
+ * as OnlineGaussianModel, but the co-moments between features are kept as
+ * well, so scoring uses the true Mahalanobis distance and catches
+ * combinations that are unusual even when each feature alone is not (many
+ * people and no motion, say). The distance comes from a cached Cholesky
+ * factor of the covariance, rebuilt once kRefactorInterval updates have
+ * accumulated rather than after every one, and from features read into a
+ * stack array, so scoring never allocates. scoreBatch() runs the forward
+ * substitution for kBatchLanes samples at a time in loops the compiler
+ * vectorizes. Features with (near) zero variance are left out, as in the
+ * diagonal model. Not thread-safe.
+ */
+class CovarianceGaussianModel : public AnomalyModel {
+public:
+    static constexpr int kMaxFeatures = 16;
+    
+    explicit CovarianceGaussianModel(double decay = 0.0, uint64_t minSamples = 100);
+    
+    void train(const std::vector<FeatureVector>& normalFeatures) override;
+    void update(const FeatureVector& features) override;
+    float scoreAnomaly(const FeatureVector& features) override;
+    void scoreBatch(const FeatureVector* features, size_t count, float* scores) override;
+    bool saveToFile(const std::string& filePath) override;
+    bool loadFromFile(const std::string& filePath) override;
+    bool isTrained() const override { return m_sampleCount >= m_minSamples; }
+    bool exportState(SnapshotEntry& entry) const override;
+    bool importState(const SnapshotEntry& entry) override;
+    size_t memoryBytes() const override;
+    
+    uint64_t sampleCount() const { return m_sampleCount; }
+    
+private:
+    static constexpr int kBatchLanes = 8;
+    static constexpr uint64_t kRefactorInterval = 64;
+    static constexpr size_t kPackedSize = kMaxFeatures * (kMaxFeatures + 1) / 2;
+    
+    // Position of (row, col), col <= row, in a packed lower triangle
+    static constexpr size_t packed(int row, int col) { return row * (row + 1) / 2 + col; }
+    
+    // Rebuild the factor if it is missing or stale
+    void prepareFactor();
+    void refactor();
+    float toScore(float distanceSquared) const;
+    void clear();
+    
+    double m_decay;
+    uint64_t m_minSamples;
+    uint64_t m_sampleCount = 0;
+    double m_weight = 0.0;                              // Effective (decayed) number of samples
+    int m_featureCount = 0;
+    std::array<double, kMaxFeatures> m_mean{};
+    std::array<double, kPackedSize> m_coMoment{};       // Weighted co-moments, packed lower triangle
+    
+    // Scoring state derived from the above, over the features with variance
+    bool m_factorReady = false;
+    uint64_t m_pendingUpdates = 0;                      // Updates since the last refactor
+    int m_activeCount = 0;
+    std::array<int, kMaxFeatures> m_active{};           // Feature index of each factor row
+    std::array<float, kMaxFeatures> m_activeMean{};
+    std::array<float, kPackedSize> m_factor{};          // Cholesky factor, packed lower triangle
+    std::array<float, kMaxFeatures> m_inverseDiagonal{};
+};
+
 /**
  * Main anomaly detection engine
+ *
+ * Keeps one model per hour of the day. Only the hour the frames are in
+ * (event time) and the next one are pinned in memory; other hours are
+ * paged in from the mapped snapshot when a frame needs them and evicted,
+ * least recently used first, whenever the models of all detectors exceed
+ * GlobalConfig::modelCacheBudgetKB. An evicted model with unsaved changes
+ * is kept in its exported form until the next save writes it.
  */
 class AnomalyDetector {
 public:
@@ -84,7 +230,7 @@ public:
     ~AnomalyDetector();
     
     // Configure the detector
-    void configure(std::shared_ptr<DeviceConfig> config);
+    void configure(std::shared_ptr<const DeviceConfig> config);
     
     // Process a frame analysis result to detect anomalies
     bool detectAnomaly(FrameAnalysisResult& result);
@@ -95,40 +241,142 @@ public:
     // Clear existing baseline data
     void resetBaseline();
     
-    // Manually set an alert threshold
+    // Manually set an alert threshold; published as the device's anomalyThreshold
     void setThreshold(float threshold);
     
     // Save model to disk
     bool saveModel();
     
-    // Load model from disk
+    // Load model from disk (binary snapshot, else legacy per-hour XML files)
     bool loadModel();
     
+    // True if at least one hour has a usable model
+    bool hasTrainedModels();
+    
+    // Queue a write-behind save; never touches the filesystem on the caller's thread
+    void requestSave();
+    
+    // Rebuild the models from the feature log; returns the samples replayed
+    size_t retrainFromFeatureLog();
+    
+    // Hour models in memory, and their size summed over every detector
+    size_t residentModelCount();
+    static int64_t residentModelBytes() { return s_residentBytes.load(std::memory_order_relaxed); }
+    
 private:
+    static constexpr uint64_t kMinTrainedSamples = 100;
+    
+    struct ResidentModel {
+        std::unique_ptr<AnomalyModel> model;
+        uint64_t lastUse = 0;
+        uint64_t version = 0;        // Updates applied
+        uint64_t savedVersion = 0;   // Version the snapshot holds
+        size_t chargedBytes = 0;     // Counted in s_residentBytes
+    };
+    
+    struct EvictedModel {
+        uint64_t generation = 0;     // Tells a re-evicted model from the one a save wrote
+        SnapshotEntry entry;
+    };
+    
     // Device identification
     std::string m_deviceId;
     
-    // Configuration
-    std::shared_ptr<DeviceConfig> m_config;
+    // Configuration snapshot, swapped atomically by configure()
+    std::shared_ptr<const DeviceConfig> m_config;
     
-    // Anomaly models (time-based)
-    std::map<int, std::unique_ptr<AnomalyModel>> m_timeModels;  // Key: hour of day
+    // Anomaly models (time-based), key: hour of day
+    std::mutex m_modelMutex;
+    std::map<int, ResidentModel> m_models;
+    std::map<int, EvictedModel> m_evictedModels;   // Unsaved, until the next save
+    MappedSnapshot m_snapshot;                     // Last saved models, paged in on demand
+    int m_activeHour = -1;
+    int64_t m_latestUs = 0;                        // Newest event time seen
+    uint64_t m_useClock = 0;
+    uint64_t m_evictionGeneration = 0;
+    uint64_t m_resetCount = 0;                     // Saves begun before a reset leave m_snapshot closed
+    std::shared_ptr<Gauge> m_residentBytesGauge;
+    static std::atomic<int64_t> s_residentBytes;
     
-    // Baseline data collection
-    std::mutex m_baselineMutex;
-    std::map<int, std::vector<FeatureVector>> m_baselineData;  // Key: hour of day
+    // Baseline samples kept on disk for retraining
+    std::unique_ptr<FeatureLog> m_featureLog;
     
-    // Recent history for short-term pattern detection
-    std::deque<FeatureVector> m_recentHistory;
+    // Recent history for short-term burst and drift detection
+    std::mutex m_historyMutex;
+    ShortTermDetector m_shortTerm;
     
     // Thresholds
-    float m_anomalyThreshold;
+    std::atomic<float> m_anomalyThreshold;
+    
+    // Write-behind persistence
+    std::string m_modelDir;              // Created once in the constructor
+    uint64_t m_persistHandle = 0;
+    std::atomic<bool> m_dirty{false};    // Changed since the last save was queued
+    void markDirty();
     
     // Helper methods
     FeatureVector extractFeatures(const FrameAnalysisResult& result);
-    void trainModels();
+    std::unique_ptr<AnomalyModel> createModel() const;
+    
+    // Model for the frame's hour, moving the active hour along with event
+    // time; m_modelMutex must be held (as for the helpers below)
+    ResidentModel& modelFor(const FeatureVector& features);
+    ResidentModel& acquireModel(int hour);
+    void activateHour(int hour);
+    void evictModel(int hour);
+    void enforceBudget(int keepHour);   // Never evicts keepHour
+    void charge(ResidentModel& resident);
+    bool isPinned(int hour) const;
+    bool readStoredEntry(int hour, SnapshotEntry& entry) const;
+    
+    bool loadSnapshot();
+    bool importXmlModels();
+    std::string getSnapshotPath() const;
     std::string getModelFilePath(int hourOfDay) const;
-    int getHourOfDay(int64_t timestampUs) const;
+};
+
+/**
+ * What BaselineLearner::process did with a frame
+ */
+struct BaselineStep {
+    bool sampled = false;            // Added to the baseline
+    bool learningComplete = false;   // This sample ended learning mode
+    bool scored = false;             // Went through anomaly detection
+    bool anomaly = false;
+};
+
+/**
+ * Learning/detection state of one camera's baseline.
+ *
+ * While learning, analyzed frames are added to the baseline at most once
+ * per learningSampleIntervalSecs; after kLearningSamples samples the camera
+ * switches to detection, where every frame is scored and non-anomalous ones
+ * keep refining the baseline once per continuousLearningIntervalSecs.
+ * Samples are spaced by event time, so the statistics depend neither on
+ * how many frames are analyzed nor on how fast they arrive. The device
+ * agent and archive replay both train through this class. process() is
+ * called from one thread at a time; the mode and count may be read from
+ * any thread.
+ */
+class BaselineLearner {
+public:
+    static constexpr int kLearningSamples = 200;
+    static constexpr int kMinFinishSamples = 20;   // Fewest samples learning can be ended with
+    
+    BaselineStep process(AnomalyDetector& detector, FrameAnalysisResult& result, int64_t timestampUs,
+                         const DeviceConfig& config);
+    
+    // End learning early (learning was switched off); false if too few samples
+    bool finishLearning();
+    
+    bool isLearning() const { return m_learning; }
+    void setLearning(bool learning) { m_learning = learning; }
+    int sampleCount() const { return m_sampleCount; }
+    
+private:
+    std::atomic<bool> m_learning{true};
+    std::atomic<int> m_sampleCount{0};
+    int64_t m_lastSampleUs = 0;          // process() only
 };
 
 } // namespace nx_agent
@@ -0,0 +1,177 @@
+// nx_agent_attributes.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+/**
+ * Object classes the analysis logic cares about. Everything else is Other
+ * and only travels through to the VMS.
+ */
+enum class ObjectClass : uint8_t {
+    Other,
+    Person,
+    Vehicle
+};
+
+// Classify an Nx object type id ("person", "vehicle", ...)
+ObjectClass classifyObjectType(const std::string& typeId);
+
+/**
+ * An object type id with its class resolved once, on assignment, so the
+ * per-frame logic compares a byte instead of a string. Converts to and
+ * from std::string for the Nx boundary.
+ */
+class ObjectType {
+public:
+    ObjectType() = default;
+    ObjectType(std::string id) : m_id(std::move(id)), m_class(classifyObjectType(m_id)) {}
+    ObjectType(const char* id) : ObjectType(std::string(id)) {}
+
+    const std::string& id() const { return m_id; }
+    ObjectClass objectClass() const { return m_class; }
+    operator const std::string&() const { return m_id; }
+
+    bool operator==(ObjectClass objectClass) const { return m_class == objectClass; }
+    bool operator!=(ObjectClass objectClass) const { return m_class != objectClass; }
+
+private:
+    std::string m_id;
+    ObjectClass m_class = ObjectClass::Other;
+};
+
+// Interned attribute name
+using AttributeKey = uint16_t;
+
+namespace AttributeKeys {
+    // Well-known names, interned at fixed ids
+    constexpr AttributeKey RecognitionStatus = 0;   // "recognitionStatus"
+    constexpr AttributeKey VehicleType = 1;         // "vehicleType"
+    constexpr AttributeKey DurationSecs = 2;        // "durationSecs"
+
+    // Names come from camera metadata, so the table is bounded; names past
+    // it share the Uninterned id and the AttributeSet entry keeps the name
+    constexpr size_t kCapacity = 4096;
+    constexpr AttributeKey Uninterned = 0xFFFF;
+
+    // Id for a name, allocated on first use (Uninterned once the table is
+    // full); thread-safe, and names already interned only take a shared lock
+    AttributeKey intern(const std::string& name);
+
+    // Name for an id returned by intern(), empty for Uninterned; lock-free
+    const std::string& name(AttributeKey key);
+}
+
+/**
+ * Small flat attribute container. The first kInlineCapacity entries live
+ * inside the object, so typical detections (one or two attributes) never
+ * allocate for the container itself, and lookups by AttributeKey are a
+ * short linear scan. Name-based access interns the name first.
+ */
+class AttributeSet {
+public:
+    struct Entry {
+        AttributeKey key = 0;
+        std::string value;
+        std::string uninternedName;     // Name of an Uninterned entry
+
+        const std::string& name() const {
+            return key == AttributeKeys::Uninterned ? uninternedName : AttributeKeys::name(key);
+        }
+    };
+
+    static constexpr size_t kInlineCapacity = 4;
+
+    // Lookup; returns nullptr if the attribute is not set. Lookups by key
+    // alone cannot tell Uninterned names apart; the name overloads can.
+    const std::string* find(AttributeKey key) const;
+    const std::string* find(AttributeKey key, const std::string& name) const;
+    const std::string* find(const std::string& name) const { return find(AttributeKeys::intern(name), name); }
+
+    // True if the attribute is set to exactly this value
+    bool equals(AttributeKey key, const char* value) const {
+        const std::string* current = find(key);
+        return current && *current == value;
+    }
+
+    void set(AttributeKey key, std::string value);
+
+    // Map-style access; inserts an empty value if missing
+    std::string& operator[](AttributeKey key);
+    std::string& operator[](const std::string& name) { return slot(AttributeKeys::intern(name), name); }
+
+    // Map-style access for a name already interned as key
+    std::string& slot(AttributeKey key, const std::string& name);
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear();
+
+    const Entry& at(size_t index) const {
+        return index < kInlineCapacity ? m_inline[index] : m_overflow[index - kInlineCapacity];
+    }
+
+    // Copy out as a name -> value map
+    std::map<std::string, std::string> toMap() const;
+
+private:
+    Entry* findEntry(AttributeKey key, const std::string* name);
+    Entry& append(AttributeKey key);
+
+    std::array<Entry, kInlineCapacity> m_inline;
+    std::vector<Entry> m_overflow;
+    size_t m_size = 0;
+};
+
+// Value type of an attribute, as the plugin manifest declares it
+enum class AttributeType : uint8_t {
+    Unknown,    // Not declared: sent as a number when the whole value is one
+    String,
+    Float,
+    Int,
+    Boolean
+};
+
+// Parse a manifest type name ("float", "int", "string", "boolean")
+AttributeType parseAttributeType(const std::string& name);
+
+// Whole-string numeric conversion without exceptions; false (result
+// untouched) unless the entire value is a finite number
+bool parseAttributeNumber(const std::string& value, float& result);
+
+// Format a number as an attribute value, reusing value's buffer
+void formatAttributeNumber(float number, AttributeType type, std::string& value);
+
+/**
+ * Attribute value types per object type, read from the objectTypes of the
+ * plugin manifest, so object metadata is converted by declaration instead
+ * of by trial parsing. Built once and immutable afterwards; safe to share
+ * between threads.
+ */
+class AttributeSchema {
+public:
+    AttributeSchema() = default;
+
+    // Schema of a device agent manifest; empty if the manifest does not parse
+    static AttributeSchema fromManifest(const std::string& manifestJson);
+
+    void declare(const std::string& objectTypeId, AttributeKey key, AttributeType type);
+
+    // Unknown when the object type or the attribute is not declared
+    AttributeType type(const std::string& objectTypeId, AttributeKey key) const;
+
+    bool empty() const { return m_types.empty(); }
+
+private:
+    // Per object type id, indexed by AttributeKey
+    std::unordered_map<std::string, std::vector<AttributeType>> m_types;
+};
+
+} // namespace nx_agent
@@ -6,9 +6,12 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <functional>
 
 namespace nx_agent {
 
+class RegionIndex;
+
 /**
  * Represents a region of interest in the video frame.
  */
@@ -20,6 +23,12 @@ struct Region {
 
 /**
  * Configuration for a single camera/device.
+ *
+ * Published settings are immutable snapshots (std::shared_ptr<const
+ * DeviceConfig>). Components swap in a whole new snapshot on configure()
+ * and each frame reads the one it pinned, so a reader never sees a
+ * half-applied change. To change settings, edit a copy and publish it
+ * through GlobalConfig.
  */
 class DeviceConfig {
 public:
@@ -28,6 +37,7 @@ public:
     // Camera identification
     std::string deviceId;
     std::string deviceName;
+    std::string siteId;                            // Cameras of one site share incidents; empty = engine-wide
     
     // Detection settings
     float minPersonConfidence = 0.6f;
@@ -40,9 +50,39 @@ public:
     int unknownVisitorThresholdSecs = 300; // 5 minutes
     bool enableActivityAnalysis = true;
     
+    // Frame scheduling settings
+    bool enableAdaptiveFrameRate = true;           // Sample slowly while the scene is static
+    float idleFrameRate = 1.0f;                    // Analyzed frames per second while idle
+    int activityHoldSecs = 10;                     // Full rate is kept this long after the last activity
+    
+    // Tracking settings
+    float trackIouThreshold = 0.3f;                // Minimum box overlap to continue a track
+    float trackMaxDistance = 0.1f;                 // Otherwise, center distance gate as a fraction of the frame diagonal
+    int trackMaxAgeMs = 3000;                      // Tracks not seen for this long are dropped
+    
+    // Motion analysis settings
+    int motionAnalysisWidth = 320;                 // Motion runs at this width, 0 = native resolution
+    bool cropMotionToRegions = false;              // Only analyze the bounding box of the regions of interest
+    std::string motionEngine = "mog2";             // "mog2", or "fast" (running average) for low-power hosts
+    int fastMotionThreshold = 20;                  // Fast engine: luma difference from the background that is motion
+    int fastMotionAdaptShift = 6;                  // Fast engine: background moves 1/2^n of the difference per frame
+    std::string analysisMode = "decoded";          // "decoded", "compressed" or "metadataOnly" (no server-side decode)
+    float compressedMotionScale = 0.05f;           // Compressed mode: motion level per unit of relative inter-frame growth
+    
     // Learning settings
     bool enableLearning = true;
     int baselineDurationDays = 7;
+    int learningSampleIntervalSecs = 5;            // Baseline sampling period while learning
+    int continuousLearningIntervalSecs = 20;       // Baseline sampling period in detection mode
+    float baselineDecay = 0.0f;                    // Per-sample forgetting factor, 0 = never forget
+    std::string anomalyModel = "diagonal";         // "diagonal", or "fullCovariance" to learn how features co-vary
+    bool enableShortTermDetection = true;          // Also flag bursts and drifts against the last 30 minutes
+    
+    // Processing pipeline settings
+    bool enableAsyncPipeline = true;               // Analyze frames off the SDK delivery thread
+    int pipelineQueueCapacity = 4;                 // Frames buffered per pipeline stage
+    std::string frameDropPolicy = "keepLatest";    // "keepLatest" or "dropAlternate"
+    bool sendAttributeChangesOnly = true;          // Send a track's attributes only when they change
     
     // Schedule settings (in seconds from midnight)
     struct TimeRange {
@@ -54,11 +94,17 @@ public:
         {8 * 3600, 18 * 3600} // 8 AM to 6 PM by default
     };
     
+    // Derived from the settings above by freeze(); not serialized
+    std::shared_ptr<const RegionIndex> regionIndex;    // Compiled detectionRegions
+    
     // Load settings from JSON string
     bool loadFromJson(const std::string& jsonStr);
     
     // Serialize to JSON string
     std::string toJson() const;
+    
+    // Snapshot of these settings with the derived data rebuilt
+    static std::shared_ptr<const DeviceConfig> freeze(DeviceConfig config);
 };
 
 /**
@@ -73,6 +119,41 @@ public:
     int maxStorageSizeMB = 1024;
     bool enableDiagnostics = true;
     int diagnosticLogLevel = 2; // 0=off, 1=error, 2=warn, 3=info, 4=debug
+    int modelPersistIntervalSecs = 60; // How often changed models are written to disk
+    int modelCacheBudgetKB = 16384;     // Hour models kept in memory across all devices; 0 = unlimited
+    
+    // Object detection, shared by every device
+    std::string detectorBackend = "simulated"; // "simulated" or "opencv" (Caffe/TensorFlow/ONNX via OpenCV DNN)
+    std::string detectorModelPath = "";
+    std::string detectorConfigPath = "";
+    int detectorInputSize = 300;        // Square network input, in pixels
+    float detectorMinConfidence = 0.5f;
+    int detectorMaxBatchSize = 8;       // Frames from any devices combined into one inference
+    int detectorMaxLatencyMs = 20;      // Longest a frame waits for its batch to fill
+    bool detectorUseCuda = false;
+    
+    // Webhook delivery, shared by every device
+    int httpMaxInFlight = 16;           // Concurrent requests
+    int httpMaxRetries = 3;
+    int httpRetryBackoffMs = 500;       // First retry delay, doubled on each attempt
+    int httpBatchWindowMs = 250;        // Alerts to one URL within this window share a request; 0 disables
+    int httpTimeoutMs = 10000;
+    
+    // Cross-camera incident correlation
+    int incidentWindowSecs = 30;        // Responses this close together form one incident; 0 disables
+    int incidentMaxDurationSecs = 300;  // An incident is re-announced after this long
+    int incidentMaxOpen = 256;          // Open incidents kept; the quietest is evicted beyond this
+    int incidentHoldMs = 2000;          // A new incident's response waits this long for other cameras
+    
+    // Metrics export
+    int metricsIntervalSecs = 60;       // Status event and metrics file period; 0 disables both
+    std::string metricsFilePath = "";   // Prometheus text file; empty means <dataStoragePath>/metrics.prom
+    
+    // Model replication for warm failover between servers
+    std::string replicationTarget = ""; // Shared directory or http(s):// URL; empty disables
+    int replicationIntervalSecs = 60;   // Shortest time between replications of a device
+    int replicationMaxKBps = 1024;      // Upload bandwidth shared by all devices; 0 is unlimited
+    int replicationRestoreTimeoutMs = 2000; // A starting device waits this long for its replica
     
     // SIP/notification settings
     bool enableSipIntegration = false;
@@ -84,29 +165,41 @@ public:
     // Load global settings from JSON
     bool loadFromJson(const std::string& jsonStr);
     
-    // Get device configuration (creates if doesn't exist)
-    std::shared_ptr<DeviceConfig> getDeviceConfig(const std::string& deviceId);
+    // Current settings of a device (created with defaults if it has none).
+    // Lock-free once the device exists; the snapshot never changes, so call
+    // again to see later updates.
+    std::shared_ptr<const DeviceConfig> getDeviceConfig(const std::string& deviceId);
     
     // Save all configurations
     bool saveConfig();
     
-    // Update a device's configuration
-    void updateDeviceConfig(const std::shared_ptr<DeviceConfig>& config);
+    // Publish new settings for config.deviceId
+    std::shared_ptr<const DeviceConfig> updateDeviceConfig(DeviceConfig config);
+    
+    // Publish the current settings of a device with edit applied. Edits
+    // are applied one at a time, so concurrent edits of different fields
+    // are all kept.
+    std::shared_ptr<const DeviceConfig> modifyDeviceConfig(const std::string& deviceId,
+                                                           const std::function<void(DeviceConfig&)>& edit);
     
 private:
     GlobalConfig();
     ~GlobalConfig();
     
-    // Device-specific configurations
-    std::map<std::string, std::shared_ptr<DeviceConfig>> m_deviceConfigs;
+    using DeviceConfigMap = std::map<std::string, std::shared_ptr<const DeviceConfig>>;
+    
+    // Device-specific configurations; readers load the map atomically and
+    // writers, serialized by m_configMutex, publish a modified copy
+    std::shared_ptr<const DeviceConfigMap> m_deviceConfigs;
     std::mutex m_configMutex;
+    void publish(std::shared_ptr<const DeviceConfig> config);
     
     // Private implementation to prevent copying
     GlobalConfig(const GlobalConfig&) = delete;
     GlobalConfig& operator=(const GlobalConfig&) = delete;
 };
 
-// Helper to parse settings from Nx Meta settings model
-void parseSettings(const nx::sdk::ISettingsResponse* settings, std::shared_ptr<DeviceConfig> config);
+// Helper to parse settings from Nx Meta settings model into a copy to publish
+void parseSettings(const nx::sdk::ISettingsResponse* settings, DeviceConfig& config);
 
 } // namespace nx_agent
@@ -0,0 +1,158 @@
+// nx_agent_detector.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <opencv2/dnn.hpp>
+
+#include "nx_agent_metadata.h"
+#include "nx_agent_utils.h"
+
+namespace nx_agent {
+
+// Forward declarations
+class GlobalConfig;
+
+/**
+ * An object detection model. detect() receives a batch of frames, possibly
+ * from different devices, and returns one list of objects per frame in
+ * pixel coordinates of that frame. Calls are serialized by the owner.
+ */
+class ObjectDetectorBackend {
+public:
+    virtual ~ObjectDetectorBackend() = default;
+
+    virtual std::string name() const = 0;
+
+    // Largest batch the backend accepts in one call
+    virtual size_t maxBatchSize() const { return 1; }
+
+    virtual std::vector<std::vector<DetectedObject>> detect(
+        const std::vector<const ImageUtils::FrameView*>& frames) = 0;
+};
+
+/**
+ * Random people and vehicles, for testing without a model. The draws are
+ * seeded from the frame's pixels, so the same frames always give the same
+ * detections, as a real model would.
+ */
+class SimulatedDetectorBackend : public ObjectDetectorBackend {
+public:
+    std::string name() const override { return "simulated"; }
+    size_t maxBatchSize() const override { return 64; }
+
+    std::vector<std::vector<DetectedObject>> detect(
+        const std::vector<const ImageUtils::FrameView*>& frames) override;
+};
+
+/**
+ * SSD-style detector run through OpenCV DNN. Loads any model format
+ * cv::dnn::readNet understands (Caffe, TensorFlow, ONNX, ...) and expects
+ * the usual DetectionOutput layout: [1, 1, N, 7] rows of
+ * (imageId, classId, confidence, left, top, right, bottom), normalized.
+ */
+class OpenCvDnnDetectorBackend : public ObjectDetectorBackend {
+public:
+    OpenCvDnnDetectorBackend(const std::string& modelPath, const std::string& configPath,
+                             int inputSize, float minConfidence, size_t maxBatch, bool useCuda);
+
+    bool isLoaded() const { return !m_net.empty(); }
+
+    std::string name() const override { return "opencv"; }
+    size_t maxBatchSize() const override { return m_maxBatch; }
+
+    std::vector<std::vector<DetectedObject>> detect(
+        const std::vector<const ImageUtils::FrameView*>& frames) override;
+
+private:
+    // Map a COCO class id to one of our object types, empty if not of interest
+    static std::string typeForClass(int classId);
+
+    cv::dnn::Net m_net;
+    int m_inputSize;
+    float m_minConfidence;
+    size_t m_maxBatch;
+};
+
+// Create the backend selected in the global configuration. Falls back to
+// the simulated backend if the model cannot be loaded.
+std::shared_ptr<ObjectDetectorBackend> createDetectorBackend(const GlobalConfig& config);
+
+/**
+ * Batching counters
+ */
+struct DetectionBatcherStats {
+    uint64_t batches = 0;
+    uint64_t frames = 0;
+    uint64_t failures = 0;         // Batches whose inference threw
+    double avgBatchSize = 0.0;
+    size_t maxBatchSize = 0;
+    double avgWaitUs = 0.0;        // Time from submit() to the start of inference
+    size_t pending = 0;
+};
+
+/**
+ * Collects detection requests from every device and runs them through one
+ * backend in batches. A batch is started as soon as it is full or its
+ * oldest frame has waited maxLatency, so quiet systems do not trade latency
+ * for throughput. Results are delivered through each request's callback on
+ * the batcher thread.
+ */
+class DetectionBatcher {
+public:
+    using Callback = std::function<void(std::vector<DetectedObject> objects, bool ok)>;
+
+    DetectionBatcher(std::shared_ptr<ObjectDetectorBackend> backend, size_t maxBatch,
+                     std::chrono::microseconds maxLatency);
+    ~DetectionBatcher();
+
+    DetectionBatcher(const DetectionBatcher&) = delete;
+    DetectionBatcher& operator=(const DetectionBatcher&) = delete;
+
+    // Queue a frame; the view must stay valid until the callback runs
+    void submit(const std::string& deviceId, const ImageUtils::FrameView& frame, Callback callback);
+
+    // Run everything still queued and stop the worker
+    void stop();
+
+    std::string backendName() const { return m_backend->name(); }
+    DetectionBatcherStats stats() const;
+
+private:
+    struct Request {
+        std::string deviceId;
+        const ImageUtils::FrameView* frame;
+        Callback callback;
+        std::chrono::steady_clock::time_point submittedAt;
+    };
+
+    void run();
+    void runBatch(std::vector<Request>& batch);
+
+    std::shared_ptr<ObjectDetectorBackend> m_backend;
+    size_t m_maxBatch;
+    std::chrono::microseconds m_maxLatency;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Request> m_queue;
+    bool m_stopping = false;
+    std::thread m_worker;
+
+    // Statistics (guarded by m_mutex)
+    uint64_t m_batches = 0;
+    uint64_t m_frames = 0;
+    uint64_t m_failures = 0;
+    size_t m_largestBatch = 0;
+    uint64_t m_totalWaitUs = 0;
+};
+
+} // namespace nx_agent
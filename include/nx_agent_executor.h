@@ -0,0 +1,120 @@
+// nx_agent_executor.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+namespace nx_agent {
+
+/**
+ * Scheduling lanes; a worker always takes the most urgent runnable task
+ */
+enum class TaskPriority {
+    Alarm = 0,       // Response dispatch for verified anomalies
+    Normal = 1,      // Per-frame device pipeline work
+    Background = 2   // Model training and other housekeeping
+};
+
+/**
+ * Executor counters
+ */
+struct ExecutorStats {
+    size_t workerCount = 0;
+    size_t pending = 0;
+    uint64_t submitted = 0;
+    uint64_t executed = 0;
+    uint64_t stolen = 0;
+    double stealRate = 0.0;           // Fraction of executed tasks that were stolen
+    double avgLatencyUs = 0.0;        // Average queueing delay before a task starts
+    uint64_t maxLatencyUs = 0;
+    std::array<uint64_t, 3> executedByPriority = {{0, 0, 0}};
+};
+
+/**
+ * Work-stealing thread pool shared by all device agents of an engine.
+ *
+ * Tasks submitted from outside the pool go to a per-priority queue that is
+ * served round-robin by key (normally the device ID), so one busy camera
+ * cannot starve the others. Tasks submitted from a worker go to that
+ * worker's own deque, and idle workers steal from their peers.
+ */
+class TaskExecutor {
+public:
+    using Task = std::function<void()>;
+
+    // workerCount == 0 sizes the pool to the hardware concurrency
+    explicit TaskExecutor(size_t workerCount = 0);
+    ~TaskExecutor();
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    // Queue a task; key groups tasks for fairness (e.g. a device ID)
+    void submit(const std::string& key, TaskPriority priority, Task task);
+
+    // Run everything still queued, then stop the workers
+    void shutdown();
+
+    size_t workerCount() const { return m_workers.size(); }
+    ExecutorStats stats() const;
+
+private:
+    static constexpr size_t kLaneCount = 3;
+
+    struct Item {
+        Task task;
+        std::chrono::steady_clock::time_point enqueuedAt;
+    };
+
+    // Per-worker deques, one per priority lane
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::array<std::deque<Item>, kLaneCount> lanes;
+    };
+
+    // Round-robin over keys for tasks submitted from outside the pool
+    struct FairLane {
+        std::map<std::string, std::deque<Item>> byKey;
+        std::deque<std::string> rotation;  // Keys with pending work, in service order
+    };
+
+    void workerLoop(size_t index);
+    bool takeTask(size_t index, Item& item, bool& stolen, size_t& lane);
+    bool popFair(size_t lane, Item& item);
+    bool popLocal(size_t index, size_t lane, Item& item);
+    bool steal(size_t thief, size_t lane, Item& item);
+    void execute(Item& item, bool stolen, size_t lane);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+    std::mutex m_fairMutex;
+    std::array<FairLane, kLaneCount> m_fairLanes;
+
+    // Idle workers park here until work arrives
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    std::atomic<size_t> m_pending{0};
+    std::atomic<bool> m_stopping{false};
+
+    // Statistics
+    std::atomic<uint64_t> m_submitted{0};
+    std::atomic<uint64_t> m_executed{0};
+    std::atomic<uint64_t> m_stolen{0};
+    std::atomic<uint64_t> m_totalLatencyUs{0};
+    std::atomic<uint64_t> m_maxLatencyUs{0};
+    std::array<std::atomic<uint64_t>, kLaneCount> m_executedByLane;
+};
+
+} // namespace nx_agent
@@ -0,0 +1,142 @@
+// nx_agent_featurelog.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "nx_agent_anomaly.h"
+
+namespace nx_agent {
+
+/**
+ * On-disk layout of a feature log segment: one file per UTC day of event
+ * time ("<day>.nxflog", days since the epoch), holding appended blocks
+ *
+ *   FeatureLogBlockHeader, payload[payloadSize]
+ *
+ * The payload is columnar. Timestamps are delta-of-delta and the integer
+ * fields (time of day, day of week, counts) delta coded, each as zigzag
+ * varints; every float column is bit-packed as the XOR with its previous
+ * value (leading zeros, significant length, significant bits). A block
+ * failing its checksum (CRC-32 of the payload) is skipped and a malformed
+ * header ends the segment, so an append torn by a crash loses only itself.
+ */
+struct FeatureLogBlockHeader {
+    uint32_t magic;            // kFeatureLogMagic
+    uint32_t version;          // kFeatureLogVersion
+    uint32_t sampleCount;
+    uint32_t floatColumns;     // Motion level, then the additional features
+    uint32_t payloadSize;
+    uint32_t checksum;
+    int64_t firstUs;
+    int64_t lastUs;
+};
+
+constexpr uint32_t kFeatureLogMagic = 0x4c46584e;  // "NXFL"
+constexpr uint32_t kFeatureLogVersion = 1;
+
+/**
+ * Append-only log of one device's baseline samples, so the baseline can be
+ * retrained after a restart, a lost snapshot or a model change without
+ * waiting baselineDurationDays for new samples.
+ *
+ * append() only buffers; flush() (called with the model saves, on the
+ * persistence thread) writes the buffered samples as one block per day,
+ * compacts the previous day's small blocks into large ones when the day
+ * rolls over and deletes segments older than the retention. Thread-safe.
+ */
+class FeatureLog {
+public:
+    static constexpr uint32_t kMaxBlockSamples = 4096;
+
+    explicit FeatureLog(std::string directory);
+    ~FeatureLog();
+
+    FeatureLog(const FeatureLog&) = delete;
+    FeatureLog& operator=(const FeatureLog&) = delete;
+
+    // Days of event time kept before the newest; 0 keeps everything
+    void setRetentionDays(int days) { m_retentionDays = days; }
+
+    void append(const FeatureVector& features);
+
+    // Write buffered samples; false if a segment could not be written (the samples are dropped)
+    bool flush();
+
+    // Drop the buffered samples and delete every segment
+    void clear();
+
+    const std::string& directory() const { return m_directory; }
+
+    // Segment paths, oldest day first
+    std::vector<std::string> segments() const;
+
+    // Samples buffered, not yet written
+    size_t pendingCount() const;
+
+    // Delete the oldest feature log segments under rootPath (a data storage
+    // directory of per-device subdirectories) until everything under it
+    // fits in maxBytes. A device's newest segment is never deleted.
+    static void enforceQuota(const std::string& rootPath, uint64_t maxBytes);
+
+    // Encode samples as one block (header and payload)
+    static std::vector<uint8_t> encodeBlock(const std::vector<FeatureVector>& samples, size_t begin, size_t end);
+
+private:
+    bool writeSegment(int64_t day, const std::vector<FeatureVector>& samples, size_t begin, size_t end);
+    bool compactSegment(int64_t day);
+    void dropExpired(int64_t newestDay);
+    std::string segmentPath(int64_t day) const;
+
+    std::string m_directory;
+    std::atomic<int> m_retentionDays{0};
+
+    mutable std::mutex m_pendingMutex;
+    std::vector<FeatureVector> m_pending;
+    uint64_t m_clearGeneration = 0;
+
+    std::mutex m_fileMutex;           // Held while segments are written or deleted
+    int64_t m_openDay = -1;           // Day appended to last; -1 until known
+};
+
+/**
+ * Streams the samples of a feature log, segment by segment and block by
+ * block, decoding one block at a time.
+ */
+class FeatureLogReader {
+public:
+    // Every segment in the directory, oldest day first
+    explicit FeatureLogReader(const std::string& directory);
+
+    // A single segment file
+    static FeatureLogReader forSegment(const std::string& filePath);
+
+    bool next(FeatureVector& features);
+
+    // Blocks skipped for a bad header or checksum
+    uint64_t corruptBlocks() const { return m_corruptBlocks; }
+
+    // Decode one block's payload; false if it is malformed
+    static bool decodeBlock(const FeatureLogBlockHeader& header, const uint8_t* payload,
+                            std::vector<FeatureVector>& samples);
+
+private:
+    FeatureLogReader() = default;
+
+    bool loadNextBlock();
+
+    std::vector<std::string> m_segments;
+    size_t m_nextSegment = 0;
+    std::vector<uint8_t> m_data;        // Current segment
+    size_t m_offset = 0;
+
+    std::vector<FeatureVector> m_block;
+    size_t m_blockIndex = 0;
+    uint64_t m_corruptBlocks = 0;
+};
+
+} // namespace nx_agent
@@ -0,0 +1,71 @@
+// nx_agent_framepool.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+
+namespace nx_agent {
+
+class Counter;
+
+/**
+ * Frame pool counters
+ */
+struct FramePoolStats {
+    uint64_t hits = 0;         // Requests served from a pooled buffer
+    uint64_t misses = 0;       // Requests that allocated
+    size_t buffers = 0;        // Buffers owned by the pool
+    size_t bytes = 0;
+};
+
+/**
+ * Per-device pool of image buffers. acquire() hands out an ordinary
+ * cv::Mat that shares a pooled allocation; once every other copy of it is
+ * released the buffer is free again, so frames, converted planes and
+ * masks can travel through the pipeline and come back without any
+ * explicit release. Buffers are kept per shape (rows, cols, type); when
+ * the stream changes resolution the idle buffers of shapes no longer
+ * requested are dropped. Thread-safe.
+ */
+class FramePool {
+public:
+    explicit FramePool(const std::string& deviceId, size_t maxBuffersPerShape = 16);
+
+    // An uninitialized buffer of exactly this shape
+    cv::Mat acquire(int rows, int cols, int type);
+
+    FramePoolStats stats() const;
+
+private:
+    using Shape = std::tuple<int, int, int>; // rows, cols, type
+
+    struct Slot {
+        std::vector<cv::Mat> buffers;
+        uint64_t lastUse = 0;                    // m_acquisitions when last requested
+    };
+
+    // A shape not requested for this many acquisitions is considered gone
+    static constexpr uint64_t kShapeExpiry = 1000;
+
+    // True if only the pool still refers to the buffer
+    static bool isIdle(const cv::Mat& buffer);
+
+    size_t m_maxBuffersPerShape;
+
+    mutable std::mutex m_mutex;
+    std::map<Shape, Slot> m_slots;
+    uint64_t m_acquisitions = 0;
+
+    std::shared_ptr<Counter> m_hits;
+    std::shared_ptr<Counter> m_misses;
+};
+
+} // namespace nx_agent
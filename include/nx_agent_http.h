@@ -0,0 +1,141 @@
+// nx_agent_http.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+// Forward declarations
+class GlobalConfig;
+
+/**
+ * Limits and timing for the HTTP dispatcher
+ */
+struct HttpDispatcherOptions {
+    size_t maxInFlight = 16;                            // Concurrent transfers across all hosts
+    size_t maxHostConnections = 4;                      // Kept-alive connections per host
+    size_t maxQueued = 1024;                            // Alerts waiting to be sent, including retries
+    int maxRetries = 3;
+    std::chrono::milliseconds retryBackoff{500};        // Doubled on every attempt
+    std::chrono::milliseconds batchWindow{250};         // 0 sends every alert on its own
+    size_t maxBatchSize = 20;
+    std::chrono::milliseconds timeout{10000};
+    std::chrono::milliseconds connectTimeout{3000};
+};
+
+// Options from the global http* settings
+HttpDispatcherOptions httpDispatcherOptions(const GlobalConfig& config);
+
+/**
+ * Dispatcher counters
+ */
+struct HttpDispatcherStats {
+    uint64_t posted = 0;       // Alerts accepted by post()
+    uint64_t requests = 0;     // HTTP requests completed successfully
+    uint64_t delivered = 0;    // Alerts in those requests
+    uint64_t retried = 0;
+    uint64_t failed = 0;       // Alerts given up on after the last retry
+    uint64_t dropped = 0;      // Alerts refused because the queue was full
+    size_t inFlight = 0;
+    size_t queued = 0;
+};
+
+/**
+ * Engine-wide webhook sender. A single thread drives every transfer
+ * through one curl multi handle, which keeps connections to each host
+ * alive between alerts, so a storm costs neither a thread nor a TLS
+ * handshake per alert. Alerts for the same URL that arrive within the
+ * batch window are sent as one request: a lone alert is posted as is,
+ * several are posted as a JSON array of the individual payloads.
+ * Transport errors, 429 and 5xx responses are retried with exponential
+ * backoff.
+ */
+class HttpDispatcher {
+public:
+    explicit HttpDispatcher(HttpDispatcherOptions options = HttpDispatcherOptions());
+    ~HttpDispatcher();
+
+    HttpDispatcher(const HttpDispatcher&) = delete;
+    HttpDispatcher& operator=(const HttpDispatcher&) = delete;
+
+    // Queue a JSON payload to be POSTed to url; never blocks. Returns false
+    // if the alert was refused (queue full or dispatcher stopped).
+    bool post(const std::string& url, const std::string& jsonPayload);
+
+    // Send what is queued without further retries, then stop. Transfers
+    // still running after the request timeout are abandoned.
+    void stop();
+
+    HttpDispatcherStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Alerts for one URL waiting for their batch window to close
+    struct Batch {
+        std::vector<std::string> payloads;
+        Clock::time_point dueAt;
+    };
+
+    // One HTTP request, possibly carrying several alerts
+    struct Transfer {
+        std::string url;
+        std::string host;
+        std::string body;
+        size_t alerts = 0;
+        int attempt = 0;
+        Clock::time_point dueAt;
+        void* handle = nullptr;     // CURL*
+    };
+
+    void run();
+    void startTransfer(std::unique_ptr<Transfer> transfer);
+    void finishTransfer(std::unique_ptr<Transfer> transfer, bool ok, bool retryable, const std::string& error);
+    Clock::duration pollTimeout(Clock::time_point now);
+    void* acquireHandle(const std::string& host);
+    void releaseHandle(const std::string& host, void* handle);
+    void wake();
+
+    static std::string hostOf(const std::string& url);
+    static std::string batchBody(std::vector<std::string>& payloads);
+
+    HttpDispatcherOptions m_options;
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Batch> m_batches;                 // url -> open batch
+    std::deque<std::unique_ptr<Transfer>> m_ready;          // Waiting for a transfer slot
+    std::vector<std::unique_ptr<Transfer>> m_retries;       // Waiting for their backoff
+    size_t m_queuedAlerts = 0;
+    bool m_stopping = false;
+    Clock::time_point m_stopDeadline;
+
+    // Created and destroyed with the dispatcher; only wake() uses m_multi off the worker
+    void* m_multi = nullptr;                                // CURLM*
+    void* m_headers = nullptr;                              // curl_slist*
+
+    // Worker thread only
+    std::map<void*, std::unique_ptr<Transfer>> m_running;   // handle -> transfer
+    std::map<std::string, std::vector<void*>> m_idleHandles;
+    std::thread m_worker;
+
+    // Statistics
+    std::atomic<uint64_t> m_posted{0};
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_delivered{0};
+    std::atomic<uint64_t> m_retried{0};
+    std::atomic<uint64_t> m_failed{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<size_t> m_inFlight{0};
+};
+
+} // namespace nx_agent
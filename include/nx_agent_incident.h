@@ -0,0 +1,121 @@
+// nx_agent_incident.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+/**
+ * What the correlator decided about one device's response
+ */
+struct IncidentDecision {
+    bool lead = true;          // This device opened the incident and runs the action
+    uint64_t incidentId = 0;
+};
+
+/**
+ * An incident as its response sees it: every report merged into it while
+ * the response was held
+ */
+struct IncidentSummary {
+    uint64_t id = 0;
+    std::string anomalyType;
+    std::string actionName;
+    std::vector<std::string> devices;   // Reporting cameras, the lead first
+    uint64_t reports = 0;
+    float maxScore = 0.0f;
+};
+
+/**
+ * Correlator counters
+ */
+struct IncidentStats {
+    uint64_t opened = 0;       // Incidents created; one external response each
+    uint64_t merged = 0;       // Responses folded into an existing incident
+    uint64_t evicted = 0;      // Incidents dropped early to stay within maxOpen
+    size_t open = 0;
+};
+
+/**
+ * Engine-wide deduplication of external responses (webhooks, calls,
+ * commands). Reports are grouped by site, anomaly type and action; the
+ * first report opens an incident and every report of the same group that
+ * follows within the window - from any camera - is merged into it instead
+ * of triggering again. The incident's response is held for holdUs after it
+ * opens, so the reports arriving meanwhile are merged into what it sends,
+ * and then runs once, on the correlator thread (inline with a zero hold).
+ * The window slides with each merged report, up to maxDuration from the
+ * first one, after which a new incident is opened so long-running
+ * situations are re-announced. Cameras' frame clocks are not comparable,
+ * so every window is measured on the steady clock at report time. At most
+ * maxOpen incidents are kept; closed ones are logged with their camera
+ * count and removed.
+ */
+class IncidentCorrelator {
+public:
+    // Runs the incident's response; called once, for the lead report only
+    using Dispatch = std::function<void(const IncidentSummary& incident)>;
+
+    IncidentCorrelator(int64_t windowUs, int64_t maxDurationUs, size_t maxOpen, int64_t holdUs = 0);
+    ~IncidentCorrelator();
+
+    IncidentDecision report(const std::string& siteId, const std::string& anomalyType,
+                            const std::string& actionName, const std::string& deviceId,
+                            float score, Dispatch dispatch);
+
+    IncidentStats stats() const;
+
+private:
+    using Key = std::tuple<std::string, std::string, std::string>; // site, anomaly type, action
+
+    struct Incident {
+        uint64_t id = 0;
+        int64_t firstUs = 0;           // Steady clock
+        int64_t lastUs = 0;
+        float maxScore = 0.0f;
+        uint64_t reports = 0;
+        std::vector<std::string> devices;
+        Dispatch dispatch;             // Set while the response is held
+    };
+
+    struct Response {
+        Dispatch dispatch;
+        IncidentSummary incident;
+    };
+
+    static int64_t nowUs();
+    static IncidentSummary summarize(const Key& key, const Incident& incident);
+
+    // Close incidents whose window has passed; caller holds m_mutex
+    void expire(int64_t nowUs, std::vector<Response>& due);
+    void close(const Key& key, Incident& incident, const char* reason, std::vector<Response>& due);
+    void run(std::vector<Response>& due);
+
+    // Releases held responses as their hold runs out
+    void releaseHeld();
+
+    int64_t m_windowUs;
+    int64_t m_maxDurationUs;
+    size_t m_maxOpen;
+    int64_t m_holdUs;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::map<Key, Incident> m_incidents;
+    uint64_t m_nextId = 1;
+    IncidentStats m_stats;
+    bool m_stopping = false;
+    std::thread m_worker;
+};
+
+} // namespace nx_agent
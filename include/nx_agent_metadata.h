@@ -6,27 +6,49 @@
 #include <map>
 #include <memory>
 #include <chrono>
+#include <atomic>
 #include <nx/sdk/analytics/helpers/object_metadata.h>
 #include <opencv2/opencv.hpp>
 
+#include "nx_agent_attributes.h"
+#include "nx_agent_regions.h"
+#include "nx_agent_metrics.h"
+#include "nx_agent_motion.h"
+#include "nx_agent_tracker.h"
+#include "nx_agent_utils.h"
+
 namespace nx_agent {
 
 // Forward declarations
 class DeviceConfig;
+class ObjectDetectorBackend;
+class FramePool;
 
 /**
  * Represents a detected object with its metadata
  */
 struct DetectedObject {
-    std::string typeId;                   // Object type (person, vehicle, etc.)
+    ObjectType typeId;                    // Object type (person, vehicle, etc.)
     float confidence;                     // Detection confidence (0.0-1.0)
     cv::Rect boundingBox;                 // Object bounding box in pixel coordinates
-    std::map<std::string, std::string> attributes; // Additional attributes
+    AttributeSet attributes;              // Additional attributes
     int64_t timestampUs;                  // Detection timestamp in microseconds
     std::string trackId;                  // Tracking ID (if available)
     
-    // Convert to Nx ObjectMetadata
-    nx::sdk::analytics::ObjectMetadata toNxObjectMetadata() const;
+    // Filled by the ObjectTracker
+    uint32_t trackNumber = 0;             // Tracker-assigned id, 0 = not tracked
+    float dwellSecs = 0.0f;               // Time since the track was first seen
+    cv::Point2f velocity;                 // Center velocity in frame widths/heights per second
+    float zoneDwellSecs = 0.0f;           // Continuous time inside the regions of interest
+    
+    // A person whose recognition status is "unknown"
+    bool isUnknownPerson() const {
+        return typeId == ObjectClass::Person &&
+               attributes.equals(AttributeKeys::RecognitionStatus, "unknown");
+    }
+    
+    // Convert to Nx ObjectMetadata, typing attributes by the schema if given
+    nx::sdk::analytics::ObjectMetadata toNxObjectMetadata(const AttributeSchema* schema = nullptr) const;
 };
 
 /**
@@ -34,17 +56,53 @@ struct DetectedObject {
  */
 struct MotionInfo {
     float overallMotionLevel;            // Overall motion level (0.0-1.0)
-    cv::Mat motionMask;                  // Binary mask showing motion areas
-    std::vector<cv::Point> motionCenters; // Centers of motion regions
+    cv::Mat motionMask;                  // Binary mask showing motion areas (analysis resolution)
+    std::vector<cv::Point> motionCenters; // Centers of motion regions (native pixel coordinates)
     int64_t timestampUs;                 // Timestamp in microseconds
 };
 
+/**
+ * Per-frame object and calendar statistics, computed once when a frame's
+ * objects are known and read by every scorer and feature extractor.
+ * All calendar fields derive from the frame timestamp, not the wall clock.
+ */
+struct FrameSummary {
+    bool valid = false;                  // Set once the summary has been computed
+    
+    int personCount = 0;
+    int unknownPersonCount = 0;
+    int vehicleCount = 0;
+    int otherCount = 0;
+    
+    // Object centers inside/outside the regions of interest
+    int objectsInRegions = 0;
+    int objectsOutsideRegions = 0;
+    int personsOutsideRegions = 0;
+    
+    // Track statistics (zero for objects the tracker has not seen)
+    float maxDwellSecs = 0.0f;
+    float maxUnknownPersonDwellSecs = 0.0f;
+    float maxZoneDwellSecs = 0.0f;
+    float meanSpeed = 0.0f;              // Mean speed of tracked objects, frame sizes per second
+    
+    int timeOfDaySeconds = 0;            // Local time of the frame
+    int hourOfDay = 0;
+    int dayOfWeek = 0;                   // 0 = Sunday
+    bool duringBusinessHours = false;
+    
+    // Counts and calendar fields only (no regions or business hours)
+    static FrameSummary fromObjects(const std::vector<DetectedObject>& objects, int64_t timestampUs);
+};
+
 /**
  * Represents analysis results for a single frame
  */
 struct FrameAnalysisResult {
     int64_t timestampUs;                 // Frame timestamp
+    int frameWidth;                      // Native frame size the objects are measured in
+    int frameHeight;
     std::vector<DetectedObject> objects; // Detected objects
+    FrameSummary summary;                // Statistics over objects, filled by the analyzer
     MotionInfo motionInfo;               // Motion information
     float anomalyScore;                  // Overall anomaly score (0.0-1.0)
     std::string anomalyType;             // Type of anomaly (if any)
@@ -54,6 +112,8 @@ struct FrameAnalysisResult {
     // Default constructor
     FrameAnalysisResult() : 
         timestampUs(0), 
+        frameWidth(0),
+        frameHeight(0),
         anomalyScore(0.0f), 
         isAnomaly(false) {}
 };
@@ -67,7 +127,7 @@ public:
     ~MetadataAnalyzer();
     
     // Configure the analyzer
-    void configure(std::shared_ptr<DeviceConfig> config);
+    void configure(std::shared_ptr<const DeviceConfig> config);
     
     // Process a video frame and return analysis results
     FrameAnalysisResult processFrame(
@@ -75,47 +135,122 @@ public:
         int64_t timestampUs,
         const nx::sdk::analytics::IMetadataPacket* existingMetadata = nullptr);
     
-    // Process existing metadata without a frame
+    // Process a frame view; motion runs on the luma plane and colour is
+    // only converted if a detector asks for it
+    FrameAnalysisResult processFrame(
+        const ImageUtils::FrameView& frame,
+        int64_t timestampUs,
+        const nx::sdk::analytics::IMetadataPacket* existingMetadata = nullptr);
+    
+    // The two halves of processFrame, for callers that run them on
+    // different threads: motion first, then scoring once objects are known
+    FrameAnalysisResult analyzeMotion(const ImageUtils::FrameView& frame, int64_t timestampUs);
+    void analyzeObjects(FrameAnalysisResult& result);
+    
+    // analyzeMotion for a stream that is not decoded: the motion level is
+    // estimated from packet sizes, with no mask or centers
+    FrameAnalysisResult analyzeCompressedMotion(const CompressedFrameInfo& frame, int64_t timestampUs);
+    
+    // analyzeObjects for results without any motion information; scores
+    // the objects only, as processMetadata does
+    void analyzeMetadataObjects(FrameAnalysisResult& result);
+    
+    // Run the object detector on a frame. Devices sharing a DetectionBatcher
+    // submit to it instead; this is the unbatched path.
+    std::vector<DetectedObject> detectObjects(const ImageUtils::FrameView& frame);
+    
+    // Replace the detector used by detectObjects (simulated by default).
+    // Call before analysis starts; the backend must not be used elsewhere.
+    void setDetectorBackend(std::shared_ptr<ObjectDetectorBackend> backend);
+    
+    // Draw motion masks from the device's frame pool. Call before analysis starts.
+    void setFramePool(std::shared_ptr<FramePool> pool);
+    
+    // Read declared numeric attributes of incoming object metadata as
+    // numbers. Call before analysis starts.
+    void setAttributeSchema(std::shared_ptr<const AttributeSchema> schema);
+    
+    // Extract objects from metadata packet
+    std::vector<DetectedObject> extractObjectsFromMetadata(
+        const nx::sdk::analytics::IMetadataPacket* metadata,
+        int frameWidth, int frameHeight);
+    
+    // Process existing metadata without a frame. Pass the stream resolution
+    // when known; 1920x1080 is assumed otherwise.
     FrameAnalysisResult processMetadata(
         const nx::sdk::analytics::IMetadataPacket* metadata,
-        int64_t timestampUs);
+        int64_t timestampUs,
+        int frameWidth = 0,
+        int frameHeight = 0);
         
-    // Check if a point is inside any region of interest
+    // Check if a point (normalized coordinates) is inside any region of interest
     bool isInRegionOfInterest(float x, float y) const;
     
+    // Fill result.summary from the result's objects and timestamp
+    void summarize(FrameAnalysisResult& result) const;
+    
+    // Motion level above which the scene counts as active
+    float motionThreshold() const { return m_motionThreshold.load(); }
+    
 private:
     // Device identification
     std::string m_deviceId;
     
-    // Configuration
-    std::shared_ptr<DeviceConfig> m_config;
+    // Configuration snapshot, swapped atomically by configure(); each call
+    // below pins one so a frame is analyzed under a single set of settings
+    std::shared_ptr<const DeviceConfig> m_config;
     
-    // Object detection components (to be expanded)
-    // In a real implementation, this would integrate with detection libraries
+    // Object detection
+    std::shared_ptr<ObjectDetectorBackend> m_detector;
+    
+    // Buffer pool for motion masks (optional)
+    std::shared_ptr<FramePool> m_framePool;
+    
+    // Attribute types of incoming object metadata (optional)
+    std::shared_ptr<const AttributeSchema> m_attributeSchema;
     
     // Motion detection
     cv::Ptr<cv::BackgroundSubtractorMOG2> m_bgSubtractor;
-    float m_motionThreshold;
+    RunningAverageSubtractor m_fastSubtractor;
+    PacketMotionEstimator m_packetMotion;                           // Motion thread only
+    std::atomic<MotionEngine> m_motionEngine{MotionEngine::Mog2};   // Set by configure()
+    MotionEngine m_activeMotionEngine = MotionEngine::Mog2;         // Motion thread only
+    std::atomic<float> m_motionThreshold;
+    
+    // Per-stage latency, in microseconds
+    std::shared_ptr<Histogram> m_mog2Latency;
+    std::shared_ptr<Histogram> m_fastMotionLatency;
+    std::shared_ptr<Histogram> m_contoursLatency;
+    
+    // Region mask at motion resolution (motion thread only)
+    std::shared_ptr<const RegionIndex> m_motionMaskIndex;
+    cv::Rect m_motionMaskWindow;
+    cv::Mat m_motionRegionMask;
+    int m_motionRegionArea = 0;
+    
+    // Downscaled motion input and the size the subtractor was trained on
+    cv::Mat m_motionInput;
+    int m_motionInputWidth = 0;
+    int m_motionInputHeight = 0;
     
-    // Object tracking state
-    std::map<std::string, std::chrono::time_point<std::chrono::system_clock>> m_unknownVisitorTracks;
+    // Contour buffer reused across frames
+    std::vector<std::vector<cv::Point>> m_contours;
+    
+    // Object tracking (analysis thread only)
+    ObjectTracker m_tracker;
     
     // Helper methods
-    std::vector<DetectedObject> detectObjects(const cv::Mat& frame);
-    MotionInfo detectMotion(const cv::Mat& frame);
+    MotionInfo detectMotion(const cv::Mat& luma, const DeviceConfig& config);
+    void trackObjects(FrameAnalysisResult& result, const DeviceConfig& config);
+    void summarize(FrameAnalysisResult& result, const DeviceConfig& config) const;
     void analyzeSceneActivity(FrameAnalysisResult& result);
     float calculateAnomalyScore(const FrameAnalysisResult& result);
-    bool detectUnknownVisitors(FrameAnalysisResult& result);
-    bool detectAnomalousActivity(FrameAnalysisResult& result);
+    bool detectUnknownVisitors(FrameAnalysisResult& result, const DeviceConfig& config);
+    bool detectAnomalousActivity(FrameAnalysisResult& result, const DeviceConfig& config);
     
     // Convert normalized coordinates to pixel coordinates
     cv::Rect normalizedToPixelCoords(float x, float y, float width, float height, 
                                      int frameWidth, int frameHeight) const;
-                                     
-    // Extract objects from metadata packet
-    std::vector<DetectedObject> extractObjectsFromMetadata(
-        const nx::sdk::analytics::IMetadataPacket* metadata,
-        int frameWidth, int frameHeight);
 };
 
 } // namespace nx_agent
@@ -0,0 +1,174 @@
+// nx_agent_metrics.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+// Writers spread over this many shards so concurrent updates rarely share a cache line
+constexpr size_t kMetricShards = 4;
+
+// Shard of the calling thread, assigned round-robin on first use
+size_t metricShardIndex();
+
+// Steady clock in microseconds, the time base for latencies measured across threads
+inline int64_t metricsClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Monotonic counter
+ */
+class Counter {
+public:
+    void increment(uint64_t n = 1) {
+        m_shards[metricShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, kMetricShards> m_shards;
+};
+
+/**
+ * Value that is set rather than accumulated
+ */
+class Gauge {
+public:
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value{0};
+};
+
+/**
+ * Point-in-time copy of a histogram
+ */
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    std::vector<uint64_t> buckets;
+
+    // Upper bound of the bucket holding the given quantile (0.0-1.0)
+    uint64_t percentile(double quantile) const;
+    double mean() const { return count > 0 ? static_cast<double>(sum) / count : 0.0; }
+};
+
+/**
+ * Log-linear histogram in the style of HdrHistogram: every power of two is
+ * split into 8 linear sub-buckets, so a value is reported to within 12.5%
+ * with a fixed 272 buckets. Values above 2^36 are clamped. Recording is
+ * two relaxed atomic adds on the caller's shard plus a rarely-taken max update.
+ */
+class Histogram {
+public:
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kMaxValueBits = 36;
+    static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) << kSubBucketBits;
+
+    void record(uint64_t value);
+    HistogramSnapshot snapshot() const;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBucketCount> buckets{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+    std::array<Shard, kMetricShards> m_shards;
+};
+
+/**
+ * Records the lifetime of a scope, in microseconds, into a histogram
+ */
+class LatencyTimer {
+public:
+    explicit LatencyTimer(Histogram* histogram)
+        : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+    ~LatencyTimer();
+
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+    Histogram* m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+ * Process-wide metric registry. Metrics are identified by name plus
+ * device and stage labels; components look their handles up once and
+ * update them without touching the registry again. The registry renders
+ * everything in the Prometheus text format, optionally to a file on a
+ * timer (for node_exporter's textfile collector or any scraper).
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    std::shared_ptr<Counter> counter(const std::string& name, const std::string& device,
+                                     const std::string& stage = "");
+    std::shared_ptr<Gauge> gauge(const std::string& name, const std::string& device,
+                                 const std::string& stage = "");
+    std::shared_ptr<Histogram> histogram(const std::string& name, const std::string& device,
+                                         const std::string& stage = "");
+
+    // Stop exporting a device's metrics; handles already held stay valid
+    void removeDevice(const std::string& device);
+
+    std::string renderPrometheus() const;
+    bool writePrometheusFile(const std::string& filePath) const;
+
+    // Rewrite filePath every intervalSecs until stopExporter()
+    void startExporter(const std::string& filePath, int intervalSecs);
+    void stopExporter();
+
+private:
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    using Key = std::tuple<std::string, std::string, std::string>; // name, device, stage
+
+    struct Entry {
+        std::shared_ptr<Counter> counter;
+        std::shared_ptr<Gauge> gauge;
+        std::shared_ptr<Histogram> histogram;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<Key, Entry> m_metrics;
+
+    // Exporter
+    std::mutex m_exporterMutex;
+    std::condition_variable m_exporterCv;
+    std::thread m_exporter;
+    bool m_exporterStopping = false;
+};
+
+} // namespace nx_agent
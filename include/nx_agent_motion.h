@@ -0,0 +1,115 @@
+// nx_agent_motion.h
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+
+namespace nx_agent {
+
+/**
+ * Background model used for motion detection
+ */
+enum class MotionEngine {
+    Mog2,   // OpenCV Gaussian mixture; best quality, highest cost
+    Fast    // Running-average background with a fixed threshold, for low-power hosts
+};
+
+// Parse an engine name from configuration ("mog2"/"fast")
+MotionEngine parseMotionEngine(const std::string& name);
+
+/**
+ * What a device asks the server to deliver and analyze
+ */
+enum class AnalysisMode {
+    Decoded,        // Uncompressed frames; full motion and object analysis
+    Compressed,     // Compressed packets; motion estimated from packet sizes
+    MetadataOnly    // Compressed packets only as carriers of the camera's object metadata
+};
+
+// Parse a mode name from configuration ("decoded"/"compressed"/"metadataOnly")
+AnalysisMode parseAnalysisMode(const std::string& name);
+
+/**
+ * What is kept of a compressed video packet once its callback returns
+ */
+struct CompressedFrameInfo {
+    int width = 0;
+    int height = 0;
+    size_t sizeBytes = 0;
+    bool keyFrame = false;
+};
+
+/**
+ * Running-average background subtraction on an 8-bit luma plane.
+ *
+ * The background is kept per pixel in 16-bit fixed point. Each frame a
+ * pixel counts as motion when it differs from the background by more than
+ * the threshold, and the background then moves 1/2^adaptShift of the way
+ * towards it. The mask is 0/255, as MOG2 produces without shadow detection.
+ * The per-row kernel is vectorized (AVX2 or SSE2 on x86, NEON on ARM) and
+ * chosen once at runtime from what the CPU supports; every kernel gives
+ * bit-identical results to the scalar one. Not thread-safe.
+ */
+class RunningAverageSubtractor {
+public:
+    explicit RunningAverageSubtractor(int threshold = 20, int adaptShift = 6);
+
+    // Threshold in luma levels (1-254); adaptShift in 0-14
+    void setParameters(int threshold, int adaptShift);
+
+    // Fill mask (CV_8UC1, same size as input) and update the background.
+    // The first frame, or one of a new size, seeds the background and
+    // reports no motion.
+    void apply(const cv::Mat& input, cv::Mat& mask);
+
+    // Forget the background
+    void reset();
+
+    // Name of the kernel selected for this CPU ("avx2", "sse2", "neon" or "scalar")
+    static const char* kernelName();
+
+private:
+    cv::Mat m_background;   // CV_16SC1, luma scaled by 2^7
+    int m_threshold;
+    int m_adaptShift;
+};
+
+/**
+ * Motion estimate from the size of compressed inter frames, for streams
+ * that are never decoded.
+ *
+ * A static scene encodes into small, steady inter frames; motion makes
+ * them grow. The estimator tracks the static-scene size (following drops
+ * quickly and rises slowly) and reports the relative excess of each inter
+ * frame, times the scale, as a 0-1 motion level. Keyframes carry no motion
+ * information and repeat the previous level. The level is global - there
+ * is no mask and there are no motion centers - and it is blunted on
+ * constant-bitrate streams, where the encoder spends a fixed budget per
+ * frame. Not thread-safe.
+ */
+class PacketMotionEstimator {
+public:
+    explicit PacketMotionEstimator(float scale = 0.05f);
+
+    void setScale(float scale) { m_scale = scale; }
+
+    // Motion level (0-1) for the next packet of the stream
+    float update(const CompressedFrameInfo& frame);
+
+    void reset();
+
+private:
+    // Inter frames seen before a level is reported
+    static constexpr int kWarmupFrames = 8;
+
+    float m_scale;
+    double m_baselineBytes = 0.0;
+    int m_samples = 0;
+    float m_level = 0.0f;
+    int m_width = 0;
+    int m_height = 0;
+};
+
+} // namespace nx_agent
@@ -0,0 +1,84 @@
+// nx_agent_objectmeta.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <nx/sdk/analytics/helpers/object_metadata.h>
+
+#include "nx_agent_attributes.h"
+
+namespace nx_agent {
+
+struct DetectedObject;
+
+// Add one attribute to Nx object metadata by its declared type: numbers
+// declared float or int, and undeclared values that are entirely numeric,
+// go out as floats; everything else as strings. Never throws.
+void addNxAttribute(nx::sdk::analytics::ObjectMetadata& metadata, const std::string& name,
+                    const std::string& value, AttributeType type);
+
+/**
+ * Object metadata output counters
+ */
+struct ObjectMetadataStats {
+    uint64_t objects = 0;
+    uint64_t attributesSent = 0;
+    uint64_t attributesSkipped = 0;     // Unchanged since last sent for the track
+};
+
+/**
+ * Converts a frame's detections to Nx object metadata, typed by the
+ * manifest schema. The output vector is owned by the writer and reused
+ * from frame to frame, so steady-state conversion does not grow it.
+ *
+ * With changes only, an attribute of a track (an object with a trackId)
+ * is sent when its value differs from the one last sent for that track;
+ * the VMS keeps the last value of a track attribute. Type, box and
+ * confidence are sent every frame, since tracks that stop appearing are
+ * ended. Track state not refreshed for kTrackStateTtlUs of frame time is
+ * dropped. Not thread-safe.
+ */
+class ObjectMetadataWriter {
+public:
+    static constexpr int64_t kTrackStateTtlUs = 10000000;
+
+    explicit ObjectMetadataWriter(std::shared_ptr<const AttributeSchema> schema = nullptr);
+
+    void setChangesOnly(bool changesOnly) { m_changesOnly = changesOnly; }
+
+    // Metadata for this frame's objects; valid until the next call
+    const std::vector<nx::sdk::analytics::ObjectMetadata>& write(const std::vector<DetectedObject>& objects,
+                                                                 int64_t timestampUs);
+
+    // Forget what was sent, so every track gets its attributes again
+    void reset();
+
+    ObjectMetadataStats stats() const { return m_stats; }
+
+    size_t trackCount() const { return m_tracks.size(); }
+
+private:
+    static constexpr int64_t kExpiryIntervalUs = 1000000;
+
+    struct TrackState {
+        std::string typeId;
+        AttributeSet sent;
+        int64_t lastSeenUs = 0;
+    };
+
+    void expireTracks(int64_t nowUs);
+
+    std::shared_ptr<const AttributeSchema> m_schema;
+    bool m_changesOnly = true;
+
+    std::vector<nx::sdk::analytics::ObjectMetadata> m_metadata;
+    std::unordered_map<std::string, TrackState> m_tracks;
+    int64_t m_lastExpiryUs = 0;
+
+    ObjectMetadataStats m_stats;
+};
+
+} // namespace nx_agent
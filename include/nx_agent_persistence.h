@@ -0,0 +1,87 @@
+// nx_agent_persistence.h
+#pragma once
+
+#include <string>
+#include <map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+namespace nx_agent {
+
+/**
+ * Persistence counters
+ */
+struct PersistenceStats {
+    size_t sources = 0;
+    size_t dirty = 0;
+    uint64_t writes = 0;
+    uint64_t failures = 0;
+    uint64_t coalesced = 0;    // markDirty() calls absorbed by an already pending write
+};
+
+/**
+ * Write-behind persistence for model state.
+ *
+ * Owners register a flush function and mark themselves dirty whenever
+ * their state changes; a single background thread calls each dirty flush
+ * at most once per interval (GlobalConfig::modelPersistIntervalSecs), so
+ * any number of changes between two writes cost one write. Nothing on the
+ * caller's side ever touches the filesystem.
+ */
+class ModelPersistenceService {
+public:
+    using FlushFn = std::function<bool()>;
+
+    static ModelPersistenceService& instance();
+
+    // Register a flush function; the returned handle identifies the source
+    uint64_t registerSource(FlushFn flush);
+
+    // Flush a dirty source synchronously and forget it. Waits for a
+    // background flush of the same source that is already in progress.
+    void unregisterSource(uint64_t handle);
+
+    // Schedule a write for the next interval; cheap and never blocks on I/O
+    void markDirty(uint64_t handle);
+
+    // Write every dirty source now, on the calling thread
+    void flushAll();
+
+    PersistenceStats stats() const;
+
+private:
+    ModelPersistenceService();
+    ~ModelPersistenceService();
+
+    ModelPersistenceService(const ModelPersistenceService&) = delete;
+    ModelPersistenceService& operator=(const ModelPersistenceService&) = delete;
+
+    struct Source {
+        FlushFn flush;
+        bool dirty = false;
+    };
+
+    void run();
+    void flushDirty(std::unique_lock<std::mutex>& lock);
+    void flushOne(uint64_t handle, std::unique_lock<std::mutex>& lock);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    std::condition_variable m_flushDoneCv;
+    std::map<uint64_t, Source> m_sources;
+    uint64_t m_nextHandle = 1;
+    uint64_t m_flushingHandle = 0;     // Source whose flush is running, 0 if none
+
+    std::thread m_worker;
+    bool m_stopping = false;
+
+    // Statistics
+    uint64_t m_writes = 0;
+    uint64_t m_failures = 0;
+    uint64_t m_coalesced = 0;
+};
+
+} // namespace nx_agent
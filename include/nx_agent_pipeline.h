@@ -0,0 +1,189 @@
+// nx_agent_pipeline.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <deque>
+#include <cstdint>
+
+#include "nx_agent_executor.h"
+#include "nx_agent_spsc.h"
+#include "nx_agent_metadata.h"
+#include "nx_agent_utils.h"
+
+namespace nx_agent {
+
+/**
+ * What to do with incoming frames when the pipeline falls behind
+ */
+enum class FrameDropPolicy {
+    KeepLatest,     // First stage only sees the newest frame; a new one replaces any still waiting
+    DropAlternate   // Drop every other frame while the ingest queue is over half full
+};
+
+// Parse a policy name from configuration ("keepLatest"/"dropAlternate")
+FrameDropPolicy parseFrameDropPolicy(const std::string& name);
+
+/**
+ * A single frame travelling through the analysis pipeline
+ */
+struct PipelineJob {
+    AnalysisMode mode = AnalysisMode::Decoded;
+    ImageUtils::FrameView frame;                  // Owned copy of the frame (decoded mode)
+    CompressedFrameInfo compressed;               // Packet description (other modes)
+    int64_t timestampUs = 0;
+    int64_t receivedAtUs = 0;                     // Steady clock, for end-to-end latency
+    bool hasProvidedObjects = false;              // Objects came with the frame metadata
+    std::vector<DetectedObject> providedObjects;
+    FrameAnalysisResult result;
+    bool anomalyDetected = false;                 // Set by the anomaly stage
+};
+
+/**
+ * Counters for one pipeline stage
+ */
+struct PipelineStageStats {
+    std::string name;
+    size_t queueDepth = 0;
+    size_t queueCapacity = 0;
+    size_t inFlight = 0;       // Jobs handed to an asynchronous stage and not yet completed
+    uint64_t processed = 0;
+    uint64_t dropped = 0;
+};
+
+/**
+ * Counters for a whole pipeline
+ */
+struct PipelineStats {
+    uint64_t submitted = 0;
+    uint64_t dropped = 0;
+    std::vector<PipelineStageStats> stages;
+};
+
+/**
+ * Bounded multi-stage frame pipeline for a single device.
+ *
+ * Each stage is fed by an SPSC queue, so the caller of submit() only pays
+ * for a queue push. With a shared TaskExecutor a stage is drained by at most
+ * one executor task at a time (which keeps each queue single-consumer);
+ * without one every stage gets a dedicated thread. Backpressure between
+ * stages never drops frames - a stage whose output queue is full parks the
+ * job until downstream catches up. Frames are only dropped at ingest,
+ * according to the configured FrameDropPolicy.
+ */
+class AnalysisPipeline {
+public:
+    // A stage returns false to stop the job from reaching later stages
+    using Stage = std::function<bool(PipelineJob&)>;
+
+    // An asynchronous stage starts work on the job and calls done exactly
+    // once, from any thread, when it has finished with it. Throwing means
+    // done will not be called. Up to the queue capacity of jobs may be
+    // outstanding at a time.
+    using Done = std::function<void(bool proceed)>;
+    using AsyncStage = std::function<void(PipelineJob&, Done done)>;
+
+    AnalysisPipeline(const std::string& deviceId, size_t queueCapacity, FrameDropPolicy policy,
+                     std::shared_ptr<TaskExecutor> executor = nullptr);
+    ~AnalysisPipeline();
+
+    // Register stages in order; must be called before start()
+    void addStage(const std::string& name, Stage stage);
+    void addAsyncStage(const std::string& name, AsyncStage stage);
+
+    void start();
+
+    // Stop all workers and wait for in-flight stage tasks; queued jobs are discarded
+    void stop();
+
+    // Hand a job to the first stage. Must always be called from the same
+    // thread. Returns false if the frame was dropped.
+    bool submit(std::unique_ptr<PipelineJob> job);
+
+    PipelineStats stats() const;
+
+private:
+    struct StageSlot {
+        StageSlot(const std::string& stageName, size_t capacity)
+            : name(stageName), queue(capacity) {}
+
+        std::string name;
+        Stage fn;
+        AsyncStage asyncFn;                   // Set instead of fn for asynchronous stages
+        SpscQueue<std::unique_ptr<PipelineJob>> queue;
+        LatestMailbox<PipelineJob> latest;    // Used instead of the queue by a KeepLatest first stage
+        std::thread worker;
+
+        // Asynchronous stages: jobs out for processing and jobs handed back
+        struct Completion {
+            std::unique_ptr<PipelineJob> job;
+            bool proceed;
+        };
+        std::atomic<size_t> outstanding{0};
+        std::mutex completedMutex;
+        std::deque<Completion> completed;
+        std::atomic<size_t> completedCount{0};
+
+        // Executor mode: a drain task is queued or running
+        std::atomic<bool> scheduled{false};
+
+        // Executor mode: output parked because the next queue was full
+        std::unique_ptr<PipelineJob> pendingOutput;
+        std::atomic<bool> blocked{false};
+
+        // Thread mode: wakeup for an idle worker
+        std::mutex wakeMutex;
+        std::condition_variable wakeCv;
+        std::atomic<bool> sleeping{false};
+
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    // Thread mode
+    void runStage(size_t index);
+    void push(StageSlot& slot, std::unique_ptr<PipelineJob> job);
+    void wake(StageSlot& slot);
+
+    // Executor mode
+    void schedule(size_t index);
+    void drainStage(size_t index);
+
+    bool usesMailbox(const StageSlot& slot) const;
+    bool hasInput(const StageSlot& slot) const;
+    std::unique_ptr<PipelineJob> nextJob(StageSlot& slot);
+    bool runJob(StageSlot& slot, PipelineJob& job);
+    void notify(size_t index);
+
+    // Asynchronous stages
+    bool saturated(const StageSlot& slot) const;
+    void startAsync(size_t index, std::unique_ptr<PipelineJob> job);
+    void complete(size_t index, PipelineJob* job, bool proceed);
+    bool takeCompleted(StageSlot& slot, std::unique_ptr<PipelineJob>& job, bool& proceed);
+    bool forwardOrPark(size_t index, std::unique_ptr<PipelineJob> job);
+
+    // Jobs a drain task handles before yielding its worker to other devices
+    static constexpr int kDrainBatch = 4;
+
+    std::string m_deviceId;
+    size_t m_queueCapacity;
+    FrameDropPolicy m_policy;
+    std::shared_ptr<TaskExecutor> m_executor;
+    std::atomic<int> m_inFlight{0};
+
+    std::vector<std::unique_ptr<StageSlot>> m_stages;
+    std::atomic<bool> m_running{false};
+
+    // Ingest counters (touched only by the submitting thread, read by stats())
+    std::atomic<uint64_t> m_submitted{0};
+    std::atomic<uint64_t> m_ingestDropped{0};
+    bool m_dropToggle = false;
+};
+
+} // namespace nx_agent
@@ -6,14 +6,32 @@
 #include <nx/sdk/analytics/helpers/device_agent.h>
 #include <memory>
 #include <mutex>
+#include <map>
+#include <atomic>
+#include <functional>
 
 // Forward declarations
 namespace nx_agent {
     class DeviceConfig;
     class MetadataAnalyzer;
     class AnomalyDetector;
+    class BaselineLearner;
     class ResponseProtocol;
+    class AnalysisPipeline;
+    class FrameScheduler;
+    class TaskExecutor;
+    class DetectionBatcher;
+    class HttpDispatcher;
+    class IncidentCorrelator;
+    class FramePool;
+    class ObjectMetadataWriter;
+    class Counter;
+    class Gauge;
+    class Histogram;
     struct FrameAnalysisResult;
+    struct PipelineJob;
+    struct PipelineStats;
+    enum class AnalysisMode;
 }
 
 namespace nx_agent {
@@ -50,6 +68,18 @@ private:
     
     // Track active device agents
     std::map<std::string, nx::sdk::analytics::IDeviceAgent*> m_deviceAgents;
+    
+    // Worker pool shared by every device agent this engine creates
+    std::shared_ptr<TaskExecutor> m_executor;
+    
+    // Object detection batched across all device agents
+    std::shared_ptr<DetectionBatcher> m_detectionBatcher;
+    
+    // Webhook delivery for every device agent's response protocol
+    std::shared_ptr<HttpDispatcher> m_httpDispatcher;
+    
+    // Deduplicates external responses across device agents (null if disabled)
+    std::shared_ptr<IncidentCorrelator> m_incidentCorrelator;
 };
 
 /**
@@ -57,14 +87,22 @@ private:
  */
 class NxAgentDeviceAgent: public nx::sdk::analytics::VideoFrameProcessingDeviceAgent {
 public:
-    NxAgentDeviceAgent(const nx::sdk::IDeviceInfo* deviceInfo);
+    NxAgentDeviceAgent(const nx::sdk::IDeviceInfo* deviceInfo,
+                       std::shared_ptr<TaskExecutor> executor = nullptr,
+                       std::shared_ptr<DetectionBatcher> detectionBatcher = nullptr,
+                       std::shared_ptr<HttpDispatcher> httpDispatcher = nullptr,
+                       std::shared_ptr<IncidentCorrelator> incidentCorrelator = nullptr);
     virtual ~NxAgentDeviceAgent() override;
 
     virtual std::string manifestString() const override;
     
+    // Queue depth and drop counters of the analysis pipeline
+    PipelineStats pipelineStats() const;
+    
 protected:
-    virtual bool needUncompressedVideoFrame() const override { return true; }
-    virtual bool needCompressedVideoFrame() const override { return false; }
+    // Streams analyzed without decoding ask for compressed packets instead
+    virtual bool needUncompressedVideoFrame() const override;
+    virtual bool needCompressedVideoFrame() const override;
     
     virtual nx::sdk::Result<void> doSetupAnalytics(
         const nx::sdk::analytics::SetupAnalyticsModel& setupAnalyticsModel) override;
@@ -77,28 +115,66 @@ protected:
     
     // Report detected objects to the VMS
     virtual void reportObjects(const FrameAnalysisResult& result);
+    
+    // Pipeline stages: motion -> detection -> objects/anomaly -> response/report
+    bool runMotionStage(PipelineJob& job);
+    void runDetectStage(PipelineJob& job, std::function<void(bool)> done);
+    bool runAnalysisStage(PipelineJob& job);
+    bool runReportStage(PipelineJob& job);
+    
+    // Push the periodic status event with this device's counters and latency
+    void publishMetrics(int64_t timestampUs);
         
 protected:
     // Track device settings and state
     std::string m_deviceId;
     bool m_initialized = false;
     
-    // Configuration
-    std::shared_ptr<DeviceConfig> m_config;
+    // Configuration snapshot; replaced whole by doSetupAnalytics, read
+    // with std::atomic_load from the frame threads
+    std::shared_ptr<const DeviceConfig> m_config;
+    
+    // Fixed when the agent is created: the server negotiates the stream
+    // (decoded or compressed) once, so a changed setting waits for a new agent
+    AnalysisMode m_analysisMode;
     
     // Processing components
     std::unique_ptr<MetadataAnalyzer> m_metadataAnalyzer;
     std::unique_ptr<AnomalyDetector> m_anomalyDetector;
     std::unique_ptr<ResponseProtocol> m_responseProtocol;
     
+    // Shared engine executor and detector (null when the agent runs standalone)
+    std::shared_ptr<TaskExecutor> m_executor;
+    std::shared_ptr<DetectionBatcher> m_detectionBatcher;
+    
+    // Reused buffers for frame copies, converted planes and motion masks
+    std::shared_ptr<FramePool> m_framePool;
+    
+    // Object metadata conversion, reused across frames; reporting thread only
+    std::unique_ptr<ObjectMetadataWriter> m_objectWriter;
+    
+    // Asynchronous analysis pipeline (null when analysis runs inline)
+    std::unique_ptr<AnalysisPipeline> m_pipeline;
+    
+    // Decides which delivered frames are analyzed
+    std::unique_ptr<FrameScheduler> m_scheduler;
+    void configureScheduler();
+    
     // State variables
-    bool m_isLearningMode = true;
-    int m_learningFrameCount = 0;
+    std::unique_ptr<BaselineLearner> m_baseline;   // Learning/detection mode and baseline sampling
     int64_t m_lastAnomalyTimeUs = 0;
     
-    // Statistics
-    int m_processedFrameCount = 0;
-    int m_anomalyCount = 0;
+    // Statistics, registered in the MetricsRegistry under this device
+    std::shared_ptr<Counter> m_receivedFrames;     // Every frame the server sent
+    std::shared_ptr<Counter> m_processedFrames;    // Frames the scheduler let through to analysis
+    std::shared_ptr<Counter> m_skippedFrames;
+    std::shared_ptr<Counter> m_anomalies;
+    std::shared_ptr<Gauge> m_learningModeGauge;
+    std::shared_ptr<Histogram> m_convertLatency;
+    std::shared_ptr<Histogram> m_scoringLatency;
+    std::shared_ptr<Histogram> m_responseLatency;
+    std::shared_ptr<Histogram> m_frameLatency;     // Delivery to end of the report stage
+    int64_t m_lastMetricsEventUs = 0;              // Report stage only
 };
 
 } // namespace nx_agent
@@ -0,0 +1,64 @@
+// nx_agent_regions.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+namespace nx_agent {
+
+struct Region;
+
+/**
+ * Precompiled region-of-interest lookup.
+ *
+ * The configured inclusion and exclusion polygons are rasterized once into
+ * a fixed-resolution decision bitmap over normalized frame coordinates, so
+ * a membership test is a single array lookup. The rules are those of
+ * MetadataAnalyzer::isInRegionOfInterest: no regions means everything is
+ * of interest, inclusion zones win over exclusion zones, and a point in
+ * neither is of interest only when exclusion zones are configured.
+ */
+class RegionIndex {
+public:
+    static constexpr int kResolution = 256;
+
+    RegionIndex() = default;
+    explicit RegionIndex(const std::vector<Region>& regions);
+
+    // Point in normalized (0.0-1.0) coordinates; values outside are clamped
+    bool contains(float x, float y) const {
+        if (m_coversEverything) {
+            return true;
+        }
+        return m_bitmap[cellIndex(y) * kResolution + cellIndex(x)] != 0;
+    }
+
+    // True when no pixel is excluded and callers can skip masking entirely
+    bool coversEverything() const { return m_coversEverything; }
+
+    // Binary mask (255 = of interest) of the given size covering a window
+    // of the frame in normalized coordinates (the whole frame by default)
+    cv::Mat rasterize(int width, int height, const cv::Rect2f& window = cv::Rect2f(0, 0, 1, 1)) const;
+    
+    // Pixel bounding box of everything of interest in a frame of this
+    // size; empty if nothing is of interest
+    cv::Rect interestBounds(int width, int height) const;
+
+private:
+    static int cellIndex(float v) {
+        int i = static_cast<int>(v * kResolution);
+        return i < 0 ? 0 : (i >= kResolution ? kResolution - 1 : i);
+    }
+
+    bool m_coversEverything = true;
+    std::vector<uint8_t> m_bitmap;   // kResolution x kResolution, row-major
+    
+    // Bounding box of the set cells, inclusive; empty when maxCol < minCol
+    int m_minCol = 0;
+    int m_minRow = 0;
+    int m_maxCol = kResolution - 1;
+    int m_maxRow = kResolution - 1;
+};
+
+} // namespace nx_agent
@@ -0,0 +1,134 @@
+// nx_agent_replay.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+class DetectionBatcher;
+
+/**
+ * One recorded piece of a camera's history
+ */
+struct ReplaySegment {
+    enum class Kind {
+        Video,      // Archive chunk or exported clip, decoded with OpenCV
+        FrameDump   // Directory of still images, one per frame
+    };
+
+    Kind kind = Kind::Video;
+    std::string path;
+    int64_t startUs = 0;        // Event time of the first frame
+};
+
+// Segments found at path, in event time order: a video file named after its
+// start time in milliseconds (as Nx archive chunks are, "<startMs>_<durationMs>.mkv"),
+// a frame dump directory of images named after their timestamp in microseconds
+// ("<timestampUs>.jpg"), or a directory holding either. Unnamed files are skipped.
+std::vector<ReplaySegment> findReplaySegments(const std::string& path);
+
+/**
+ * Replay settings
+ */
+struct ReplayOptions {
+    size_t maxParallelCameras = 0;      // 0 = half the hardware threads; each camera uses two
+    size_t queueCapacity = 8;           // Decoded frames buffered ahead of the analysis
+    bool freshBaseline = true;          // Discard the stored models before replaying
+    bool useScheduler = true;           // Skip quiet frames as the live agent does
+    bool saveSnapshots = true;          // Write the trained models where the agent loads them
+    double targetAnomalyRate = 0.001;   // Fraction of scored frames the suggested threshold flags
+};
+
+/**
+ * Histogram of one camera's anomaly scores
+ */
+class ScoreDistribution {
+public:
+    static constexpr int kBins = 1000;
+
+    void add(float score);
+
+    uint64_t count() const { return m_count; }
+
+    // Upper edge of the bin holding the q-quantile
+    float percentile(double q) const;
+
+    // Fraction of scores a threshold would flag (score > threshold)
+    double fractionAbove(float threshold) const;
+
+    // Lowest threshold that flags at most this fraction of scores
+    float thresholdForRate(double rate) const;
+
+private:
+    std::array<uint64_t, kBins> m_bins{};
+    uint64_t m_count = 0;
+};
+
+/**
+ * What replaying one camera produced
+ */
+struct ReplayReport {
+    std::string deviceId;
+    size_t segments = 0;
+    uint64_t frames = 0;                // Decoded, or read from the dumps
+    uint64_t skippedFrames = 0;         // Left out by the frame scheduler
+    uint64_t analyzedFrames = 0;
+    uint64_t baselineSamples = 0;
+    uint64_t anomalies = 0;
+    int64_t firstUs = 0;                // Event time span covered
+    int64_t lastUs = 0;
+    int64_t learningCompleteUs = 0;     // Event time learning ended, 0 if it did not
+    double wallSeconds = 0.0;
+    float configuredThreshold = 0.0f;
+    float suggestedThreshold = 0.0f;    // For ReplayOptions::targetAnomalyRate
+    ScoreDistribution scores;           // Frames scored in detection mode
+    bool snapshotSaved = false;
+    std::string error;                  // Empty on success
+
+    // Event time replayed per second of wall time
+    double speedup() const;
+};
+
+/**
+ * Offline replay of recorded video through the live analysis path, to
+ * train baselines in bulk and tune anomaly thresholds.
+ *
+ * Each camera gets its own MetadataAnalyzer, AnomalyDetector,
+ * BaselineLearner and FrameScheduler with the camera's DeviceConfig,
+ * exactly as its device agent would, while object detection runs through
+ * the configured backend, batched across cameras as the engine does. The
+ * segments are fed through them in event time order: a reader thread
+ * decodes ahead of the analysis thread, as the server does for the agent.
+ * Nothing is paced by the wall clock - every decision is keyed by frame
+ * timestamps - so a replay runs as fast as the cores allow and several
+ * cameras replay in parallel.
+ * run() blocks until every camera is done.
+ */
+class ReplayEngine {
+public:
+    explicit ReplayEngine(ReplayOptions options = ReplayOptions());
+
+    void addCamera(const std::string& deviceId, std::vector<ReplaySegment> segments);
+
+    std::vector<ReplayReport> run();
+
+    // JSON report for threshold tuning
+    static bool writeReport(const std::string& filePath, const std::vector<ReplayReport>& reports);
+
+private:
+    struct Camera {
+        std::string deviceId;
+        std::vector<ReplaySegment> segments;
+    };
+
+    ReplayReport replayCamera(const Camera& camera, DetectionBatcher& batcher) const;
+
+    ReplayOptions m_options;
+    std::vector<Camera> m_cameras;
+};
+
+} // namespace nx_agent
@@ -0,0 +1,227 @@
+// nx_agent_replication.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+/**
+ * Shared storage the servers of a system replicate models through
+ */
+class ReplicaStore {
+public:
+    enum class Status {
+        Ok,
+        NotFound,
+        Failed      // Unreachable or refused
+    };
+
+    virtual ~ReplicaStore() = default;
+
+    // Keys are relative paths ("<deviceId>/models.nxsnap")
+    virtual Status put(const std::string& key, const std::vector<uint8_t>& data) = 0;
+    virtual Status get(const std::string& key, std::vector<uint8_t>& data) = 0;
+    virtual Status remove(const std::string& key) = 0;
+
+    // Store for a replicationTarget: an http(s):// URL, otherwise a
+    // directory path; null if the target is empty
+    static std::unique_ptr<ReplicaStore> create(const std::string& target, int timeoutMs);
+};
+
+/**
+ * Replicas as files under a directory every server mounts. Writes are
+ * atomic (temporary file + rename).
+ */
+class DirectoryReplicaStore : public ReplicaStore {
+public:
+    explicit DirectoryReplicaStore(std::string rootPath);
+
+    Status put(const std::string& key, const std::vector<uint8_t>& data) override;
+    Status get(const std::string& key, std::vector<uint8_t>& data) override;
+    Status remove(const std::string& key) override;
+
+private:
+    std::string m_rootPath;
+};
+
+/**
+ * Replicas as resources under a base URL that accepts PUT, GET and DELETE
+ * (WebDAV, object storage). One kept-alive connection, used by one
+ * request at a time.
+ */
+class HttpReplicaStore : public ReplicaStore {
+public:
+    HttpReplicaStore(std::string baseUrl, int timeoutMs);
+    ~HttpReplicaStore() override;
+
+    Status put(const std::string& key, const std::vector<uint8_t>& data) override;
+    Status get(const std::string& key, std::vector<uint8_t>& data) override;
+    Status remove(const std::string& key) override;
+
+private:
+    Status perform(const char* method, const std::string& key, const std::vector<uint8_t>* body,
+                   std::vector<uint8_t>* response);
+    std::string urlFor(const std::string& key) const;
+
+    std::string m_baseUrl;
+    int m_timeoutMs;
+    std::mutex m_mutex;
+    void* m_handle = nullptr;       // CURL*
+    void* m_headers = nullptr;      // curl_slist*
+};
+
+/**
+ * On-store layout of a device's replica manifest ("<deviceId>/manifest"),
+ * written after the objects it lists:
+ *
+ *   ReplicaManifestHeader, segmentCount x int64_t day
+ *
+ * The days are the feature log segments replicated as
+ * "<deviceId>/features/<day>.nxflog". The checksum covers the header (with
+ * checksum = 0) and the days.
+ */
+struct ReplicaManifestHeader {
+    uint32_t magic;                // kReplicaManifestMagic
+    uint32_t version;              // kReplicaManifestVersion
+    uint32_t checksum;
+    uint32_t segmentCount;
+    uint64_t sequence;             // Replications of this device, across servers
+    int64_t snapshotCreatedUs;     // SnapshotHeader::createdUs of "<deviceId>/models.nxsnap"
+    uint32_t snapshotChecksum;     // CRC-32 of the whole snapshot file
+    uint32_t reserved;
+    char origin[64];               // Server that wrote it, NUL-terminated
+};
+
+constexpr uint32_t kReplicaManifestMagic = 0x4d52584e;  // "NXRM"
+constexpr uint32_t kReplicaManifestVersion = 1;
+
+/**
+ * Replication counters
+ */
+struct ReplicationStats {
+    uint64_t replicated = 0;       // Snapshots sent
+    uint64_t unchanged = 0;        // Saves whose snapshot had already been sent
+    uint64_t superseded = 0;       // Not sent: another server replicated newer models
+    uint64_t segments = 0;         // Feature log segments sent
+    uint64_t bytesSent = 0;
+    uint64_t failures = 0;
+    uint64_t restored = 0;         // Replicas installed before a detector loaded
+    uint64_t restoreTimeouts = 0;  // Restores a detector stopped waiting for
+};
+
+/**
+ * Cluster-wide model replication for warm failover.
+ *
+ * Every saved model snapshot is sent, in the background and at most once
+ * per replicationIntervalSecs per device, to the replica store all servers
+ * share, together with the device's completed feature log days not sent
+ * before; unchanged snapshots are not sent again. Uploads across all
+ * devices are paced to replicationMaxKBps. Each device's manifest records
+ * the snapshot's creation time, and a server never replaces a replica
+ * newer than its own models, so a camera that moved on keeps the state its
+ * new server trained.
+ *
+ * A detector calls restore() before loading its models: when the store
+ * holds a newer snapshot than the local one (the camera failed over from
+ * another server), it is installed and the detector starts in detection
+ * mode; the feature log days follow in the background. A restore waits
+ * at most replicationRestoreTimeoutMs; one still running then is left to
+ * finish on its own thread and its replica discarded, so the detector
+ * learns from its local models. An unreachable or slow store is not
+ * retried by restores for a minute, so cameras starting during an outage
+ * do not each wait for the timeout.
+ */
+class ModelReplicationService {
+public:
+    static ModelReplicationService& instance();
+
+    // Use this store instead of the configured replicationTarget; null turns replication off
+    void setStore(std::shared_ptr<ReplicaStore> store);
+
+    // The device's snapshot under modelDir was saved; never blocks on I/O
+    void notifySaved(const std::string& deviceId, const std::string& modelDir);
+
+    // Install a newer replica into modelDir; true if one was installed.
+    // Blocks for at most replicationRestoreTimeoutMs.
+    bool restore(const std::string& deviceId, const std::string& modelDir);
+
+    // Send everything pending now, on the calling thread, unpaced
+    void flush();
+
+    ReplicationStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Manifest {
+        ReplicaManifestHeader header{};
+        std::vector<int64_t> days;
+    };
+
+    struct Device {
+        std::string modelDir;
+        bool pending = false;
+        Clock::time_point dueAt;
+        uint32_t sentChecksum = 0;          // Snapshot last sent or restored
+        bool sentSnapshot = false;
+        int64_t sentThroughDay = -1;        // Newest log day sent or restored
+        uint64_t sequence = 0;
+        std::vector<int64_t> fetchDays;     // Restored log days still to fetch
+    };
+
+    // One restore, run on its own thread so the caller can stop waiting
+    struct RestoreAttempt {
+        std::mutex mutex;
+        std::condition_variable doneCv;
+        bool done = false;
+        bool installed = false;
+        bool abandoned = false;             // The caller timed out; install nothing
+        std::thread thread;
+    };
+
+    ModelReplicationService();
+    ~ModelReplicationService();
+
+    ModelReplicationService(const ModelReplicationService&) = delete;
+    ModelReplicationService& operator=(const ModelReplicationService&) = delete;
+
+    void run();
+    bool restoreReplica(const std::string& deviceId, const std::string& modelDir, ReplicaStore& store,
+                        RestoreAttempt& attempt);
+    void reapRestores(bool wait);
+    std::shared_ptr<ReplicaStore> store();
+    void replicate(const std::string& deviceId, Device state, ReplicaStore& store, bool paced);
+    void fetchSegments(const std::string& deviceId, const std::string& modelDir,
+                       const std::vector<int64_t>& days, ReplicaStore& store);
+    bool putPaced(ReplicaStore& store, const std::string& key, const std::vector<uint8_t>& data, bool paced);
+
+    static ReplicaStore::Status getManifest(ReplicaStore& store, const std::string& deviceId, Manifest& manifest);
+    static std::vector<uint8_t> encodeManifest(Manifest& manifest);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    std::shared_ptr<ReplicaStore> m_store;
+    bool m_storeResolved = false;           // m_store set from the configuration or setStore()
+    std::map<std::string, Device> m_devices;
+    Clock::time_point m_storeDownUntil;
+    Clock::time_point m_nextSendAt;         // Pacing: when the bandwidth allows the next upload
+
+    std::thread m_worker;                   // Started with the first replication
+    std::vector<std::shared_ptr<RestoreAttempt>> m_restores;   // Abandoned, still running
+    bool m_stopping = false;
+    std::string m_origin;
+
+    // Statistics
+    ReplicationStats m_stats;
+};
+
+} // namespace nx_agent
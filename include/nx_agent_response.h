@@ -7,12 +7,17 @@
 #include <memory>
 #include <functional>
 #include <mutex>
+#include <atomic>
 #include <chrono>
 
 namespace nx_agent {
 
 // Forward declarations
 class DeviceConfig;
+class TaskExecutor;
+class HttpDispatcher;
+class IncidentCorrelator;
+struct IncidentSummary;
 struct FrameAnalysisResult;
 
 /**
@@ -48,7 +53,7 @@ public:
     ~ResponseProtocol();
     
     // Configure the protocol
-    void configure(std::shared_ptr<DeviceConfig> config);
+    void configure(std::shared_ptr<const DeviceConfig> config);
     
     // Process an anomaly detection result and execute appropriate responses
     bool processAnomaly(const FrameAnalysisResult& result);
@@ -64,12 +69,25 @@ public:
     using NxEventCallback = std::function<void(const FrameAnalysisResult&)>;
     void setNxEventCallback(NxEventCallback callback);
     
+    // Run external actions on a shared executor (Alarm lane) instead of
+    // spawning a thread per action
+    void setExecutor(std::shared_ptr<TaskExecutor> executor);
+    
+    // Send webhooks through a shared dispatcher; without one the protocol
+    // creates its own on the first HTTP action
+    void setHttpDispatcher(std::shared_ptr<HttpDispatcher> dispatcher);
+    
+    // Merge external actions with those of other cameras on the same site
+    // into one incident; only the camera that opens it runs the action,
+    // once the correlator has merged the other cameras' reports
+    void setIncidentCorrelator(std::shared_ptr<IncidentCorrelator> correlator);
+    
 private:
     // Device identification
     std::string m_deviceId;
     
-    // Configuration
-    std::shared_ptr<DeviceConfig> m_config;
+    // Configuration snapshot, swapped atomically by configure()
+    std::shared_ptr<const DeviceConfig> m_config;
     
     // Response actions for different anomaly types
     std::map<std::string, std::vector<ResponseAction>> m_responseActions;
@@ -91,12 +109,24 @@ private:
     // Callback for NX events
     NxEventCallback m_nxEventCallback;
     
+    // Asynchronous action dispatch
+    std::shared_ptr<TaskExecutor> m_executor;
+    std::atomic<int> m_inFlightActions{0};
+    void dispatchAsync(std::function<void()> action);
+    
+    std::mutex m_httpMutex;
+    std::shared_ptr<HttpDispatcher> m_httpDispatcher;
+    
+    // Cross-camera deduplication (null responds independently)
+    std::shared_ptr<IncidentCorrelator> m_incidentCorrelator;
+    
     // Helper methods
     bool verifyAnomaly(const FrameAnalysisResult& result, AnomalyTracker& tracker);
     void triggerResponses(const FrameAnalysisResult& result, const AnomalyTracker& tracker);
-    bool executeAction(const ResponseAction& action, const FrameAnalysisResult& result);
+    bool executeAction(const ResponseAction& action, const FrameAnalysisResult& result,
+                       const IncidentSummary* incident = nullptr);
     
-    // HTTP client for external notifications
+    // Queue an HTTP notification on the dispatcher
     bool sendHttpRequest(const std::string& url, const std::string& payload);
     
     // SIP call functionality (if enabled)
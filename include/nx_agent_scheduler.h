@@ -0,0 +1,62 @@
+// nx_agent_scheduler.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace nx_agent {
+
+class DeviceConfig;
+
+/**
+ * Adaptive per-device frame sampling.
+ *
+ * While the scene is quiet only one frame per idle interval is analyzed.
+ * As soon as the analysis reports motion or objects every frame is
+ * analyzed, until the scene has been quiet for the hold period again.
+ * shouldProcess() is called on the frame delivery thread and
+ * reportActivity() from the analysis thread, so the shared state is atomic.
+ */
+class FrameScheduler {
+public:
+    enum class Mode {
+        Idle,      // Sampling at the idle rate
+        Active     // Analyzing every frame
+    };
+
+    FrameScheduler() = default;
+
+    // idleIntervalUs <= 0 disables skipping
+    void configure(int64_t idleIntervalUs, int64_t activityHoldUs);
+
+    // Intervals from the device's adaptive frame rate settings
+    void configure(const DeviceConfig& config);
+
+    // Decide whether the frame at this timestamp should be analyzed
+    bool shouldProcess(int64_t timestampUs);
+
+    // Feed back the outcome of an analyzed frame
+    void reportActivity(int64_t timestampUs, bool active);
+
+    Mode mode(int64_t timestampUs) const;
+
+    uint64_t consideredFrames() const { return m_considered.load(); }
+    uint64_t skippedFrames() const { return m_skipped.load(); }
+
+private:
+    std::atomic<int64_t> m_idleIntervalUs{1000000};
+    std::atomic<int64_t> m_activityHoldUs{10000000};
+
+    // Delivery thread only
+    int64_t m_lastProcessedUs = 0;
+    bool m_hasProcessed = false;
+
+    // Written by the analysis thread
+    std::atomic<int64_t> m_lastActivityUs{0};
+    std::atomic<bool> m_hasActivity{false};
+
+    std::atomic<uint64_t> m_considered{0};
+    std::atomic<uint64_t> m_skipped{0};
+};
+
+} // namespace nx_agent
@@ -0,0 +1,128 @@
+// nx_agent_snapshot.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <initializer_list>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+// CRC-32 (IEEE 802.3), chainable through the seed argument
+uint32_t crc32(const void* data, size_t length, uint32_t seed = 0);
+
+// One piece of a file written by writeFileAtomic
+struct FileChunk {
+    const void* data;
+    size_t size;
+};
+
+// Replace filePath with the chunks, in order: they are written to tempPath
+// (filePath + ".tmp" if empty) and flushed to disk before the rename, and
+// the directory after it, so even a power loss leaves the old or the new
+// file, never an empty or partial one.
+bool writeFileAtomic(const std::string& filePath, std::initializer_list<FileChunk> chunks,
+                     const std::string& tempPath = "");
+
+// Flush a rename or removal in filePath's directory to disk
+bool syncParentDirectory(const std::string& filePath);
+
+/**
+ * On-disk layout of a model snapshot. All fields are little-endian and
+ * naturally aligned so a mapped file can be read in place.
+ *
+ *   SnapshotHeader
+ *   recordCount x [SnapshotRecord, mean[featureCount], m2[featureCount]]
+ *
+ * Version 2 appends the off-diagonal co-moments of full-covariance models
+ * to every record, packed row by row below the diagonal:
+ *
+ *   [..., m2[featureCount], coMoment[featureCount * (featureCount - 1) / 2]]
+ *
+ * The checksum covers the header (with checksum = 0) and every record.
+ */
+struct SnapshotHeader {
+    uint32_t magic;            // kSnapshotMagic
+    uint32_t version;          // kSnapshotVersion or kSnapshotCovarianceVersion
+    uint32_t headerSize;       // sizeof(SnapshotHeader), for forward compatibility
+    uint32_t checksum;
+    uint32_t recordCount;
+    uint32_t featureCount;     // Features per record
+    int64_t createdUs;         // Wall clock time the snapshot was written
+    double decay;              // Forgetting factor the models were trained with
+    char deviceId[64];         // NUL-terminated, truncated if longer
+};
+
+struct SnapshotRecord {
+    int32_t key;               // Model key (hour of day)
+    uint32_t flags;            // Reserved
+    uint64_t sampleCount;
+    double weight;             // Effective (decayed) sample count
+};
+
+constexpr uint32_t kSnapshotMagic = 0x534d584e;  // "NXMS"
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr uint32_t kSnapshotCovarianceVersion = 2;
+
+/**
+ * One model's running state, as stored in a snapshot
+ */
+struct SnapshotEntry {
+    int key = 0;
+    uint64_t sampleCount = 0;
+    double weight = 0.0;
+    std::vector<double> mean;
+    std::vector<double> m2;
+    std::vector<double> coMoment;   // Packed lower triangle; empty for diagonal models
+};
+
+/**
+ * Writes a snapshot atomically and durably (see writeFileAtomic)
+ */
+class SnapshotWriter {
+public:
+    static bool write(const std::string& filePath, const std::string& deviceId, double decay,
+                      const std::vector<SnapshotEntry>& entries);
+};
+
+/**
+ * Read-only view of a snapshot file, memory-mapped where the platform allows.
+ * Record accessors point straight into the mapping; nothing is parsed.
+ */
+class MappedSnapshot {
+public:
+    MappedSnapshot() = default;
+    ~MappedSnapshot();
+
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    // Map and validate the file (magic, version, size and checksum)
+    bool open(const std::string& filePath);
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+    const SnapshotHeader& header() const { return *m_header; }
+    uint32_t recordCount() const { return m_header ? m_header->recordCount : 0; }
+
+    const SnapshotRecord& record(uint32_t index) const;
+    const double* mean(uint32_t index) const;
+    const double* m2(uint32_t index) const;
+    // Off-diagonal co-moments, or nullptr in a version 1 snapshot
+    const double* coMoment(uint32_t index) const;
+
+    bool hasCovariance() const { return m_header && m_header->version == kSnapshotCovarianceVersion; }
+
+    static size_t coMomentCount(uint32_t featureCount);
+    static size_t recordStride(uint32_t featureCount, bool covariance = false);
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    const SnapshotHeader* m_header = nullptr;
+    bool m_mapped = false;                // m_data is an mmap rather than m_buffer
+    std::vector<uint8_t> m_buffer;        // Fallback when mmap is unavailable
+};
+
+} // namespace nx_agent
@@ -0,0 +1,111 @@
+// nx_agent_spsc.h
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+namespace nx_agent {
+
+/**
+ * Bounded lock-free single-producer/single-consumer queue.
+ * Exactly one thread may push and exactly one thread may pop at a time.
+ */
+template<typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_capacity(capacity > 0 ? capacity : 1)
+    {
+        size_t slots = 1;
+        while (slots < m_capacity) {
+            slots <<= 1;
+        }
+        m_slots.resize(slots);
+        m_mask = slots - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side: returns false if the queue is full
+    bool tryPush(T&& item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) >= m_capacity) {
+            return false;
+        }
+        m_slots[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: returns false if the queue is empty
+    bool tryPop(T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: peek at the oldest element without removing it
+    T* front() {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_slots[head & m_mask];
+    }
+
+    // Approximate number of queued elements (exact from either endpoint)
+    size_t size() const {
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return m_capacity; }
+
+private:
+    std::vector<T> m_slots;
+    size_t m_capacity;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_head{0};  // Written by the consumer
+    alignas(64) std::atomic<size_t> m_tail{0};  // Written by the producer
+};
+
+/**
+ * Single-slot hand-off that only ever holds the newest item: a put replaces
+ * whatever the consumer has not taken yet. Both sides are one atomic
+ * exchange.
+ */
+template<typename T>
+class LatestMailbox {
+public:
+    LatestMailbox() = default;
+    ~LatestMailbox() { delete m_item.exchange(nullptr); }
+
+    LatestMailbox(const LatestMailbox&) = delete;
+    LatestMailbox& operator=(const LatestMailbox&) = delete;
+
+    // Producer side: returns the item this one displaced, if any
+    std::unique_ptr<T> put(std::unique_ptr<T> item) {
+        return std::unique_ptr<T>(m_item.exchange(item.release(), std::memory_order_acq_rel));
+    }
+
+    // Consumer side: returns nullptr if nothing is waiting
+    std::unique_ptr<T> take() {
+        return std::unique_ptr<T>(m_item.exchange(nullptr, std::memory_order_acq_rel));
+    }
+
+    bool empty() const { return m_item.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    std::atomic<T*> m_item{nullptr};
+};
+
+} // namespace nx_agent
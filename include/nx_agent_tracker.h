@@ -0,0 +1,113 @@
+// nx_agent_tracker.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+#include "nx_agent_attributes.h"
+
+namespace nx_agent {
+
+struct DetectedObject;
+class RegionIndex;
+
+/**
+ * Tracker counters
+ */
+struct TrackerStats {
+    uint64_t created = 0;
+    uint64_t expired = 0;
+    size_t active = 0;
+};
+
+/**
+ * Multi-object tracker that follows detections across frames and fills in
+ * their track fields (trackNumber, dwell time, velocity, time in the
+ * regions of interest).
+ *
+ * Detections that carry a trackId from the camera or VMS keep that
+ * identity. The others are matched greedily, in order, to the
+ * unmatched track of the same object class that overlaps most (IoU
+ * at or above the threshold) or, failing that, whose predicted center
+ * is nearest within the distance gate; tracks are bucketed in a coarse
+ * grid each frame, so matching costs O(detections + tracks). Track state
+ * is kept as parallel arrays indexed by slot, and tracks not seen for
+ * maxAge are dropped by a timing wheel driven by frame timestamps, so
+ * replayed video ages tracks exactly like live video. Not thread-safe.
+ */
+class ObjectTracker {
+public:
+    ObjectTracker();
+
+    // iouThreshold: minimum overlap for an IoU match; maxDistance: center
+    // distance gate as a fraction of the frame diagonal
+    void configure(float iouThreshold, float maxDistance, int64_t maxAgeUs);
+
+    // Associate this frame's objects with tracks and fill their track fields
+    void update(std::vector<DetectedObject>& objects, int64_t timestampUs,
+                const RegionIndex& regions, int frameWidth, int frameHeight);
+
+    // Drop every track
+    void reset();
+
+    TrackerStats stats() const;
+
+private:
+    static constexpr size_t kWheelSlots = 64;
+    static constexpr int kGridCells = 16;       // Per side, over the whole frame
+    static constexpr int64_t kNotInZone = INT64_MIN;
+
+    struct WheelEntry {
+        uint32_t id;
+        int64_t deadlineUs;
+    };
+
+    // Expire tracks last seen before nowUs - maxAge
+    void advanceWheel(int64_t nowUs);
+    void schedule(uint32_t id, int64_t deadlineUs);
+
+    // Best unmatched track for a detection without an external id, or -1
+    int findMatch(const DetectedObject& object, int64_t timestampUs, float frameWidth, float frameHeight,
+                  float gatePixels) const;
+    void bucketTracks(int64_t timestampUs, float frameWidth, float frameHeight);
+    int createTrack(const DetectedObject& object, int64_t timestampUs);
+    void removeTrack(size_t index);
+
+    float m_iouThreshold = 0.3f;
+    float m_maxDistance = 0.1f;
+    int64_t m_maxAgeUs = 3000000;
+    int64_t m_slotUs = 3000000 / 16;
+
+    // Track state, one entry per live track (structure of arrays)
+    std::vector<uint32_t> m_ids;
+    std::vector<ObjectClass> m_classes;
+    std::vector<float> m_x, m_y, m_w, m_h;      // Last box, pixels
+    std::vector<float> m_vx, m_vy;              // Smoothed center velocity, pixels per second
+    std::vector<int64_t> m_firstSeenUs;
+    std::vector<int64_t> m_lastSeenUs;
+    std::vector<int64_t> m_zoneEnteredUs;       // kNotInZone while outside the regions
+    std::vector<std::string> m_externalIds;     // Empty for tracks made by matching
+    std::vector<uint8_t> m_matched;             // Scratch, per update
+
+    std::unordered_map<uint32_t, uint32_t> m_slotById;
+    std::unordered_map<std::string, uint32_t> m_idByExternalId;
+    uint32_t m_nextId = 1;
+
+    // Per-frame grid over predicted centers: cell c holds m_cellTracks[m_cellStart[c] .. m_cellStart[c + 1])
+    std::vector<uint32_t> m_cellStart;
+    std::vector<uint32_t> m_cellTracks;
+    std::vector<uint32_t> m_trackCell;
+
+    // Timing wheel; one entry per track, re-armed lazily when it fires early
+    std::vector<std::vector<WheelEntry>> m_wheel;
+    int64_t m_wheelCursorUs = 0;
+    bool m_wheelStarted = false;
+    int64_t m_lastUpdateUs = 0;
+
+    TrackerStats m_stats;
+};
+
+} // namespace nx_agent
@@ -4,13 +4,33 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <opencv2/opencv.hpp>
 #include <nx/sdk/analytics/helpers/metadata_packet.h>
 
 namespace nx_agent {
 
+class FramePool;
+
 /**
- * Logging utilities with severity levels
+ * Logger counters
+ */
+struct LoggerStats {
+    uint64_t written = 0;
+    uint64_t dropped = 0;      // Lost because a thread's buffer was full
+    size_t threads = 0;        // Threads with a live log buffer
+};
+
+/**
+ * Logging utilities with severity levels.
+ *
+ * Messages are queued in a lock-free buffer owned by the calling thread and
+ * written in batches by a background thread, which also does the
+ * formatting. When a buffer is full the message is dropped and counted,
+ * except errors, which are then written synchronously. Use the NX_LOG_*
+ * macros where building the message is itself expensive.
  */
 class Logger {
 public:
@@ -25,6 +45,11 @@ public:
     static void setLogLevel(Level level);
     static Level getLogLevel();
     
+    // A single relaxed load; false means the message would be discarded
+    static bool isEnabled(Level level) {
+        return static_cast<int>(level) <= s_logLevel.load(std::memory_order_relaxed);
+    }
+    
     static void error(const std::string& message);
     static void warning(const std::string& message);
     static void info(const std::string& message);
@@ -38,8 +63,13 @@ public:
     static void debug(const std::string& context, const std::string& message);
     static void trace(const std::string& context, const std::string& message);
     
+    // Write everything queued so far, on the calling thread
+    static void flush();
+    
+    static LoggerStats stats();
+    
 private:
-    static Level s_logLevel;
+    static std::atomic<int> s_logLevel;
     static void log(Level level, const std::string& context, const std::string& message);
 };
 
@@ -54,7 +84,67 @@ namespace ImageUtils {
     
     // Convert Nx frame to OpenCV Mat
     cv::Mat nxFrameToMat(const nx::sdk::analytics::IUncompressedVideoFrame* frame);
-    
+
+    // Pixel layout of a raw frame buffer
+    enum class PixelFormat {
+        unknown,
+        rgb24,
+        bgr24,
+        nv12,
+        y800
+    };
+
+    // Map an Nx frame format to our pixel format (unknown if unsupported)
+    PixelFormat toPixelFormat(nx::sdk::analytics::UncompressedVideoFrame::Format format);
+
+    /**
+     * Lightweight view over a decoded frame.
+     *
+     * The luma plane is exposed without copying for NV12/Y800 input and is
+     * produced with a single fused colour-to-gray pass for packed RGB/BGR
+     * input. The BGR image is only built the first time a consumer asks for
+     * it. A view made from an Nx frame or raw buffer borrows that buffer and
+     * must not outlive it; use clone() to keep a frame beyond the callback.
+     * Lazily converted planes are cached, so a view must not be shared
+     * between threads.
+     */
+    class FrameView {
+    public:
+        FrameView() = default;
+        FrameView(PixelFormat format, int width, int height, const void* data);
+        explicit FrameView(const nx::sdk::analytics::IUncompressedVideoFrame* frame);
+
+        // Wrap an existing image (CV_8UC3 in BGR order, or CV_8UC1 grayscale)
+        explicit FrameView(const cv::Mat& image);
+
+        bool empty() const { return m_raw.empty(); }
+        int width() const { return m_width; }
+        int height() const { return m_height; }
+        PixelFormat format() const { return m_format; }
+
+        // Single-channel 8-bit luma plane
+        const cv::Mat& luma() const;
+
+        // 3-channel BGR image, converted on first use
+        const cv::Mat& bgr() const;
+
+        // Deep copy that owns its pixel data. With a pool, the copy and the
+        // planes later converted from it are drawn from the pool's buffers.
+        FrameView clone(const std::shared_ptr<FramePool>& pool = nullptr) const;
+
+    private:
+        // Draw a converted plane from the pool, if the view has one
+        void preallocate(cv::Mat& plane, int type) const;
+
+        PixelFormat m_format = PixelFormat::unknown;
+        int m_width = 0;
+        int m_height = 0;
+        cv::Mat m_raw;          // Packed RGB/BGR, Y800, or NV12 (height * 3 / 2 rows)
+        mutable cv::Mat m_luma;
+        mutable cv::Mat m_bgr;
+        std::shared_ptr<FramePool> m_pool;
+    };
+
     // Enhance image contrast for better visibility
     cv::Mat enhanceContrast(const cv::Mat& input, float alpha = 1.2f, int beta = 10);
     
@@ -88,6 +178,30 @@ namespace TimeUtils {
     // Get day of week from timestamp (0 = Sunday, 6 = Saturday)
     int getDayOfWeek(int64_t timestampUs);
     
+    // Local calendar fields of a timestamp
+    struct LocalTime {
+        int year = 1970;
+        int month = 1;          // 1-12
+        int day = 1;            // 1-31
+        int hour = 0;
+        int minute = 0;
+        int second = 0;
+        int timeOfDaySeconds = 0;
+        int dayOfWeek = 0;      // 0 = Sunday
+        int utcOffsetSeconds = 0;
+    };
+    
+    // The UTC offset is looked up once per UTC day and thread, together with
+    // the instant of a DST change falling in that day; everything else is
+    // integer arithmetic, so no timezone lock is taken on the hot path.
+    LocalTime getLocalTime(int64_t timestampUs);
+    
+    // Get the local hour (0-23) of a timestamp
+    int getHourOfDay(int64_t timestampUs);
+    
+    // Drop cached offsets in every thread, e.g. after changing TZ and calling tzset()
+    void resetLocalTimeCache();
+    
     // Structure to represent a time range
     struct TimeRange {
         int startSeconds;
@@ -125,15 +239,26 @@ namespace StringUtils {
     std::vector<uint8_t> base64Decode(const std::string& encoded);
 }
 
+// Log macros that only evaluate the message when the level is enabled
+#define NX_LOG_INFO(context, message) \
+    do { if (::nx_agent::Logger::isEnabled(::nx_agent::Logger::Level::INFO)) ::nx_agent::Logger::info(context, message); } while (0)
+#define NX_LOG_DEBUG(context, message) \
+    do { if (::nx_agent::Logger::isEnabled(::nx_agent::Logger::Level::DEBUG)) ::nx_agent::Logger::debug(context, message); } while (0)
+#define NX_LOG_TRACE(context, message) \
+    do { if (::nx_agent::Logger::isEnabled(::nx_agent::Logger::Level::TRACE)) ::nx_agent::Logger::trace(context, message); } while (0)
+
 /**
- * Performance measurement utilities
+ * Performance measurement utilities. Reports at DEBUG level; when that is
+ * disabled the timer reads no clock and builds no message.
  */
 class ScopedTimer {
 public:
+    ScopedTimer(const char* operationName);
     ScopedTimer(const std::string& operationName);
     ~ScopedTimer();
     
 private:
+    bool m_enabled;
     std::string m_operationName;
     std::chrono::high_resolution_clock::time_point m_startTime;
 };
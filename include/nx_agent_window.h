@@ -0,0 +1,149 @@
+// nx_agent_window.h
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace nx_agent {
+
+struct FeatureVector;
+
+/**
+ * Fixed-capacity ring of timestamped samples, stored column by column so a
+ * feature's history is contiguous. Pushing into a full ring overwrites the
+ * oldest sample. Samples are addressed by sequence number: the n-th sample
+ * ever pushed is n, and samples [head() - size(), head()) are held.
+ */
+class FeatureRing {
+public:
+    static constexpr int kMaxColumns = 16;
+
+    FeatureRing(size_t capacity, int columns);
+
+    void push(int64_t timestampUs, const float* values);
+    void clear();
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    int columns() const { return m_columns; }
+    bool full() const { return m_size == m_capacity; }
+
+    uint64_t head() const { return m_head; }
+    uint64_t oldest() const { return m_head - m_size; }
+
+    // seq must be held
+    int64_t timestampAt(uint64_t seq) const { return m_timestamps[seq % m_capacity]; }
+    float valueAt(uint64_t seq, int column) const { return m_values[column * m_capacity + seq % m_capacity]; }
+
+private:
+    size_t m_capacity;
+    int m_columns;
+    std::vector<int64_t> m_timestamps;
+    std::vector<float> m_values;     // Column c at [c * capacity, (c + 1) * capacity)
+    uint64_t m_head = 0;
+    size_t m_size = 0;
+};
+
+/**
+ * Rolling statistics of a sample stream over several trailing windows of
+ * event time (e.g. 1, 5 and 30 minutes). Samples are averaged into bins of
+ * binUs and each completed bin enters a FeatureRing sized for the longest
+ * window; every window keeps a running mean and variance (Welford, with
+ * removal), an exponentially weighted mean with the window as its time
+ * constant and its oldest bin, so adding a bin and expiring the old ones
+ * costs O(1) amortized per window and feature. A timestamp going backwards
+ * (a restarted stream) starts over. Not thread-safe.
+ */
+class SlidingWindowStats {
+public:
+    SlidingWindowStats(int columns, const std::vector<int64_t>& windowsUs, int64_t binUs = 1000000);
+
+    void add(int64_t timestampUs, const float* values);
+    void clear();
+
+    int columns() const { return m_ring.columns(); }
+    size_t windowCount() const { return m_windows.size(); }
+    int64_t windowUs(size_t window) const { return m_windows[window].durationUs; }
+
+    // Completed bins in the window
+    size_t count(size_t window) const { return m_windows[window].count; }
+
+    // Event time the window's bins span
+    int64_t coveredUs(size_t window) const;
+
+    float mean(size_t window, int column) const { return static_cast<float>(m_windows[window].mean[column]); }
+    float variance(size_t window, int column) const;
+    float ewma(size_t window, int column) const { return static_cast<float>(m_windows[window].ewma[column]); }
+
+    // Change per second from the window's oldest bin to the newest
+    float rateOfChange(size_t window, int column) const;
+
+private:
+    struct Window {
+        int64_t durationUs = 0;
+        uint64_t tail = 0;           // Sequence number of the oldest bin inside
+        size_t count = 0;
+        std::array<double, FeatureRing::kMaxColumns> mean{};
+        std::array<double, FeatureRing::kMaxColumns> m2{};
+        std::array<double, FeatureRing::kMaxColumns> ewma{};
+    };
+
+    void flushBin();
+    void removeOldest(Window& window);
+
+    int64_t m_binUs;
+    FeatureRing m_ring;
+    std::vector<Window> m_windows;
+    int64_t m_lastBinUs = 0;         // Start of the newest completed bin
+
+    // Bin being filled
+    int64_t m_pendingBin = -1;
+    size_t m_pendingCount = 0;
+    std::array<double, FeatureRing::kMaxColumns> m_pendingSum{};
+};
+
+/**
+ * How far recent activity departs from the last half hour
+ */
+struct ShortTermScore {
+    float burst = 0.0f;      // Last minute against the last 30 minutes
+    float drift = 0.0f;      // Last 5 minutes, trending the same way over 30 minutes
+    int feature = -1;        // ShortTermDetector feature of the larger score, -1 if none
+};
+
+/**
+ * Short-term burst and drift detection over a camera's recent frames,
+ * alongside the hour-of-day models: those know what is usual at this time
+ * of day, this knows what was usual a few minutes ago. Scores the frame
+ * features except the calendar ones, and only once the 30-minute window
+ * holds kMinHistoryUs of frames. Not thread-safe.
+ */
+class ShortTermDetector {
+public:
+    static constexpr int64_t kShortWindowUs = 60LL * 1000000;
+    static constexpr int64_t kMediumWindowUs = 5LL * 60 * 1000000;
+    static constexpr int64_t kLongWindowUs = 30LL * 60 * 1000000;
+    static constexpr int64_t kMinHistoryUs = 10LL * 60 * 1000000;
+
+    ShortTermDetector();
+
+    // Fold the frame's features in and score the recent windows
+    ShortTermScore update(const FeatureVector& features);
+
+    void reset() { m_stats.clear(); }
+
+    const SlidingWindowStats& stats() const { return m_stats; }
+
+    // Name of a scored feature, for event descriptions
+    static const char* featureName(int feature);
+
+private:
+    float deviation(size_t window, int feature, bool useEwma) const;
+
+    SlidingWindowStats m_stats;
+};
+
+} // namespace nx_agent
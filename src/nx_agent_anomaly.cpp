@@ -2,6 +2,10 @@
 #include "nx_agent_anomaly.h"
 #include "nx_agent_config.h"
 #include "nx_agent_metadata.h"
+#include "nx_agent_persistence.h"
+#include "nx_agent_featurelog.h"
+#include "nx_agent_replication.h"
+#include "nx_agent_metrics.h"
 
 #include <iostream>
 #include <fstream>
@@ -9,25 +13,29 @@
 #include <ctime>
 #include <filesystem>
 #include <algorithm>
+#include <cmath>
 
 namespace nx_agent {
 
 // FeatureVector implementation
+float FeatureVector::featureAt(int index) const {
+    switch (index) {
+        case 0: return static_cast<float>(timeOfDaySeconds) / 86400.0f; // Normalize to 0-1
+        case 1: return static_cast<float>(dayOfWeek) / 7.0f;           // Normalize to 0-1
+        case 2: return motionLevel;
+        case 3: return static_cast<float>(personCount);
+        case 4: return static_cast<float>(vehicleCount);
+        default: return additionalFeatures[index - 5];
+    }
+}
+
 cv::Mat FeatureVector::toMat() const {
     // Create a feature matrix (row vector)
-    int featureCount = 5 + additionalFeatures.size();
-    cv::Mat mat(1, featureCount, CV_32F);
+    int count = featureCount();
+    cv::Mat mat(1, count, CV_32F);
     
-    // Basic features
-    mat.at<float>(0, 0) = static_cast<float>(timeOfDaySeconds) / 86400.0f; // Normalize to 0-1
-    mat.at<float>(0, 1) = static_cast<float>(dayOfWeek) / 7.0f;           // Normalize to 0-1
-    mat.at<float>(0, 2) = motionLevel;
-    mat.at<float>(0, 3) = static_cast<float>(personCount);
-    mat.at<float>(0, 4) = static_cast<float>(vehicleCount);
-    
-    // Additional features
-    for (size_t i = 0; i < additionalFeatures.size(); ++i) {
-        mat.at<float>(0, 5 + i) = additionalFeatures[i];
+    for (int i = 0; i < count; ++i) {
+        mat.at<float>(0, i) = featureAt(i);
     }
     
     return mat;
@@ -58,6 +66,20 @@ FeatureVector FeatureVector::fromMat(const cv::Mat& mat) {
     return features;
 }
 
+AnomalyModelType parseAnomalyModelType(const std::string& name) {
+    if (name == "fullCovariance") {
+        return AnomalyModelType::FullCovariance;
+    }
+    return AnomalyModelType::Diagonal;
+}
+
+// AnomalyModel implementation
+void AnomalyModel::scoreBatch(const FeatureVector* features, size_t count, float* scores) {
+    for (size_t i = 0; i < count; ++i) {
+        scores[i] = scoreAnomaly(features[i]);
+    }
+}
+
 // GaussianModel implementation
 GaussianModel::GaussianModel() {}
 
@@ -94,14 +116,16 @@ float GaussianModel::scoreAnomaly(const FeatureVector& features) {
         return 1.0f; // Consider everything anomalous if not trained
     }
     
-    cv::Mat featureMat = features.toMat();
+    int count = std::min(features.featureCount(), m_mean.cols);
+    const float* means = m_mean.ptr<float>(0);
+    const float* stdDevs = m_stdDev.ptr<float>(0);
     
     // Calculate Mahalanobis distance (simplified version using std dev instead of full covariance)
     float anomalyScore = 0.0f;
-    for (int i = 0; i < featureMat.cols; ++i) {
-        float value = featureMat.at<float>(0, i);
-        float mean = m_mean.at<float>(0, i);
-        float stdDev = m_stdDev.at<float>(0, i);
+    for (int i = 0; i < count; ++i) {
+        float value = features.featureAt(i);
+        float mean = means[i];
+        float stdDev = stdDevs[i];
         
         // Avoid division by zero
         if (stdDev > 1e-5) {
@@ -111,7 +135,7 @@ float GaussianModel::scoreAnomaly(const FeatureVector& features) {
     }
     
     // Normalize to 0-1 range using an exponential transformation
-    return 1.0f - std::exp(-anomalyScore / (2.0f * featureMat.cols));
+    return 1.0f - std::exp(-anomalyScore / (2.0f * std::max(1, count)));
 }
 
 bool GaussianModel::saveToFile(const std::string& filePath) {
@@ -154,7 +178,478 @@ bool GaussianModel::loadFromFile(const std::string& filePath) {
     }
 }
 
+size_t GaussianModel::memoryBytes() const {
+    return sizeof(*this) + (m_mean.total() + m_stdDev.total()) * sizeof(float);
+}
+
+// OnlineGaussianModel implementation
+OnlineGaussianModel::OnlineGaussianModel(double decay, uint64_t minSamples)
+    : m_decay(std::max(0.0, std::min(1.0, decay))),
+      m_minSamples(std::max<uint64_t>(1, minSamples))
+{
+}
+
+void OnlineGaussianModel::train(const std::vector<FeatureVector>& normalFeatures) {
+    for (const auto& features : normalFeatures) {
+        update(features);
+    }
+}
+
+void OnlineGaussianModel::update(const FeatureVector& features) {
+    int count = features.featureCount();
+    
+    if (m_mean.empty()) {
+        m_mean.assign(count, 0.0);
+        m_m2.assign(count, 0.0);
+    } else if (static_cast<int>(m_mean.size()) != count) {
+        std::cerr << "Feature count mismatch in online model update" << std::endl;
+        return;
+    }
+    
+    // Decayed Welford update; with m_decay == 0 this is the classic algorithm
+    double keep = 1.0 - m_decay;
+    m_weight = m_weight * keep + 1.0;
+    
+    for (int i = 0; i < count; ++i) {
+        double value = features.featureAt(i);
+        double delta = value - m_mean[i];
+        m_mean[i] += delta / m_weight;
+        m_m2[i] = m_m2[i] * keep + delta * (value - m_mean[i]);
+    }
+    
+    m_sampleCount++;
+}
+
+float OnlineGaussianModel::scoreAnomaly(const FeatureVector& features) {
+    if (!isTrained()) {
+        return 1.0f; // Consider everything anomalous if not trained
+    }
+    
+    int count = std::min(features.featureCount(), static_cast<int>(m_mean.size()));
+    
+    // Same simplified Mahalanobis distance as GaussianModel
+    float anomalyScore = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        float stdDev = static_cast<float>(std::sqrt(m_m2[i] / m_weight));
+        
+        // Avoid division by zero
+        if (stdDev > 1e-5) {
+            float normalizedDiff = (features.featureAt(i) - static_cast<float>(m_mean[i])) / stdDev;
+            anomalyScore += normalizedDiff * normalizedDiff;
+        }
+    }
+    
+    // Normalize to 0-1 range using an exponential transformation
+    return 1.0f - std::exp(-anomalyScore / (2.0f * std::max(1, count)));
+}
+
+bool OnlineGaussianModel::saveToFile(const std::string& filePath) {
+    try {
+        cv::FileStorage fs(filePath, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            std::cerr << "Failed to open file for writing: " << filePath << std::endl;
+            return false;
+        }
+        
+        bool trained = isTrained();
+        fs << "trained" << trained;
+        fs << "sampleCount" << static_cast<double>(m_sampleCount);
+        fs << "weight" << m_weight;
+        fs << "mean" << m_mean;
+        fs << "m2" << m_m2;
+        
+        fs.release();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving model: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool OnlineGaussianModel::loadFromFile(const std::string& filePath) {
+    try {
+        cv::FileStorage fs(filePath, cv::FileStorage::READ);
+        if (!fs.isOpened()) {
+            std::cerr << "Failed to open file for reading: " << filePath << std::endl;
+            return false;
+        }
+        
+        if (!fs["m2"].empty()) {
+            double sampleCount = 0.0;
+            fs["sampleCount"] >> sampleCount;
+            fs["weight"] >> m_weight;
+            fs["mean"] >> m_mean;
+            fs["m2"] >> m_m2;
+            m_sampleCount = static_cast<uint64_t>(sampleCount);
+        } else {
+            // Model written by GaussianModel: seed the running state from its
+            // mean/stdDev as if it had been learned from m_minSamples samples
+            bool trained = false;
+            cv::Mat mean;
+            cv::Mat stdDev;
+            fs["trained"] >> trained;
+            fs["mean"] >> mean;
+            fs["stdDev"] >> stdDev;
+            if (!trained || mean.cols != stdDev.cols) {
+                return false;
+            }
+            
+            m_weight = static_cast<double>(m_minSamples);
+            m_sampleCount = m_minSamples;
+            m_mean.assign(mean.cols, 0.0);
+            m_m2.assign(mean.cols, 0.0);
+            for (int i = 0; i < mean.cols; ++i) {
+                double sd = stdDev.at<float>(0, i);
+                m_mean[i] = mean.at<float>(0, i);
+                m_m2[i] = sd * sd * m_weight;
+            }
+        }
+        
+        fs.release();
+        
+        if (m_mean.size() != m_m2.size()) {
+            std::cerr << "Corrupt online model: " << filePath << std::endl;
+            m_mean.clear();
+            m_m2.clear();
+            m_sampleCount = 0;
+            m_weight = 0.0;
+            return false;
+        }
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading model: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool OnlineGaussianModel::exportState(SnapshotEntry& entry) const {
+    if (m_mean.empty()) {
+        return false;
+    }
+    entry.sampleCount = m_sampleCount;
+    entry.weight = m_weight;
+    entry.mean = m_mean;
+    entry.m2 = m_m2;
+    return true;
+}
+
+bool OnlineGaussianModel::importState(const SnapshotEntry& entry) {
+    if (entry.mean.empty() || entry.mean.size() != entry.m2.size()) {
+        return false;
+    }
+    m_sampleCount = entry.sampleCount;
+    m_weight = entry.weight;
+    m_mean = entry.mean;
+    m_m2 = entry.m2;
+    return true;
+}
+
+size_t OnlineGaussianModel::memoryBytes() const {
+    return sizeof(*this) + (m_mean.capacity() + m_m2.capacity()) * sizeof(double);
+}
+
+// CovarianceGaussianModel implementation
+CovarianceGaussianModel::CovarianceGaussianModel(double decay, uint64_t minSamples)
+    : m_decay(std::max(0.0, std::min(1.0, decay))),
+      m_minSamples(std::max<uint64_t>(1, minSamples))
+{
+}
+
+void CovarianceGaussianModel::train(const std::vector<FeatureVector>& normalFeatures) {
+    for (const auto& features : normalFeatures) {
+        update(features);
+    }
+    m_factorReady = false;
+}
+
+void CovarianceGaussianModel::update(const FeatureVector& features) {
+    int count = features.featureCount();
+    
+    if (m_featureCount == 0) {
+        if (count > kMaxFeatures) {
+            std::cerr << "Too many features for covariance model: " << count << std::endl;
+            return;
+        }
+        m_featureCount = count;
+    } else if (count != m_featureCount) {
+        std::cerr << "Feature count mismatch in covariance model update" << std::endl;
+        return;
+    }
+    
+    // Multivariate form of OnlineGaussianModel's decayed Welford update
+    double keep = 1.0 - m_decay;
+    m_weight = m_weight * keep + 1.0;
+    
+    double value[kMaxFeatures];
+    double delta[kMaxFeatures];
+    for (int i = 0; i < count; ++i) {
+        value[i] = features.featureAt(i);
+        delta[i] = value[i] - m_mean[i];
+        m_mean[i] += delta[i] / m_weight;
+    }
+    for (int i = 0; i < count; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            double& coMoment = m_coMoment[packed(i, j)];
+            coMoment = coMoment * keep + delta[i] * (value[j] - m_mean[j]);
+        }
+    }
+    
+    m_sampleCount++;
+    m_pendingUpdates++;
+}
+
+void CovarianceGaussianModel::prepareFactor() {
+    if (!m_factorReady || m_pendingUpdates >= kRefactorInterval) {
+        refactor();
+    }
+}
+
+void CovarianceGaussianModel::refactor() {
+    m_factorReady = true;
+    m_pendingUpdates = 0;
+    m_activeCount = 0;
+    if (m_weight <= 0.0) {
+        return;
+    }
+    
+    // Same variance floor as the diagonal model's stdDev > 1e-5
+    for (int i = 0; i < m_featureCount; ++i) {
+        if (m_coMoment[packed(i, i)] / m_weight > 1e-10) {
+            m_active[m_activeCount++] = i;
+        }
+    }
+    int n = m_activeCount;
+    
+    double covariance[kPackedSize];
+    double meanVariance = 0.0;
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c <= r; ++c) {
+            covariance[packed(r, c)] = m_coMoment[packed(m_active[r], m_active[c])] / m_weight;
+        }
+        meanVariance += covariance[packed(r, r)] / n;
+    }
+    
+    // Features that move together can make the covariance singular; retry
+    // with a growing ridge before falling back to the diagonal
+    double factor[kPackedSize];
+    bool factored = false;
+    for (double ridge : {0.0, 1e-9, 1e-6, 1e-3}) {
+        factored = true;
+        for (int r = 0; r < n && factored; ++r) {
+            for (int c = 0; c <= r; ++c) {
+                double sum = covariance[packed(r, c)];
+                for (int k = 0; k < c; ++k) {
+                    sum -= factor[packed(r, k)] * factor[packed(c, k)];
+                }
+                if (c < r) {
+                    factor[packed(r, c)] = sum / factor[packed(c, c)];
+                } else if (sum + ridge * meanVariance > 0.0) {
+                    factor[packed(r, r)] = std::sqrt(sum + ridge * meanVariance);
+                } else {
+                    factored = false;
+                    break;
+                }
+            }
+        }
+        if (factored) {
+            break;
+        }
+    }
+    
+    for (int r = 0; r < n; ++r) {
+        m_activeMean[r] = static_cast<float>(m_mean[m_active[r]]);
+        for (int c = 0; c < r; ++c) {
+            m_factor[packed(r, c)] = factored ? static_cast<float>(factor[packed(r, c)]) : 0.0f;
+        }
+        double diagonal = factored ? factor[packed(r, r)] : std::sqrt(covariance[packed(r, r)]);
+        m_factor[packed(r, r)] = static_cast<float>(diagonal);
+        m_inverseDiagonal[r] = static_cast<float>(1.0 / diagonal);
+    }
+}
+
+float CovarianceGaussianModel::toScore(float distanceSquared) const {
+    // Same normalization as the diagonal models
+    return 1.0f - std::exp(-distanceSquared / (2.0f * std::max(1, m_featureCount)));
+}
+
+float CovarianceGaussianModel::scoreAnomaly(const FeatureVector& features) {
+    if (!isTrained()) {
+        return 1.0f; // Consider everything anomalous if not trained
+    }
+    prepareFactor();
+    
+    // Missing trailing features count as being at the mean
+    int count = features.featureCount();
+    float z[kMaxFeatures];
+    float distanceSquared = 0.0f;
+    
+    // Solve L z = x - mean; the squared length of z is the Mahalanobis distance
+    for (int r = 0; r < m_activeCount; ++r) {
+        int feature = m_active[r];
+        float value = feature < count ? features.featureAt(feature) - m_activeMean[r] : 0.0f;
+        for (int c = 0; c < r; ++c) {
+            value -= m_factor[packed(r, c)] * z[c];
+        }
+        z[r] = value * m_inverseDiagonal[r];
+        distanceSquared += z[r] * z[r];
+    }
+    
+    return toScore(distanceSquared);
+}
+
+void CovarianceGaussianModel::scoreBatch(const FeatureVector* features, size_t count, float* scores) {
+    if (!isTrained()) {
+        std::fill(scores, scores + count, 1.0f);
+        return;
+    }
+    prepareFactor();
+    
+    // Lane-major blocks: each inner loop runs over kBatchLanes independent samples
+    float z[kMaxFeatures][kBatchLanes];
+    
+    for (size_t base = 0; base < count; base += kBatchLanes) {
+        size_t lanes = std::min<size_t>(kBatchLanes, count - base);
+        float distanceSquared[kBatchLanes] = {};
+        
+        for (int r = 0; r < m_activeCount; ++r) {
+            int feature = m_active[r];
+            float value[kBatchLanes];
+            for (size_t lane = 0; lane < kBatchLanes; ++lane) {
+                // Unused tail lanes sit at the mean
+                const FeatureVector* sample = lane < lanes ? &features[base + lane] : nullptr;
+                value[lane] = sample && feature < sample->featureCount()
+                    ? sample->featureAt(feature) - m_activeMean[r] : 0.0f;
+            }
+            for (int c = 0; c < r; ++c) {
+                float coefficient = m_factor[packed(r, c)];
+                for (int lane = 0; lane < kBatchLanes; ++lane) {
+                    value[lane] -= coefficient * z[c][lane];
+                }
+            }
+            float inverse = m_inverseDiagonal[r];
+            for (int lane = 0; lane < kBatchLanes; ++lane) {
+                z[r][lane] = value[lane] * inverse;
+                distanceSquared[lane] += z[r][lane] * z[r][lane];
+            }
+        }
+        
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            scores[base + lane] = toScore(distanceSquared[lane]);
+        }
+    }
+}
+
+bool CovarianceGaussianModel::saveToFile(const std::string& filePath) {
+    SnapshotEntry entry;
+    if (!exportState(entry)) {
+        return false;
+    }
+    
+    try {
+        cv::FileStorage fs(filePath, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            std::cerr << "Failed to open file for writing: " << filePath << std::endl;
+            return false;
+        }
+        
+        bool trained = isTrained();
+        fs << "trained" << trained;
+        fs << "sampleCount" << static_cast<double>(m_sampleCount);
+        fs << "weight" << m_weight;
+        fs << "mean" << entry.mean;
+        fs << "m2" << entry.m2;
+        fs << "coMoment" << entry.coMoment;
+        
+        fs.release();
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Error saving model: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool CovarianceGaussianModel::loadFromFile(const std::string& filePath) {
+    // The diagonal model reads both older formats; add the co-moments if present
+    OnlineGaussianModel diagonal(m_decay, m_minSamples);
+    SnapshotEntry entry;
+    if (!diagonal.loadFromFile(filePath) || !diagonal.exportState(entry)) {
+        return false;
+    }
+    
+    try {
+        cv::FileStorage fs(filePath, cv::FileStorage::READ);
+        if (fs.isOpened() && !fs["coMoment"].empty()) {
+            fs["coMoment"] >> entry.coMoment;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error loading model: " << e.what() << std::endl;
+        return false;
+    }
+    
+    return importState(entry);
+}
+
+bool CovarianceGaussianModel::exportState(SnapshotEntry& entry) const {
+    if (m_featureCount == 0) {
+        return false;
+    }
+    entry.sampleCount = m_sampleCount;
+    entry.weight = m_weight;
+    entry.mean.assign(m_mean.begin(), m_mean.begin() + m_featureCount);
+    entry.m2.resize(m_featureCount);
+    entry.coMoment.clear();
+    for (int i = 0; i < m_featureCount; ++i) {
+        entry.m2[i] = m_coMoment[packed(i, i)];
+        for (int j = 0; j < i; ++j) {
+            entry.coMoment.push_back(m_coMoment[packed(i, j)]);
+        }
+    }
+    return true;
+}
+
+bool CovarianceGaussianModel::importState(const SnapshotEntry& entry) {
+    size_t count = entry.mean.size();
+    size_t offDiagonal = count * (count - 1) / 2;
+    if (count == 0 || count > static_cast<size_t>(kMaxFeatures) || entry.m2.size() != count ||
+        (!entry.coMoment.empty() && entry.coMoment.size() != offDiagonal)) {
+        return false;
+    }
+    
+    // State from a diagonal model starts out with uncorrelated features
+    clear();
+    m_featureCount = static_cast<int>(count);
+    m_sampleCount = entry.sampleCount;
+    m_weight = entry.weight;
+    size_t next = 0;
+    for (int i = 0; i < m_featureCount; ++i) {
+        m_mean[i] = entry.mean[i];
+        m_coMoment[packed(i, i)] = entry.m2[i];
+        for (int j = 0; j < i; ++j, ++next) {
+            m_coMoment[packed(i, j)] = entry.coMoment.empty() ? 0.0 : entry.coMoment[next];
+        }
+    }
+    return true;
+}
+
+size_t CovarianceGaussianModel::memoryBytes() const {
+    // Fixed-size state; nothing on the heap
+    return sizeof(*this);
+}
+
+void CovarianceGaussianModel::clear() {
+    m_sampleCount = 0;
+    m_weight = 0.0;
+    m_featureCount = 0;
+    m_mean.fill(0.0);
+    m_coMoment.fill(0.0);
+    m_factorReady = false;
+    m_pendingUpdates = 0;
+    m_activeCount = 0;
+}
+
 // AnomalyDetector implementation
+std::atomic<int64_t> AnomalyDetector::s_residentBytes{0};
+
 AnomalyDetector::AnomalyDetector(const std::string& deviceId)
     : m_deviceId(deviceId),
       m_anomalyThreshold(0.7f)
@@ -162,51 +657,78 @@ AnomalyDetector::AnomalyDetector(const std::string& deviceId)
     // Load configuration
     m_config = GlobalConfig::instance().getDeviceConfig(deviceId);
     m_anomalyThreshold = m_config->anomalyThreshold;
+    m_residentBytesGauge = MetricsRegistry::instance().gauge("nx_agent_model_cache_bytes", m_deviceId);
     
-    // Initialize models for each hour of the day
-    for (int hour = 0; hour < 24; ++hour) {
-        m_timeModels[hour] = std::make_unique<GaussianModel>();
-        m_baselineData[hour] = std::vector<FeatureVector>();
-        
-        // Try to load existing model
-        std::string modelPath = getModelFilePath(hour);
-        if (std::filesystem::exists(modelPath)) {
-            m_timeModels[hour]->loadFromFile(modelPath);
-        }
+    // Create the device-specific directory once rather than on every save
+    m_modelDir = GlobalConfig::instance().dataStoragePath + "/" + m_deviceId;
+    std::error_code ec;
+    std::filesystem::create_directories(m_modelDir, ec);
+    if (ec) {
+        std::cerr << "Failed to create model directory " << m_modelDir << ": " << ec.message() << std::endl;
     }
+    m_featureLog = std::make_unique<FeatureLog>(m_modelDir + "/features");
+    m_featureLog->setRetentionDays(m_config->baselineDurationDays);
+    
+    // A camera that failed over from another server brings its models
+    // along; a slow store delays the device by replicationRestoreTimeoutMs at most
+    ModelReplicationService::instance().restore(m_deviceId, m_modelDir);
+    
+    // Saves are written behind by the persistence service
+    m_persistHandle = ModelPersistenceService::instance().registerSource([this]() {
+        return saveModel();
+    });
+    
+    // Try to load existing models; hours are paged in as frames need them
+    loadModel();
 }
 
 AnomalyDetector::~AnomalyDetector() {
-    // Save models on destruction
-    saveModel();
+    // Writes pending changes (if any) and waits for an in-progress save
+    ModelPersistenceService::instance().unregisterSource(m_persistHandle);
+    
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    for (const auto& pair : m_models) {
+        s_residentBytes -= static_cast<int64_t>(pair.second.chargedBytes);
+        m_residentBytesGauge->add(-static_cast<int64_t>(pair.second.chargedBytes));
+    }
 }
 
-void AnomalyDetector::configure(std::shared_ptr<DeviceConfig> config) {
-    m_config = config;
-    m_anomalyThreshold = m_config->anomalyThreshold;
+void AnomalyDetector::configure(std::shared_ptr<const DeviceConfig> config) {
+    m_anomalyThreshold = config->anomalyThreshold;
+    m_featureLog->setRetentionDays(config->baselineDurationDays);
+    std::atomic_store(&m_config, std::move(config));
 }
 
 bool AnomalyDetector::detectAnomaly(FrameAnalysisResult& result) {
     // Extract features from the analysis result
     FeatureVector features = extractFeatures(result);
     
-    // Get the appropriate model for this time of day
-    int hour = getHourOfDay(result.timestampUs);
-    auto modelIt = m_timeModels.find(hour);
-    if (modelIt == m_timeModels.end() || !modelIt->second->isTrained()) {
-        // No model available, consider as normal
-        // Alternatively, you could consider everything anomalous when no model exists
-        return false;
+    // Compare the last minutes with the last half hour
+    ShortTermScore shortTerm;
+    if (std::atomic_load(&m_config)->enableShortTermDetection) {
+        std::lock_guard<std::mutex> lock(m_historyMutex);
+        shortTerm = m_shortTerm.update(features);
     }
     
-    // Score anomaly using the model
-    float anomalyScore = modelIt->second->scoreAnomaly(features);
+    // Get the appropriate model for this time of day
+    float anomalyScore = 0.0f;
+    {
+        std::lock_guard<std::mutex> lock(m_modelMutex);
+        AnomalyModel* model = modelFor(features).model.get();
+        
+        // Without a model the hour counts as normal
+        if (model->isTrained()) {
+            anomalyScore = model->scoreAnomaly(features);
+        }
+    }
+    float shortTermScore = std::max(shortTerm.burst, shortTerm.drift);
     
     // Update the result
-    result.anomalyScore = std::max(result.anomalyScore, anomalyScore);
+    result.anomalyScore = std::max(result.anomalyScore, std::max(anomalyScore, shortTermScore));
     
     // If score exceeds threshold, mark as anomaly
-    if (anomalyScore > m_anomalyThreshold) {
+    float threshold = m_anomalyThreshold;
+    if (anomalyScore > threshold) {
         // If no specific anomaly type is set, set a generic one
         if (result.anomalyType.empty()) {
             result.anomalyType = "StatisticalAnomaly";
@@ -215,97 +737,225 @@ bool AnomalyDetector::detectAnomaly(FrameAnalysisResult& result) {
         result.isAnomaly = true;
         return true;
     }
+    if (shortTermScore > threshold) {
+        if (result.anomalyType.empty()) {
+            std::string feature = ShortTermDetector::featureName(shortTerm.feature);
+            if (shortTerm.burst >= shortTerm.drift) {
+                result.anomalyType = "ActivityBurst";
+                result.anomalyDescription = "Sudden change in " + feature + " over the last minute";
+            } else {
+                result.anomalyType = "ActivityDrift";
+                result.anomalyDescription = "Sustained change in " + feature + " over the last minutes";
+            }
+        }
+        result.isAnomaly = true;
+        return true;
+    }
     
     return false;
 }
 
 void AnomalyDetector::addToBaseline(const FrameAnalysisResult& result) {
-    if (!m_config->enableLearning) {
+    if (!std::atomic_load(&m_config)->enableLearning) {
         return;
     }
     
     FeatureVector features = extractFeatures(result);
-    int hour = getHourOfDay(result.timestampUs);
     
     {
-        std::lock_guard<std::mutex> lock(m_baselineMutex);
-        
-        // Add to hourly baseline data
-        m_baselineData[hour].push_back(features);
-        
-        // If we've collected enough data, train the model
-        if (m_baselineData[hour].size() >= 100) { // Arbitrary threshold, adjust as needed
-            trainModels();
-        }
-    }
-    
-    // Also maintain recent history for short-term pattern detection
-    m_recentHistory.push_back(features);
-    while (m_recentHistory.size() > 1000) { // Keep last ~30 minutes assuming 1 frame/2 seconds
-        m_recentHistory.pop_front();
+        // Fold the sample into the hourly model; no samples are retained
+        std::lock_guard<std::mutex> lock(m_modelMutex);
+        ResidentModel& resident = modelFor(features);
+        resident.model->update(features);
+        ++resident.version;
+        charge(resident);
     }
+    m_featureLog->append(features);
+    markDirty();
 }
 
 void AnomalyDetector::resetBaseline() {
-    std::lock_guard<std::mutex> lock(m_baselineMutex);
-    
-    for (auto& pair : m_baselineData) {
-        pair.second.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_historyMutex);
+        m_shortTerm.reset();
     }
+    m_featureLog->clear();
     
-    m_recentHistory.clear();
-    
-    // Also reset models
-    for (auto& pair : m_timeModels) {
-        pair.second = std::make_unique<GaussianModel>();
+    // The models are the baseline; the stored ones are dropped at the next save
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    for (auto& pair : m_models) {
+        ResidentModel& resident = pair.second;
+        resident.model = createModel();
+        ++resident.version;
+        charge(resident);
     }
+    m_evictedModels.clear();
+    m_snapshot.close();
+    ++m_resetCount;
+    markDirty();
 }
 
 void AnomalyDetector::setThreshold(float threshold) {
-    m_anomalyThreshold = std::max(0.0f, std::min(1.0f, threshold));
-    if (m_config) {
-        m_config->anomalyThreshold = m_anomalyThreshold;
-        GlobalConfig::instance().updateDeviceConfig(m_config);
-    }
+    float clamped = std::max(0.0f, std::min(1.0f, threshold));
+    m_anomalyThreshold = clamped;
+    
+    // Other components pick the new value up when they are next configured
+    std::atomic_store(&m_config, GlobalConfig::instance().modifyDeviceConfig(m_deviceId,
+        [clamped](DeviceConfig& config) { config.anomalyThreshold = clamped; }));
 }
 
 bool AnomalyDetector::saveModel() {
-    bool allSaved = true;
+    std::vector<SnapshotEntry> entries;
+    std::map<int, uint64_t> savedVersions;
+    std::map<int, uint64_t> savedEvictions;
+    uint64_t resetCount = 0;
     
-    for (const auto& pair : m_timeModels) {
-        int hour = pair.first;
-        const auto& model = pair.second;
-        
-        if (model->isTrained()) {
-            std::string filePath = getModelFilePath(hour);
-            if (!model->saveToFile(filePath)) {
-                std::cerr << "Failed to save model for hour " << hour << std::endl;
-                allSaved = false;
+    // Changes made while we export will queue another save
+    m_dirty = false;
+    
+    {
+        // Every hour is written, from memory if it is resident, else as
+        // evicted or as last saved
+        std::lock_guard<std::mutex> lock(m_modelMutex);
+        resetCount = m_resetCount;
+        for (int hour = 0; hour < 24; ++hour) {
+            SnapshotEntry entry;
+            entry.key = hour;
+            
+            auto resident = m_models.find(hour);
+            auto evicted = m_evictedModels.find(hour);
+            bool stored = false;
+            if (resident != m_models.end()) {
+                stored = resident->second.model->exportState(entry);
+                savedVersions[hour] = resident->second.version;
+            } else if (evicted != m_evictedModels.end()) {
+                entry = evicted->second.entry;
+                stored = true;
+                savedEvictions[hour] = evicted->second.generation;
+            } else {
+                stored = readStoredEntry(hour, entry);
+            }
+            
+            if (stored) {
+                entries.push_back(std::move(entry));
             }
         }
     }
     
-    return allSaved;
+    // Samples logged since the last save go out with it, within the storage quota
+    auto& globalConfig = GlobalConfig::instance();
+    if (m_featureLog->pendingCount() > 0 && m_featureLog->flush() && globalConfig.maxStorageSizeMB > 0) {
+        FeatureLog::enforceQuota(globalConfig.dataStoragePath,
+                                 static_cast<uint64_t>(globalConfig.maxStorageSizeMB) * 1024 * 1024);
+    }
+    
+    double decay = std::atomic_load(&m_config)->baselineDecay;
+    if (!SnapshotWriter::write(getSnapshotPath(), m_deviceId, decay, entries)) {
+        std::cerr << "Failed to save model snapshot for " << m_deviceId << std::endl;
+        return false;
+    }
+    
+    // Peer servers get a copy in the background
+    ModelReplicationService::instance().notifySaved(m_deviceId, m_modelDir);
+    
+    // The new file now backs whatever was written and left memory meanwhile,
+    // unless the baseline was reset since; the save that queued replaces it
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    if (resetCount != m_resetCount) {
+        return true;
+    }
+    for (const auto& pair : savedVersions) {
+        auto resident = m_models.find(pair.first);
+        if (resident != m_models.end()) {
+            resident->second.savedVersion = pair.second;
+        }
+    }
+    for (const auto& pair : savedEvictions) {
+        auto evicted = m_evictedModels.find(pair.first);
+        if (evicted != m_evictedModels.end() && evicted->second.generation == pair.second) {
+            m_evictedModels.erase(evicted);
+        }
+    }
+    if (!m_snapshot.open(getSnapshotPath())) {
+        std::cerr << "Failed to reopen model snapshot for " << m_deviceId << std::endl;
+    }
+    
+    return true;
 }
 
 bool AnomalyDetector::loadModel() {
-    bool anyLoaded = false;
+    if (loadSnapshot()) {
+        return true;
+    }
     
-    for (auto& pair : m_timeModels) {
-        int hour = pair.first;
-        auto& model = pair.second;
-        
-        std::string filePath = getModelFilePath(hour);
-        if (std::filesystem::exists(filePath)) {
-            if (model->loadFromFile(filePath)) {
-                anyLoaded = true;
-            } else {
-                std::cerr << "Failed to load model for hour " << hour << std::endl;
+    // First start after an upgrade: pick up the old XML models and
+    // convert them so the next start reads the snapshot. They predate any
+    // snapshot, so they are never newer than an incompatible one; models
+    // of another feature layout are skipped, as loadSnapshot does.
+    if (!std::filesystem::exists(getSnapshotPath()) && importXmlModels()) {
+        saveModel();
+        return true;
+    }
+    
+    // No usable snapshot (lost, or from another model type): the logged
+    // samples rebuild it, and the next save replaces the old one
+    return retrainFromFeatureLog() > 0;
+}
+
+size_t AnomalyDetector::retrainFromFeatureLog() {
+    FeatureLogReader reader(m_featureLog->directory());
+    FeatureVector features;
+    size_t samples = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_modelMutex);
+        while (reader.next(features)) {
+            if (features.featureCount() != FeatureVector::kExtractedFeatureCount) {
+                continue;
             }
+            ResidentModel& resident = modelFor(features);
+            resident.model->update(features);
+            ++resident.version;
+            charge(resident);
+            ++samples;
         }
     }
     
-    return anyLoaded;
+    if (reader.corruptBlocks() > 0) {
+        std::cerr << "Skipped " << reader.corruptBlocks() << " damaged feature log blocks for "
+                  << m_deviceId << std::endl;
+    }
+    if (samples > 0) {
+        std::cout << "[NxAgentAnomaly] Retrained " << m_deviceId << " from " << samples
+                  << " logged baseline samples" << std::endl;
+        markDirty();
+    }
+    return samples;
+}
+
+bool AnomalyDetector::hasTrainedModels() {
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    for (int hour = 0; hour < 24; ++hour) {
+        auto resident = m_models.find(hour);
+        auto evicted = m_evictedModels.find(hour);
+        SnapshotEntry entry;
+        if (resident != m_models.end()) {
+            if (resident->second.model->isTrained()) {
+                return true;
+            }
+        } else if (evicted != m_evictedModels.end()) {
+            if (evicted->second.entry.sampleCount >= kMinTrainedSamples) {
+                return true;
+            }
+        } else if (readStoredEntry(hour, entry) && entry.sampleCount >= kMinTrainedSamples) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t AnomalyDetector::residentModelCount() {
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    return m_models.size();
 }
 
 // Private helper methods
@@ -313,83 +963,311 @@ FeatureVector AnomalyDetector::extractFeatures(const FrameAnalysisResult& result
     FeatureVector features;
     features.timestampUs = result.timestampUs;
     
-    // Convert timestamp to time of day
-    auto timePoint = std::chrono::system_clock::time_point(
-        std::chrono::microseconds(result.timestampUs));
-    std::time_t time = std::chrono::system_clock::to_time_t(timePoint);
-    std::tm* localTime = std::localtime(&time);
+    // The analyzer summarizes each frame once; results built elsewhere
+    // (tests, replays of stored results) are summarized here
+    const FrameSummary summary = result.summary.valid
+        ? result.summary
+        : FrameSummary::fromObjects(result.objects, result.timestampUs);
     
-    features.timeOfDaySeconds = localTime->tm_hour * 3600 + 
-                                localTime->tm_min * 60 + 
-                                localTime->tm_sec;
-    features.dayOfWeek = localTime->tm_wday;
+    features.timeOfDaySeconds = summary.timeOfDaySeconds;
+    features.dayOfWeek = summary.dayOfWeek;
     
     // Basic motion and object features
     features.motionLevel = result.motionInfo.overallMotionLevel;
-    
-    // Count objects by type
-    features.personCount = 0;
-    features.unknownPersonCount = 0;
-    features.vehicleCount = 0;
-    
-    for (const auto& obj : result.objects) {
-        if (obj.typeId == "person") {
-            features.personCount++;
-            
-            // Check if this person is recognized or unknown
-            auto it = obj.attributes.find("recognitionStatus");
-            if (it != obj.attributes.end() && it->second == "unknown") {
-                features.unknownPersonCount++;
-            }
-        } else if (obj.typeId == "vehicle") {
-            features.vehicleCount++;
-        }
-    }
+    features.personCount = summary.personCount;
+    features.unknownPersonCount = summary.unknownPersonCount;
+    features.vehicleCount = summary.vehicleCount;
     
     // Additional features can be added here
     // For example, ratios, motion pattern descriptors, etc.
     features.additionalFeatures.push_back(static_cast<float>(features.unknownPersonCount) / 
                                          std::max(1, features.personCount));
     
+    // Track features: how long objects stay, in the regions and overall, and how fast they move
+    features.additionalFeatures.push_back(summary.maxDwellSecs);
+    features.additionalFeatures.push_back(summary.maxZoneDwellSecs);
+    features.additionalFeatures.push_back(summary.meanSpeed);
+    
     return features;
 }
 
-void AnomalyDetector::trainModels() {
-    std::lock_guard<std::mutex> lock(m_baselineMutex);
+void AnomalyDetector::requestSave() {
+    m_dirty = true;
+    ModelPersistenceService::instance().markDirty(m_persistHandle);
+}
+
+void AnomalyDetector::markDirty() {
+    // Only the first change after a save needs to reach the service
+    if (!m_dirty.exchange(true)) {
+        ModelPersistenceService::instance().markDirty(m_persistHandle);
+    }
+}
+
+std::unique_ptr<AnomalyModel> AnomalyDetector::createModel() const {
+    auto config = std::atomic_load(&m_config);
+    double decay = config->baselineDecay;
+    if (parseAnomalyModelType(config->anomalyModel) == AnomalyModelType::FullCovariance) {
+        return std::make_unique<CovarianceGaussianModel>(decay);
+    }
+    return std::make_unique<OnlineGaussianModel>(decay);
+}
+
+AnomalyDetector::ResidentModel& AnomalyDetector::modelFor(const FeatureVector& features) {
+    int hour = features.timeOfDaySeconds / 3600;
+    
+    // Event time moving on (or jumping back over an hour, as when a replay
+    // starts over) moves the pins; a late frame from the previous hour is
+    // served on demand instead
+    constexpr int64_t kHourUs = 3600LL * 1000000;
+    if (features.timestampUs >= m_latestUs || m_latestUs - features.timestampUs > kHourUs) {
+        m_latestUs = features.timestampUs;
+        if (hour != m_activeHour) {
+            activateHour(hour);
+        }
+    }
     
-    for (const auto& pair : m_baselineData) {
-        int hour = pair.first;
-        const auto& data = pair.second;
+    return acquireModel(hour);
+}
+
+AnomalyDetector::ResidentModel& AnomalyDetector::acquireModel(int hour) {
+    auto it = m_models.find(hour);
+    if (it == m_models.end()) {
+        ResidentModel resident;
+        resident.model = createModel();
         
-        if (!data.empty()) {
-            auto it = m_timeModels.find(hour);
-            if (it != m_timeModels.end()) {
-                it->second->train(data);
+        SnapshotEntry entry;
+        auto evicted = m_evictedModels.find(hour);
+        if (evicted != m_evictedModels.end()) {
+            // Still not saved, so it comes back changed
+            resident.model->importState(evicted->second.entry);
+            resident.version = 1;
+            m_evictedModels.erase(evicted);
+        } else if (readStoredEntry(hour, entry) && !resident.model->importState(entry)) {
+            std::cerr << "Failed to load model for hour " << hour << std::endl;
+        }
+        
+        it = m_models.emplace(hour, std::move(resident)).first;
+        it->second.lastUse = ++m_useClock;
+        charge(it->second);
+        enforceBudget(hour);
+    }
+    
+    it->second.lastUse = ++m_useClock;
+    return it->second;
+}
+
+void AnomalyDetector::activateHour(int hour) {
+    m_activeHour = hour;
+    
+    std::vector<int> unpinned;
+    for (const auto& pair : m_models) {
+        if (!isPinned(pair.first)) {
+            unpinned.push_back(pair.first);
+        }
+    }
+    for (int other : unpinned) {
+        evictModel(other);
+    }
+    
+    // Prefetch the next hour so the frames crossing into it find it resident
+    acquireModel((hour + 1) % 24);
+}
+
+void AnomalyDetector::evictModel(int hour) {
+    auto it = m_models.find(hour);
+    if (it == m_models.end()) {
+        return;
+    }
+    
+    // Unsaved changes wait in exported form; the change already queued a save
+    ResidentModel& resident = it->second;
+    EvictedModel evicted;
+    if (resident.version != resident.savedVersion && resident.model->exportState(evicted.entry)) {
+        evicted.entry.key = hour;
+        evicted.generation = ++m_evictionGeneration;
+        m_evictedModels[hour] = std::move(evicted);
+    }
+    
+    s_residentBytes -= static_cast<int64_t>(resident.chargedBytes);
+    m_residentBytesGauge->add(-static_cast<int64_t>(resident.chargedBytes));
+    m_models.erase(it);
+}
+
+void AnomalyDetector::enforceBudget(int keepHour) {
+    int64_t budget = static_cast<int64_t>(GlobalConfig::instance().modelCacheBudgetKB) * 1024;
+    if (budget <= 0) {
+        return;
+    }
+    
+    // Each detector sheds its own models: with only pinned ones left the
+    // total stays over budget until other detectors page in and shed theirs
+    while (s_residentBytes.load() > budget) {
+        auto victim = m_models.end();
+        for (auto it = m_models.begin(); it != m_models.end(); ++it) {
+            if (it->first != keepHour && !isPinned(it->first) &&
+                (victim == m_models.end() || it->second.lastUse < victim->second.lastUse)) {
+                victim = it;
             }
         }
+        if (victim == m_models.end()) {
+            break;
+        }
+        evictModel(victim->first);
+    }
+}
+
+void AnomalyDetector::charge(ResidentModel& resident) {
+    size_t bytes = resident.model->memoryBytes();
+    int64_t delta = static_cast<int64_t>(bytes) - static_cast<int64_t>(resident.chargedBytes);
+    if (delta != 0) {
+        s_residentBytes += delta;
+        m_residentBytesGauge->add(delta);
+        resident.chargedBytes = bytes;
+    }
+}
+
+bool AnomalyDetector::isPinned(int hour) const {
+    return m_activeHour >= 0 && (hour == m_activeHour || hour == (m_activeHour + 1) % 24);
+}
+
+bool AnomalyDetector::readStoredEntry(int hour, SnapshotEntry& entry) const {
+    for (uint32_t i = 0; i < m_snapshot.recordCount(); ++i) {
+        const SnapshotRecord& record = m_snapshot.record(i);
+        if (record.key != hour) {
+            continue;
+        }
+        
+        uint32_t featureCount = m_snapshot.header().featureCount;
+        entry.key = record.key;
+        entry.sampleCount = record.sampleCount;
+        entry.weight = record.weight;
+        entry.mean.assign(m_snapshot.mean(i), m_snapshot.mean(i) + featureCount);
+        entry.m2.assign(m_snapshot.m2(i), m_snapshot.m2(i) + featureCount);
+        if (m_snapshot.hasCovariance()) {
+            const double* coMoment = m_snapshot.coMoment(i);
+            entry.coMoment.assign(coMoment, coMoment + MappedSnapshot::coMomentCount(featureCount));
+        }
+        return true;
+    }
+    return false;
+}
+
+bool AnomalyDetector::loadSnapshot() {
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    if (!m_snapshot.open(getSnapshotPath())) {
+        return false;
+    }
+    
+    uint32_t featureCount = m_snapshot.header().featureCount;
+    if (featureCount != static_cast<uint32_t>(FeatureVector::kExtractedFeatureCount)) {
+        std::cerr << "Stored models for " << m_deviceId << " use " << featureCount
+                  << " features instead of " << FeatureVector::kExtractedFeatureCount
+                  << "; learning again" << std::endl;
+        m_snapshot.close();
+        return false;
     }
     
-    // Save models after training
-    saveModel();
+    // The mapping stays open; each hour is imported when its frames arrive
+    return m_snapshot.recordCount() > 0;
 }
 
-std::string AnomalyDetector::getModelFilePath(int hourOfDay) const {
-    std::string dataPath = GlobalConfig::instance().dataStoragePath;
+bool AnomalyDetector::importXmlModels() {
+    bool anyLoaded = false;
+    
+    // Converted models wait with the evicted ones for the save that follows
+    std::lock_guard<std::mutex> lock(m_modelMutex);
+    for (int hour = 0; hour < 24; ++hour) {
+        std::string filePath = getModelFilePath(hour);
+        if (!std::filesystem::exists(filePath)) {
+            continue;
+        }
+        
+        std::unique_ptr<AnomalyModel> model = createModel();
+        EvictedModel imported;
+        if (!model->loadFromFile(filePath) || !model->exportState(imported.entry)) {
+            std::cerr << "Failed to load model for hour " << hour << std::endl;
+        } else if (imported.entry.mean.size() != static_cast<size_t>(FeatureVector::kExtractedFeatureCount)) {
+            std::cerr << "Legacy model for hour " << hour << " of " << m_deviceId << " uses "
+                      << imported.entry.mean.size() << " features instead of "
+                      << FeatureVector::kExtractedFeatureCount << "; learning again" << std::endl;
+        } else {
+            imported.entry.key = hour;
+            imported.generation = ++m_evictionGeneration;
+            m_evictedModels[hour] = std::move(imported);
+            anyLoaded = true;
+        }
+    }
     
-    // Create device-specific directory
-    std::string deviceDir = dataPath + "/" + m_deviceId;
-    std::filesystem::create_directories(deviceDir);
+    if (anyLoaded) {
+        std::cout << "[NxAgentAnomaly] Imported legacy XML models for " << m_deviceId << std::endl;
+    }
     
-    return deviceDir + "/model_hour_" + std::to_string(hourOfDay) + ".xml";
+    return anyLoaded;
+}
+
+std::string AnomalyDetector::getSnapshotPath() const {
+    return m_modelDir + "/models.nxsnap";
 }
 
-int AnomalyDetector::getHourOfDay(int64_t timestampUs) const {
-    auto timePoint = std::chrono::system_clock::time_point(
-        std::chrono::microseconds(timestampUs));
-    std::time_t time = std::chrono::system_clock::to_time_t(timePoint);
-    std::tm* localTime = std::localtime(&time);
+std::string AnomalyDetector::getModelFilePath(int hourOfDay) const {
+    return m_modelDir + "/model_hour_" + std::to_string(hourOfDay) + ".xml";
+}
+
+// BaselineLearner implementation
+BaselineStep BaselineLearner::process(AnomalyDetector& detector, FrameAnalysisResult& result,
+                                      int64_t timestampUs, const DeviceConfig& config) {
+    BaselineStep step;
+    
+    // Baseline samples are spaced in time rather than counted in frames, so
+    // the statistics do not depend on how many frames the scheduler lets through
+    int sampleIntervalSecs = m_learning ? config.learningSampleIntervalSecs
+                                        : config.continuousLearningIntervalSecs;
+    int64_t sinceLastSample = timestampUs - m_lastSampleUs;
+    bool sampleDue = m_lastSampleUs == 0 || sinceLastSample < 0 ||
+                     sinceLastSample >= static_cast<int64_t>(sampleIntervalSecs) * 1000000;
+    
+    // In learning mode, collect baseline data
+    if (m_learning && config.enableLearning) {
+        // Sample at a fixed period to avoid too much correlation
+        if (!sampleDue) {
+            return step;
+        }
+        
+        detector.addToBaseline(result);
+        m_lastSampleUs = timestampUs;
+        step.sampled = true;
+        
+        // After collecting enough samples, switch to detection mode
+        if (++m_sampleCount >= kLearningSamples) {
+            m_learning = false;
+            step.learningComplete = true;
+        }
+        return step;
+    }
+    
+    step.scored = true;
+    step.anomaly = detector.detectAnomaly(result);
+    
+    // Still collect data for continuous learning if enabled
+    if (config.enableLearning && sampleDue) {
+        // Only add frames that are not anomalous to the baseline
+        if (!result.isAnomaly) {
+            detector.addToBaseline(result);
+            m_sampleCount++;
+            step.sampled = true;
+        }
+        m_lastSampleUs = timestampUs;
+    }
     
-    return localTime->tm_hour;
+    return step;
+}
+
+bool BaselineLearner::finishLearning() {
+    if (!m_learning || m_sampleCount <= kMinFinishSamples) {
+        return false;
+    }
+    m_learning = false;
+    return true;
 }
 
 } // namespace nx_agent
@@ -0,0 +1,286 @@
+// nx_agent_attributes.cpp
+#include "nx_agent_attributes.h"
+
+#include <deque>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+
+namespace nx_agent {
+
+ObjectClass classifyObjectType(const std::string& typeId) {
+    if (typeId == "person") {
+        return ObjectClass::Person;
+    }
+    if (typeId == "vehicle") {
+        return ObjectClass::Vehicle;
+    }
+    return ObjectClass::Other;
+}
+
+// Intern table. Names live in a deque so references stay valid as it
+// grows, and each is published to a fixed array once it is complete, so
+// name() never locks.
+namespace {
+
+struct InternTable {
+    std::shared_mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string, AttributeKey> ids;
+    std::array<std::atomic<const std::string*>, AttributeKeys::kCapacity> published{};
+    bool fullReported = false;
+
+    InternTable() {
+        // Must match the constants in AttributeKeys
+        add("recognitionStatus");
+        add("vehicleType");
+        add("durationSecs");
+    }
+
+    // Caller holds the mutex exclusively
+    AttributeKey add(const std::string& name) {
+        if (names.size() >= AttributeKeys::kCapacity) {
+            if (!fullReported) {
+                fullReported = true;
+                std::cerr << "Attribute name table full (" << AttributeKeys::kCapacity
+                          << " names); new names are no longer interned" << std::endl;
+            }
+            return AttributeKeys::Uninterned;
+        }
+        AttributeKey key = static_cast<AttributeKey>(names.size());
+        names.push_back(name);
+        ids.emplace(name, key);
+        published[key].store(&names.back(), std::memory_order_release);
+        return key;
+    }
+};
+
+InternTable& internTable() {
+    static InternTable table;
+    return table;
+}
+
+} // namespace
+
+AttributeKey AttributeKeys::intern(const std::string& name) {
+    InternTable& table = internTable();
+    {
+        std::shared_lock<std::shared_mutex> lock(table.mutex);
+        auto it = table.ids.find(name);
+        if (it != table.ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(table.mutex);
+    auto it = table.ids.find(name);
+    if (it != table.ids.end()) {
+        return it->second;
+    }
+    return table.add(name);
+}
+
+const std::string& AttributeKeys::name(AttributeKey key) {
+    static const std::string unknown;
+    if (key >= kCapacity) {
+        return unknown;
+    }
+    const std::string* name = internTable().published[key].load(std::memory_order_acquire);
+    return name ? *name : unknown;
+}
+
+// AttributeSet implementation
+const std::string* AttributeSet::find(AttributeKey key) const {
+    for (size_t i = 0; i < m_size; ++i) {
+        const Entry& entry = at(i);
+        if (entry.key == key) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+const std::string* AttributeSet::find(AttributeKey key, const std::string& name) const {
+    if (key != AttributeKeys::Uninterned) {
+        return find(key);
+    }
+    for (size_t i = 0; i < m_size; ++i) {
+        const Entry& entry = at(i);
+        if (entry.key == key && entry.uninternedName == name) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+void AttributeSet::set(AttributeKey key, std::string value) {
+    (*this)[key] = std::move(value);
+}
+
+std::string& AttributeSet::operator[](AttributeKey key) {
+    if (Entry* entry = findEntry(key, nullptr)) {
+        return entry->value;
+    }
+    return append(key).value;
+}
+
+std::string& AttributeSet::slot(AttributeKey key, const std::string& name) {
+    bool uninterned = key == AttributeKeys::Uninterned;
+    if (Entry* entry = findEntry(key, uninterned ? &name : nullptr)) {
+        return entry->value;
+    }
+    Entry& entry = append(key);
+    if (uninterned) {
+        entry.uninternedName = name;
+    }
+    return entry.value;
+}
+
+void AttributeSet::clear() {
+    for (size_t i = 0; i < m_size && i < kInlineCapacity; ++i) {
+        m_inline[i].value.clear();
+    }
+    m_overflow.clear();
+    m_size = 0;
+}
+
+std::map<std::string, std::string> AttributeSet::toMap() const {
+    std::map<std::string, std::string> result;
+    for (size_t i = 0; i < m_size; ++i) {
+        result[at(i).name()] = at(i).value;
+    }
+    return result;
+}
+
+// Private methods
+AttributeSet::Entry* AttributeSet::findEntry(AttributeKey key, const std::string* name) {
+    for (size_t i = 0; i < m_size; ++i) {
+        Entry& entry = i < kInlineCapacity ? m_inline[i] : m_overflow[i - kInlineCapacity];
+        if (entry.key == key && (!name || entry.uninternedName == *name)) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+AttributeSet::Entry& AttributeSet::append(AttributeKey key) {
+    Entry* entry = nullptr;
+    if (m_size < kInlineCapacity) {
+        entry = &m_inline[m_size];
+    } else {
+        m_overflow.emplace_back();
+        entry = &m_overflow.back();
+    }
+    entry->key = key;
+    entry->value.clear();
+    entry->uninternedName.clear();
+    m_size++;
+    return *entry;
+}
+
+// Attribute types
+AttributeType parseAttributeType(const std::string& name) {
+    if (name == "float" || name == "number") {
+        return AttributeType::Float;
+    }
+    if (name == "int" || name == "integer") {
+        return AttributeType::Int;
+    }
+    if (name == "string") {
+        return AttributeType::String;
+    }
+    if (name == "boolean") {
+        return AttributeType::Boolean;
+    }
+    return AttributeType::Unknown;
+}
+
+bool parseAttributeNumber(const std::string& value, float& result) {
+    if (value.empty()) {
+        return false;
+    }
+    const char* begin = value.c_str();
+    char* end = nullptr;
+    float parsed = std::strtof(begin, &end);
+    if (end != begin + value.size() || !std::isfinite(parsed)) {
+        return false;
+    }
+    result = parsed;
+    return true;
+}
+
+void formatAttributeNumber(float number, AttributeType type, std::string& value) {
+    char buffer[32];
+    int length = type == AttributeType::Int
+        ? std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(std::llround(number)))
+        : std::snprintf(buffer, sizeof(buffer), "%g", number);
+    value.assign(buffer, length > 0 ? static_cast<size_t>(length) : 0);
+}
+
+// AttributeSchema implementation
+AttributeSchema AttributeSchema::fromManifest(const std::string& manifestJson) {
+    using json = nlohmann::json;
+    AttributeSchema schema;
+
+    // Parsed without exceptions; a bad manifest only loses the typing
+    json manifest = json::parse(manifestJson, nullptr, false);
+    if (manifest.is_discarded() || !manifest.is_object()) {
+        return schema;
+    }
+
+    auto metadataTypes = manifest.find("supportedMetadataTypes");
+    if (metadataTypes == manifest.end() || !metadataTypes->is_array()) {
+        return schema;
+    }
+    for (const auto& metadataType : *metadataTypes) {
+        auto objectTypes = metadataType.find("objectTypes");
+        if (objectTypes == metadataType.end() || !objectTypes->is_array()) {
+            continue;
+        }
+        for (const auto& objectType : *objectTypes) {
+            auto attributes = objectType.find("attributes");
+            if (!objectType.contains("id") || !objectType["id"].is_string() ||
+                attributes == objectType.end() || !attributes->is_array()) {
+                continue;
+            }
+            std::string typeId = objectType["id"].get<std::string>();
+            for (const auto& attribute : *attributes) {
+                if (attribute.contains("id") && attribute["id"].is_string() &&
+                    attribute.contains("type") && attribute["type"].is_string()) {
+                    schema.declare(typeId, AttributeKeys::intern(attribute["id"].get<std::string>()),
+                                   parseAttributeType(attribute["type"].get<std::string>()));
+                }
+            }
+        }
+    }
+
+    return schema;
+}
+
+void AttributeSchema::declare(const std::string& objectTypeId, AttributeKey key, AttributeType type) {
+    if (key == AttributeKeys::Uninterned) {
+        return;
+    }
+    std::vector<AttributeType>& types = m_types[objectTypeId];
+    if (types.size() <= key) {
+        types.resize(static_cast<size_t>(key) + 1, AttributeType::Unknown);
+    }
+    types[key] = type;
+}
+
+AttributeType AttributeSchema::type(const std::string& objectTypeId, AttributeKey key) const {
+    auto it = m_types.find(objectTypeId);
+    if (it == m_types.end() || key >= it->second.size()) {
+        return AttributeType::Unknown;
+    }
+    return it->second[key];
+}
+
+} // namespace nx_agent
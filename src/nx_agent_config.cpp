@@ -1,5 +1,6 @@
 // nx_agent_config.cpp
 #include "nx_agent_config.h"
+#include "nx_agent_regions.h"
 
 #include <fstream>
 #include <iostream>
@@ -20,6 +21,7 @@ bool DeviceConfig::loadFromJson(const std::string& jsonStr) {
         
         // Parse basic settings
         deviceName = j.value("deviceName", deviceName);
+        siteId = j.value("siteId", siteId);
         minPersonConfidence = j.value("minPersonConfidence", minPersonConfidence);
         minVehicleConfidence = j.value("minVehicleConfidence", minVehicleConfidence);
         
@@ -33,6 +35,30 @@ bool DeviceConfig::loadFromJson(const std::string& jsonStr) {
         enableLearning = j.value("enableLearning", enableLearning);
         baselineDurationDays = j.value("baselineDurationDays", baselineDurationDays);
         
+        // Parse pipeline settings
+        enableAsyncPipeline = j.value("enableAsyncPipeline", enableAsyncPipeline);
+        pipelineQueueCapacity = j.value("pipelineQueueCapacity", pipelineQueueCapacity);
+        motionAnalysisWidth = j.value("motionAnalysisWidth", motionAnalysisWidth);
+        trackIouThreshold = j.value("trackIouThreshold", trackIouThreshold);
+        trackMaxDistance = j.value("trackMaxDistance", trackMaxDistance);
+        trackMaxAgeMs = j.value("trackMaxAgeMs", trackMaxAgeMs);
+        cropMotionToRegions = j.value("cropMotionToRegions", cropMotionToRegions);
+        motionEngine = j.value("motionEngine", motionEngine);
+        fastMotionThreshold = j.value("fastMotionThreshold", fastMotionThreshold);
+        fastMotionAdaptShift = j.value("fastMotionAdaptShift", fastMotionAdaptShift);
+        analysisMode = j.value("analysisMode", analysisMode);
+        compressedMotionScale = j.value("compressedMotionScale", compressedMotionScale);
+        enableAdaptiveFrameRate = j.value("enableAdaptiveFrameRate", enableAdaptiveFrameRate);
+        idleFrameRate = j.value("idleFrameRate", idleFrameRate);
+        activityHoldSecs = j.value("activityHoldSecs", activityHoldSecs);
+        learningSampleIntervalSecs = j.value("learningSampleIntervalSecs", learningSampleIntervalSecs);
+        continuousLearningIntervalSecs = j.value("continuousLearningIntervalSecs", continuousLearningIntervalSecs);
+        frameDropPolicy = j.value("frameDropPolicy", frameDropPolicy);
+        sendAttributeChangesOnly = j.value("sendAttributeChangesOnly", sendAttributeChangesOnly);
+        baselineDecay = j.value("baselineDecay", baselineDecay);
+        anomalyModel = j.value("anomalyModel", anomalyModel);
+        enableShortTermDetection = j.value("enableShortTermDetection", enableShortTermDetection);
+        
         // Parse business hours
         businessHours.clear();
         if (j.contains("businessHours") && j["businessHours"].is_array()) {
@@ -83,6 +109,7 @@ std::string DeviceConfig::toJson() const {
     // Basic settings
     j["deviceId"] = deviceId;
     j["deviceName"] = deviceName;
+    j["siteId"] = siteId;
     j["minPersonConfidence"] = minPersonConfidence;
     j["minVehicleConfidence"] = minVehicleConfidence;
     
@@ -96,6 +123,30 @@ std::string DeviceConfig::toJson() const {
     j["enableLearning"] = enableLearning;
     j["baselineDurationDays"] = baselineDurationDays;
     
+    // Pipeline settings
+    j["enableAsyncPipeline"] = enableAsyncPipeline;
+    j["pipelineQueueCapacity"] = pipelineQueueCapacity;
+    j["motionAnalysisWidth"] = motionAnalysisWidth;
+    j["trackIouThreshold"] = trackIouThreshold;
+    j["trackMaxDistance"] = trackMaxDistance;
+    j["trackMaxAgeMs"] = trackMaxAgeMs;
+    j["cropMotionToRegions"] = cropMotionToRegions;
+    j["motionEngine"] = motionEngine;
+    j["fastMotionThreshold"] = fastMotionThreshold;
+    j["fastMotionAdaptShift"] = fastMotionAdaptShift;
+    j["analysisMode"] = analysisMode;
+    j["compressedMotionScale"] = compressedMotionScale;
+    j["enableAdaptiveFrameRate"] = enableAdaptiveFrameRate;
+    j["idleFrameRate"] = idleFrameRate;
+    j["activityHoldSecs"] = activityHoldSecs;
+    j["learningSampleIntervalSecs"] = learningSampleIntervalSecs;
+    j["continuousLearningIntervalSecs"] = continuousLearningIntervalSecs;
+    j["frameDropPolicy"] = frameDropPolicy;
+    j["sendAttributeChangesOnly"] = sendAttributeChangesOnly;
+    j["baselineDecay"] = baselineDecay;
+    j["anomalyModel"] = anomalyModel;
+    j["enableShortTermDetection"] = enableShortTermDetection;
+    
     // Business hours
     json hoursArray = json::array();
     for (const auto& range : businessHours) {
@@ -129,8 +180,14 @@ std::string DeviceConfig::toJson() const {
     return j.dump(4); // Pretty print with 4-space indent
 }
 
+std::shared_ptr<const DeviceConfig> DeviceConfig::freeze(DeviceConfig config) {
+    // Compiled here, once per change, instead of by every reader
+    config.regionIndex = std::make_shared<const RegionIndex>(config.detectionRegions);
+    return std::make_shared<const DeviceConfig>(std::move(config));
+}
+
 // GlobalConfig implementation
-GlobalConfig::GlobalConfig() {
+GlobalConfig::GlobalConfig() : m_deviceConfigs(std::make_shared<const DeviceConfigMap>()) {
     // Create default storage path if needed
     if (dataStoragePath.empty()) {
         // Use platform-specific paths
@@ -174,6 +231,41 @@ bool GlobalConfig::loadFromJson(const std::string& jsonStr) {
         maxStorageSizeMB = j.value("maxStorageSizeMB", maxStorageSizeMB);
         enableDiagnostics = j.value("enableDiagnostics", enableDiagnostics);
         diagnosticLogLevel = j.value("diagnosticLogLevel", diagnosticLogLevel);
+        modelPersistIntervalSecs = j.value("modelPersistIntervalSecs", modelPersistIntervalSecs);
+        modelCacheBudgetKB = j.value("modelCacheBudgetKB", modelCacheBudgetKB);
+        
+        // Parse detector settings
+        detectorBackend = j.value("detectorBackend", detectorBackend);
+        detectorModelPath = j.value("detectorModelPath", detectorModelPath);
+        detectorConfigPath = j.value("detectorConfigPath", detectorConfigPath);
+        detectorInputSize = j.value("detectorInputSize", detectorInputSize);
+        detectorMinConfidence = j.value("detectorMinConfidence", detectorMinConfidence);
+        detectorMaxBatchSize = j.value("detectorMaxBatchSize", detectorMaxBatchSize);
+        detectorMaxLatencyMs = j.value("detectorMaxLatencyMs", detectorMaxLatencyMs);
+        detectorUseCuda = j.value("detectorUseCuda", detectorUseCuda);
+        
+        // Parse HTTP settings
+        httpMaxInFlight = j.value("httpMaxInFlight", httpMaxInFlight);
+        httpMaxRetries = j.value("httpMaxRetries", httpMaxRetries);
+        httpRetryBackoffMs = j.value("httpRetryBackoffMs", httpRetryBackoffMs);
+        httpBatchWindowMs = j.value("httpBatchWindowMs", httpBatchWindowMs);
+        httpTimeoutMs = j.value("httpTimeoutMs", httpTimeoutMs);
+        
+        // Parse incident settings
+        incidentWindowSecs = j.value("incidentWindowSecs", incidentWindowSecs);
+        incidentMaxDurationSecs = j.value("incidentMaxDurationSecs", incidentMaxDurationSecs);
+        incidentMaxOpen = j.value("incidentMaxOpen", incidentMaxOpen);
+        incidentHoldMs = j.value("incidentHoldMs", incidentHoldMs);
+        
+        // Parse metrics settings
+        metricsIntervalSecs = j.value("metricsIntervalSecs", metricsIntervalSecs);
+        metricsFilePath = j.value("metricsFilePath", metricsFilePath);
+        
+        // Parse replication settings
+        replicationTarget = j.value("replicationTarget", replicationTarget);
+        replicationIntervalSecs = j.value("replicationIntervalSecs", replicationIntervalSecs);
+        replicationMaxKBps = j.value("replicationMaxKBps", replicationMaxKBps);
+        replicationRestoreTimeoutMs = j.value("replicationRestoreTimeoutMs", replicationRestoreTimeoutMs);
         
         // Parse SIP settings
         enableSipIntegration = j.value("enableSipIntegration", enableSipIntegration);
@@ -187,10 +279,9 @@ bool GlobalConfig::loadFromJson(const std::string& jsonStr) {
             std::lock_guard<std::mutex> lock(m_configMutex);
             for (const auto& deviceJson : j["devices"]) {
                 if (deviceJson.contains("deviceId")) {
-                    std::string deviceId = deviceJson["deviceId"];
-                    auto config = std::make_shared<DeviceConfig>(deviceId);
-                    config->loadFromJson(deviceJson.dump());
-                    m_deviceConfigs[deviceId] = config;
+                    DeviceConfig config(deviceJson["deviceId"].get<std::string>());
+                    config.loadFromJson(deviceJson.dump());
+                    publish(DeviceConfig::freeze(std::move(config)));
                 }
             }
         }
@@ -202,23 +293,52 @@ bool GlobalConfig::loadFromJson(const std::string& jsonStr) {
     }
 }
 
-std::shared_ptr<DeviceConfig> GlobalConfig::getDeviceConfig(const std::string& deviceId) {
-    std::lock_guard<std::mutex> lock(m_configMutex);
+std::shared_ptr<const DeviceConfig> GlobalConfig::getDeviceConfig(const std::string& deviceId) {
+    {
+        auto configs = std::atomic_load(&m_deviceConfigs);
+        auto it = configs->find(deviceId);
+        if (it != configs->end()) {
+            return it->second;
+        }
+    }
     
-    auto it = m_deviceConfigs.find(deviceId);
-    if (it != m_deviceConfigs.end()) {
+    // Create new config if it doesn't exist (unless another thread just did)
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    auto it = m_deviceConfigs->find(deviceId);
+    if (it != m_deviceConfigs->end()) {
         return it->second;
     }
-    
-    // Create new config if it doesn't exist
-    auto config = std::make_shared<DeviceConfig>(deviceId);
-    m_deviceConfigs[deviceId] = config;
+    auto config = DeviceConfig::freeze(DeviceConfig(deviceId));
+    publish(config);
     return config;
 }
 
-void GlobalConfig::updateDeviceConfig(const std::shared_ptr<DeviceConfig>& config) {
+std::shared_ptr<const DeviceConfig> GlobalConfig::updateDeviceConfig(DeviceConfig config) {
+    auto snapshot = DeviceConfig::freeze(std::move(config));
     std::lock_guard<std::mutex> lock(m_configMutex);
-    m_deviceConfigs[config->deviceId] = config;
+    publish(snapshot);
+    return snapshot;
+}
+
+std::shared_ptr<const DeviceConfig> GlobalConfig::modifyDeviceConfig(
+    const std::string& deviceId, const std::function<void(DeviceConfig&)>& edit)
+{
+    std::lock_guard<std::mutex> lock(m_configMutex);
+    auto it = m_deviceConfigs->find(deviceId);
+    DeviceConfig config = it != m_deviceConfigs->end() ? *it->second : DeviceConfig(deviceId);
+    edit(config);
+    config.deviceId = deviceId;
+    
+    auto snapshot = DeviceConfig::freeze(std::move(config));
+    publish(snapshot);
+    return snapshot;
+}
+
+void GlobalConfig::publish(std::shared_ptr<const DeviceConfig> config) {
+    // Copy on write: readers holding the old map keep a consistent view
+    auto configs = std::make_shared<DeviceConfigMap>(*m_deviceConfigs);
+    (*configs)[config->deviceId] = std::move(config);
+    std::atomic_store(&m_deviceConfigs, std::shared_ptr<const DeviceConfigMap>(std::move(configs)));
 }
 
 bool GlobalConfig::saveConfig() {
@@ -235,6 +355,39 @@ bool GlobalConfig::saveConfig() {
         j["maxStorageSizeMB"] = maxStorageSizeMB;
         j["enableDiagnostics"] = enableDiagnostics;
         j["diagnosticLogLevel"] = diagnosticLogLevel;
+        j["modelPersistIntervalSecs"] = modelPersistIntervalSecs;
+        j["modelCacheBudgetKB"] = modelCacheBudgetKB;
+        
+        // Detector settings
+        j["detectorBackend"] = detectorBackend;
+        j["detectorModelPath"] = detectorModelPath;
+        j["detectorConfigPath"] = detectorConfigPath;
+        j["detectorInputSize"] = detectorInputSize;
+        j["detectorMinConfidence"] = detectorMinConfidence;
+        j["detectorMaxBatchSize"] = detectorMaxBatchSize;
+        j["detectorMaxLatencyMs"] = detectorMaxLatencyMs;
+        j["detectorUseCuda"] = detectorUseCuda;
+        
+        // HTTP settings
+        j["httpMaxInFlight"] = httpMaxInFlight;
+        j["httpMaxRetries"] = httpMaxRetries;
+        j["httpRetryBackoffMs"] = httpRetryBackoffMs;
+        j["httpBatchWindowMs"] = httpBatchWindowMs;
+        j["httpTimeoutMs"] = httpTimeoutMs;
+        
+        // Incident settings
+        j["incidentWindowSecs"] = incidentWindowSecs;
+        j["incidentMaxDurationSecs"] = incidentMaxDurationSecs;
+        j["incidentMaxOpen"] = incidentMaxOpen;
+        j["incidentHoldMs"] = incidentHoldMs;
+        
+        // Metrics settings
+        j["metricsIntervalSecs"] = metricsIntervalSecs;
+        j["metricsFilePath"] = metricsFilePath;
+        j["replicationTarget"] = replicationTarget;
+        j["replicationIntervalSecs"] = replicationIntervalSecs;
+        j["replicationMaxKBps"] = replicationMaxKBps;
+        j["replicationRestoreTimeoutMs"] = replicationRestoreTimeoutMs;
         
         // SIP settings
         j["enableSipIntegration"] = enableSipIntegration;
@@ -245,12 +398,9 @@ bool GlobalConfig::saveConfig() {
         
         // Device configurations
         json devicesArray = json::array();
-        {
-            std::lock_guard<std::mutex> lock(m_configMutex);
-            for (const auto& pair : m_deviceConfigs) {
-                json deviceJson = json::parse(pair.second->toJson());
-                devicesArray.push_back(deviceJson);
-            }
+        for (const auto& pair : *std::atomic_load(&m_deviceConfigs)) {
+            json deviceJson = json::parse(pair.second->toJson());
+            devicesArray.push_back(deviceJson);
         }
         j["devices"] = devicesArray;
         
@@ -271,28 +421,27 @@ bool GlobalConfig::saveConfig() {
 }
 
 // Helper function to parse settings from Nx Meta
-void parseSettings(const nx::sdk::ISettingsResponse* settings, std::shared_ptr<DeviceConfig> config) {
-    if (!settings || !config)
+void parseSettings(const nx::sdk::ISettingsResponse* settings, DeviceConfig& config) {
+    if (!settings)
         return;
     
     // Parse detection settings
-    float minConfidence = settings->getFloat("minPersonConfidence", config->minPersonConfidence);
-    config->minPersonConfidence = minConfidence;
+    config.minPersonConfidence = settings->getFloat("minPersonConfidence", config.minPersonConfidence);
     
     // Parse anomaly threshold
-    float threshold = settings->getFloat("anomalyThreshold", config->anomalyThreshold);
-    config->anomalyThreshold = threshold;
+    config.anomalyThreshold = settings->getFloat("anomalyThreshold", config.anomalyThreshold);
     
     // Parse learning settings
-    bool learning = settings->getBool("enableLearning", config->enableLearning);
-    config->enableLearning = learning;
+    config.enableLearning = settings->getBool("enableLearning", config.enableLearning);
+    
+    // Parse the analysis mode; applied when the server next asks which frames to deliver
+    config.analysisMode = settings->getString("analysisMode", config.analysisMode);
     
     // Parse regions of interest (this is more complex and would need custom parsing)
     // This would typically involve parsing a JSON string from settings
     // For now, we'll leave it as a placeholder
     
-    // Update the config in global settings
-    GlobalConfig::instance().updateDeviceConfig(config);
+    // The caller publishes the edited copy (GlobalConfig::modifyDeviceConfig)
 }
 
 } // namespace nx_agent
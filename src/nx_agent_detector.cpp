@@ -0,0 +1,346 @@
+// nx_agent_detector.cpp
+#include "nx_agent_detector.h"
+#include "nx_agent_config.h"
+
+#include <algorithm>
+#include <random>
+
+namespace nx_agent {
+
+static int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Seed for one frame's simulated detections: a hash of a sparse grid of
+// luma samples, so a frame gets the same objects however calls are ordered
+static uint32_t frameSeed(const ImageUtils::FrameView& frame) {
+    uint32_t hash = 2166136261u;    // FNV-1a
+    auto mix = [&hash](uint32_t value) { hash = (hash ^ value) * 16777619u; };
+    mix(static_cast<uint32_t>(frame.width()));
+    mix(static_cast<uint32_t>(frame.height()));
+
+    const cv::Mat& luma = frame.luma();
+    int rowStep = std::max(1, luma.rows / 16);
+    int colStep = std::max(1, luma.cols / 16);
+    for (int y = 0; y < luma.rows; y += rowStep) {
+        const uint8_t* row = luma.ptr<uint8_t>(y);
+        for (int x = 0; x < luma.cols; x += colStep) {
+            mix(row[x]);
+        }
+    }
+    return hash;
+}
+
+// SimulatedDetectorBackend implementation
+std::vector<std::vector<DetectedObject>> SimulatedDetectorBackend::detect(
+    const std::vector<const ImageUtils::FrameView*>& frames)
+{
+    std::vector<std::vector<DetectedObject>> results(frames.size());
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        const ImageUtils::FrameView& frame = *frames[i];
+        std::minstd_rand random(frameSeed(frame));
+        auto roll = [&random](int range) {
+            return range > 0 ? static_cast<int>(random() % static_cast<uint32_t>(range)) : 0;
+        };
+
+        // 30% chance to detect an object
+        if (roll(10) >= 3) {
+            continue;
+        }
+
+        DetectedObject obj;
+
+        // 70% chance for person, 30% for vehicle
+        if (roll(10) < 7) {
+            obj.typeId = "person";
+            obj.confidence = 0.7f + roll(300) / 1000.0f; // 0.7 - 0.99
+
+            // Create a person-sized box in a random location
+            int personWidth = frame.width() / 10;
+            int personHeight = frame.height() / 4;
+            int x = roll(frame.width() - personWidth);
+            int y = roll(frame.height() - personHeight);
+
+            obj.boundingBox = cv::Rect(x, y, personWidth, personHeight);
+            obj.attributes[AttributeKeys::RecognitionStatus] = (roll(10) < 3) ? "known" : "unknown";
+            obj.trackId = "person_" + std::to_string(roll(10));
+        } else {
+            obj.typeId = "vehicle";
+            obj.confidence = 0.75f + roll(250) / 1000.0f; // 0.75 - 0.99
+
+            // Create a vehicle-sized box
+            int vehicleWidth = frame.width() / 5;
+            int vehicleHeight = frame.height() / 6;
+            int x = roll(frame.width() - vehicleWidth);
+            int y = roll(frame.height() - vehicleHeight);
+
+            obj.boundingBox = cv::Rect(x, y, vehicleWidth, vehicleHeight);
+            obj.attributes[AttributeKeys::VehicleType] = (roll(2) == 0) ? "car" : "truck";
+            obj.trackId = "vehicle_" + std::to_string(roll(5));
+        }
+
+        obj.timestampUs = nowUs();
+        results[i].push_back(obj);
+    }
+
+    return results;
+}
+
+// OpenCvDnnDetectorBackend implementation
+OpenCvDnnDetectorBackend::OpenCvDnnDetectorBackend(
+    const std::string& modelPath, const std::string& configPath,
+    int inputSize, float minConfidence, size_t maxBatch, bool useCuda)
+    : m_inputSize(inputSize > 0 ? inputSize : 300),
+      m_minConfidence(minConfidence),
+      m_maxBatch(std::max<size_t>(1, maxBatch))
+{
+    try {
+        m_net = cv::dnn::readNet(modelPath, configPath);
+        if (useCuda && !m_net.empty()) {
+            m_net.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+            m_net.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+        }
+    } catch (const std::exception& e) {
+        Logger::error("Detector", "Failed to load model " + modelPath + ": " + e.what());
+        m_net = cv::dnn::Net();
+    }
+}
+
+std::vector<std::vector<DetectedObject>> OpenCvDnnDetectorBackend::detect(
+    const std::vector<const ImageUtils::FrameView*>& frames)
+{
+    std::vector<std::vector<DetectedObject>> results(frames.size());
+    if (frames.empty()) {
+        return results;
+    }
+
+    std::vector<cv::Mat> images;
+    images.reserve(frames.size());
+    for (const auto* frame : frames) {
+        images.push_back(frame->bgr());
+    }
+
+    // One forward pass for the whole batch
+    cv::Mat blob = cv::dnn::blobFromImages(images, 1.0, cv::Size(m_inputSize, m_inputSize),
+                                           cv::Scalar(104.0, 117.0, 123.0), false, false);
+    m_net.setInput(blob);
+    cv::Mat output = m_net.forward();
+
+    const float* rows = output.ptr<float>();
+    size_t rowCount = output.total() / 7;
+    int64_t timestampUs = nowUs();
+
+    for (size_t r = 0; r < rowCount; ++r) {
+        const float* row = rows + r * 7;
+        int imageId = static_cast<int>(row[0]);
+        float confidence = row[2];
+        if (imageId < 0 || static_cast<size_t>(imageId) >= frames.size() || confidence < m_minConfidence) {
+            continue;
+        }
+
+        std::string typeId = typeForClass(static_cast<int>(row[1]));
+        if (typeId.empty()) {
+            continue;
+        }
+
+        const ImageUtils::FrameView& frame = *frames[imageId];
+        int left = static_cast<int>(std::clamp(row[3], 0.0f, 1.0f) * frame.width());
+        int top = static_cast<int>(std::clamp(row[4], 0.0f, 1.0f) * frame.height());
+        int right = static_cast<int>(std::clamp(row[5], 0.0f, 1.0f) * frame.width());
+        int bottom = static_cast<int>(std::clamp(row[6], 0.0f, 1.0f) * frame.height());
+        if (right <= left || bottom <= top) {
+            continue;
+        }
+
+        DetectedObject obj;
+        obj.typeId = typeId;
+        obj.confidence = confidence;
+        obj.boundingBox = cv::Rect(left, top, right - left, bottom - top);
+        obj.timestampUs = timestampUs;
+        results[imageId].push_back(obj);
+    }
+
+    return results;
+}
+
+std::string OpenCvDnnDetectorBackend::typeForClass(int classId) {
+    switch (classId) {
+        case 1:
+            return "person";
+        case 2:  // bicycle
+        case 3:  // car
+        case 4:  // motorcycle
+        case 6:  // bus
+        case 8:  // truck
+            return "vehicle";
+        default:
+            return "";
+    }
+}
+
+std::shared_ptr<ObjectDetectorBackend> createDetectorBackend(const GlobalConfig& config) {
+    if (config.detectorBackend == "opencv") {
+        auto backend = std::make_shared<OpenCvDnnDetectorBackend>(
+            config.detectorModelPath, config.detectorConfigPath, config.detectorInputSize,
+            config.detectorMinConfidence, static_cast<size_t>(std::max(1, config.detectorMaxBatchSize)),
+            config.detectorUseCuda);
+        if (backend->isLoaded()) {
+            return backend;
+        }
+        Logger::error("Detector", "Could not load " + config.detectorModelPath +
+                      ", using simulated detections");
+    } else if (config.detectorBackend != "simulated") {
+        Logger::error("Detector", "Unknown detector backend '" + config.detectorBackend +
+                      "', using simulated detections");
+    }
+
+    return std::make_shared<SimulatedDetectorBackend>();
+}
+
+// DetectionBatcher implementation
+DetectionBatcher::DetectionBatcher(std::shared_ptr<ObjectDetectorBackend> backend, size_t maxBatch,
+                                   std::chrono::microseconds maxLatency)
+    : m_backend(std::move(backend)),
+      m_maxBatch(std::max<size_t>(1, std::min(maxBatch, m_backend->maxBatchSize()))),
+      m_maxLatency(maxLatency)
+{
+    m_worker = std::thread(&DetectionBatcher::run, this);
+    Logger::info("Detector", "Using " + m_backend->name() + " backend, batches of up to " +
+                 std::to_string(m_maxBatch));
+}
+
+DetectionBatcher::~DetectionBatcher() {
+    stop();
+}
+
+void DetectionBatcher::submit(const std::string& deviceId, const ImageUtils::FrameView& frame,
+                              Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_stopping) {
+            m_queue.push_back(Request{deviceId, &frame, std::move(callback),
+                                      std::chrono::steady_clock::now()});
+            m_cv.notify_one();
+            return;
+        }
+    }
+
+    // Already stopped; the caller still gets its answer
+    callback({}, false);
+}
+
+void DetectionBatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    DetectionBatcherStats finalStats = stats();
+    Logger::info("Detector", "Stopped after " + std::to_string(finalStats.frames) + " frames in " +
+                 std::to_string(finalStats.batches) + " batches (avg " +
+                 std::to_string(finalStats.avgBatchSize) + ", avg wait " +
+                 std::to_string(finalStats.avgWaitUs) + " us)");
+}
+
+DetectionBatcherStats DetectionBatcher::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    DetectionBatcherStats stats;
+    stats.batches = m_batches;
+    stats.frames = m_frames;
+    stats.failures = m_failures;
+    stats.maxBatchSize = m_largestBatch;
+    stats.pending = m_queue.size();
+    if (m_batches > 0) {
+        stats.avgBatchSize = static_cast<double>(m_frames) / m_batches;
+    }
+    if (m_frames > 0) {
+        stats.avgWaitUs = static_cast<double>(m_totalWaitUs) / m_frames;
+    }
+    return stats;
+}
+
+// Private methods
+void DetectionBatcher::run() {
+    std::vector<Request> batch;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]() { return !m_queue.empty() || m_stopping; });
+            if (m_queue.empty()) {
+                break; // Stopping and drained
+            }
+
+            // Give the batch until the oldest frame's deadline to fill up
+            auto deadline = m_queue.front().submittedAt + m_maxLatency;
+            m_cv.wait_until(lock, deadline, [this]() {
+                return m_queue.size() >= m_maxBatch || m_stopping;
+            });
+
+            size_t count = std::min(m_queue.size(), m_maxBatch);
+            batch.clear();
+            for (size_t i = 0; i < count; ++i) {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+        }
+
+        runBatch(batch);
+    }
+}
+
+void DetectionBatcher::runBatch(std::vector<Request>& batch) {
+    auto startedAt = std::chrono::steady_clock::now();
+    uint64_t waitUs = 0;
+
+    std::vector<const ImageUtils::FrameView*> frames;
+    frames.reserve(batch.size());
+    for (const auto& request : batch) {
+        frames.push_back(request.frame);
+        waitUs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            startedAt - request.submittedAt).count());
+    }
+
+    std::vector<std::vector<DetectedObject>> results;
+    bool ok = true;
+    try {
+        results = m_backend->detect(frames);
+        ok = results.size() == batch.size();
+        if (!ok) {
+            Logger::error("Detector", m_backend->name() + " returned " + std::to_string(results.size()) +
+                          " results for " + std::to_string(batch.size()) + " frames");
+        }
+    } catch (const std::exception& e) {
+        Logger::error("Detector", m_backend->name() + " failed: " + e.what());
+        ok = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batches++;
+        m_frames += batch.size();
+        m_totalWaitUs += waitUs;
+        m_largestBatch = std::max(m_largestBatch, batch.size());
+        if (!ok) {
+            m_failures++;
+        }
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i].callback(ok ? std::move(results[i]) : std::vector<DetectedObject>(), ok);
+    }
+}
+
+} // namespace nx_agent
@@ -0,0 +1,251 @@
+// nx_agent_executor.cpp
+#include "nx_agent_executor.h"
+#include "nx_agent_utils.h"
+
+#include <algorithm>
+
+namespace nx_agent {
+
+// Identifies the pool (and worker slot) the current thread belongs to
+static thread_local TaskExecutor* t_currentExecutor = nullptr;
+static thread_local size_t t_workerIndex = 0;
+
+// TaskExecutor implementation
+TaskExecutor::TaskExecutor(size_t workerCount) {
+    if (workerCount == 0) {
+        workerCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (auto& counter : m_executedByLane) {
+        counter.store(0);
+    }
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        m_workers.emplace_back(&TaskExecutor::workerLoop, this, i);
+    }
+
+    Logger::info("TaskExecutor", "Started " + std::to_string(workerCount) + " worker threads");
+}
+
+TaskExecutor::~TaskExecutor() {
+    shutdown();
+}
+
+void TaskExecutor::submit(const std::string& key, TaskPriority priority, Task task) {
+    if (!task) {
+        return;
+    }
+
+    size_t lane = std::min(static_cast<size_t>(priority), kLaneCount - 1);
+    Item item{std::move(task), std::chrono::steady_clock::now()};
+
+    // Counted before it is published: workers only exit once shutdown has
+    // started and nothing is pending, so a task that sees m_stopping unset
+    // here is guaranteed a worker. Once shutdown has started nothing new is
+    // queued; run it on the caller.
+    m_pending++;
+    if (m_stopping) {
+        m_pending--;
+        execute(item, false, lane);
+        return;
+    }
+
+    if (t_currentExecutor == this) {
+        // Spawned from one of our workers: keep it local, peers may steal it
+        WorkerQueue& queue = *m_queues[t_workerIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.lanes[lane].push_back(std::move(item));
+    } else {
+        std::lock_guard<std::mutex> lock(m_fairMutex);
+        FairLane& fair = m_fairLanes[lane];
+        auto& pending = fair.byKey[key];
+        if (pending.empty()) {
+            fair.rotation.push_back(key);
+        }
+        pending.push_back(std::move(item));
+    }
+
+    m_submitted++;
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wakeCv.notify_one();
+}
+
+void TaskExecutor::shutdown() {
+    if (m_stopping.exchange(true)) {
+        return;
+    }
+
+    m_wakeCv.notify_all();
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    ExecutorStats finalStats = stats();
+    Logger::info("TaskExecutor", "Stopped after " + std::to_string(finalStats.executed) +
+                 " tasks (steal rate " + std::to_string(finalStats.stealRate) +
+                 ", avg latency " + std::to_string(finalStats.avgLatencyUs) + " us)");
+}
+
+ExecutorStats TaskExecutor::stats() const {
+    ExecutorStats stats;
+    stats.workerCount = m_workers.size();
+    stats.pending = m_pending.load();
+    stats.submitted = m_submitted.load();
+    stats.executed = m_executed.load();
+    stats.stolen = m_stolen.load();
+    stats.maxLatencyUs = m_maxLatencyUs.load();
+
+    if (stats.executed > 0) {
+        stats.stealRate = static_cast<double>(stats.stolen) / stats.executed;
+        stats.avgLatencyUs = static_cast<double>(m_totalLatencyUs.load()) / stats.executed;
+    }
+
+    for (size_t lane = 0; lane < kLaneCount; ++lane) {
+        stats.executedByPriority[lane] = m_executedByLane[lane].load();
+    }
+
+    return stats;
+}
+
+// Private methods
+void TaskExecutor::workerLoop(size_t index) {
+    t_currentExecutor = this;
+    t_workerIndex = index;
+
+    while (true) {
+        Item item;
+        bool stolen = false;
+        size_t lane = 0;
+
+        if (takeTask(index, item, stolen, lane)) {
+            m_pending--;
+            execute(item, stolen, lane);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        if (m_stopping && m_pending == 0) {
+            break;
+        }
+        m_wakeCv.wait_for(lock, std::chrono::milliseconds(50), [this]() {
+            return m_pending > 0 || m_stopping;
+        });
+        if (m_stopping && m_pending == 0) {
+            break;
+        }
+    }
+
+    t_currentExecutor = nullptr;
+}
+
+bool TaskExecutor::takeTask(size_t index, Item& item, bool& stolen, size_t& lane) {
+    // Strict priority across lanes; within a lane, fair external work first,
+    // then our own deque, then whatever a peer has queued
+    for (lane = 0; lane < kLaneCount; ++lane) {
+        if (popFair(lane, item) || popLocal(index, lane, item)) {
+            stolen = false;
+            return true;
+        }
+        if (steal(index, lane, item)) {
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TaskExecutor::popFair(size_t lane, Item& item) {
+    std::lock_guard<std::mutex> lock(m_fairMutex);
+    FairLane& fair = m_fairLanes[lane];
+
+    while (!fair.rotation.empty()) {
+        std::string key = std::move(fair.rotation.front());
+        fair.rotation.pop_front();
+
+        auto it = fair.byKey.find(key);
+        if (it == fair.byKey.end() || it->second.empty()) {
+            if (it != fair.byKey.end()) {
+                fair.byKey.erase(it);
+            }
+            continue;
+        }
+
+        item = std::move(it->second.front());
+        it->second.pop_front();
+
+        // Send the key to the back of the line if it still has work
+        if (it->second.empty()) {
+            fair.byKey.erase(it);
+        } else {
+            fair.rotation.push_back(std::move(key));
+        }
+        return true;
+    }
+
+    return false;
+}
+
+bool TaskExecutor::popLocal(size_t index, size_t lane, Item& item) {
+    WorkerQueue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    auto& deque = queue.lanes[lane];
+    if (deque.empty()) {
+        return false;
+    }
+    item = std::move(deque.front());
+    deque.pop_front();
+    return true;
+}
+
+bool TaskExecutor::steal(size_t thief, size_t lane, Item& item) {
+    size_t count = m_queues.size();
+    for (size_t offset = 1; offset < count; ++offset) {
+        WorkerQueue& victim = *m_queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        auto& deque = victim.lanes[lane];
+        if (!deque.empty()) {
+            // Take from the opposite end to the owner
+            item = std::move(deque.back());
+            deque.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskExecutor::execute(Item& item, bool stolen, size_t lane) {
+    uint64_t latencyUs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - item.enqueuedAt).count());
+
+    m_totalLatencyUs += latencyUs;
+    uint64_t currentMax = m_maxLatencyUs.load();
+    while (latencyUs > currentMax && !m_maxLatencyUs.compare_exchange_weak(currentMax, latencyUs)) {
+    }
+
+    if (stolen) {
+        m_stolen++;
+    }
+
+    try {
+        item.task();
+    } catch (const std::exception& e) {
+        Logger::error("TaskExecutor", "Task failed: " + std::string(e.what()));
+    } catch (...) {
+        Logger::error("TaskExecutor", "Task failed with unknown exception");
+    }
+
+    m_executed++;
+    m_executedByLane[lane]++;
+}
+
+} // namespace nx_agent
@@ -0,0 +1,637 @@
+// nx_agent_featurelog.cpp
+#include "nx_agent_featurelog.h"
+#include "nx_agent_snapshot.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <utility>
+
+namespace nx_agent {
+
+static_assert(sizeof(FeatureLogBlockHeader) % 8 == 0, "FeatureLogBlockHeader must stay 8-byte aligned");
+
+namespace {
+
+constexpr int64_t kDayUs = 86400LL * 1000000;
+constexpr uint32_t kMaxFloatColumns = 64;
+constexpr int kIntColumns = 5;          // Time of day, day of week, persons, unknown persons, vehicles
+const char* const kSegmentExtension = ".nxflog";
+
+int64_t dayOf(int64_t timestampUs) {
+    return timestampUs >= 0 ? timestampUs / kDayUs : -((-timestampUs + kDayUs - 1) / kDayUs);
+}
+
+uint32_t floatColumnsOf(const FeatureVector& features) {
+    return static_cast<uint32_t>(1 + features.additionalFeatures.size());
+}
+
+int32_t intColumn(const FeatureVector& features, int column) {
+    switch (column) {
+        case 0: return features.timeOfDaySeconds;
+        case 1: return features.dayOfWeek;
+        case 2: return features.personCount;
+        case 3: return features.unknownPersonCount;
+        default: return features.vehicleCount;
+    }
+}
+
+void setIntColumn(FeatureVector& features, int column, int32_t value) {
+    switch (column) {
+        case 0: features.timeOfDaySeconds = value; break;
+        case 1: features.dayOfWeek = value; break;
+        case 2: features.personCount = value; break;
+        case 3: features.unknownPersonCount = value; break;
+        default: features.vehicleCount = value; break;
+    }
+}
+
+float floatColumn(const FeatureVector& features, uint32_t column) {
+    return column == 0 ? features.motionLevel : features.additionalFeatures[column - 1];
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Most significant bit first
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+    void write(uint32_t value, int count) {
+        for (int bit = count - 1; bit >= 0; --bit) {
+            m_byte = static_cast<uint8_t>((m_byte << 1) | ((value >> bit) & 1));
+            if (++m_bits == 8) {
+                m_out.push_back(m_byte);
+                m_byte = 0;
+                m_bits = 0;
+            }
+        }
+    }
+
+    void finish() {
+        if (m_bits > 0) {
+            m_out.push_back(static_cast<uint8_t>(m_byte << (8 - m_bits)));
+            m_byte = 0;
+            m_bits = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+    uint8_t m_byte = 0;
+    int m_bits = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* begin, const uint8_t* end) : m_p(begin), m_end(end) {}
+
+    bool read(int count, uint32_t& value) {
+        value = 0;
+        for (int i = 0; i < count; ++i) {
+            if (m_bits == 0) {
+                if (m_p == m_end) {
+                    return false;
+                }
+                m_byte = *m_p++;
+                m_bits = 8;
+            }
+            --m_bits;
+            value = (value << 1) | ((m_byte >> m_bits) & 1);
+        }
+        return true;
+    }
+
+private:
+    const uint8_t* m_p;
+    const uint8_t* m_end;
+    uint8_t m_byte = 0;
+    int m_bits = 0;
+};
+
+uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int leadingZeros(uint32_t value) {
+    int count = 0;
+    for (uint32_t mask = 0x80000000u; mask && !(value & mask); mask >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+int trailingZeros(uint32_t value) {
+    int count = 0;
+    for (uint32_t mask = 1; mask && !(value & mask); mask <<= 1) {
+        ++count;
+    }
+    return count;
+}
+
+// Blocks for samples[begin, end): split where the column count changes
+// and at kMaxBlockSamples
+void appendBlocks(std::vector<uint8_t>& out, const std::vector<FeatureVector>& samples, size_t begin, size_t end) {
+    while (begin < end) {
+        uint32_t columns = floatColumnsOf(samples[begin]);
+        size_t blockEnd = begin + 1;
+        while (blockEnd < end && blockEnd - begin < FeatureLog::kMaxBlockSamples &&
+               floatColumnsOf(samples[blockEnd]) == columns) {
+            ++blockEnd;
+        }
+        std::vector<uint8_t> block = FeatureLog::encodeBlock(samples, begin, blockEnd);
+        out.insert(out.end(), block.begin(), block.end());
+        begin = blockEnd;
+    }
+}
+
+bool readFile(const std::string& filePath, std::vector<uint8_t>& data) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    return data.empty() || static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), size));
+}
+
+// Segments of a log directory by day, oldest first
+std::vector<std::pair<int64_t, std::string>> listSegments(const std::string& directory) {
+    std::vector<std::pair<int64_t, std::string>> segments;
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(directory, ec);
+         !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        const std::filesystem::path& path = it->path();
+        if (path.extension() != kSegmentExtension) {
+            continue;
+        }
+        std::string stem = path.stem().string();
+        char* end = nullptr;
+        long long day = std::strtoll(stem.c_str(), &end, 10);
+        if (!stem.empty() && end == stem.c_str() + stem.size()) {
+            segments.emplace_back(static_cast<int64_t>(day), path.string());
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+} // namespace
+
+// FeatureLog implementation
+FeatureLog::FeatureLog(std::string directory)
+    : m_directory(std::move(directory)) {
+}
+
+FeatureLog::~FeatureLog() = default;
+
+void FeatureLog::append(const FeatureVector& features) {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    m_pending.push_back(features);
+}
+
+size_t FeatureLog::pendingCount() const {
+    std::lock_guard<std::mutex> lock(m_pendingMutex);
+    return m_pending.size();
+}
+
+bool FeatureLog::flush() {
+    // Appends go on into a fresh buffer while this one is written
+    std::vector<FeatureVector> samples;
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        samples.swap(m_pending);
+        generation = m_clearGeneration;
+    }
+    if (samples.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_fileMutex);
+    {
+        // Samples taken before a clear() belong to the baseline it dropped
+        std::lock_guard<std::mutex> pendingLock(m_pendingMutex);
+        if (generation != m_clearGeneration) {
+            return true;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (m_openDay < 0) {
+        auto existing = listSegments(m_directory);
+        if (!existing.empty()) {
+            m_openDay = existing.back().first;
+        }
+    }
+
+    bool written = true;
+    size_t begin = 0;
+    while (begin < samples.size()) {
+        int64_t day = dayOf(samples[begin].timestampUs);
+        size_t end = begin + 1;
+        while (end < samples.size() && dayOf(samples[end].timestampUs) == day) {
+            ++end;
+        }
+        written = writeSegment(day, samples, begin, end) && written;
+
+        // The day rolled over: its segment is complete and can be packed
+        if (day > m_openDay) {
+            if (m_openDay >= 0) {
+                compactSegment(m_openDay);
+            }
+            m_openDay = day;
+        }
+        begin = end;
+    }
+
+    dropExpired(m_openDay);
+    return written;
+}
+
+void FeatureLog::clear() {
+    std::lock_guard<std::mutex> fileLock(m_fileMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_pendingMutex);
+        m_pending.clear();
+        ++m_clearGeneration;
+    }
+    for (const auto& segment : listSegments(m_directory)) {
+        std::error_code ec;
+        std::filesystem::remove(segment.second, ec);
+    }
+    m_openDay = -1;
+}
+
+std::vector<std::string> FeatureLog::segments() const {
+    std::vector<std::string> paths;
+    for (const auto& segment : listSegments(m_directory)) {
+        paths.push_back(segment.second);
+    }
+    return paths;
+}
+
+void FeatureLog::enforceQuota(const std::string& rootPath, uint64_t maxBytes) {
+    struct Segment {
+        int64_t day;
+        std::string path;
+        uint64_t size;
+    };
+
+    // One sweep at a time; every device's save may trigger one
+    static std::mutex sweepMutex;
+    std::lock_guard<std::mutex> lock(sweepMutex);
+
+    uint64_t totalBytes = 0;
+    std::map<std::string, std::vector<Segment>> segmentsByLog;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(rootPath, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code sizeError;
+        if (!it->is_regular_file(sizeError)) {
+            continue;
+        }
+        uint64_t size = it->file_size(sizeError);
+        if (sizeError) {
+            continue;
+        }
+        totalBytes += size;
+
+        const std::filesystem::path& path = it->path();
+        if (path.extension() == kSegmentExtension) {
+            std::string stem = path.stem().string();
+            char* end = nullptr;
+            long long day = std::strtoll(stem.c_str(), &end, 10);
+            if (!stem.empty() && end == stem.c_str() + stem.size()) {
+                segmentsByLog[path.parent_path().string()].push_back({static_cast<int64_t>(day), path.string(), size});
+            }
+        }
+    }
+    if (totalBytes <= maxBytes) {
+        return;
+    }
+
+    // Oldest days go first, across devices; each log keeps its newest segment
+    std::vector<Segment> candidates;
+    for (auto& pair : segmentsByLog) {
+        std::vector<Segment>& segments = pair.second;
+        std::sort(segments.begin(), segments.end(),
+                  [](const Segment& a, const Segment& b) { return a.day < b.day; });
+        candidates.insert(candidates.end(), segments.begin(), segments.end() - 1);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Segment& a, const Segment& b) { return a.day < b.day; });
+
+    for (const auto& segment : candidates) {
+        if (totalBytes <= maxBytes) {
+            break;
+        }
+        std::error_code removeError;
+        if (std::filesystem::remove(segment.path, removeError)) {
+            totalBytes -= std::min(totalBytes, segment.size);
+        }
+    }
+    if (totalBytes > maxBytes) {
+        std::cerr << "Data storage exceeds maxStorageSizeMB after evicting feature logs: "
+                  << totalBytes / (1024 * 1024) << " MB in " << rootPath << std::endl;
+    }
+}
+
+std::vector<uint8_t> FeatureLog::encodeBlock(const std::vector<FeatureVector>& samples, size_t begin, size_t end) {
+    FeatureLogBlockHeader header = {};
+    header.magic = kFeatureLogMagic;
+    header.version = kFeatureLogVersion;
+    header.sampleCount = static_cast<uint32_t>(end - begin);
+    header.floatColumns = std::min(floatColumnsOf(samples[begin]), kMaxFloatColumns);
+    header.firstUs = samples[begin].timestampUs;
+    header.lastUs = samples[end - 1].timestampUs;
+
+    std::vector<uint8_t> block(sizeof(header));
+
+    // Timestamps, delta of delta
+    int64_t previousUs = header.firstUs;
+    int64_t previousDelta = 0;
+    for (size_t i = begin; i < end; ++i) {
+        int64_t delta = samples[i].timestampUs - previousUs;
+        putVarint(block, zigzag(delta - previousDelta));
+        previousUs = samples[i].timestampUs;
+        previousDelta = delta;
+    }
+
+    // Integer fields, delta coded column by column
+    for (int column = 0; column < kIntColumns; ++column) {
+        int64_t previous = 0;
+        for (size_t i = begin; i < end; ++i) {
+            int64_t value = intColumn(samples[i], column);
+            putVarint(block, zigzag(value - previous));
+            previous = value;
+        }
+    }
+
+    // Float columns, XOR with the previous value
+    BitWriter bits(block);
+    for (uint32_t column = 0; column < header.floatColumns; ++column) {
+        uint32_t previous = 0;
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t value = floatBits(floatColumn(samples[i], column));
+            uint32_t x = value ^ previous;
+            previous = value;
+            if (x == 0) {
+                bits.write(0, 1);
+                continue;
+            }
+            int leading = std::min(leadingZeros(x), 31);
+            int significant = 32 - leading - trailingZeros(x);
+            bits.write(1, 1);
+            bits.write(static_cast<uint32_t>(leading), 5);
+            bits.write(static_cast<uint32_t>(significant - 1), 5);
+            bits.write(x >> (32 - leading - significant), significant);
+        }
+    }
+    bits.finish();
+
+    header.payloadSize = static_cast<uint32_t>(block.size() - sizeof(header));
+    header.checksum = crc32(block.data() + sizeof(header), header.payloadSize);
+    std::memcpy(block.data(), &header, sizeof(header));
+    return block;
+}
+
+bool FeatureLog::writeSegment(int64_t day, const std::vector<FeatureVector>& samples, size_t begin, size_t end) {
+    std::vector<uint8_t> blocks;
+    appendBlocks(blocks, samples, begin, end);
+
+    std::string filePath = segmentPath(day);
+    std::ofstream file(filePath, std::ios::binary | std::ios::app);
+    if (!file.is_open() || !file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size())) {
+        std::cerr << "Failed to append to feature log " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FeatureLog::compactSegment(int64_t day) {
+    std::string filePath = segmentPath(day);
+    std::vector<uint8_t> data;
+    if (!readFile(filePath, data)) {
+        return false;
+    }
+
+    // Count the blocks; a segment written in one block is already compact
+    size_t blocks = 0;
+    for (size_t offset = 0; offset + sizeof(FeatureLogBlockHeader) <= data.size() && blocks < 2; ++blocks) {
+        FeatureLogBlockHeader header;
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        offset += sizeof(header) + header.payloadSize;
+    }
+    if (blocks < 2) {
+        return true;
+    }
+
+    std::vector<FeatureVector> samples;
+    FeatureVector features;
+    FeatureLogReader reader = FeatureLogReader::forSegment(filePath);
+    while (reader.next(features)) {
+        samples.push_back(features);
+    }
+    std::vector<uint8_t> packed;
+    appendBlocks(packed, samples, 0, samples.size());
+
+    // Replaced atomically and durably, as snapshots are
+    if (!writeFileAtomic(filePath, {{packed.data(), packed.size()}})) {
+        std::cerr << "Failed to compact feature log " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FeatureLog::dropExpired(int64_t newestDay) {
+    int retentionDays = m_retentionDays;
+    if (retentionDays <= 0 || newestDay < 0) {
+        return;
+    }
+    for (const auto& segment : listSegments(m_directory)) {
+        if (segment.first >= newestDay - retentionDays) {
+            break;
+        }
+        std::error_code ec;
+        std::filesystem::remove(segment.second, ec);
+    }
+}
+
+std::string FeatureLog::segmentPath(int64_t day) const {
+    return m_directory + "/" + std::to_string(day) + kSegmentExtension;
+}
+
+// FeatureLogReader implementation
+FeatureLogReader::FeatureLogReader(const std::string& directory) {
+    for (const auto& segment : listSegments(directory)) {
+        m_segments.push_back(segment.second);
+    }
+}
+
+FeatureLogReader FeatureLogReader::forSegment(const std::string& filePath) {
+    FeatureLogReader reader;
+    reader.m_segments.push_back(filePath);
+    return reader;
+}
+
+bool FeatureLogReader::next(FeatureVector& features) {
+    while (m_blockIndex >= m_block.size()) {
+        if (!loadNextBlock()) {
+            return false;
+        }
+    }
+    features = m_block[m_blockIndex++];
+    return true;
+}
+
+bool FeatureLogReader::loadNextBlock() {
+    m_block.clear();
+    m_blockIndex = 0;
+
+    while (true) {
+        if (m_offset >= m_data.size()) {
+            if (m_nextSegment >= m_segments.size()) {
+                return false;
+            }
+            if (!readFile(m_segments[m_nextSegment++], m_data)) {
+                m_data.clear();
+            }
+            m_offset = 0;
+            continue;
+        }
+
+        // A header that does not fit ends the segment: a torn append
+        FeatureLogBlockHeader header;
+        size_t remaining = m_data.size() - m_offset;
+        if (remaining < sizeof(header)) {
+            ++m_corruptBlocks;
+            m_offset = m_data.size();
+            continue;
+        }
+        std::memcpy(&header, m_data.data() + m_offset, sizeof(header));
+        if (header.magic != kFeatureLogMagic || header.version != kFeatureLogVersion ||
+            header.payloadSize > remaining - sizeof(header)) {
+            ++m_corruptBlocks;
+            m_offset = m_data.size();
+            continue;
+        }
+
+        const uint8_t* payload = m_data.data() + m_offset + sizeof(header);
+        m_offset += sizeof(header) + header.payloadSize;
+        if (crc32(payload, header.payloadSize) != header.checksum || !decodeBlock(header, payload, m_block)) {
+            ++m_corruptBlocks;
+            m_block.clear();
+            continue;
+        }
+        if (!m_block.empty()) {
+            return true;
+        }
+    }
+}
+
+bool FeatureLogReader::decodeBlock(const FeatureLogBlockHeader& header, const uint8_t* payload,
+                                   std::vector<FeatureVector>& samples) {
+    if (header.sampleCount > FeatureLog::kMaxBlockSamples || header.floatColumns == 0 ||
+        header.floatColumns > kMaxFloatColumns) {
+        return false;
+    }
+    const uint8_t* p = payload;
+    const uint8_t* end = payload + header.payloadSize;
+    samples.assign(header.sampleCount, FeatureVector());
+
+    int64_t previousUs = header.firstUs;
+    int64_t previousDelta = 0;
+    for (auto& features : samples) {
+        uint64_t value;
+        if (!getVarint(p, end, value)) {
+            return false;
+        }
+        previousDelta += unzigzag(value);
+        previousUs += previousDelta;
+        features.timestampUs = previousUs;
+        features.additionalFeatures.resize(header.floatColumns - 1);
+    }
+
+    for (int column = 0; column < kIntColumns; ++column) {
+        int64_t previous = 0;
+        for (auto& features : samples) {
+            uint64_t value;
+            if (!getVarint(p, end, value)) {
+                return false;
+            }
+            previous += unzigzag(value);
+            setIntColumn(features, column, static_cast<int32_t>(previous));
+        }
+    }
+
+    BitReader bits(p, end);
+    for (uint32_t column = 0; column < header.floatColumns; ++column) {
+        uint32_t previous = 0;
+        for (auto& features : samples) {
+            uint32_t changed;
+            if (!bits.read(1, changed)) {
+                return false;
+            }
+            if (changed) {
+                uint32_t leading;
+                uint32_t significant;
+                uint32_t x;
+                if (!bits.read(5, leading) || !bits.read(5, significant) ||
+                    leading + significant + 1 > 32 || !bits.read(static_cast<int>(significant) + 1, x)) {
+                    return false;
+                }
+                previous ^= x << (31 - leading - significant);
+            }
+            float value = bitsFloat(previous);
+            if (column == 0) {
+                features.motionLevel = value;
+            } else {
+                features.additionalFeatures[column - 1] = value;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace nx_agent
@@ -0,0 +1,76 @@
+// nx_agent_framepool.cpp
+#include "nx_agent_framepool.h"
+#include "nx_agent_metrics.h"
+
+#include <algorithm>
+
+namespace nx_agent {
+
+FramePool::FramePool(const std::string& deviceId, size_t maxBuffersPerShape)
+    : m_maxBuffersPerShape(std::max<size_t>(1, maxBuffersPerShape)),
+      m_hits(MetricsRegistry::instance().counter("nx_agent_frame_pool_hits_total", deviceId)),
+      m_misses(MetricsRegistry::instance().counter("nx_agent_frame_pool_misses_total", deviceId))
+{
+}
+
+cv::Mat FramePool::acquire(int rows, int cols, int type) {
+    Shape shape(rows, cols, type);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Slot& slot = m_slots[shape];
+    slot.lastUse = ++m_acquisitions;
+    for (const cv::Mat& buffer : slot.buffers) {
+        if (isIdle(buffer)) {
+            m_hits->increment();
+            return buffer;
+        }
+    }
+
+    m_misses->increment();
+
+    // Everything is in use; grow up to the limit, beyond it hand out an
+    // unpooled buffer rather than stall the pipeline
+    if (slot.buffers.size() >= m_maxBuffersPerShape) {
+        return cv::Mat(rows, cols, type);
+    }
+
+    // Growing is rare once the stream is steady, so this is the time to
+    // let go of shapes left behind by a resolution change
+    for (auto it = m_slots.begin(); it != m_slots.end();) {
+        if (m_acquisitions - it->second.lastUse <= kShapeExpiry) {
+            ++it;
+            continue;
+        }
+        auto& buffers = it->second.buffers;
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(), isIdle), buffers.end());
+        it = buffers.empty() ? m_slots.erase(it) : std::next(it);
+    }
+
+    slot.buffers.emplace_back(rows, cols, type);
+    return slot.buffers.back();
+}
+
+FramePoolStats FramePool::stats() const {
+    FramePoolStats stats;
+    stats.hits = m_hits->value();
+    stats.misses = m_misses->value();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_slots) {
+        stats.buffers += entry.second.buffers.size();
+        for (const cv::Mat& buffer : entry.second.buffers) {
+            stats.bytes += buffer.total() * buffer.elemSize();
+        }
+    }
+    return stats;
+}
+
+// Private methods
+bool FramePool::isIdle(const cv::Mat& buffer) {
+    // Atomic read of OpenCV's reference count. A count of one can only be
+    // raised while the pool lock is held (by acquire handing the buffer
+    // out), so it means no frame, plane or mask refers to the buffer any more.
+    return buffer.u && CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+} // namespace nx_agent
@@ -0,0 +1,372 @@
+// nx_agent_http.cpp
+#include "nx_agent_http.h"
+#include "nx_agent_config.h"
+#include "nx_agent_utils.h"
+
+#include <algorithm>
+#include <curl/curl.h>
+
+namespace nx_agent {
+
+// Webhook replies are not used; read and discard them
+static size_t discardResponse(char*, size_t size, size_t nmemb, void*) {
+    return size * nmemb;
+}
+
+HttpDispatcherOptions httpDispatcherOptions(const GlobalConfig& config) {
+    HttpDispatcherOptions options;
+    options.maxInFlight = static_cast<size_t>(std::max(1, config.httpMaxInFlight));
+    options.maxRetries = std::max(0, config.httpMaxRetries);
+    options.retryBackoff = std::chrono::milliseconds(std::max(0, config.httpRetryBackoffMs));
+    options.batchWindow = std::chrono::milliseconds(std::max(0, config.httpBatchWindowMs));
+    options.timeout = std::chrono::milliseconds(std::max(100, config.httpTimeoutMs));
+    return options;
+}
+
+// HttpDispatcher implementation
+HttpDispatcher::HttpDispatcher(HttpDispatcherOptions options)
+    : m_options(options)
+{
+    m_options.maxInFlight = std::max<size_t>(1, m_options.maxInFlight);
+    m_options.maxBatchSize = std::max<size_t>(1, m_options.maxBatchSize);
+
+    // Once per process; libcurl's global state is never torn down because
+    // curl_global_cleanup is not safe while other threads may use curl
+    static std::once_flag curlInit;
+    std::call_once(curlInit, []() { curl_global_init(CURL_GLOBAL_ALL); });
+
+    CURLM* multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(m_options.maxHostConnections));
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(m_options.maxInFlight));
+    m_multi = multi;
+
+    curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = curl_slist_append(headers, "Expect:");   // No 100-continue round trip
+    m_headers = headers;
+
+    m_worker = std::thread(&HttpDispatcher::run, this);
+}
+
+HttpDispatcher::~HttpDispatcher() {
+    stop();
+
+    curl_multi_cleanup(static_cast<CURLM*>(m_multi));
+    curl_slist_free_all(static_cast<curl_slist*>(m_headers));
+}
+
+bool HttpDispatcher::post(const std::string& url, const std::string& jsonPayload) {
+    bool refused = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return false;
+        }
+        if (m_queuedAlerts >= m_options.maxQueued) {
+            refused = true;
+        } else if (m_options.batchWindow.count() == 0) {
+            auto transfer = std::make_unique<Transfer>();
+            transfer->url = url;
+            transfer->host = hostOf(url);
+            transfer->body = jsonPayload;
+            transfer->alerts = 1;
+            m_ready.push_back(std::move(transfer));
+            m_queuedAlerts++;
+        } else {
+            Batch& batch = m_batches[url];
+            if (batch.payloads.empty()) {
+                batch.dueAt = Clock::now() + m_options.batchWindow;
+            }
+            batch.payloads.push_back(jsonPayload);
+            if (batch.payloads.size() >= m_options.maxBatchSize) {
+                batch.dueAt = Clock::now();
+            }
+            m_queuedAlerts++;
+        }
+    }
+
+    if (refused) {
+        uint64_t dropped = ++m_dropped;
+        if (dropped == 1 || dropped % 100 == 0) {
+            Logger::warning("HttpDispatcher", "Alert queue full, " + std::to_string(dropped) +
+                            " alerts dropped so far");
+        }
+        return false;
+    }
+
+    m_posted++;
+    wake();
+    return true;
+}
+
+void HttpDispatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        m_stopDeadline = Clock::now() + m_options.timeout + std::chrono::seconds(1);
+    }
+    wake();
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+HttpDispatcherStats HttpDispatcher::stats() const {
+    HttpDispatcherStats stats;
+    stats.posted = m_posted.load();
+    stats.requests = m_requests.load();
+    stats.delivered = m_delivered.load();
+    stats.retried = m_retried.load();
+    stats.failed = m_failed.load();
+    stats.dropped = m_dropped.load();
+    stats.inFlight = m_inFlight.load();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.queued = m_queuedAlerts;
+    return stats;
+}
+
+// Private methods
+void HttpDispatcher::run() {
+    CURLM* multi = static_cast<CURLM*>(m_multi);
+    std::vector<std::unique_ptr<Transfer>> starting;
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        Clock::duration timeout;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Close batches whose window has passed
+            for (auto it = m_batches.begin(); it != m_batches.end();) {
+                if (m_stopping || it->second.dueAt <= now) {
+                    auto transfer = std::make_unique<Transfer>();
+                    transfer->url = it->first;
+                    transfer->host = hostOf(it->first);
+                    transfer->alerts = it->second.payloads.size();
+                    transfer->body = batchBody(it->second.payloads);
+                    m_ready.push_back(std::move(transfer));
+                    it = m_batches.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            // Retries whose backoff has passed; when stopping they get one last try now
+            for (auto it = m_retries.begin(); it != m_retries.end();) {
+                if (m_stopping || (*it)->dueAt <= now) {
+                    m_ready.push_back(std::move(*it));
+                    it = m_retries.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            while (!m_ready.empty() && m_running.size() + starting.size() < m_options.maxInFlight) {
+                m_queuedAlerts -= m_ready.front()->alerts;
+                starting.push_back(std::move(m_ready.front()));
+                m_ready.pop_front();
+            }
+
+            if (m_stopping) {
+                bool drained = m_ready.empty() && m_retries.empty() && m_batches.empty() &&
+                               m_running.empty() && starting.empty();
+                if (drained || now >= m_stopDeadline) {
+                    break;
+                }
+            }
+
+            timeout = pollTimeout(now);
+        }
+
+        for (auto& transfer : starting) {
+            startTransfer(std::move(transfer));
+        }
+        starting.clear();
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int remaining = 0;
+        bool finished = false;
+        while (CURLMsg* message = curl_multi_info_read(multi, &remaining)) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            finished = true;
+
+            CURL* handle = message->easy_handle;
+            CURLcode result = message->data.result;
+            long status = 0;
+            curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+            curl_multi_remove_handle(multi, handle);
+
+            auto it = m_running.find(handle);
+            if (it == m_running.end()) {
+                continue;
+            }
+            std::unique_ptr<Transfer> transfer = std::move(it->second);
+            m_running.erase(it);
+            m_inFlight = m_running.size();
+            releaseHandle(transfer->host, handle);
+
+            bool ok = result == CURLE_OK && status >= 200 && status < 300;
+            bool retryable = result != CURLE_OK || status == 429 || status >= 500;
+            std::string error = result != CURLE_OK ? std::string(curl_easy_strerror(result))
+                                                   : "HTTP " + std::to_string(status);
+            finishTransfer(std::move(transfer), ok, retryable, error);
+        }
+
+        // A failed transfer may have queued a retry due sooner than the timeout above
+        if (finished) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timeout = std::min(timeout, pollTimeout(Clock::now()));
+        }
+
+        int timeoutMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
+        curl_multi_poll(multi, nullptr, 0, std::max(0, timeoutMs), nullptr);
+    }
+
+    // Abandon whatever outlived the stop deadline
+    for (auto& entry : m_running) {
+        curl_multi_remove_handle(multi, entry.first);
+        curl_easy_cleanup(entry.first);
+        m_failed += entry.second->alerts;
+    }
+    m_running.clear();
+    m_inFlight = 0;
+
+    for (auto& host : m_idleHandles) {
+        for (void* handle : host.second) {
+            curl_easy_cleanup(handle);
+        }
+    }
+    m_idleHandles.clear();
+
+    HttpDispatcherStats finalStats = stats();
+    Logger::info("HttpDispatcher", "Stopped after " + std::to_string(finalStats.requests) + " requests carrying " +
+                 std::to_string(finalStats.delivered) + " alerts (" + std::to_string(finalStats.retried) +
+                 " retries, " + std::to_string(finalStats.failed) + " failed, " +
+                 std::to_string(finalStats.dropped) + " dropped)");
+}
+
+void HttpDispatcher::startTransfer(std::unique_ptr<Transfer> transfer) {
+    CURL* handle = static_cast<CURL*>(acquireHandle(transfer->host));
+    if (!handle) {
+        finishTransfer(std::move(transfer), false, true, "Failed to initialize CURL");
+        return;
+    }
+
+    curl_easy_setopt(handle, CURLOPT_URL, transfer->url.c_str());
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(transfer->body.size()));
+    curl_easy_setopt(handle, CURLOPT_HTTPHEADER, static_cast<curl_slist*>(m_headers));
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, discardResponse);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(m_options.timeout.count()));
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(m_options.connectTimeout.count()));
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    transfer->handle = handle;
+    m_running[handle] = std::move(transfer);
+    m_inFlight = m_running.size();
+    curl_multi_add_handle(static_cast<CURLM*>(m_multi), handle);
+}
+
+void HttpDispatcher::finishTransfer(std::unique_ptr<Transfer> transfer, bool ok, bool retryable,
+                                    const std::string& error)
+{
+    transfer->handle = nullptr;
+
+    if (ok) {
+        m_requests++;
+        m_delivered += transfer->alerts;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (retryable && transfer->attempt < m_options.maxRetries && !m_stopping) {
+        transfer->attempt++;
+        transfer->dueAt = Clock::now() + m_options.retryBackoff * (1 << std::min(transfer->attempt - 1, 10));
+        m_queuedAlerts += transfer->alerts;
+        m_retried++;
+        m_retries.push_back(std::move(transfer));
+        return;
+    }
+
+    m_failed += transfer->alerts;
+    Logger::error("HttpDispatcher", "Giving up on " + transfer->url + " after " +
+                  std::to_string(transfer->attempt + 1) + " attempts: " + error);
+}
+
+HttpDispatcher::Clock::duration HttpDispatcher::pollTimeout(Clock::time_point now) {
+    // Sleep until the next batch or retry is due; post() and stop() wake us early
+    Clock::time_point next = now + std::chrono::seconds(1);
+    if (!m_ready.empty() && m_running.size() < m_options.maxInFlight) {
+        return Clock::duration::zero();
+    }
+    for (const auto& batch : m_batches) {
+        next = std::min(next, batch.second.dueAt);
+    }
+    for (const auto& retry : m_retries) {
+        next = std::min(next, retry->dueAt);
+    }
+    return std::max(Clock::duration::zero(), next - now);
+}
+
+void* HttpDispatcher::acquireHandle(const std::string& host) {
+    auto it = m_idleHandles.find(host);
+    if (it != m_idleHandles.end() && !it->second.empty()) {
+        void* handle = it->second.back();
+        it->second.pop_back();
+        return handle;
+    }
+    return curl_easy_init();
+}
+
+void HttpDispatcher::releaseHandle(const std::string& host, void* handle) {
+    // Keep a few handles per host; the multi handle's connection cache keeps
+    // their connections alive for the next alert
+    std::vector<void*>& idle = m_idleHandles[host];
+    if (idle.size() < m_options.maxHostConnections) {
+        idle.push_back(handle);
+    } else {
+        curl_easy_cleanup(handle);
+    }
+}
+
+void HttpDispatcher::wake() {
+    // curl_multi_wakeup may be called from any thread
+    if (m_multi) {
+        curl_multi_wakeup(static_cast<CURLM*>(m_multi));
+    }
+}
+
+std::string HttpDispatcher::hostOf(const std::string& url) {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    size_t end = url.find_first_of("/?#", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+std::string HttpDispatcher::batchBody(std::vector<std::string>& payloads) {
+    if (payloads.size() == 1) {
+        return std::move(payloads.front());
+    }
+
+    std::string body = "[";
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        if (i > 0) {
+            body += ",";
+        }
+        body += payloads[i];
+    }
+    body += "]";
+    return body;
+}
+
+} // namespace nx_agent
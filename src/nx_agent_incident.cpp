@@ -0,0 +1,217 @@
+// nx_agent_incident.cpp
+#include "nx_agent_incident.h"
+#include "nx_agent_utils.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace nx_agent {
+
+IncidentCorrelator::IncidentCorrelator(int64_t windowUs, int64_t maxDurationUs, size_t maxOpen,
+                                       int64_t holdUs)
+    : m_windowUs(std::max<int64_t>(0, windowUs)),
+      m_maxDurationUs(std::max(maxDurationUs, windowUs)),
+      m_maxOpen(std::max<size_t>(1, maxOpen)),
+      m_holdUs(std::clamp<int64_t>(holdUs, 0, m_windowUs))
+{
+    if (m_holdUs > 0) {
+        m_worker = std::thread(&IncidentCorrelator::releaseHeld, this);
+    }
+}
+
+IncidentCorrelator::~IncidentCorrelator() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    // Responses still held go out now rather than never
+    std::vector<Response> due;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& entry : m_incidents) {
+            close(entry.first, entry.second, "shutdown", due);
+        }
+        m_incidents.clear();
+    }
+    run(due);
+}
+
+IncidentDecision IncidentCorrelator::report(const std::string& siteId, const std::string& anomalyType,
+                                            const std::string& actionName, const std::string& deviceId,
+                                            float score, Dispatch dispatch)
+{
+    int64_t now = nowUs();
+    std::vector<Response> due;
+    IncidentDecision decision;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        expire(now, due);
+
+        Key key(siteId, anomalyType, actionName);
+        auto it = m_incidents.find(key);
+        if (it != m_incidents.end()) {
+            Incident& incident = it->second;
+            bool tooLong = now - incident.firstUs > m_maxDurationUs;
+            if (!tooLong) {
+                incident.lastUs = now;
+                incident.maxScore = std::max(incident.maxScore, score);
+                incident.reports++;
+                if (std::find(incident.devices.begin(), incident.devices.end(), deviceId) ==
+                    incident.devices.end()) {
+                    incident.devices.push_back(deviceId);
+                }
+                m_stats.merged++;
+                decision = IncidentDecision{false, incident.id};
+            } else {
+                close(it->first, incident, "renewed", due);
+                m_incidents.erase(it);
+            }
+        }
+
+        if (decision.lead) {
+            // Make room by dropping the incident that has been quiet the longest
+            if (m_incidents.size() >= m_maxOpen) {
+                auto oldest = std::min_element(m_incidents.begin(), m_incidents.end(),
+                    [](const std::pair<const Key, Incident>& a, const std::pair<const Key, Incident>& b) {
+                        return a.second.lastUs < b.second.lastUs;
+                    });
+                close(oldest->first, oldest->second, "evicted", due);
+                m_incidents.erase(oldest);
+                m_stats.evicted++;
+            }
+
+            Incident incident;
+            incident.id = m_nextId++;
+            incident.firstUs = now;
+            incident.lastUs = now;
+            incident.maxScore = score;
+            incident.reports = 1;
+            incident.devices.push_back(deviceId);
+            incident.dispatch = std::move(dispatch);
+            auto inserted = m_incidents.emplace(key, std::move(incident)).first;
+            m_stats.opened++;
+            decision = IncidentDecision{true, inserted->second.id};
+
+            if (m_holdUs == 0) {
+                due.push_back(Response{std::move(inserted->second.dispatch), summarize(key, inserted->second)});
+                inserted->second.dispatch = nullptr;
+            } else {
+                m_cv.notify_one();
+            }
+        }
+    }
+
+    run(due);
+    return decision;
+}
+
+IncidentStats IncidentCorrelator::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    IncidentStats stats = m_stats;
+    stats.open = m_incidents.size();
+    return stats;
+}
+
+// Private methods
+int64_t IncidentCorrelator::nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+IncidentSummary IncidentCorrelator::summarize(const Key& key, const Incident& incident) {
+    IncidentSummary summary;
+    summary.id = incident.id;
+    summary.anomalyType = std::get<1>(key);
+    summary.actionName = std::get<2>(key);
+    summary.devices = incident.devices;
+    summary.reports = incident.reports;
+    summary.maxScore = incident.maxScore;
+    return summary;
+}
+
+void IncidentCorrelator::expire(int64_t nowUs, std::vector<Response>& due) {
+    for (auto it = m_incidents.begin(); it != m_incidents.end();) {
+        if (nowUs > it->second.lastUs + m_windowUs) {
+            close(it->first, it->second, "expired", due);
+            it = m_incidents.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void IncidentCorrelator::close(const Key& key, Incident& incident, const char* reason,
+                               std::vector<Response>& due)
+{
+    if (incident.dispatch) {
+        due.push_back(Response{std::move(incident.dispatch), summarize(key, incident)});
+        incident.dispatch = nullptr;
+    }
+
+    // Single-camera incidents are the common case and already logged by the device
+    if (incident.reports <= 1) {
+        return;
+    }
+
+    Logger::info("IncidentCorrelator", "Incident " + std::to_string(incident.id) + " (" +
+                 std::get<1>(key) + "/" + std::get<2>(key) +
+                 (std::get<0>(key).empty() ? "" : " at " + std::get<0>(key)) + ") " + reason + ": " +
+                 std::to_string(incident.reports) + " reports from " +
+                 std::to_string(incident.devices.size()) + " cameras over " +
+                 std::to_string((incident.lastUs - incident.firstUs) / 1000000) + " s, max score " +
+                 std::to_string(incident.maxScore));
+}
+
+void IncidentCorrelator::run(std::vector<Response>& due) {
+    // Outside m_mutex: a response may report again
+    for (Response& response : due) {
+        try {
+            response.dispatch(response.incident);
+        } catch (const std::exception& e) {
+            Logger::error("IncidentCorrelator", "Response to incident " + std::to_string(response.incident.id) +
+                          " failed: " + e.what());
+        }
+    }
+    due.clear();
+}
+
+void IncidentCorrelator::releaseHeld() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        int64_t now = nowUs();
+        int64_t nextDueUs = INT64_MAX;
+        std::vector<Response> due;
+        for (auto& entry : m_incidents) {
+            Incident& incident = entry.second;
+            if (!incident.dispatch) {
+                continue;
+            }
+            if (now >= incident.firstUs + m_holdUs) {
+                due.push_back(Response{std::move(incident.dispatch), summarize(entry.first, incident)});
+                incident.dispatch = nullptr;
+            } else {
+                nextDueUs = std::min(nextDueUs, incident.firstUs + m_holdUs);
+            }
+        }
+
+        if (!due.empty()) {
+            lock.unlock();
+            run(due);
+            lock.lock();
+            continue;
+        }
+
+        if (nextDueUs == INT64_MAX) {
+            m_cv.wait(lock);
+        } else {
+            m_cv.wait_for(lock, std::chrono::microseconds(nextDueUs - now));
+        }
+    }
+}
+
+} // namespace nx_agent
@@ -5,6 +5,16 @@
 #include "nx_agent_metadata.h"
 #include "nx_agent_anomaly.h"
 #include "nx_agent_response.h"
+#include "nx_agent_pipeline.h"
+#include "nx_agent_executor.h"
+#include "nx_agent_scheduler.h"
+#include "nx_agent_detector.h"
+#include "nx_agent_metrics.h"
+#include "nx_agent_http.h"
+#include "nx_agent_incident.h"
+#include "nx_agent_framepool.h"
+#include "nx_agent_objectmeta.h"
+#include "nx_agent_motion.h"
 #include "nx_agent_utils.h"
 
 #include <nx/sdk/helpers/uuid_helper.h>
@@ -17,6 +27,9 @@
 #include <sstream>
 #include <thread>
 #include <mutex>
+#include <future>
+#include <algorithm>
+#include <filesystem>
 
 namespace nx_agent {
 
@@ -47,14 +60,41 @@ nx::sdk::Result<nx::sdk::analytics::IEngine*> NxAgentPlugin::doCreateEngine() {
 
 // Engine Implementation
 NxAgentEngine::NxAgentEngine(NxAgentPlugin* plugin):
-    nx::sdk::analytics::Engine(plugin)
+    nx::sdk::analytics::Engine(plugin),
+    m_executor(std::make_shared<TaskExecutor>())
 {
-    Logger::info("NxAgentEngine", "Initializing engine");
+    const GlobalConfig& config = GlobalConfig::instance();
+    m_httpDispatcher = std::make_shared<HttpDispatcher>(httpDispatcherOptions(config));
+    if (config.incidentWindowSecs > 0) {
+        m_incidentCorrelator = std::make_shared<IncidentCorrelator>(
+            static_cast<int64_t>(config.incidentWindowSecs) * 1000000,
+            static_cast<int64_t>(config.incidentMaxDurationSecs) * 1000000,
+            static_cast<size_t>(std::max(1, config.incidentMaxOpen)),
+            static_cast<int64_t>(std::max(0, config.incidentHoldMs)) * 1000);
+    }
+    m_detectionBatcher = std::make_shared<DetectionBatcher>(
+        createDetectorBackend(config),
+        static_cast<size_t>(std::max(1, config.detectorMaxBatchSize)),
+        std::chrono::milliseconds(std::max(0, config.detectorMaxLatencyMs)));
+    
+    // Publish the metrics registry for scraping (node_exporter textfile format)
+    if (config.metricsIntervalSecs > 0) {
+        std::string metricsFile = config.metricsFilePath;
+        if (metricsFile.empty() && !config.dataStoragePath.empty()) {
+            metricsFile = (std::filesystem::path(config.dataStoragePath) / "metrics.prom").string();
+        }
+        MetricsRegistry::instance().startExporter(metricsFile, config.metricsIntervalSecs);
+    }
+    
+    Logger::info("NxAgentEngine", "Initializing engine with " +
+                 std::to_string(m_executor->workerCount()) + " executor threads");
 }
 
 NxAgentEngine::~NxAgentEngine() {
     Logger::info("NxAgentEngine", "Destroying engine");
     
+    MetricsRegistry::instance().stopExporter();
+    
     // Clean up any remaining device agents
     std::lock_guard<std::mutex> lock(m_engineMutex);
     for (auto& pair : m_deviceAgents) {
@@ -62,6 +102,29 @@ NxAgentEngine::~NxAgentEngine() {
         pair.second = nullptr;
     }
     m_deviceAgents.clear();
+    
+    ExecutorStats stats = m_executor->stats();
+    Logger::info("NxAgentEngine", "Executor: executed " + std::to_string(stats.executed) +
+                 " tasks, steal rate " + std::to_string(stats.stealRate) +
+                 ", avg latency " + std::to_string(stats.avgLatencyUs) + " us, max latency " +
+                 std::to_string(stats.maxLatencyUs) + " us");
+    
+    DetectionBatcherStats detectorStats = m_detectionBatcher->stats();
+    Logger::info("NxAgentEngine", "Detector: " + std::to_string(detectorStats.frames) + " frames in " +
+                 std::to_string(detectorStats.batches) + " batches, avg batch " +
+                 std::to_string(detectorStats.avgBatchSize) + ", max batch " +
+                 std::to_string(detectorStats.maxBatchSize) + ", avg wait " +
+                 std::to_string(detectorStats.avgWaitUs) + " us");
+    
+    if (m_incidentCorrelator) {
+        IncidentStats incidentStats = m_incidentCorrelator->stats();
+        Logger::info("NxAgentEngine", "Incidents: " + std::to_string(incidentStats.opened) + " opened, " +
+                     std::to_string(incidentStats.merged) + " responses merged, " +
+                     std::to_string(incidentStats.evicted) + " evicted");
+    }
+    
+    // Deliver queued webhooks before the engine goes away
+    m_httpDispatcher->stop();
 }
 
 std::string NxAgentEngine::manifestString() const {
@@ -131,7 +194,8 @@ nx::sdk::analytics::IDeviceAgent* NxAgentEngine::doCreateDeviceAgent(
     Logger::info("NxAgentEngine", "Creating device agent for " + deviceId);
     
     // Create new device agent
-    nx::sdk::analytics::IDeviceAgent* agent = new NxAgentDeviceAgent(deviceInfo);
+    nx::sdk::analytics::IDeviceAgent* agent = new NxAgentDeviceAgent(deviceInfo, m_executor, m_detectionBatcher,
+                                                                  m_httpDispatcher, m_incidentCorrelator);
     
     // Track it in our map
     {
@@ -143,20 +207,42 @@ nx::sdk::analytics::IDeviceAgent* NxAgentEngine::doCreateDeviceAgent(
 }
 
 // DeviceAgent Implementation
-NxAgentDeviceAgent::NxAgentDeviceAgent(const nx::sdk::IDeviceInfo* deviceInfo):
+NxAgentDeviceAgent::NxAgentDeviceAgent(const nx::sdk::IDeviceInfo* deviceInfo,
+                                       std::shared_ptr<TaskExecutor> executor,
+                                       std::shared_ptr<DetectionBatcher> detectionBatcher,
+                                       std::shared_ptr<HttpDispatcher> httpDispatcher,
+                                       std::shared_ptr<IncidentCorrelator> incidentCorrelator):
     nx::sdk::analytics::VideoFrameProcessingDeviceAgent(deviceInfo),
     m_deviceId(deviceInfo->id()),
     m_initialized(false),
-    m_isLearningMode(true),
-    m_learningFrameCount(0),
-    m_lastAnomalyTimeUs(0),
-    m_processedFrameCount(0),
-    m_anomalyCount(0)
+    m_executor(std::move(executor)),
+    m_detectionBatcher(std::move(detectionBatcher)),
+    m_lastAnomalyTimeUs(0)
 {
     Logger::info("NxAgentDeviceAgent", "Initializing device agent for " + m_deviceId);
     
+    MetricsRegistry& metrics = MetricsRegistry::instance();
+    m_receivedFrames = metrics.counter("nx_agent_frames_received_total", m_deviceId);
+    m_processedFrames = metrics.counter("nx_agent_frames_processed_total", m_deviceId);
+    m_skippedFrames = metrics.counter("nx_agent_frames_skipped_total", m_deviceId);
+    m_anomalies = metrics.counter("nx_agent_anomalies_total", m_deviceId);
+    m_learningModeGauge = metrics.gauge("nx_agent_learning_mode", m_deviceId);
+    m_convertLatency = metrics.histogram("nx_agent_stage_latency_us", m_deviceId, "convert");
+    m_scoringLatency = metrics.histogram("nx_agent_stage_latency_us", m_deviceId, "scoring");
+    m_responseLatency = metrics.histogram("nx_agent_stage_latency_us", m_deviceId, "response");
+    m_frameLatency = metrics.histogram("nx_agent_frame_latency_us", m_deviceId);
+    
     // Load configuration for this device
     m_config = GlobalConfig::instance().getDeviceConfig(m_deviceId);
+    m_analysisMode = parseAnalysisMode(m_config->analysisMode);
+    if (m_analysisMode != AnalysisMode::Decoded) {
+        Logger::info("NxAgentDeviceAgent", "Analyzing " + m_deviceId + " without decoding (" +
+                     m_config->analysisMode + " mode)");
+    }
+    
+    // Frame copies and masks in flight are bounded by the queue plus one per stage
+    m_framePool = std::make_shared<FramePool>(
+        m_deviceId, static_cast<size_t>(std::max(1, m_config->pipelineQueueCapacity)) + 8);
     
     // Initialize processing components
     m_metadataAnalyzer = std::make_unique<MetadataAnalyzer>(m_deviceId);
@@ -167,32 +253,106 @@ NxAgentDeviceAgent::NxAgentDeviceAgent(const nx::sdk::IDeviceInfo* deviceInfo):
     m_metadataAnalyzer->configure(m_config);
     m_anomalyDetector->configure(m_config);
     m_responseProtocol->configure(m_config);
+    m_metadataAnalyzer->setFramePool(m_framePool);
+    
+    // Object attributes are typed by the manifest the server is given
+    auto attributeSchema = std::make_shared<const AttributeSchema>(
+        AttributeSchema::fromManifest(manifestString()));
+    m_metadataAnalyzer->setAttributeSchema(attributeSchema);
+    m_objectWriter = std::make_unique<ObjectMetadataWriter>(attributeSchema);
+    
+    // Analyze every frame while the scene is busy, sample slowly otherwise
+    m_scheduler = std::make_unique<FrameScheduler>();
+    configureScheduler();
+    
+    // Response dispatch shares the engine's workers and webhook connections
+    if (m_executor) {
+        m_responseProtocol->setExecutor(m_executor);
+    }
+    if (httpDispatcher) {
+        m_responseProtocol->setHttpDispatcher(std::move(httpDispatcher));
+    }
+    if (incidentCorrelator) {
+        m_responseProtocol->setIncidentCorrelator(std::move(incidentCorrelator));
+    }
     
     // Check if we're in learning mode
-    // Try to load existing models - if none found, start in learning mode
-    m_isLearningMode = !m_anomalyDetector->loadModel();
+    // The detector loads its models on construction - if none found, start in learning mode
+    m_baseline = std::make_unique<BaselineLearner>();
+    m_baseline->setLearning(!m_anomalyDetector->hasTrainedModels());
+    m_learningModeGauge->set(m_baseline->isLearning() ? 1 : 0);
     
     // Set up response protocol to use our event generation
     m_responseProtocol->setNxEventCallback([this](const FrameAnalysisResult& result) {
         generateAnomalyEvent(result);
     });
     
+    // Run analysis off the SDK delivery thread unless configured otherwise
+    if (m_config->enableAsyncPipeline) {
+        m_pipeline = std::make_unique<AnalysisPipeline>(
+            m_deviceId,
+            static_cast<size_t>(std::max(1, m_config->pipelineQueueCapacity)),
+            parseFrameDropPolicy(m_config->frameDropPolicy),
+            m_executor);
+        
+        m_pipeline->addStage("motion", [this](PipelineJob& job) { return runMotionStage(job); });
+        m_pipeline->addAsyncStage("detect", [this](PipelineJob& job, AnalysisPipeline::Done done) {
+            runDetectStage(job, std::move(done));
+        });
+        m_pipeline->addStage("analysis", [this](PipelineJob& job) { return runAnalysisStage(job); });
+        m_pipeline->addStage("report", [this](PipelineJob& job) { return runReportStage(job); });
+        m_pipeline->start();
+    }
+    
     Logger::info("NxAgentDeviceAgent", "Device agent initialized in " + 
-                 std::string(m_isLearningMode ? "learning" : "detection") + " mode");
+                 std::string(m_baseline->isLearning() ? "learning" : "detection") + " mode");
 }
 
 NxAgentDeviceAgent::~NxAgentDeviceAgent() {
     Logger::info("NxAgentDeviceAgent", "Destroying device agent for " + m_deviceId);
     
-    // Save the anomaly detection model when shutting down
-    if (m_anomalyDetector) {
-        m_anomalyDetector->saveModel();
+    // Stop the pipeline before tearing down the components its stages use
+    if (m_pipeline) {
+        m_pipeline->stop();
+        
+        PipelineStats stats = m_pipeline->stats();
+        Logger::info("NxAgentDeviceAgent", "Pipeline: submitted " +
+                     std::to_string(stats.submitted) + " frames, dropped " +
+                     std::to_string(stats.dropped));
     }
     
     // Log statistics
+    HistogramSnapshot frameLatency = m_frameLatency->snapshot();
     Logger::info("NxAgentDeviceAgent", "Statistics: Processed " + 
-                 std::to_string(m_processedFrameCount) + " frames, detected " +
-                 std::to_string(m_anomalyCount) + " anomalies");
+                 std::to_string(m_processedFrames->value()) + " frames (" +
+                 std::to_string(m_skippedFrames->value()) + " skipped while idle), detected " +
+                 std::to_string(m_anomalies->value()) + " anomalies, frame latency p50 " +
+                 std::to_string(frameLatency.percentile(0.5)) + " us, p99 " +
+                 std::to_string(frameLatency.percentile(0.99)) + " us");
+    
+    FramePoolStats poolStats = m_framePool->stats();
+    Logger::info("NxAgentDeviceAgent", "Frame pool: " + std::to_string(poolStats.hits) + " hits, " +
+                 std::to_string(poolStats.misses) + " misses, " +
+                 std::to_string(poolStats.buffers) + " buffers (" +
+                 std::to_string(poolStats.bytes / 1024) + " KiB)");
+    
+    MetricsRegistry::instance().removeDevice(m_deviceId);
+}
+
+void NxAgentDeviceAgent::configureScheduler() {
+    m_scheduler->configure(*std::atomic_load(&m_config));
+}
+
+PipelineStats NxAgentDeviceAgent::pipelineStats() const {
+    return m_pipeline ? m_pipeline->stats() : PipelineStats();
+}
+
+bool NxAgentDeviceAgent::needUncompressedVideoFrame() const {
+    return m_analysisMode == AnalysisMode::Decoded;
+}
+
+bool NxAgentDeviceAgent::needCompressedVideoFrame() const {
+    return m_analysisMode != AnalysisMode::Decoded;
 }
 
 std::string NxAgentDeviceAgent::manifestString() const {
@@ -347,6 +507,18 @@ std::string NxAgentDeviceAgent::manifestString() const {
                 "type": "int",
                 "defaultValue": 64800,
                 "description": "Business hours end time (seconds from midnight, default 6:00 PM)"
+            },
+            {
+                "name": "analysisMode",
+                "type": "ComboBox",
+                "defaultValue": "decoded",
+                "range": ["decoded", "compressed", "metadataOnly"],
+                "itemCaptions": {
+                    "decoded": "Decoded frames (full motion analysis)",
+                    "compressed": "Compressed packets (no server-side decode)",
+                    "metadataOnly": "Camera metadata only"
+                },
+                "description": "How frames are analyzed; the lighter modes trade motion detail for server load. Takes effect when analytics are re-enabled for the camera"
             }
         ]
     }
@@ -367,42 +539,44 @@ nx::sdk::Result<void> NxAgentDeviceAgent::doSetupAnalytics(
         if (setupAnalyticsModel.deviceAgent) {
             auto settingsResponse = setupAnalyticsModel.deviceAgent->settings();
             if (settingsResponse) {
-                parseSettings(settingsResponse.get(), m_config);
+                // Build the new settings as one snapshot so frame threads see
+                // either the old or the new ones, never a mix
+                std::shared_ptr<const DeviceConfig> previous = std::atomic_load(&m_config);
+                std::shared_ptr<const DeviceConfig> config = GlobalConfig::instance().modifyDeviceConfig(
+                    m_deviceId, [&](DeviceConfig& edited) {
+                        parseSettings(settingsResponse.get(), edited);
+                        
+                        // Business hours settings
+                        if (!edited.businessHours.empty()) {
+                            DeviceConfig::TimeRange& hours = edited.businessHours[0];
+                            hours.startTime = settingsResponse->getInt("businessHoursStart", hours.startTime);
+                            hours.endTime = settingsResponse->getInt("businessHoursEnd", hours.endTime);
+                        }
+                    });
+                std::atomic_store(&m_config, config);
                 
                 // Update components with new settings
-                m_metadataAnalyzer->configure(m_config);
-                m_anomalyDetector->configure(m_config);
-                m_responseProtocol->configure(m_config);
-                
-                // Check learning mode setting
-                bool enableLearning = settingsResponse->getBool("enableLearning", m_config->enableLearning);
-                if (enableLearning != m_config->enableLearning) {
-                    m_config->enableLearning = enableLearning;
-                    GlobalConfig::instance().updateDeviceConfig(m_config);
+                m_metadataAnalyzer->configure(config);
+                m_anomalyDetector->configure(config);
+                m_responseProtocol->configure(config);
+                configureScheduler();
+                if (parseAnalysisMode(config->analysisMode) != parseAnalysisMode(previous->analysisMode)) {
+                    Logger::warning("NxAgentDeviceAgent", "Analysis mode for " + m_deviceId + " changed to " +
+                                    config->analysisMode + "; it applies once the device agent is re-created");
                 }
                 
                 // If learning is being turned off and we're in learning mode, attempt to finalize learning
-                if (!enableLearning && m_isLearningMode) {
-                    if (m_learningFrameCount > 100) { // Minimum frames needed to build a model
-                        Logger::info("NxAgentDeviceAgent", "Learning disabled - finalizing model");
-                        m_isLearningMode = false;
-                        m_anomalyDetector->saveModel();
-                    }
+                if (!config->enableLearning && m_baseline->finishLearning()) {
+                    Logger::info("NxAgentDeviceAgent", "Learning disabled - finalizing model");
+                    m_learningModeGauge->set(0);
+                    m_anomalyDetector->requestSave();
                 }
                 
-                // Update business hours settings
-                int businessStart = settingsResponse->getInt("businessHoursStart", m_config->businessHours[0].startTime);
-                int businessEnd = settingsResponse->getInt("businessHoursEnd", m_config->businessHours[0].endTime);
-                
-                // Update if changed
-                if (businessStart != m_config->businessHours[0].startTime || 
-                    businessEnd != m_config->businessHours[0].endTime) {
-                    
-                    // Update config
-                    m_config->businessHours[0].startTime = businessStart;
-                    m_config->businessHours[0].endTime = businessEnd;
-                    GlobalConfig::instance().updateDeviceConfig(m_config);
-                    
+                if (!config->businessHours.empty() && !previous->businessHours.empty() &&
+                    (config->businessHours[0].startTime != previous->businessHours[0].startTime ||
+                     config->businessHours[0].endTime != previous->businessHours[0].endTime)) {
+                    int businessStart = config->businessHours[0].startTime;
+                    int businessEnd = config->businessHours[0].endTime;
                     Logger::info("NxAgentDeviceAgent", "Updated business hours: " + 
                                  std::to_string(businessStart / 3600) + ":" + 
                                  std::to_string((businessStart % 3600) / 60) + " to " +
@@ -417,10 +591,10 @@ nx::sdk::Result<void> NxAgentDeviceAgent::doSetupAnalytics(
         statusEvent.typeId = "nx.agent.statusEvent";
         statusEvent.caption = "NX Agent Initialized";
         statusEvent.description = "NX Agent has been initialized and is " + 
-                                  std::string(m_isLearningMode ? "learning" : "monitoring");
+                                  std::string(m_baseline->isLearning() ? "learning" : "monitoring");
         
         statusEvent.attributes()->addString("statusType", "Initialization");
-        statusEvent.attributes()->addString("message", m_isLearningMode ? 
+        statusEvent.attributes()->addString("message", m_baseline->isLearning() ? 
                                            "Learning mode active" : "Monitoring mode active");
                                            
         auto eventPacket = nx::sdk::analytics::MetadataPacket::makeEventMetadataPacket(
@@ -452,94 +626,78 @@ nx::sdk::Result<nx::sdk::analytics::DetectionResult> NxAgentDeviceAgent::process
     }
     
     int64_t timestampUs = videoFrame->timestampUs();
-    m_processedFrameCount++;
+    m_receivedFrames->increment();
+    
+    // Quiet scene: skip the frame before paying for any copy or analysis
+    if (!m_scheduler->shouldProcess(timestampUs)) {
+        m_skippedFrames->increment();
+        return nx::sdk::analytics::DetectionResult::success();
+    }
+    m_processedFrames->increment();
     
     try {
-        TIME_SCOPE("ProcessFrame");
+        auto job = std::make_unique<PipelineJob>();
+        job->timestampUs = timestampUs;
+        job->receivedAtUs = metricsClockUs();
+        job->mode = m_analysisMode;
         
-        // Convert Nx frame to OpenCV Mat
-        cv::Mat frame = ImageUtils::nxFrameToMat(
-            dynamic_cast<const nx::sdk::analytics::IUncompressedVideoFrame*>(videoFrame));
-            
-        if (frame.empty()) {
-            Logger::warning("NxAgentDeviceAgent", "Failed to convert frame to OpenCV Mat");
-            return nx::sdk::analytics::DetectionResult::error(
-                nx::sdk::error::InvalidArgument, "Failed to process frame format");
+        ImageUtils::FrameView frame;
+        int width = 0;
+        int height = 0;
+        if (job->mode == AnalysisMode::Decoded) {
+            // Wrap the Nx frame without converting it; motion analysis reads the
+            // luma plane in place and BGR is only built if a detector needs it
+            frame = ImageUtils::FrameView(
+                dynamic_cast<const nx::sdk::analytics::IUncompressedVideoFrame*>(videoFrame));
+                
+            if (frame.empty()) {
+                Logger::warning("NxAgentDeviceAgent", "Failed to wrap frame for analysis");
+                return nx::sdk::analytics::DetectionResult::error(
+                    nx::sdk::error::InvalidArgument, "Failed to process frame format");
+            }
+            width = frame.width();
+            height = frame.height();
+        } else {
+            // Nothing is decoded; only the packet's size and type are kept
+            auto packet = dynamic_cast<const nx::sdk::analytics::ICompressedVideoPacket*>(videoFrame);
+            if (!packet) {
+                Logger::warning("NxAgentDeviceAgent", "Expected a compressed video packet");
+                return nx::sdk::analytics::DetectionResult::error(
+                    nx::sdk::error::InvalidArgument, "Expected a compressed video packet");
+            }
+            job->compressed.width = width = packet->width();
+            job->compressed.height = height = packet->height();
+            job->compressed.sizeBytes = static_cast<size_t>(std::max(0, packet->dataSize()));
+            job->compressed.keyFrame = (static_cast<int>(packet->flags()) &
+                static_cast<int>(nx::sdk::analytics::ICompressedVideoPacket::MediaFlags::keyFrame)) != 0;
         }
         
-        // Process the frame
-        FrameAnalysisResult result = m_metadataAnalyzer->processFrame(
-            frame, timestampUs, request.compressionMetadata());
-        
-        // Always report detected objects regardless of mode
-        reportObjects(result);
+        // The metadata packet only lives for this call, so objects are taken now
+        if (request.compressionMetadata()) {
+            job->hasProvidedObjects = true;
+            job->providedObjects = m_metadataAnalyzer->extractObjectsFromMetadata(
+                request.compressionMetadata(), width, height);
+        }
         
-        // In learning mode, collect baseline data
-        if (m_isLearningMode && m_config->enableLearning) {
-            // Only use every 5th frame for training to avoid too much correlation
-            if (m_learningFrameCount % 5 == 0) {
-                m_anomalyDetector->addToBaseline(result);
+        if (m_pipeline) {
+            // Likewise the frame buffer, so the pipeline gets its own copy
+            if (!frame.empty()) {
+                LatencyTimer timer(m_convertLatency.get());
+                job->frame = frame.clone(m_framePool);
             }
-            
-            m_learningFrameCount++;
-            
-            // After collecting enough frames, switch to detection mode
-            if (m_learningFrameCount >= 1000) { // ~8-12 hours at 1 frame every 30 seconds
-                m_isLearningMode = false;
-                m_anomalyDetector->saveModel();
-                
-                Logger::info("NxAgentDeviceAgent", "Switching from learning to detection mode");
-                
-                // Send a status event to indicate mode change
-                nx::sdk::analytics::EventMetadata statusEvent;
-                statusEvent.typeId = "nx.agent.statusEvent";
-                statusEvent.caption = "Learning Complete";
-                statusEvent.description = "NX Agent has completed learning and is now in monitoring mode";
-                statusEvent.attributes()->addString("statusType", "ModeChange");
-                statusEvent.attributes()->addString("message", "Monitoring mode active");
-                
-                auto eventPacket = nx::sdk::analytics::MetadataPacket::makeEventMetadataPacket(
-                    &statusEvent, timestampUs);
-                pushMetadataPacket(eventPacket.get());
-            }
-            
-            // In learning mode, periodically log progress
-            if (m_learningFrameCount % 100 == 0) {
-                Logger::info("NxAgentDeviceAgent", "Learning progress: " + 
-                             std::to_string(m_learningFrameCount) + " frames collected");
-            }
-            
+            m_pipeline->submit(std::move(job));
         } else {
-            // In detection mode
-            
-            // Apply anomaly detection
-            bool anomalyDetected = m_anomalyDetector->detectAnomaly(result);
-            
-            // Process potential anomaly through response protocol
-            if (anomalyDetected) {
-                bool responded = m_responseProtocol->processAnomaly(result);
+            job->frame = frame;
+            if (runMotionStage(*job)) {
+                // Detection may still be batched with other devices; wait for it
+                std::promise<void> detected;
+                runDetectStage(*job, [&detected](bool) { detected.set_value(); });
+                detected.get_future().wait();
                 
-                if (responded) {
-                    m_anomalyCount++;
-                    Logger::info("NxAgentDeviceAgent", "Anomaly detected and response triggered: " + 
-                                 result.anomalyType + " (Score: " + std::to_string(result.anomalyScore) + ")");
-                }
-            }
-            
-            // Still collect data for continuous learning if enabled
-            if (m_config->enableLearning && m_learningFrameCount % 20 == 0) {
-                // Only add frames that are not anomalous to the baseline
-                if (!result.isAnomaly) {
-                    m_anomalyDetector->addToBaseline(result);
+                if (runAnalysisStage(*job)) {
+                    runReportStage(*job);
                 }
             }
-            
-            m_learningFrameCount++;
-            
-            // Periodically save model to persist learning
-            if (m_config->enableLearning && m_learningFrameCount % 500 == 0) {
-                m_anomalyDetector->saveModel();
-            }
         }
         
         return nx::sdk::analytics::DetectionResult::success();
@@ -551,6 +709,160 @@ nx::sdk::Result<nx::sdk::analytics::DetectionResult> NxAgentDeviceAgent::process
     }
 }
 
+bool NxAgentDeviceAgent::runMotionStage(PipelineJob& job) {
+    switch (job.mode) {
+        case AnalysisMode::Decoded:
+            job.result = m_metadataAnalyzer->analyzeMotion(job.frame, job.timestampUs);
+            break;
+        case AnalysisMode::Compressed:
+            job.result = m_metadataAnalyzer->analyzeCompressedMotion(job.compressed, job.timestampUs);
+            break;
+        case AnalysisMode::MetadataOnly:
+            job.result.timestampUs = job.timestampUs;
+            job.result.frameWidth = job.compressed.width;
+            job.result.frameHeight = job.compressed.height;
+            break;
+    }
+    return true;
+}
+
+void NxAgentDeviceAgent::runDetectStage(PipelineJob& job, std::function<void(bool)> done) {
+    // Without a decoded frame the camera's metadata is all there is
+    if (job.hasProvidedObjects || job.frame.empty()) {
+        job.result.objects = std::move(job.providedObjects);
+        done(true);
+        return;
+    }
+    
+    if (!m_detectionBatcher) {
+        job.result.objects = m_metadataAnalyzer->detectObjects(job.frame);
+        done(true);
+        return;
+    }
+    
+    // A failed batch leaves the frame without objects; motion still counts
+    PipelineJob* pending = &job;
+    m_detectionBatcher->submit(m_deviceId, job.frame,
+        [pending, done = std::move(done)](std::vector<DetectedObject> objects, bool) {
+            pending->result.objects = std::move(objects);
+            done(true);
+        });
+}
+
+bool NxAgentDeviceAgent::runAnalysisStage(PipelineJob& job) {
+    LatencyTimer timer(m_scoringLatency.get());
+    FrameAnalysisResult& result = job.result;
+    int64_t timestampUs = job.timestampUs;
+    
+    if (job.mode == AnalysisMode::MetadataOnly) {
+        m_metadataAnalyzer->analyzeMetadataObjects(result);
+    } else {
+        m_metadataAnalyzer->analyzeObjects(result);
+    }
+    
+    // Keep the scheduler at full rate while something is happening
+    bool sceneActive = !result.objects.empty() ||
+                       result.motionInfo.overallMotionLevel > m_metadataAnalyzer->motionThreshold();
+    m_scheduler->reportActivity(timestampUs, sceneActive);
+    
+    // Learn or score; the response is handled by the report stage. Updated
+    // models are written periodically by the persistence service.
+    BaselineStep step = m_baseline->process(*m_anomalyDetector, result, timestampUs,
+                                            *std::atomic_load(&m_config));
+    job.anomalyDetected = step.anomaly;
+    
+    if (step.learningComplete) {
+        m_learningModeGauge->set(0);
+        m_anomalyDetector->requestSave();
+        
+        Logger::info("NxAgentDeviceAgent", "Switching from learning to detection mode");
+        
+        // Send a status event to indicate mode change
+        nx::sdk::analytics::EventMetadata statusEvent;
+        statusEvent.typeId = "nx.agent.statusEvent";
+        statusEvent.caption = "Learning Complete";
+        statusEvent.description = "NX Agent has completed learning and is now in monitoring mode";
+        statusEvent.attributes()->addString("statusType", "ModeChange");
+        statusEvent.attributes()->addString("message", "Monitoring mode active");
+        
+        auto eventPacket = nx::sdk::analytics::MetadataPacket::makeEventMetadataPacket(
+            &statusEvent, timestampUs);
+        pushMetadataPacket(eventPacket.get());
+    }
+    
+    // In learning mode, periodically log progress
+    if (step.sampled && !step.scored && m_baseline->sampleCount() % 20 == 0) {
+        Logger::info("NxAgentDeviceAgent", "Learning progress: " + 
+                     std::to_string(m_baseline->sampleCount()) + " samples collected");
+    }
+    
+    return true;
+}
+
+bool NxAgentDeviceAgent::runReportStage(PipelineJob& job) {
+    const FrameAnalysisResult& result = job.result;
+    
+    // Always report detected objects regardless of mode
+    reportObjects(result);
+    
+    // Process potential anomaly through response protocol
+    if (job.anomalyDetected) {
+        LatencyTimer timer(m_responseLatency.get());
+        bool responded = m_responseProtocol->processAnomaly(result);
+        
+        if (responded) {
+            m_anomalies->increment();
+            Logger::info("NxAgentDeviceAgent", "Anomaly detected and response triggered: " + 
+                         result.anomalyType + " (Score: " + std::to_string(result.anomalyScore) + ")");
+        }
+    }
+    
+    m_frameLatency->record(static_cast<uint64_t>(std::max<int64_t>(0, metricsClockUs() - job.receivedAtUs)));
+    
+    // Periodic status event; timed on frame timestamps so replays behave the same
+    int64_t intervalUs = static_cast<int64_t>(GlobalConfig::instance().metricsIntervalSecs) * 1000000;
+    if (intervalUs > 0) {
+        if (m_lastMetricsEventUs == 0 || job.timestampUs < m_lastMetricsEventUs) {
+            m_lastMetricsEventUs = job.timestampUs;
+        } else if (job.timestampUs - m_lastMetricsEventUs >= intervalUs) {
+            m_lastMetricsEventUs = job.timestampUs;
+            publishMetrics(job.timestampUs);
+        }
+    }
+    
+    return true;
+}
+
+void NxAgentDeviceAgent::publishMetrics(int64_t timestampUs) {
+    try {
+        HistogramSnapshot frameLatency = m_frameLatency->snapshot();
+        HistogramSnapshot scoringLatency = m_scoringLatency->snapshot();
+        
+        std::ostringstream message;
+        message << "received=" << m_receivedFrames->value()
+                << " frames=" << m_processedFrames->value()
+                << " skipped=" << m_skippedFrames->value()
+                << " anomalies=" << m_anomalies->value()
+                << " latencyP50Us=" << frameLatency.percentile(0.5)
+                << " latencyP99Us=" << frameLatency.percentile(0.99)
+                << " latencyMaxUs=" << frameLatency.max
+                << " scoringP99Us=" << scoringLatency.percentile(0.99);
+        
+        nx::sdk::analytics::EventMetadata statusEvent;
+        statusEvent.typeId = "nx.agent.statusEvent";
+        statusEvent.caption = "NX Agent Metrics";
+        statusEvent.description = "Frame latency p99 " + std::to_string(frameLatency.percentile(0.99)) + " us";
+        statusEvent.attributes()->addString("statusType", "Metrics");
+        statusEvent.attributes()->addString("message", message.str());
+        
+        auto eventPacket = nx::sdk::analytics::MetadataPacket::makeEventMetadataPacket(
+            &statusEvent, timestampUs);
+        pushMetadataPacket(eventPacket.get());
+    } catch (const std::exception& e) {
+        Logger::error("NxAgentDeviceAgent", "Error publishing metrics: " + std::string(e.what()));
+    }
+}
+
 void NxAgentDeviceAgent::generateAnomalyEvent(const FrameAnalysisResult& result) {
     try {
         nx::sdk::analytics::EventMetadata event;
@@ -598,12 +910,8 @@ void NxAgentDeviceAgent::reportObjects(const FrameAnalysisResult& result) {
     try {
         // Convert detected objects to Nx metadata packets
         if (!result.objects.empty()) {
-            std::vector<nx::sdk::analytics::ObjectMetadata> nxObjects;
-            nxObjects.reserve(result.objects.size());
-            
-            for (const auto& obj : result.objects) {
-                nxObjects.push_back(obj.toNxObjectMetadata());
-            }
+            m_objectWriter->setChangesOnly(std::atomic_load(&m_config)->sendAttributeChangesOnly);
+            const auto& nxObjects = m_objectWriter->write(result.objects, result.timestampUs);
             
             // Create and push the metadata packet
             auto packet = nx::sdk::analytics::MetadataPacket::makeObjectMetadataPacket(
@@ -60,18 +60,13 @@ protected:
         if (setupAnalyticsModel.deviceAgent) {
             auto settingsResponse = setupAnalyticsModel.deviceAgent->settings();
             if (settingsResponse) {
-                parseSettings(settingsResponse.get(), m_config);
+                m_config = GlobalConfig::instance().modifyDeviceConfig(m_deviceId, [&](DeviceConfig& edited) {
+                    parseSettings(settingsResponse.get(), edited);
+                });
                 
                 // Update components with new settings
                 m_metadataAnalyzer.configure(m_config);
                 m_anomalyDetector.configure(m_config);
-                
-                // Check learning mode setting
-                bool enableLearning = settingsResponse->getBool("enableLearning", m_config->enableLearning);
-                if (enableLearning != m_config->enableLearning) {
-                    m_config->enableLearning = enableLearning;
-                    GlobalConfig::instance().updateDeviceConfig(m_config);
-                }
             }
         }
         
@@ -155,7 +150,7 @@ protected:
 private:
     // Device information
     std::string m_deviceId;
-    std::shared_ptr<DeviceConfig> m_config;
+    std::shared_ptr<const DeviceConfig> m_config;
     
     // Processing components
     MetadataAnalyzer m_metadataAnalyzer;
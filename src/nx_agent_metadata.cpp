@@ -1,17 +1,21 @@
 // nx_agent_metadata.cpp
 #include "nx_agent_metadata.h"
 #include "nx_agent_config.h"
+#include "nx_agent_detector.h"
+#include "nx_agent_framepool.h"
+#include "nx_agent_objectmeta.h"
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
 #include <ctime>
 
 namespace nx_agent {
 
 // DetectedObject methods
-nx::sdk::analytics::ObjectMetadata DetectedObject::toNxObjectMetadata() const {
+nx::sdk::analytics::ObjectMetadata DetectedObject::toNxObjectMetadata(const AttributeSchema* schema) const {
     nx::sdk::analytics::ObjectMetadata obj;
-    obj.typeId = typeId;
+    obj.typeId = typeId.id();
     obj.trackId = trackId;
     
     // Set bounding box using Nx SDK format
@@ -25,44 +29,91 @@ nx::sdk::analytics::ObjectMetadata DetectedObject::toNxObjectMetadata() const {
     // Add confidence as an attribute
     obj.attributes()->addFloat("confidence", confidence);
     
-    // Add other attributes
-    for (const auto& attr : attributes) {
-        // Determine type and add accordingly
-        // This is a simple approach - you might need more sophisticated type detection
-        try {
-            float val = std::stof(attr.second);
-            obj.attributes()->addFloat(attr.first, val);
-        } catch (std::invalid_argument&) {
-            // Not a float, add as string
-            obj.attributes()->addString(attr.first, attr.second);
-        }
+    // Add other attributes, typed by the schema when there is one
+    for (size_t i = 0; i < attributes.size(); ++i) {
+        const auto& attr = attributes.at(i);
+        AttributeType type = schema ? schema->type(typeId.id(), attr.key) : AttributeType::Unknown;
+        addNxAttribute(obj, attr.name(), attr.value, type);
     }
     
     return obj;
 }
 
+// FrameSummary methods
+FrameSummary FrameSummary::fromObjects(const std::vector<DetectedObject>& objects, int64_t timestampUs) {
+    FrameSummary summary;
+    summary.valid = true;
+    
+    int tracked = 0;
+    float speedSum = 0.0f;
+    
+    for (const auto& obj : objects) {
+        switch (obj.typeId.objectClass()) {
+            case ObjectClass::Person:
+                summary.personCount++;
+                if (obj.isUnknownPerson()) {
+                    summary.unknownPersonCount++;
+                    summary.maxUnknownPersonDwellSecs = std::max(summary.maxUnknownPersonDwellSecs, obj.dwellSecs);
+                }
+                break;
+            case ObjectClass::Vehicle:
+                summary.vehicleCount++;
+                break;
+            default:
+                summary.otherCount++;
+                break;
+        }
+        
+        if (obj.trackNumber != 0) {
+            tracked++;
+            speedSum += std::sqrt(obj.velocity.x * obj.velocity.x + obj.velocity.y * obj.velocity.y);
+            summary.maxDwellSecs = std::max(summary.maxDwellSecs, obj.dwellSecs);
+            summary.maxZoneDwellSecs = std::max(summary.maxZoneDwellSecs, obj.zoneDwellSecs);
+        }
+    }
+    summary.meanSpeed = tracked > 0 ? speedSum / tracked : 0.0f;
+    
+    TimeUtils::LocalTime local = TimeUtils::getLocalTime(timestampUs);
+    summary.timeOfDaySeconds = local.timeOfDaySeconds;
+    summary.hourOfDay = local.hour;
+    summary.dayOfWeek = local.dayOfWeek;
+    
+    return summary;
+}
+
 // MetadataAnalyzer implementation
 MetadataAnalyzer::MetadataAnalyzer(const std::string& deviceId) 
     : m_deviceId(deviceId),
-      m_motionThreshold(0.03f)
+      m_detector(std::make_shared<SimulatedDetectorBackend>()),
+      m_motionThreshold(0.03f),
+      m_mog2Latency(MetricsRegistry::instance().histogram("nx_agent_stage_latency_us", deviceId, "mog2")),
+      m_fastMotionLatency(MetricsRegistry::instance().histogram("nx_agent_stage_latency_us", deviceId, "motion_fast")),
+      m_contoursLatency(MetricsRegistry::instance().histogram("nx_agent_stage_latency_us", deviceId, "contours"))
 {
     // Initialize background subtractor for motion detection
     m_bgSubtractor = cv::createBackgroundSubtractorMOG2(500, 16, false);
     
     // Load configuration for this device
     m_config = GlobalConfig::instance().getDeviceConfig(deviceId);
+    m_motionEngine = parseMotionEngine(m_config->motionEngine);
 }
 
 MetadataAnalyzer::~MetadataAnalyzer() {
     // Clean up resources if needed
 }
 
-void MetadataAnalyzer::configure(std::shared_ptr<DeviceConfig> config) {
-    m_config = config;
+void MetadataAnalyzer::configure(std::shared_ptr<const DeviceConfig> config) {
+    // Published snapshots carry compiled regions; compile any other once here
+    if (!config->regionIndex) {
+        config = DeviceConfig::freeze(*config);
+    }
     
     // Update internal parameters based on config
     // For example, adjust motion threshold based on sensitivity
-    m_motionThreshold = 0.01f + (1.0f - m_config->anomalyThreshold) * 0.1f;
+    m_motionThreshold = 0.01f + (1.0f - config->anomalyThreshold) * 0.1f;
+    m_motionEngine = parseMotionEngine(config->motionEngine);
+    
+    std::atomic_store(&m_config, std::move(config));
 }
 
 FrameAnalysisResult MetadataAnalyzer::processFrame(
@@ -70,20 +121,50 @@ FrameAnalysisResult MetadataAnalyzer::processFrame(
     int64_t timestampUs,
     const nx::sdk::analytics::IMetadataPacket* existingMetadata)
 {
-    FrameAnalysisResult result;
-    result.timestampUs = timestampUs;
-    
-    // Detect motion in the frame
-    result.motionInfo = detectMotion(frame);
+    return processFrame(ImageUtils::FrameView(frame), timestampUs, existingMetadata);
+}
+
+FrameAnalysisResult MetadataAnalyzer::processFrame(
+    const ImageUtils::FrameView& frame,
+    int64_t timestampUs,
+    const nx::sdk::analytics::IMetadataPacket* existingMetadata)
+{
+    FrameAnalysisResult result = analyzeMotion(frame, timestampUs);
     
     // If existing metadata is provided, extract objects from it
     if (existingMetadata) {
-        result.objects = extractObjectsFromMetadata(existingMetadata, frame.cols, frame.rows);
+        result.objects = extractObjectsFromMetadata(existingMetadata, frame.width(), frame.height());
     } else {
         // Otherwise, run our own object detection
         result.objects = detectObjects(frame);
     }
     
+    analyzeObjects(result);
+    return result;
+}
+
+FrameAnalysisResult MetadataAnalyzer::analyzeMotion(
+    const ImageUtils::FrameView& frame,
+    int64_t timestampUs)
+{
+    FrameAnalysisResult result;
+    result.timestampUs = timestampUs;
+    result.frameWidth = frame.width();
+    result.frameHeight = frame.height();
+    
+    // Detect motion on the luma plane
+    result.motionInfo = detectMotion(frame.luma(), *std::atomic_load(&m_config));
+    
+    return result;
+}
+
+void MetadataAnalyzer::analyzeObjects(FrameAnalysisResult& result) {
+    auto config = std::atomic_load(&m_config);
+    trackObjects(result, *config);
+    
+    // Count objects and resolve the local time once for every consumer below
+    summarize(result, *config);
+    
     // Analyze scene activity (people count, motion patterns, etc.)
     analyzeSceneActivity(result);
     
@@ -91,11 +172,11 @@ FrameAnalysisResult MetadataAnalyzer::processFrame(
     result.anomalyScore = calculateAnomalyScore(result);
     
     // Detect specific anomaly types
-    bool unknownVisitorAnomaly = detectUnknownVisitors(result);
-    bool activityAnomaly = detectAnomalousActivity(result);
+    bool unknownVisitorAnomaly = detectUnknownVisitors(result, *config);
+    bool activityAnomaly = detectAnomalousActivity(result, *config);
     
     // Determine if there's an anomaly and what type
-    result.isAnomaly = unknownVisitorAnomaly || activityAnomaly || result.anomalyScore > m_config->anomalyThreshold;
+    result.isAnomaly = unknownVisitorAnomaly || activityAnomaly || result.anomalyScore > config->anomalyThreshold;
     
     if (unknownVisitorAnomaly) {
         result.anomalyType = "UnknownVisitor";
@@ -103,33 +184,60 @@ FrameAnalysisResult MetadataAnalyzer::processFrame(
     } else if (activityAnomaly) {
         result.anomalyType = "AbnormalActivity";
         result.anomalyDescription = "Unusual activity pattern detected";
-    } else if (result.anomalyScore > m_config->anomalyThreshold) {
+    } else if (result.anomalyScore > config->anomalyThreshold) {
         result.anomalyType = "GeneralAnomaly";
         result.anomalyDescription = "General unusual activity detected";
     }
+}
+
+FrameAnalysisResult MetadataAnalyzer::analyzeCompressedMotion(
+    const CompressedFrameInfo& frame,
+    int64_t timestampUs)
+{
+    FrameAnalysisResult result;
+    result.timestampUs = timestampUs;
+    result.frameWidth = frame.width;
+    result.frameHeight = frame.height;
+    result.motionInfo.timestampUs = timestampUs;
+    
+    m_packetMotion.setScale(std::atomic_load(&m_config)->compressedMotionScale);
+    result.motionInfo.overallMotionLevel = m_packetMotion.update(frame);
     
     return result;
 }
 
 FrameAnalysisResult MetadataAnalyzer::processMetadata(
     const nx::sdk::analytics::IMetadataPacket* metadata,
-    int64_t timestampUs)
+    int64_t timestampUs,
+    int frameWidth,
+    int frameHeight)
 {
     // Process metadata without a frame
     // This is useful when we only have metadata from another source
     FrameAnalysisResult result;
     result.timestampUs = timestampUs;
     
-    // Default frame size (this would ideally come from device info)
+    // Fallback frame size when the caller does not know the stream's
     const int DEFAULT_WIDTH = 1920;
     const int DEFAULT_HEIGHT = 1080;
     
     // Extract objects from metadata
-    result.objects = extractObjectsFromMetadata(metadata, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+    result.frameWidth = frameWidth > 0 ? frameWidth : DEFAULT_WIDTH;
+    result.frameHeight = frameHeight > 0 ? frameHeight : DEFAULT_HEIGHT;
+    result.objects = extractObjectsFromMetadata(metadata, result.frameWidth, result.frameHeight);
     
     // Set motion info to default values
     result.motionInfo.overallMotionLevel = 0.0f;
     
+    analyzeMetadataObjects(result);
+    return result;
+}
+
+void MetadataAnalyzer::analyzeMetadataObjects(FrameAnalysisResult& result) {
+    auto config = std::atomic_load(&m_config);
+    trackObjects(result, *config);
+    summarize(result, *config);
+    
     // Analyze what we can without a frame
     analyzeSceneActivity(result);
     
@@ -137,182 +245,147 @@ FrameAnalysisResult MetadataAnalyzer::processMetadata(
     result.anomalyScore = calculateAnomalyScore(result);
     
     // Detect specific anomalies based on objects
-    bool unknownVisitorAnomaly = detectUnknownVisitors(result);
+    bool unknownVisitorAnomaly = detectUnknownVisitors(result, *config);
     
     // Determine if there's an anomaly
-    result.isAnomaly = unknownVisitorAnomaly || result.anomalyScore > m_config->anomalyThreshold;
+    result.isAnomaly = unknownVisitorAnomaly || result.anomalyScore > config->anomalyThreshold;
     
     if (unknownVisitorAnomaly) {
         result.anomalyType = "UnknownVisitor";
         result.anomalyDescription = "Unknown visitor detected for extended period";
-    } else if (result.anomalyScore > m_config->anomalyThreshold) {
+    } else if (result.anomalyScore > config->anomalyThreshold) {
         result.anomalyType = "GeneralAnomaly";
         result.anomalyDescription = "Unusual metadata patterns detected";
     }
-    
-    return result;
 }
 
 bool MetadataAnalyzer::isInRegionOfInterest(float x, float y) const {
-    // If no regions defined, the entire frame is considered a region of interest
-    if (m_config->detectionRegions.empty()) {
-        return true;
-    }
-    
-    // Check each region
-    for (const auto& region : m_config->detectionRegions) {
-        if (region.isExclusionZone) {
-            continue; // Skip exclusion zones for now
-        }
-        
-        if (region.points.size() < 3) {
-            continue; // Need at least 3 points for a polygon
-        }
-        
-        // Convert region points to format for cv::pointPolygonTest
-        std::vector<cv::Point2f> contour;
-        for (const auto& point : region.points) {
-            contour.push_back(cv::Point2f(point.first, point.second));
-        }
-        
-        // Check if point is inside the polygon
-        if (cv::pointPolygonTest(contour, cv::Point2f(x, y), false) >= 0) {
-            return true;
-        }
-    }
-    
-    // Check if point is outside any exclusion zones
-    for (const auto& region : m_config->detectionRegions) {
-        if (!region.isExclusionZone) {
-            continue; // Skip inclusion zones
-        }
-        
-        if (region.points.size() < 3) {
-            continue; // Need at least 3 points for a polygon
-        }
-        
-        // Convert region points to format for cv::pointPolygonTest
-        std::vector<cv::Point2f> contour;
-        for (const auto& point : region.points) {
-            contour.push_back(cv::Point2f(point.first, point.second));
-        }
-        
-        // If point is inside an exclusion zone, return false
-        if (cv::pointPolygonTest(contour, cv::Point2f(x, y), false) >= 0) {
-            return false;
-        }
-    }
-    
-    // If no specific regions defined, or point not in any region, 
-    // depend on whether we have exclusion zones
-    bool hasExclusionZones = false;
-    for (const auto& region : m_config->detectionRegions) {
-        if (region.isExclusionZone) {
-            hasExclusionZones = true;
-            break;
-        }
-    }
-    
-    // If we have exclusion zones and the point isn't in any inclusion zone
-    // but also not in any exclusion zone, it's considered of interest.
-    // If we only have inclusion zones and point isn't in any, it's not of interest.
-    return hasExclusionZones;
+    // O(1) lookup in the bitmap compiled with the settings
+    return std::atomic_load(&m_config)->regionIndex->contains(x, y);
 }
 
 // Private methods
-std::vector<DetectedObject> MetadataAnalyzer::detectObjects(const cv::Mat& frame) {
-    // In a real implementation, this would call an object detection model
-    // For now, we'll simulate detections for testing
-    
-    std::vector<DetectedObject> objects;
-    
-    // For demonstration, randomly detect a person or vehicle
-    // In real code, this would be replaced with actual detection logic
-    if (std::rand() % 10 < 3) { // 30% chance to detect an object
-        DetectedObject obj;
-        
-        // 70% chance for person, 30% for vehicle
-        if (std::rand() % 10 < 7) {
-            obj.typeId = "person";
-            obj.confidence = 0.7f + (std::rand() % 300) / 1000.0f; // 0.7 - 0.99
-            
-            // Create a person-sized box in a random location
-            int personWidth = frame.cols / 10;
-            int personHeight = frame.rows / 4;
-            int x = std::rand() % (frame.cols - personWidth);
-            int y = std::rand() % (frame.rows - personHeight);
-            
-            obj.boundingBox = cv::Rect(x, y, personWidth, personHeight);
-            
-            // Add attributes
-            obj.attributes["recognitionStatus"] = (std::rand() % 10 < 3) ? "known" : "unknown";
-            
-            // Generate a consistent tracking ID
-            obj.trackId = "person_" + std::to_string(std::rand() % 10);
-        } else {
-            obj.typeId = "vehicle";
-            obj.confidence = 0.75f + (std::rand() % 250) / 1000.0f; // 0.75 - 0.99
-            
-            // Create a vehicle-sized box
-            int vehicleWidth = frame.cols / 5;
-            int vehicleHeight = frame.rows / 6;
-            int x = std::rand() % (frame.cols - vehicleWidth);
-            int y = std::rand() % (frame.rows - vehicleHeight);
-            
-            obj.boundingBox = cv::Rect(x, y, vehicleWidth, vehicleHeight);
-            
-            // Add attributes
-            obj.attributes["vehicleType"] = (std::rand() % 2 == 0) ? "car" : "truck";
-            
-            // Generate a consistent tracking ID
-            obj.trackId = "vehicle_" + std::to_string(std::rand() % 5);
-        }
-        
-        obj.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
-            std::chrono::system_clock::now().time_since_epoch()).count();
-            
-        objects.push_back(obj);
+std::vector<DetectedObject> MetadataAnalyzer::detectObjects(const ImageUtils::FrameView& frame) {
+    auto results = m_detector->detect({&frame});
+    return results.empty() ? std::vector<DetectedObject>() : std::move(results.front());
+}
+
+void MetadataAnalyzer::setDetectorBackend(std::shared_ptr<ObjectDetectorBackend> backend) {
+    if (backend) {
+        m_detector = std::move(backend);
     }
-    
-    return objects;
 }
 
-MotionInfo MetadataAnalyzer::detectMotion(const cv::Mat& frame) {
+void MetadataAnalyzer::setFramePool(std::shared_ptr<FramePool> pool) {
+    m_framePool = std::move(pool);
+}
+
+void MetadataAnalyzer::setAttributeSchema(std::shared_ptr<const AttributeSchema> schema) {
+    m_attributeSchema = std::move(schema);
+}
+
+MotionInfo MetadataAnalyzer::detectMotion(const cv::Mat& luma, const DeviceConfig& config) {
     MotionInfo info;
     info.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
         std::chrono::system_clock::now().time_since_epoch()).count();
     
-    // Convert frame to grayscale if needed
-    cv::Mat gray;
-    if (frame.channels() == 3) {
-        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    info.overallMotionLevel = 0.0f;
+    
+    const std::shared_ptr<const RegionIndex>& regionIndex = config.regionIndex;
+    
+    // Optionally analyze only the bounding box of the regions of interest
+    cv::Rect window(0, 0, luma.cols, luma.rows);
+    if (config.cropMotionToRegions && !regionIndex->coversEverything()) {
+        window = regionIndex->interestBounds(luma.cols, luma.rows);
+        if (window.width <= 0 || window.height <= 0) {
+            return info; // Nothing in the frame is of interest
+        }
+    }
+    cv::Mat source = (window.width == luma.cols && window.height == luma.rows) ? luma : luma(window);
+    
+    // Downscale to the analysis width; MOG2 cost scales with pixel count
+    double scale = 1.0;
+    cv::Mat input = source;
+    if (config.motionAnalysisWidth > 0 && source.cols > config.motionAnalysisWidth) {
+        scale = static_cast<double>(config.motionAnalysisWidth) / source.cols;
+        int height = std::max(1, static_cast<int>(source.rows * scale + 0.5));
+        cv::resize(source, m_motionInput, cv::Size(config.motionAnalysisWidth, height), 0, 0, cv::INTER_AREA);
+        input = m_motionInput;
+    }
+    
+    // The background model is tied to its input size and engine; start
+    // afresh if either changed (the fast engine reseeds itself on a new size)
+    MotionEngine engine = m_motionEngine.load();
+    if (input.cols != m_motionInputWidth || input.rows != m_motionInputHeight ||
+        engine != m_activeMotionEngine) {
+        if (m_motionInputWidth != 0) {
+            m_bgSubtractor = cv::createBackgroundSubtractorMOG2(500, 16, false);
+            m_fastSubtractor.reset();
+        }
+        m_motionInputWidth = input.cols;
+        m_motionInputHeight = input.rows;
+        m_activeMotionEngine = engine;
+    }
+    
+    // Apply background subtraction directly on the (possibly downscaled)
+    // luma plane - the subtractor only reads its input, so no copy is needed
+    if (m_framePool) {
+        // The mask leaves with the result, so it cannot be a member buffer
+        info.motionMask = m_framePool->acquire(input.rows, input.cols, CV_8UC1);
+    }
+    if (engine == MotionEngine::Fast) {
+        LatencyTimer timer(m_fastMotionLatency.get());
+        m_fastSubtractor.setParameters(config.fastMotionThreshold, config.fastMotionAdaptShift);
+        m_fastSubtractor.apply(input, info.motionMask);
     } else {
-        gray = frame.clone();
+        LatencyTimer timer(m_mog2Latency.get());
+        m_bgSubtractor->apply(input, info.motionMask);
     }
     
-    // Apply background subtraction
-    m_bgSubtractor->apply(gray, info.motionMask);
+    // Ignore motion outside the regions of interest
+    int areaPixels = info.motionMask.rows * info.motionMask.cols;
+    if (!regionIndex->coversEverything()) {
+        if (regionIndex != m_motionMaskIndex || window != m_motionMaskWindow ||
+            m_motionRegionMask.rows != info.motionMask.rows ||
+            m_motionRegionMask.cols != info.motionMask.cols) {
+            cv::Rect2f normalizedWindow(
+                static_cast<float>(window.x) / luma.cols,
+                static_cast<float>(window.y) / luma.rows,
+                static_cast<float>(window.width) / luma.cols,
+                static_cast<float>(window.height) / luma.rows);
+            m_motionRegionMask = regionIndex->rasterize(info.motionMask.cols, info.motionMask.rows,
+                                                        normalizedWindow);
+            m_motionRegionArea = cv::countNonZero(m_motionRegionMask);
+            m_motionMaskIndex = regionIndex;
+            m_motionMaskWindow = window;
+        }
+        cv::bitwise_and(info.motionMask, m_motionRegionMask, info.motionMask);
+        areaPixels = m_motionRegionArea;
+    }
     
     // Calculate overall motion level
     info.overallMotionLevel = cv::countNonZero(info.motionMask) / 
-                              static_cast<float>(info.motionMask.rows * info.motionMask.cols);
+                              static_cast<float>(std::max(1, areaPixels));
     
     // Find motion centers (contours)
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(info.motionMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    LatencyTimer contoursTimer(m_contoursLatency.get());
+    cv::findContours(info.motionMask, m_contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    
+    // The size filter is in native pixels, so scale it to the analysis resolution
+    double minContourArea = 100.0 * scale * scale;
     
     // Calculate centers of significant contours
-    for (const auto& contour : contours) {
+    for (const auto& contour : m_contours) {
         // Filter small contours
-        if (cv::contourArea(contour) < 100) {
+        if (cv::contourArea(contour) < minContourArea) {
             continue;
         }
         
-        // Calculate center of mass
+        // Calculate center of mass, mapped back to native frame coordinates
         cv::Moments moments = cv::moments(contour);
         if (moments.m00 != 0) {
-            int cx = static_cast<int>(moments.m10 / moments.m00);
-            int cy = static_cast<int>(moments.m01 / moments.m00);
+            int cx = window.x + static_cast<int>(moments.m10 / moments.m00 / scale);
+            int cy = window.y + static_cast<int>(moments.m01 / moments.m00 / scale);
             info.motionCenters.push_back(cv::Point(cx, cy));
         }
     }
@@ -321,40 +394,14 @@ MotionInfo MetadataAnalyzer::detectMotion(const cv::Mat& frame) {
 }
 
 void MetadataAnalyzer::analyzeSceneActivity(FrameAnalysisResult& result) {
-    // Count people and vehicles
-    int personCount = 0;
-    int vehicleCount = 0;
-    
-    for (const auto& obj : result.objects) {
-        if (obj.typeId == "person") {
-            personCount++;
-        } else if (obj.typeId == "vehicle") {
-            vehicleCount++;
-        }
-    }
-    
-    // Determine current time of day
-    auto now = std::chrono::system_clock::now();
-    std::time_t time = std::chrono::system_clock::to_time_t(now);
-    std::tm* localTime = std::localtime(&time);
-    
-    int currentTimeOfDay = localTime->tm_hour * 3600 + localTime->tm_min * 60 + localTime->tm_sec;
-    
-    // Check if we're in business hours
-    bool duringBusinessHours = false;
-    for (const auto& timeRange : m_config->businessHours) {
-        if (currentTimeOfDay >= timeRange.startTime && currentTimeOfDay <= timeRange.endTime) {
-            duringBusinessHours = true;
-            break;
-        }
-    }
+    const FrameSummary& summary = result.summary;
     
     // In a real implementation, we would analyze the activity more deeply
     // For example, compare current activity to historical patterns for this time of day
     // For now, we'll use simple heuristics for testing
     
     // Example: After hours activity is unusual
-    if (!duringBusinessHours && (personCount > 0 || result.motionInfo.overallMotionLevel > 0.05f)) {
+    if (!summary.duringBusinessHours && (summary.personCount > 0 || result.motionInfo.overallMotionLevel > 0.05f)) {
         // Increase anomaly score based on activity level
         result.anomalyScore += 0.3f + result.motionInfo.overallMotionLevel;
     }
@@ -372,116 +419,59 @@ float MetadataAnalyzer::calculateAnomalyScore(const FrameAnalysisResult& result)
         score += result.motionInfo.overallMotionLevel * 0.5f;
     }
     
-    // Check object counts
-    int personCount = 0;
-    int vehicleCount = 0;
-    int unknownPersonCount = 0;
-    
-    for (const auto& obj : result.objects) {
-        if (obj.typeId == "person") {
-            personCount++;
-            auto it = obj.attributes.find("recognitionStatus");
-            if (it != obj.attributes.end() && it->second == "unknown") {
-                unknownPersonCount++;
-            }
-        } else if (obj.typeId == "vehicle") {
-            vehicleCount++;
-        }
-    }
-    
-    // Determine current time of day
-    auto now = std::chrono::system_clock::now();
-    std::time_t time = std::chrono::system_clock::to_time_t(now);
-    std::tm* localTime = std::localtime(&time);
-    
-    int currentTimeOfDay = localTime->tm_hour * 3600 + localTime->tm_min * 60 + localTime->tm_sec;
-    
-    // Check if we're in business hours
-    bool duringBusinessHours = false;
-    for (const auto& timeRange : m_config->businessHours) {
-        if (currentTimeOfDay >= timeRange.startTime && currentTimeOfDay <= timeRange.endTime) {
-            duringBusinessHours = true;
-            break;
-        }
-    }
+    // Object counts come from the frame summary
+    const FrameSummary& summary = result.summary;
     
     // After hours activity is more suspicious
-    if (!duringBusinessHours) {
-        score += personCount * 0.15f;
-        score += vehicleCount * 0.1f;
+    if (!summary.duringBusinessHours) {
+        score += summary.personCount * 0.15f;
+        score += summary.vehicleCount * 0.1f;
     } else {
         // During business hours, only unknown persons are somewhat unusual
-        score += unknownPersonCount * 0.05f;
+        score += summary.unknownPersonCount * 0.05f;
     }
     
     // Cap the score at 1.0
     return std::min(score, 1.0f);
 }
 
-bool MetadataAnalyzer::detectUnknownVisitors(FrameAnalysisResult& result) {
-    if (!m_config->enableUnknownVisitorDetection) {
+bool MetadataAnalyzer::detectUnknownVisitors(FrameAnalysisResult& result, const DeviceConfig& config) {
+    if (!config.enableUnknownVisitorDetection) {
         return false;
     }
     
     bool anomalyDetected = false;
-    auto now = std::chrono::system_clock::now();
     
-    // Process each person in the current frame
-    for (const auto& obj : result.objects) {
-        if (obj.typeId != "person" || obj.trackId.empty()) {
+    // Dwell times come from the tracker, in frame time, so replayed
+    // archives behave like live video
+    for (auto& obj : result.objects) {
+        if (!obj.isUnknownPerson() || obj.trackNumber == 0) {
             continue;
         }
         
-        // Check if this is an unknown person
-        auto it = obj.attributes.find("recognitionStatus");
-        if (it == obj.attributes.end() || it->second != "unknown") {
-            continue;
-        }
-        
-        // Check if we already have this person in our tracking map
-        auto trackIt = m_unknownVisitorTracks.find(obj.trackId);
-        if (trackIt == m_unknownVisitorTracks.end()) {
-            // New unknown person, start tracking
-            m_unknownVisitorTracks[obj.trackId] = now;
-        } else {
-            // Already tracking this person, check duration
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-                now - trackIt->second).count();
+        // If they've been present longer than the threshold, mark as anomaly
+        int64_t duration = static_cast<int64_t>(obj.dwellSecs);
+        if (duration > config.unknownVisitorThresholdSecs) {
+            anomalyDetected = true;
             
-            // If they've been present longer than the threshold, mark as anomaly
-            if (duration > m_config->unknownVisitorThresholdSecs) {
-                anomalyDetected = true;
-                
-                // Add duration as an attribute to the object
-                result.objects[&obj - &result.objects[0]].attributes["durationSecs"] = 
-                    std::to_string(duration);
-            }
-        }
-    }
-    
-    // Clean up tracking for persons no longer in the frame
-    auto it = m_unknownVisitorTracks.begin();
-    while (it != m_unknownVisitorTracks.end()) {
-        bool found = false;
-        for (const auto& obj : result.objects) {
-            if (obj.trackId == it->first) {
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            it = m_unknownVisitorTracks.erase(it);
-        } else {
-            ++it;
+            // Add duration as an attribute to the object
+            obj.attributes[AttributeKeys::DurationSecs] = std::to_string(duration);
         }
     }
     
     return anomalyDetected;
 }
 
-bool MetadataAnalyzer::detectAnomalousActivity(FrameAnalysisResult& result) {
-    if (!m_config->enableActivityAnalysis) {
+void MetadataAnalyzer::trackObjects(FrameAnalysisResult& result, const DeviceConfig& config) {
+    // Settings are applied here so the tracker is only touched by the analysis thread
+    m_tracker.configure(config.trackIouThreshold, config.trackMaxDistance,
+                        static_cast<int64_t>(config.trackMaxAgeMs) * 1000);
+    m_tracker.update(result.objects, result.timestampUs, *config.regionIndex,
+                     result.frameWidth, result.frameHeight);
+}
+
+bool MetadataAnalyzer::detectAnomalousActivity(FrameAnalysisResult& result, const DeviceConfig& config) {
+    if (!config.enableActivityAnalysis) {
         return false;
     }
     
@@ -495,31 +485,44 @@ bool MetadataAnalyzer::detectAnomalousActivity(FrameAnalysisResult& result) {
     }
     
     // An example of rule-based anomaly:
-    // Detect multiple people moving in a restricted area
+    // If multiple people are outside the regions of interest, that's unusual
+    return result.summary.personsOutsideRegions >= 2;
+}
+
+void MetadataAnalyzer::summarize(FrameAnalysisResult& result) const {
+    summarize(result, *std::atomic_load(&m_config));
+}
+
+void MetadataAnalyzer::summarize(FrameAnalysisResult& result, const DeviceConfig& config) const {
+    FrameSummary summary = FrameSummary::fromObjects(result.objects, result.timestampUs);
     
-    int peopleInRestrictedAreas = 0;
-    for (const auto& obj : result.objects) {
-        if (obj.typeId != "person") {
-            continue;
+    for (const auto& timeRange : config.businessHours) {
+        if (summary.timeOfDaySeconds >= timeRange.startTime && summary.timeOfDaySeconds <= timeRange.endTime) {
+            summary.duringBusinessHours = true;
+            break;
         }
+    }
+    
+    // Object centers against the regions of interest
+    const RegionIndex* regionIndex = config.regionIndex.get();
+    float frameWidth = static_cast<float>(result.frameWidth > 0 ? result.frameWidth : 1920);
+    float frameHeight = static_cast<float>(result.frameHeight > 0 ? result.frameHeight : 1080);
+    
+    for (const auto& obj : result.objects) {
+        float centerX = (obj.boundingBox.x + obj.boundingBox.width / 2.0f) / frameWidth;
+        float centerY = (obj.boundingBox.y + obj.boundingBox.height / 2.0f) / frameHeight;
         
-        // Calculate center point of bounding box
-        float centerX = obj.boundingBox.x + obj.boundingBox.width / 2.0f;
-        float centerY = obj.boundingBox.y + obj.boundingBox.height / 2.0f;
-        
-        // Normalize to 0-1 range (assuming frame dimensions)
-        // This is simplified - in a real implementation, you'd have the actual frame size
-        float normalizedX = centerX / 1920.0f; // Assuming 1920x1080 for simplicity
-        float normalizedY = centerY / 1080.0f;
-        
-        // Check if this point is in a region of interest
-        if (!isInRegionOfInterest(normalizedX, normalizedY)) {
-            peopleInRestrictedAreas++;
+        if (regionIndex->contains(centerX, centerY)) {
+            summary.objectsInRegions++;
+        } else {
+            summary.objectsOutsideRegions++;
+            if (obj.typeId == ObjectClass::Person) {
+                summary.personsOutsideRegions++;
+            }
         }
     }
     
-    // If multiple people are in restricted areas, that's unusual
-    return peopleInRestrictedAreas >= 2;
+    result.summary = summary;
 }
 
 cv::Rect MetadataAnalyzer::normalizedToPixelCoords(
@@ -571,13 +574,25 @@ std::vector<DetectedObject> MetadataAnalyzer::extractObjectsFromMetadata(
                     obj.confidence = 1.0f; // Default if not specified
                 }
                 
-                // Extract other attributes
+                // Extract other attributes; declared numbers are read as
+                // numbers, everything else is stored as a string
                 for (int j = 0; j < nxObj.attributes()->size(); ++j) {
                     std::string key = nxObj.attributes()->key(j);
-                    std::string value;
-                    // We just store everything as strings internally
-                    nxObj.attributes()->getString(key, &value);
-                    obj.attributes[key] = value;
+                    if (key == "confidence") {
+                        continue;
+                    }
+                    AttributeKey attributeKey = AttributeKeys::intern(key);
+                    AttributeType type = m_attributeSchema
+                        ? m_attributeSchema->type(obj.typeId.id(), attributeKey)
+                        : AttributeType::Unknown;
+                    std::string& value = obj.attributes.slot(attributeKey, key);
+                    float number;
+                    if ((type == AttributeType::Float || type == AttributeType::Int) &&
+                        nxObj.attributes()->getFloat(key, &number)) {
+                        formatAttributeNumber(number, type, value);
+                    } else {
+                        nxObj.attributes()->getString(key, &value);
+                    }
                 }
             }
             
@@ -0,0 +1,310 @@
+// nx_agent_metrics.cpp
+#include "nx_agent_metrics.h"
+#include "nx_agent_utils.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <filesystem>
+
+namespace nx_agent {
+
+size_t metricShardIndex() {
+    static std::atomic<size_t> nextShard{0};
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % kMetricShards;
+    return shard;
+}
+
+// Counter implementation
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : m_shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// HistogramSnapshot implementation
+uint64_t HistogramSnapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(std::clamp(quantile, 0.0, 1.0) * count);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(Histogram::bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+// Histogram implementation
+void Histogram::record(uint64_t value) {
+    Shard& shard = m_shards[metricShardIndex()];
+    shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t currentMax = shard.max.load(std::memory_order_relaxed);
+    while (value > currentMax &&
+           !shard.max.compare_exchange_weak(currentMax, value, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const {
+    HistogramSnapshot snapshot;
+    snapshot.buckets.assign(kBucketCount, 0);
+
+    for (const auto& shard : m_shards) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, shard.max.load(std::memory_order_relaxed));
+    }
+
+    for (uint64_t bucket : snapshot.buckets) {
+        snapshot.count += bucket;
+    }
+    return snapshot;
+}
+
+size_t Histogram::bucketIndex(uint64_t value) {
+    const uint64_t maxValue = (uint64_t(1) << kMaxValueBits) - 1;
+    value = std::min(value, maxValue);
+
+    if (value < (uint64_t(1) << kSubBucketBits)) {
+        return static_cast<size_t>(value);
+    }
+
+    int msb = 63;
+    while (!(value & (uint64_t(1) << msb))) {
+        msb--;
+    }
+    int shift = msb - kSubBucketBits;
+    size_t subBucket = static_cast<size_t>((value >> shift) & ((1u << kSubBucketBits) - 1));
+    return (static_cast<size_t>(shift + 1) << kSubBucketBits) + subBucket;
+}
+
+uint64_t Histogram::bucketUpperBound(size_t index) {
+    if (index < (size_t(1) << kSubBucketBits)) {
+        return index;
+    }
+
+    int shift = static_cast<int>(index >> kSubBucketBits) - 1;
+    uint64_t subBucket = index & ((size_t(1) << kSubBucketBits) - 1);
+    uint64_t lower = ((uint64_t(1) << kSubBucketBits) + subBucket) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+// LatencyTimer implementation
+LatencyTimer::~LatencyTimer() {
+    if (m_histogram) {
+        m_histogram->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - m_start).count()));
+    }
+}
+
+// MetricsRegistry implementation
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopExporter();
+}
+
+std::shared_ptr<Counter> MetricsRegistry::counter(const std::string& name, const std::string& device,
+                                                  const std::string& stage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_metrics[Key(name, device, stage)];
+    if (!entry.counter) {
+        entry.counter = std::make_shared<Counter>();
+    }
+    return entry.counter;
+}
+
+std::shared_ptr<Gauge> MetricsRegistry::gauge(const std::string& name, const std::string& device,
+                                              const std::string& stage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_metrics[Key(name, device, stage)];
+    if (!entry.gauge) {
+        entry.gauge = std::make_shared<Gauge>();
+    }
+    return entry.gauge;
+}
+
+std::shared_ptr<Histogram> MetricsRegistry::histogram(const std::string& name, const std::string& device,
+                                                      const std::string& stage) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry& entry = m_metrics[Key(name, device, stage)];
+    if (!entry.histogram) {
+        entry.histogram = std::make_shared<Histogram>();
+    }
+    return entry.histogram;
+}
+
+void MetricsRegistry::removeDevice(const std::string& device) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_metrics.begin(); it != m_metrics.end();) {
+        if (std::get<1>(it->first) == device) {
+            it = m_metrics.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Escape a label value for the Prometheus text format
+static std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string labelSet(const std::string& device, const std::string& stage, const std::string& extra = "") {
+    std::string labels;
+    auto append = [&labels](const std::string& label) {
+        labels += labels.empty() ? "{" : ",";
+        labels += label;
+    };
+    if (!device.empty()) {
+        append("device=\"" + escapeLabel(device) + "\"");
+    }
+    if (!stage.empty()) {
+        append("stage=\"" + escapeLabel(stage) + "\"");
+    }
+    if (!extra.empty()) {
+        append(extra);
+    }
+    return labels.empty() ? labels : labels + "}";
+}
+
+std::string MetricsRegistry::renderPrometheus() const {
+    // Copy the handles so rendering does not hold up lookups
+    std::vector<std::pair<Key, Entry>> metrics;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        metrics.assign(m_metrics.begin(), m_metrics.end());
+    }
+
+    std::ostringstream out;
+    std::string lastTypeLine;
+    auto typeLine = [&](const std::string& name, const char* type) {
+        std::string line = "# TYPE " + name + " " + type;
+        if (line != lastTypeLine) {
+            out << line << "\n";
+            lastTypeLine = line;
+        }
+    };
+
+    for (const auto& metric : metrics) {
+        const std::string& name = std::get<0>(metric.first);
+        const std::string& device = std::get<1>(metric.first);
+        const std::string& stage = std::get<2>(metric.first);
+        const Entry& entry = metric.second;
+
+        if (entry.counter) {
+            typeLine(name, "counter");
+            out << name << labelSet(device, stage) << " " << entry.counter->value() << "\n";
+        }
+        if (entry.gauge) {
+            typeLine(name, "gauge");
+            out << name << labelSet(device, stage) << " " << entry.gauge->value() << "\n";
+        }
+        if (entry.histogram) {
+            HistogramSnapshot snapshot = entry.histogram->snapshot();
+            typeLine(name, "summary");
+            for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+                std::ostringstream q;
+                q << "quantile=\"" << quantile << "\"";
+                out << name << labelSet(device, stage, q.str()) << " " << snapshot.percentile(quantile) << "\n";
+            }
+            out << name << "_sum" << labelSet(device, stage) << " " << snapshot.sum << "\n";
+            out << name << "_count" << labelSet(device, stage) << " " << snapshot.count << "\n";
+        }
+    }
+
+    return out.str();
+}
+
+bool MetricsRegistry::writePrometheusFile(const std::string& filePath) const {
+    std::string content = renderPrometheus();
+
+    // Write next to the target and rename so scrapers never see a partial file
+    std::string tmpPath = filePath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file.is_open()) {
+            Logger::error("Metrics", "Failed to open " + tmpPath);
+            return false;
+        }
+        file << content;
+        if (!file) {
+            Logger::error("Metrics", "Failed to write " + tmpPath);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, filePath, ec);
+    if (ec) {
+        Logger::error("Metrics", "Failed to replace " + filePath + ": " + ec.message());
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MetricsRegistry::startExporter(const std::string& filePath, int intervalSecs) {
+    std::lock_guard<std::mutex> lock(m_exporterMutex);
+    if (m_exporter.joinable() || filePath.empty()) {
+        return;
+    }
+
+    m_exporterStopping = false;
+    auto interval = std::chrono::seconds(std::max(1, intervalSecs));
+    m_exporter = std::thread([this, filePath, interval]() {
+        std::unique_lock<std::mutex> lock(m_exporterMutex);
+        while (!m_exporterStopping) {
+            m_exporterCv.wait_for(lock, interval, [this]() { return m_exporterStopping; });
+
+            lock.unlock();
+            writePrometheusFile(filePath);
+            lock.lock();
+        }
+    });
+
+    Logger::info("Metrics", "Exporting metrics to " + filePath);
+}
+
+void MetricsRegistry::stopExporter() {
+    std::thread exporter;
+    {
+        std::lock_guard<std::mutex> lock(m_exporterMutex);
+        m_exporterStopping = true;
+        exporter = std::move(m_exporter);
+    }
+    m_exporterCv.notify_all();
+    if (exporter.joinable()) {
+        exporter.join();
+    }
+}
+
+} // namespace nx_agent
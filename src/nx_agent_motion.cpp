@@ -0,0 +1,268 @@
+// nx_agent_motion.cpp
+#include "nx_agent_motion.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NX_AGENT_MOTION_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NX_AGENT_MOTION_AVX2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NX_AGENT_MOTION_NEON 1
+#endif
+
+namespace nx_agent {
+
+MotionEngine parseMotionEngine(const std::string& name) {
+    if (name == "fast") {
+        return MotionEngine::Fast;
+    }
+    return MotionEngine::Mog2;
+}
+
+AnalysisMode parseAnalysisMode(const std::string& name) {
+    if (name == "compressed") {
+        return AnalysisMode::Compressed;
+    }
+    if (name == "metadataOnly") {
+        return AnalysisMode::MetadataOnly;
+    }
+    return AnalysisMode::Decoded;
+}
+
+namespace {
+
+// Background values are luma << kFractionBits; 255 << 7 still fits in int16,
+// and so does the difference of any two of them
+constexpr int kFractionBits = 7;
+
+// luma/mask: count pixels; background: count fixed-point values.
+// threshold is already scaled by 2^kFractionBits.
+using MotionRowKernel = void (*)(const uint8_t* luma, int16_t* background, uint8_t* mask,
+                                 int count, int adaptShift, int16_t threshold);
+
+void scalarRow(const uint8_t* luma, int16_t* background, uint8_t* mask,
+               int count, int adaptShift, int16_t threshold)
+{
+    for (int i = 0; i < count; ++i) {
+        int diff = (static_cast<int>(luma[i]) << kFractionBits) - background[i];
+        mask[i] = std::abs(diff) > threshold ? 255 : 0;
+        // Arithmetic shift, as the vector kernels do
+        background[i] = static_cast<int16_t>(background[i] + (diff >> adaptShift));
+    }
+}
+
+#ifdef NX_AGENT_MOTION_SSE2
+void sse2Row(const uint8_t* luma, int16_t* background, uint8_t* mask,
+             int count, int adaptShift, int16_t threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16(threshold);
+    const __m128i shift = _mm_cvtsi32_si128(adaptShift);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + i));
+        __m128i lo = _mm_slli_epi16(_mm_unpacklo_epi8(pixels, zero), kFractionBits);
+        __m128i hi = _mm_slli_epi16(_mm_unpackhi_epi8(pixels, zero), kFractionBits);
+        __m128i bgLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i));
+        __m128i bgHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + i + 8));
+
+        __m128i diffLo = _mm_sub_epi16(lo, bgLo);
+        __m128i diffHi = _mm_sub_epi16(hi, bgHi);
+
+        // SSE2 has no abs_epi16
+        __m128i absLo = _mm_max_epi16(diffLo, _mm_sub_epi16(zero, diffLo));
+        __m128i absHi = _mm_max_epi16(diffHi, _mm_sub_epi16(zero, diffHi));
+        __m128i moving = _mm_packs_epi16(_mm_cmpgt_epi16(absLo, limit), _mm_cmpgt_epi16(absHi, limit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), moving);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(background + i),
+                         _mm_add_epi16(bgLo, _mm_sra_epi16(diffLo, shift)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(background + i + 8),
+                         _mm_add_epi16(bgHi, _mm_sra_epi16(diffHi, shift)));
+    }
+    scalarRow(luma + i, background + i, mask + i, count - i, adaptShift, threshold);
+}
+#endif
+
+#ifdef NX_AGENT_MOTION_AVX2
+__attribute__((target("avx2")))
+void avx2Row(const uint8_t* luma, int16_t* background, uint8_t* mask,
+             int count, int adaptShift, int16_t threshold)
+{
+    const __m256i limit = _mm256_set1_epi16(threshold);
+    const __m128i shift = _mm_cvtsi32_si128(adaptShift);
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lo = _mm256_slli_epi16(_mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + i))), kFractionBits);
+        __m256i hi = _mm256_slli_epi16(_mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + i + 16))), kFractionBits);
+        __m256i bgLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background + i));
+        __m256i bgHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background + i + 16));
+
+        __m256i diffLo = _mm256_sub_epi16(lo, bgLo);
+        __m256i diffHi = _mm256_sub_epi16(hi, bgHi);
+
+        // packs works within 128-bit lanes; restore pixel order afterwards
+        __m256i moving = _mm256_packs_epi16(_mm256_cmpgt_epi16(_mm256_abs_epi16(diffLo), limit),
+                                            _mm256_cmpgt_epi16(_mm256_abs_epi16(diffHi), limit));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + i),
+                            _mm256_permute4x64_epi64(moving, 0xD8));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(background + i),
+                            _mm256_add_epi16(bgLo, _mm256_sra_epi16(diffLo, shift)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(background + i + 16),
+                            _mm256_add_epi16(bgHi, _mm256_sra_epi16(diffHi, shift)));
+    }
+    scalarRow(luma + i, background + i, mask + i, count - i, adaptShift, threshold);
+}
+#endif
+
+#ifdef NX_AGENT_MOTION_NEON
+void neonRow(const uint8_t* luma, int16_t* background, uint8_t* mask,
+             int count, int adaptShift, int16_t threshold)
+{
+    const int16x8_t limit = vdupq_n_s16(threshold);
+    const int16x8_t shift = vdupq_n_s16(static_cast<int16_t>(-adaptShift)); // Negative = arithmetic right
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t pixels = vld1q_u8(luma + i);
+        int16x8_t lo = vreinterpretq_s16_u16(vshll_n_u8(vget_low_u8(pixels), kFractionBits));
+        int16x8_t hi = vreinterpretq_s16_u16(vshll_n_u8(vget_high_u8(pixels), kFractionBits));
+        int16x8_t bgLo = vld1q_s16(background + i);
+        int16x8_t bgHi = vld1q_s16(background + i + 8);
+
+        int16x8_t diffLo = vsubq_s16(lo, bgLo);
+        int16x8_t diffHi = vsubq_s16(hi, bgHi);
+
+        uint16x8_t movingLo = vcgtq_s16(vabsq_s16(diffLo), limit);
+        uint16x8_t movingHi = vcgtq_s16(vabsq_s16(diffHi), limit);
+        vst1q_u8(mask + i, vcombine_u8(vmovn_u16(movingLo), vmovn_u16(movingHi)));
+
+        vst1q_s16(background + i, vaddq_s16(bgLo, vshlq_s16(diffLo, shift)));
+        vst1q_s16(background + i + 8, vaddq_s16(bgHi, vshlq_s16(diffHi, shift)));
+    }
+    scalarRow(luma + i, background + i, mask + i, count - i, adaptShift, threshold);
+}
+#endif
+
+struct MotionKernel {
+    const char* name;
+    MotionRowKernel row;
+};
+
+MotionKernel selectKernel() {
+#ifdef NX_AGENT_MOTION_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", avx2Row};
+    }
+#endif
+#if defined(NX_AGENT_MOTION_SSE2)
+    return {"sse2", sse2Row};
+#elif defined(NX_AGENT_MOTION_NEON)
+    return {"neon", neonRow};
+#else
+    return {"scalar", scalarRow};
+#endif
+}
+
+const MotionKernel& motionKernel() {
+    static const MotionKernel kernel = selectKernel();
+    return kernel;
+}
+
+} // namespace
+
+// RunningAverageSubtractor implementation
+RunningAverageSubtractor::RunningAverageSubtractor(int threshold, int adaptShift) {
+    setParameters(threshold, adaptShift);
+}
+
+void RunningAverageSubtractor::setParameters(int threshold, int adaptShift) {
+    m_threshold = std::clamp(threshold, 1, 254);
+    m_adaptShift = std::clamp(adaptShift, 0, 14);
+}
+
+void RunningAverageSubtractor::apply(const cv::Mat& input, cv::Mat& mask) {
+    if (input.type() != CV_8UC1) {
+        mask.release();
+        return;
+    }
+    mask.create(input.rows, input.cols, CV_8UC1);
+
+    if (m_background.rows != input.rows || m_background.cols != input.cols) {
+        input.convertTo(m_background, CV_16SC1, 1 << kFractionBits);
+        mask.setTo(cv::Scalar(0));
+        return;
+    }
+
+    const MotionRowKernel row = motionKernel().row;
+    const int16_t limit = static_cast<int16_t>(m_threshold << kFractionBits);
+    for (int y = 0; y < input.rows; ++y) {
+        // Rows are processed separately because input may be a window into a larger frame
+        row(input.ptr<uint8_t>(y), m_background.ptr<int16_t>(y), mask.ptr<uint8_t>(y),
+            input.cols, m_adaptShift, limit);
+    }
+}
+
+void RunningAverageSubtractor::reset() {
+    m_background.release();
+}
+
+const char* RunningAverageSubtractor::kernelName() {
+    return motionKernel().name;
+}
+
+// PacketMotionEstimator implementation
+PacketMotionEstimator::PacketMotionEstimator(float scale)
+    : m_scale(scale)
+{
+}
+
+float PacketMotionEstimator::update(const CompressedFrameInfo& frame) {
+    // Packet sizes are only comparable within one stream configuration
+    if (frame.width != m_width || frame.height != m_height) {
+        reset();
+        m_width = frame.width;
+        m_height = frame.height;
+    }
+    if (frame.keyFrame || frame.sizeBytes == 0) {
+        return m_level;
+    }
+
+    double size = static_cast<double>(frame.sizeBytes);
+    if (m_samples == 0) {
+        m_baselineBytes = size;
+    } else if (size < m_baselineBytes) {
+        m_baselineBytes += (size - m_baselineBytes) * 0.1;
+    } else {
+        m_baselineBytes += (size - m_baselineBytes) * 0.002;
+    }
+
+    if (++m_samples <= kWarmupFrames) {
+        m_level = 0.0f;
+    } else {
+        double excess = size / std::max(1.0, m_baselineBytes) - 1.0;
+        m_level = static_cast<float>(std::clamp(excess * m_scale, 0.0, 1.0));
+    }
+    return m_level;
+}
+
+void PacketMotionEstimator::reset() {
+    m_baselineBytes = 0.0;
+    m_samples = 0;
+    m_level = 0.0f;
+}
+
+} // namespace nx_agent
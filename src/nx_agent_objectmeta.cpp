@@ -0,0 +1,103 @@
+// nx_agent_objectmeta.cpp
+#include "nx_agent_objectmeta.h"
+#include "nx_agent_metadata.h"
+
+namespace nx_agent {
+
+void addNxAttribute(nx::sdk::analytics::ObjectMetadata& metadata, const std::string& name,
+                    const std::string& value, AttributeType type) {
+    // Declared strings are never trial-parsed; a declared number that is
+    // not one goes out as text rather than as a made-up zero
+    float number = 0.0f;
+    if (type != AttributeType::String && type != AttributeType::Boolean &&
+        parseAttributeNumber(value, number)) {
+        metadata.attributes()->addFloat(name, number);
+    } else {
+        metadata.attributes()->addString(name, value);
+    }
+}
+
+// ObjectMetadataWriter implementation
+ObjectMetadataWriter::ObjectMetadataWriter(std::shared_ptr<const AttributeSchema> schema)
+    : m_schema(std::move(schema)) {
+}
+
+const std::vector<nx::sdk::analytics::ObjectMetadata>& ObjectMetadataWriter::write(
+    const std::vector<DetectedObject>& objects, int64_t timestampUs) {
+    // clear() keeps the capacity of the previous frames
+    m_metadata.clear();
+    m_metadata.reserve(objects.size());
+
+    for (const auto& object : objects) {
+        m_metadata.emplace_back();
+        nx::sdk::analytics::ObjectMetadata& metadata = m_metadata.back();
+        metadata.typeId = object.typeId.id();
+        metadata.trackId = object.trackId;
+        metadata.setBoundingBox(
+            object.boundingBox.x,
+            object.boundingBox.y,
+            object.boundingBox.width,
+            object.boundingBox.height
+        );
+        metadata.attributes()->addFloat("confidence", object.confidence);
+        ++m_stats.objects;
+
+        // Objects without a trackId cannot be associated by the VMS, so
+        // they always carry all their attributes
+        TrackState* track = nullptr;
+        if (m_changesOnly && !object.trackId.empty()) {
+            track = &m_tracks[object.trackId];
+            if (track->typeId != object.typeId.id()) {
+                track->typeId = object.typeId.id();
+                track->sent.clear();
+            }
+            track->lastSeenUs = timestampUs;
+        }
+
+        for (size_t i = 0; i < object.attributes.size(); ++i) {
+            const auto& attribute = object.attributes.at(i);
+            if (track) {
+                const std::string* sent = track->sent.find(attribute.key, attribute.name());
+                if (sent && *sent == attribute.value) {
+                    ++m_stats.attributesSkipped;
+                    continue;
+                }
+                track->sent.slot(attribute.key, attribute.name()) = attribute.value;
+            }
+
+            AttributeType type = m_schema
+                ? m_schema->type(object.typeId.id(), attribute.key)
+                : AttributeType::Unknown;
+            addNxAttribute(metadata, attribute.name(), attribute.value, type);
+            ++m_stats.attributesSent;
+        }
+    }
+
+    expireTracks(timestampUs);
+    return m_metadata;
+}
+
+void ObjectMetadataWriter::reset() {
+    m_tracks.clear();
+    m_lastExpiryUs = 0;
+}
+
+void ObjectMetadataWriter::expireTracks(int64_t nowUs) {
+    // Swept about once a second of frame time; a timestamp going backwards
+    // (a restarted stream) sweeps at once
+    if (nowUs >= m_lastExpiryUs && nowUs - m_lastExpiryUs < kExpiryIntervalUs) {
+        return;
+    }
+    m_lastExpiryUs = nowUs;
+
+    for (auto it = m_tracks.begin(); it != m_tracks.end();) {
+        int64_t lastSeenUs = it->second.lastSeenUs;
+        if (lastSeenUs > nowUs || nowUs - lastSeenUs > kTrackStateTtlUs) {
+            it = m_tracks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace nx_agent
@@ -0,0 +1,148 @@
+// nx_agent_persistence.cpp
+#include "nx_agent_persistence.h"
+#include "nx_agent_config.h"
+#include "nx_agent_utils.h"
+
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+namespace nx_agent {
+
+// ModelPersistenceService implementation
+ModelPersistenceService& ModelPersistenceService::instance() {
+    static ModelPersistenceService instance;
+    return instance;
+}
+
+ModelPersistenceService::ModelPersistenceService() {
+    // Make sure the config outlives us; the worker reads the interval from it
+    GlobalConfig::instance();
+    m_worker = std::thread(&ModelPersistenceService::run, this);
+}
+
+ModelPersistenceService::~ModelPersistenceService() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeCv.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    // Whatever is still registered gets its final write now
+    flushAll();
+}
+
+uint64_t ModelPersistenceService::registerSource(FlushFn flush) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t handle = m_nextHandle++;
+    m_sources[handle].flush = std::move(flush);
+    return handle;
+}
+
+void ModelPersistenceService::unregisterSource(uint64_t handle) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushOne(handle, lock);
+    m_sources.erase(handle);
+}
+
+void ModelPersistenceService::markDirty(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sources.find(handle);
+    if (it == m_sources.end()) {
+        return;
+    }
+    if (it->second.dirty) {
+        m_coalesced++;
+    }
+    it->second.dirty = true;
+}
+
+void ModelPersistenceService::flushAll() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushDirty(lock);
+}
+
+PersistenceStats ModelPersistenceService::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PersistenceStats stats;
+    stats.sources = m_sources.size();
+    for (const auto& pair : m_sources) {
+        if (pair.second.dirty) {
+            stats.dirty++;
+        }
+    }
+    stats.writes = m_writes;
+    stats.failures = m_failures;
+    stats.coalesced = m_coalesced;
+    return stats;
+}
+
+// Private methods
+void ModelPersistenceService::run() {
+    while (true) {
+        auto interval = std::chrono::seconds(
+            std::max(1, GlobalConfig::instance().modelPersistIntervalSecs));
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wakeCv.wait_for(lock, interval, [this]() { return m_stopping; });
+        if (m_stopping) {
+            break;
+        }
+        flushDirty(lock);
+    }
+}
+
+void ModelPersistenceService::flushDirty(std::unique_lock<std::mutex>& lock) {
+    std::vector<uint64_t> dirty;
+    for (const auto& pair : m_sources) {
+        if (pair.second.dirty) {
+            dirty.push_back(pair.first);
+        }
+    }
+
+    for (uint64_t handle : dirty) {
+        flushOne(handle, lock);
+    }
+}
+
+void ModelPersistenceService::flushOne(uint64_t handle, std::unique_lock<std::mutex>& lock) {
+    // One flush at a time, so unregisterSource() can wait for its own
+    m_flushDoneCv.wait(lock, [this]() { return m_flushingHandle == 0; });
+
+    auto it = m_sources.find(handle);
+    if (it == m_sources.end() || !it->second.dirty) {
+        return;
+    }
+
+    it->second.dirty = false;
+    FlushFn flush = it->second.flush;
+    m_flushingHandle = handle;
+
+    // Run the write without holding the lock so markDirty() never waits on disk
+    lock.unlock();
+    bool ok = false;
+    try {
+        ok = flush();
+    } catch (const std::exception& e) {
+        Logger::error("ModelPersistence", "Flush failed: " + std::string(e.what()));
+    }
+    lock.lock();
+
+    m_flushingHandle = 0;
+    if (ok) {
+        m_writes++;
+    } else {
+        // Try again next interval
+        m_failures++;
+        it = m_sources.find(handle);
+        if (it != m_sources.end()) {
+            it->second.dirty = true;
+        }
+    }
+    m_flushDoneCv.notify_all();
+}
+
+} // namespace nx_agent
@@ -0,0 +1,399 @@
+// nx_agent_pipeline.cpp
+#include "nx_agent_pipeline.h"
+
+#include <chrono>
+
+namespace nx_agent {
+
+FrameDropPolicy parseFrameDropPolicy(const std::string& name) {
+    if (name == "dropAlternate") {
+        return FrameDropPolicy::DropAlternate;
+    }
+    return FrameDropPolicy::KeepLatest;
+}
+
+// AnalysisPipeline implementation
+AnalysisPipeline::AnalysisPipeline(const std::string& deviceId, size_t queueCapacity,
+                                   FrameDropPolicy policy,
+                                   std::shared_ptr<TaskExecutor> executor)
+    : m_deviceId(deviceId),
+      m_queueCapacity(queueCapacity > 0 ? queueCapacity : 1),
+      m_policy(policy),
+      m_executor(std::move(executor))
+{
+}
+
+AnalysisPipeline::~AnalysisPipeline() {
+    stop();
+}
+
+void AnalysisPipeline::addStage(const std::string& name, Stage stage) {
+    if (m_running) {
+        Logger::error(m_deviceId, "Cannot add pipeline stage '" + name + "' while running");
+        return;
+    }
+    auto slot = std::make_unique<StageSlot>(name, m_queueCapacity);
+    slot->fn = std::move(stage);
+    m_stages.push_back(std::move(slot));
+}
+
+void AnalysisPipeline::addAsyncStage(const std::string& name, AsyncStage stage) {
+    if (m_running) {
+        Logger::error(m_deviceId, "Cannot add pipeline stage '" + name + "' while running");
+        return;
+    }
+    auto slot = std::make_unique<StageSlot>(name, m_queueCapacity);
+    slot->asyncFn = std::move(stage);
+    m_stages.push_back(std::move(slot));
+}
+
+void AnalysisPipeline::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+
+    // With an executor, stages are scheduled on demand as work arrives
+    if (m_executor) {
+        return;
+    }
+
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        m_stages[i]->worker = std::thread(&AnalysisPipeline::runStage, this, i);
+    }
+}
+
+void AnalysisPipeline::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    // Asynchronous stages finish every job they accepted; wait so that no
+    // completion callback outlives the pipeline
+    for (auto& slot : m_stages) {
+        while (slot->outstanding.load() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    if (m_executor) {
+        // Drain tasks see m_running == false and retire without touching the stage
+        while (m_inFlight.load() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return;
+    }
+
+    for (auto& slot : m_stages) {
+        std::lock_guard<std::mutex> lock(slot->wakeMutex);
+        slot->wakeCv.notify_all();
+    }
+
+    for (auto& slot : m_stages) {
+        if (slot->worker.joinable()) {
+            slot->worker.join();
+        }
+    }
+}
+
+bool AnalysisPipeline::submit(std::unique_ptr<PipelineJob> job) {
+    if (!m_running || m_stages.empty() || !job) {
+        return false;
+    }
+
+    StageSlot& first = *m_stages.front();
+
+    // Under backpressure, shed every other frame rather than the whole tail
+    if (m_policy == FrameDropPolicy::DropAlternate &&
+        first.queue.size() * 2 >= first.queue.capacity()) {
+        m_dropToggle = !m_dropToggle;
+        if (m_dropToggle) {
+            m_ingestDropped++;
+            return false;
+        }
+    }
+
+    // Keep the newest frame; the one it replaces was never going to be analyzed
+    if (usesMailbox(first)) {
+        if (first.latest.put(std::move(job))) {
+            m_ingestDropped++;
+        }
+    } else if (!first.queue.tryPush(std::move(job))) {
+        m_ingestDropped++;
+        return false;
+    }
+
+    m_submitted++;
+    notify(0);
+    return true;
+}
+
+PipelineStats AnalysisPipeline::stats() const {
+    PipelineStats stats;
+    stats.submitted = m_submitted.load();
+    stats.dropped = m_ingestDropped.load();
+
+    for (const auto& slot : m_stages) {
+        PipelineStageStats stageStats;
+        stageStats.name = slot->name;
+        if (usesMailbox(*slot)) {
+            stageStats.queueDepth = slot->latest.empty() ? 0 : 1;
+            stageStats.queueCapacity = 1;
+        } else {
+            stageStats.queueDepth = slot->queue.size();
+            stageStats.queueCapacity = slot->queue.capacity();
+        }
+        stageStats.inFlight = slot->outstanding.load();
+        stageStats.processed = slot->processed.load();
+        stageStats.dropped = slot->dropped.load();
+        stats.dropped += stageStats.dropped;
+        stats.stages.push_back(stageStats);
+    }
+
+    return stats;
+}
+
+// Private methods
+void AnalysisPipeline::runStage(size_t index) {
+    StageSlot& slot = *m_stages[index];
+    StageSlot* next = index + 1 < m_stages.size() ? m_stages[index + 1].get() : nullptr;
+
+    while (m_running) {
+        std::unique_ptr<PipelineJob> job;
+        bool proceed = false;
+
+        // Jobs handed back by an asynchronous stage go downstream first
+        if (takeCompleted(slot, job, proceed)) {
+            if (proceed && next) {
+                push(*next, std::move(job));
+            }
+            continue;
+        }
+
+        if (!saturated(slot)) {
+            job = nextJob(slot);
+        }
+
+        if (!job) {
+            // Nothing to do - sleep until the producer rings. The timeout
+            // bounds the cost of a wakeup lost to a race with the producer.
+            std::unique_lock<std::mutex> lock(slot.wakeMutex);
+            slot.sleeping.store(true);
+            slot.wakeCv.wait_for(lock, std::chrono::milliseconds(10), [&]() {
+                return (hasInput(slot) && !saturated(slot)) ||
+                       slot.completedCount.load() > 0 || !m_running;
+            });
+            slot.sleeping.store(false);
+            continue;
+        }
+
+        if (slot.asyncFn) {
+            startAsync(index, std::move(job));
+        } else if (runJob(slot, *job) && next) {
+            push(*next, std::move(job));
+        }
+    }
+}
+
+void AnalysisPipeline::schedule(size_t index) {
+    StageSlot& slot = *m_stages[index];
+    if (slot.scheduled.exchange(true)) {
+        return;
+    }
+
+    m_inFlight++;
+    m_executor->submit(m_deviceId, TaskPriority::Normal, [this, index]() {
+        drainStage(index);
+    });
+}
+
+void AnalysisPipeline::drainStage(size_t index) {
+    StageSlot& slot = *m_stages[index];
+    StageSlot* next = index + 1 < m_stages.size() ? m_stages[index + 1].get() : nullptr;
+    StageSlot* prev = index > 0 ? m_stages[index - 1].get() : nullptr;
+
+    if (m_running) {
+        // Handle a bounded batch so a busy device yields the worker to its peers
+        for (int n = 0; n < kDrainBatch; ++n) {
+            if (slot.pendingOutput) {
+                if (!next->queue.tryPush(std::move(slot.pendingOutput))) {
+                    break;
+                }
+                slot.blocked.store(false);
+                notify(index + 1);
+            }
+
+            std::unique_ptr<PipelineJob> job;
+            bool proceed = false;
+
+            // Jobs handed back by an asynchronous stage go downstream first
+            if (takeCompleted(slot, job, proceed)) {
+                if (proceed && next && !forwardOrPark(index, std::move(job))) {
+                    break;
+                }
+                continue;
+            }
+
+            if (saturated(slot)) {
+                break;
+            }
+
+            job = nextJob(slot);
+            if (!job) {
+                break;
+            }
+
+            if (slot.asyncFn) {
+                startAsync(index, std::move(job));
+            } else if (runJob(slot, *job) && next && !forwardOrPark(index, std::move(job))) {
+                break;
+            }
+        }
+
+        // We may have freed room for a blocked upstream stage
+        if (prev && prev->blocked.load()) {
+            schedule(index - 1);
+        }
+    }
+
+    slot.scheduled.store(false);
+
+    // Re-check after releasing the flag so work published meanwhile is not stranded
+    if (m_running) {
+        bool runnable = slot.blocked.load()
+            ? next->queue.size() < next->queue.capacity()
+            : (hasInput(slot) && !saturated(slot)) || slot.completedCount.load() > 0;
+        if (runnable) {
+            schedule(index);
+        }
+    }
+
+    // Last touch of this object; stop() may return right after
+    m_inFlight--;
+}
+
+bool AnalysisPipeline::forwardOrPark(size_t index, std::unique_ptr<PipelineJob> job) {
+    StageSlot& slot = *m_stages[index];
+    StageSlot& next = *m_stages[index + 1];
+
+    if (!next.queue.tryPush(std::move(job))) {
+        // Park it; downstream reschedules us once it has room
+        slot.pendingOutput = std::move(job);
+        slot.blocked.store(true);
+        return false;
+    }
+
+    notify(index + 1);
+    return true;
+}
+
+bool AnalysisPipeline::saturated(const StageSlot& slot) const {
+    return slot.asyncFn && slot.outstanding.load() >= slot.queue.capacity();
+}
+
+void AnalysisPipeline::startAsync(size_t index, std::unique_ptr<PipelineJob> job) {
+    StageSlot& slot = *m_stages[index];
+    slot.outstanding++;
+
+    // Ownership travels with the callback and comes back in complete()
+    PipelineJob* raw = job.release();
+    try {
+        slot.asyncFn(*raw, [this, index, raw](bool proceed) {
+            complete(index, raw, proceed);
+        });
+    } catch (const std::exception& e) {
+        Logger::error(m_deviceId, "Pipeline stage '" + slot.name + "' failed: " + e.what());
+        complete(index, raw, false);
+    }
+}
+
+void AnalysisPipeline::complete(size_t index, PipelineJob* job, bool proceed) {
+    StageSlot& slot = *m_stages[index];
+    {
+        std::lock_guard<std::mutex> lock(slot.completedMutex);
+        slot.completed.push_back(StageSlot::Completion{std::unique_ptr<PipelineJob>(job), proceed});
+        slot.completedCount++;
+    }
+    slot.processed++;
+    notify(index);
+
+    // Last touch of the slot; stop() waits for this to reach zero
+    slot.outstanding--;
+}
+
+bool AnalysisPipeline::takeCompleted(StageSlot& slot, std::unique_ptr<PipelineJob>& job, bool& proceed) {
+    if (slot.completedCount.load() == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(slot.completedMutex);
+    if (slot.completed.empty()) {
+        return false;
+    }
+    job = std::move(slot.completed.front().job);
+    proceed = slot.completed.front().proceed;
+    slot.completed.pop_front();
+    slot.completedCount--;
+    return true;
+}
+
+bool AnalysisPipeline::runJob(StageSlot& slot, PipelineJob& job) {
+    bool proceed = false;
+    try {
+        proceed = slot.fn(job);
+    } catch (const std::exception& e) {
+        Logger::error(m_deviceId, "Pipeline stage '" + slot.name + "' failed: " + e.what());
+    }
+    slot.processed++;
+    return proceed;
+}
+
+void AnalysisPipeline::notify(size_t index) {
+    if (m_executor) {
+        schedule(index);
+    } else {
+        wake(*m_stages[index]);
+    }
+}
+
+bool AnalysisPipeline::usesMailbox(const StageSlot& slot) const {
+    // The first stage works on the freshest frame and never sees stale ones
+    return m_policy == FrameDropPolicy::KeepLatest && &slot == m_stages.front().get();
+}
+
+bool AnalysisPipeline::hasInput(const StageSlot& slot) const {
+    return usesMailbox(slot) ? !slot.latest.empty() : !slot.queue.empty();
+}
+
+std::unique_ptr<PipelineJob> AnalysisPipeline::nextJob(StageSlot& slot) {
+    if (usesMailbox(slot)) {
+        return slot.latest.take();
+    }
+
+    std::unique_ptr<PipelineJob> job;
+    if (!slot.queue.tryPop(job)) {
+        return nullptr;
+    }
+    return job;
+}
+
+void AnalysisPipeline::push(StageSlot& slot, std::unique_ptr<PipelineJob> job) {
+    // Intermediate stages never drop; wait for the consumer to catch up
+    while (!slot.queue.tryPush(std::move(job))) {
+        if (!m_running) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    wake(slot);
+}
+
+void AnalysisPipeline::wake(StageSlot& slot) {
+    // Order the queue publish before reading the sleeping flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (slot.sleeping.load()) {
+        std::lock_guard<std::mutex> lock(slot.wakeMutex);
+        slot.wakeCv.notify_one();
+    }
+}
+
+} // namespace nx_agent
@@ -0,0 +1,128 @@
+// nx_agent_regions.cpp
+#include "nx_agent_regions.h"
+#include "nx_agent_config.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nx_agent {
+
+// Scanline-fill a polygon into a coverage bitmap, sampling cell centres
+static void fillPolygon(const Region& region, std::vector<uint8_t>& coverage) {
+    const auto& points = region.points;
+    const int res = RegionIndex::kResolution;
+
+    float minY = 1.0f;
+    float maxY = 0.0f;
+    for (const auto& point : points) {
+        minY = std::min(minY, point.second);
+        maxY = std::max(maxY, point.second);
+    }
+
+    int firstRow = std::max(0, static_cast<int>(std::floor(minY * res)));
+    int lastRow = std::min(res - 1, static_cast<int>(std::ceil(maxY * res)));
+
+    std::vector<float> crossings;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        float y = (row + 0.5f) / res;
+
+        // Edge table for this row: x of every edge crossing the centre line
+        crossings.clear();
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto& a = points[i];
+            const auto& b = points[(i + 1) % points.size()];
+            if ((a.second <= y && b.second > y) || (b.second <= y && a.second > y)) {
+                crossings.push_back(a.first + (y - a.second) * (b.first - a.first) / (b.second - a.second));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Even-odd rule: cells whose centre lies between pairs of crossings
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2) {
+            int firstCol = std::max(0, static_cast<int>(std::ceil(crossings[k] * res - 0.5f)));
+            int lastCol = std::min(res - 1, static_cast<int>(std::floor(crossings[k + 1] * res - 0.5f)));
+            if (firstCol <= lastCol) {
+                std::fill(coverage.begin() + row * res + firstCol,
+                          coverage.begin() + row * res + lastCol + 1, 1);
+            }
+        }
+    }
+}
+
+// RegionIndex implementation
+RegionIndex::RegionIndex(const std::vector<Region>& regions) {
+    if (regions.empty()) {
+        return;
+    }
+
+    const size_t cells = static_cast<size_t>(kResolution) * kResolution;
+    std::vector<uint8_t> included(cells, 0);
+    std::vector<uint8_t> excluded(cells, 0);
+    bool hasExclusionZones = false;
+
+    for (const auto& region : regions) {
+        if (region.isExclusionZone) {
+            hasExclusionZones = true;
+        }
+        if (region.points.size() < 3) {
+            continue; // Need at least 3 points for a polygon
+        }
+        fillPolygon(region, region.isExclusionZone ? excluded : included);
+    }
+
+    // Inclusion zones first, then exclusion zones, then the default
+    m_bitmap.resize(cells);
+    bool everything = true;
+    m_minCol = kResolution;
+    m_minRow = kResolution;
+    m_maxCol = -1;
+    m_maxRow = -1;
+    
+    for (size_t i = 0; i < cells; ++i) {
+        bool ofInterest = included[i] || (!excluded[i] && hasExclusionZones);
+        m_bitmap[i] = ofInterest ? 1 : 0;
+        everything = everything && ofInterest;
+        
+        if (ofInterest) {
+            int row = static_cast<int>(i / kResolution);
+            int col = static_cast<int>(i % kResolution);
+            m_minCol = std::min(m_minCol, col);
+            m_maxCol = std::max(m_maxCol, col);
+            m_minRow = std::min(m_minRow, row);
+            m_maxRow = std::max(m_maxRow, row);
+        }
+    }
+    m_coversEverything = everything;
+}
+
+cv::Mat RegionIndex::rasterize(int width, int height, const cv::Rect2f& window) const {
+    cv::Mat mask(height, width, CV_8U, cv::Scalar(255));
+    if (m_coversEverything) {
+        return mask;
+    }
+    
+    // Sample the bitmap at each output pixel centre
+    for (int row = 0; row < height; ++row) {
+        float y = window.y + (row + 0.5f) / height * window.height;
+        uint8_t* out = mask.ptr<uint8_t>(row);
+        for (int col = 0; col < width; ++col) {
+            float x = window.x + (col + 0.5f) / width * window.width;
+            out[col] = contains(x, y) ? 255 : 0;
+        }
+    }
+    return mask;
+}
+
+cv::Rect RegionIndex::interestBounds(int width, int height) const {
+    if (m_maxCol < m_minCol) {
+        return cv::Rect();
+    }
+    
+    int left = m_minCol * width / kResolution;
+    int top = m_minRow * height / kResolution;
+    int right = ((m_maxCol + 1) * width + kResolution - 1) / kResolution;
+    int bottom = ((m_maxRow + 1) * height + kResolution - 1) / kResolution;
+    return cv::Rect(left, top, std::min(width, right) - left, std::min(height, bottom) - top);
+}
+
+} // namespace nx_agent
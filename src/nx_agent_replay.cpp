@@ -0,0 +1,545 @@
+// nx_agent_replay.cpp
+#include "nx_agent_replay.h"
+#include "nx_agent_config.h"
+#include "nx_agent_metadata.h"
+#include "nx_agent_detector.h"
+#include "nx_agent_anomaly.h"
+#include "nx_agent_scheduler.h"
+#include "nx_agent_framepool.h"
+#include "nx_agent_spsc.h"
+#include "nx_agent_utils.h"
+
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cctype>
+#include <nlohmann/json.hpp>
+#include <opencv2/opencv.hpp>
+
+namespace nx_agent {
+
+using json = nlohmann::json;
+
+namespace {
+
+bool hasExtension(const std::filesystem::path& path, std::initializer_list<const char*> extensions) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const char* candidate : extensions) {
+        if (extension == candidate) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isVideoFile(const std::filesystem::path& path) {
+    return hasExtension(path, {".mkv", ".mp4", ".avi", ".mov", ".ts"});
+}
+
+bool isImageFile(const std::filesystem::path& path) {
+    return hasExtension(path, {".jpg", ".jpeg", ".png", ".bmp"});
+}
+
+// Leading decimal number of a file name ("1718010000000_60000" -> 1718010000000)
+bool parseLeadingNumber(const std::string& stem, int64_t& value) {
+    size_t digits = 0;
+    while (digits < stem.size() && std::isdigit(static_cast<unsigned char>(stem[digits]))) {
+        digits++;
+    }
+    if (digits == 0 || digits > 18) {
+        return false;
+    }
+    value = std::stoll(stem.substr(0, digits));
+    return true;
+}
+
+// Image files of a frame dump, ordered by timestamp
+std::vector<std::pair<int64_t, std::string>> dumpFrames(const std::string& directory) {
+    std::vector<std::pair<int64_t, std::string>> frames;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        int64_t timestampUs = 0;
+        if (entry.is_regular_file() && isImageFile(entry.path()) &&
+            parseLeadingNumber(entry.path().stem().string(), timestampUs)) {
+            frames.emplace_back(timestampUs, entry.path().string());
+        }
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+struct ReplayFrame {
+    cv::Mat image;
+    int64_t timestampUs = 0;
+};
+
+/**
+ * Reader side of one camera's replay: plays the part of the server,
+ * decoding frames and asking the scheduler which ones to hand over
+ */
+class SegmentReader {
+public:
+    SegmentReader(const std::string& deviceId, FrameScheduler& scheduler, SpscQueue<ReplayFrame>& queue,
+                  const std::atomic<bool>& stop)
+        : m_scheduler(scheduler),
+          m_queue(queue),
+          m_stop(stop),
+          m_pool(std::make_shared<FramePool>(deviceId, queue.capacity() + 4))
+    {
+    }
+
+    void read(const std::vector<ReplaySegment>& segments) {
+        for (const auto& segment : segments) {
+            if (m_stop) {
+                return;
+            }
+            if (segment.kind == ReplaySegment::Kind::Video) {
+                readVideo(segment);
+            } else {
+                readDump(segment);
+            }
+        }
+    }
+
+    uint64_t frames = 0;
+    uint64_t skipped = 0;
+    int64_t firstUs = 0;
+    int64_t lastUs = 0;
+
+private:
+    // Count the frame and decide whether it is analyzed
+    bool admit(int64_t timestampUs) {
+        if (frames++ == 0) {
+            firstUs = timestampUs;
+        }
+        lastUs = std::max(lastUs, timestampUs);
+        if (!m_scheduler.shouldProcess(timestampUs)) {
+            skipped++;
+            return false;
+        }
+        return true;
+    }
+
+    void push(cv::Mat image, int64_t timestampUs) {
+        ReplayFrame frame;
+        frame.image = std::move(image);
+        frame.timestampUs = timestampUs;
+
+        // Never drop: a replay is limited by analysis, not by a live source
+        while (!m_queue.tryPush(std::move(frame))) {
+            if (m_stop) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    void readVideo(const ReplaySegment& segment) {
+        cv::VideoCapture capture;
+        if (!capture.open(segment.path)) {
+            Logger::warning("ReplayEngine", "Failed to open " + segment.path);
+            return;
+        }
+
+        double fps = capture.get(cv::CAP_PROP_FPS);
+        int64_t frameIndex = 0;
+        int64_t previousUs = segment.startUs;
+        cv::Size size;
+
+        while (!m_stop && capture.grab()) {
+            // Prefer the container's timestamps; fall back to the nominal rate
+            double positionMs = capture.get(cv::CAP_PROP_POS_MSEC);
+            int64_t offsetUs = positionMs > 0.0 || frameIndex == 0
+                ? static_cast<int64_t>(positionMs * 1000.0)
+                : static_cast<int64_t>(frameIndex * 1000000.0 / (fps > 0.0 ? fps : 15.0));
+            int64_t timestampUs = std::max(previousUs, segment.startUs + offsetUs);
+            previousUs = timestampUs;
+            frameIndex++;
+
+            if (!admit(timestampUs)) {
+                continue;
+            }
+
+            // retrieve() decodes into the pooled buffer when the size matches
+            cv::Mat image = size.area() > 0 ? m_pool->acquire(size.height, size.width, CV_8UC3) : cv::Mat();
+            if (!capture.retrieve(image) || image.empty()) {
+                continue;
+            }
+            size = image.size();
+            push(std::move(image), timestampUs);
+        }
+    }
+
+    void readDump(const ReplaySegment& segment) {
+        for (const auto& frame : dumpFrames(segment.path)) {
+            if (m_stop) {
+                return;
+            }
+            if (!admit(frame.first)) {
+                continue;
+            }
+            cv::Mat image = cv::imread(frame.second, cv::IMREAD_COLOR);
+            if (image.empty()) {
+                Logger::warning("ReplayEngine", "Failed to read " + frame.second);
+                continue;
+            }
+            push(std::move(image), frame.first);
+        }
+    }
+
+    FrameScheduler& m_scheduler;
+    SpscQueue<ReplayFrame>& m_queue;
+    const std::atomic<bool>& m_stop;
+    std::shared_ptr<FramePool> m_pool;
+};
+
+/**
+ * Detection for one camera's analyzer through the batcher every replaying
+ * camera shares, as the device agents share the engine's. detect() blocks
+ * until the batch holding its frames has run.
+ */
+class BatchedDetectorBackend : public ObjectDetectorBackend {
+public:
+    BatchedDetectorBackend(std::string deviceId, DetectionBatcher& batcher)
+        : m_deviceId(std::move(deviceId)), m_batcher(batcher) {}
+
+    std::string name() const override { return m_batcher.backendName(); }
+
+    std::vector<std::vector<DetectedObject>> detect(
+        const std::vector<const ImageUtils::FrameView*>& frames) override
+    {
+        std::vector<std::vector<DetectedObject>> results(frames.size());
+        size_t remaining = frames.size();
+        std::mutex mutex;
+        std::condition_variable done;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            m_batcher.submit(m_deviceId, *frames[i], [&, i](std::vector<DetectedObject> objects, bool) {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[i] = std::move(objects);
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&remaining]() { return remaining == 0; });
+        return results;
+    }
+
+private:
+    std::string m_deviceId;
+    DetectionBatcher& m_batcher;
+};
+
+} // namespace
+
+std::vector<ReplaySegment> findReplaySegments(const std::string& path) {
+    std::vector<ReplaySegment> segments;
+    std::error_code ec;
+    std::filesystem::path root(path);
+
+    auto addVideo = [&segments](const std::filesystem::path& file) {
+        int64_t startMs = 0;
+        if (parseLeadingNumber(file.stem().string(), startMs)) {
+            segments.push_back({ReplaySegment::Kind::Video, file.string(), startMs * 1000});
+        } else {
+            Logger::warning("ReplayEngine", "Skipping " + file.string() + ": no start time in its name");
+        }
+    };
+    auto addDump = [&segments](const std::filesystem::path& directory) {
+        auto frames = dumpFrames(directory.string());
+        if (!frames.empty()) {
+            segments.push_back({ReplaySegment::Kind::FrameDump, directory.string(), frames.front().first});
+        }
+    };
+
+    if (std::filesystem::is_regular_file(root, ec)) {
+        if (isVideoFile(root)) {
+            addVideo(root);
+        }
+    } else if (std::filesystem::is_directory(root, ec)) {
+        addDump(root);
+        for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+            if (entry.is_regular_file() && isVideoFile(entry.path())) {
+                addVideo(entry.path());
+            } else if (entry.is_directory()) {
+                addDump(entry.path());
+            }
+        }
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const ReplaySegment& a, const ReplaySegment& b) {
+        return a.startUs < b.startUs;
+    });
+    return segments;
+}
+
+// ScoreDistribution implementation
+void ScoreDistribution::add(float score) {
+    int bin = static_cast<int>(std::clamp(score, 0.0f, 1.0f) * kBins);
+    m_bins[std::min(bin, kBins - 1)]++;
+    m_count++;
+}
+
+float ScoreDistribution::percentile(double q) const {
+    if (m_count == 0) {
+        return 0.0f;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * (m_count - 1));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBins; ++i) {
+        seen += m_bins[i];
+        if (seen > rank) {
+            return static_cast<float>(i + 1) / kBins;
+        }
+    }
+    return 1.0f;
+}
+
+double ScoreDistribution::fractionAbove(float threshold) const {
+    if (m_count == 0) {
+        return 0.0;
+    }
+    // Bins entirely above the threshold; a score in the straddling bin may go either way
+    int first = std::clamp(static_cast<int>(std::ceil(threshold * kBins)), 0, kBins);
+    uint64_t above = 0;
+    for (int i = first; i < kBins; ++i) {
+        above += m_bins[i];
+    }
+    return static_cast<double>(above) / m_count;
+}
+
+float ScoreDistribution::thresholdForRate(double rate) const {
+    uint64_t allowed = static_cast<uint64_t>(std::max(0.0, rate) * m_count);
+    uint64_t above = 0;
+    for (int i = kBins - 1; i >= 0; --i) {
+        if (above + m_bins[i] > allowed) {
+            return static_cast<float>(i + 1) / kBins;
+        }
+        above += m_bins[i];
+    }
+    return 0.0f;
+}
+
+double ReplayReport::speedup() const {
+    return wallSeconds > 0.0 ? (lastUs - firstUs) / 1e6 / wallSeconds : 0.0;
+}
+
+// ReplayEngine implementation
+ReplayEngine::ReplayEngine(ReplayOptions options)
+    : m_options(options)
+{
+    m_options.queueCapacity = std::max<size_t>(1, m_options.queueCapacity);
+}
+
+void ReplayEngine::addCamera(const std::string& deviceId, std::vector<ReplaySegment> segments) {
+    m_cameras.push_back({deviceId, std::move(segments)});
+}
+
+std::vector<ReplayReport> ReplayEngine::run() {
+    std::vector<ReplayReport> reports(m_cameras.size());
+
+    size_t workers = m_options.maxParallelCameras;
+    if (workers == 0) {
+        workers = std::max<size_t>(1, std::thread::hardware_concurrency() / 2);
+    }
+    workers = std::min(workers, m_cameras.size());
+
+    // One detector for every camera, as in the live engine. Each camera waits
+    // for its own detections, so batches are not held back to fill up: they
+    // take whatever queued while the previous one ran.
+    const GlobalConfig& config = GlobalConfig::instance();
+    DetectionBatcher batcher(createDetectorBackend(config),
+                             static_cast<size_t>(std::max(1, config.detectorMaxBatchSize)),
+                             std::chrono::microseconds(0));
+
+    // Cameras are independent; each worker takes the next one not yet started
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back([this, &reports, &next, &batcher]() {
+            for (size_t index = next++; index < m_cameras.size(); index = next++) {
+                reports[index] = replayCamera(m_cameras[index], batcher);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    batcher.stop();
+
+    return reports;
+}
+
+ReplayReport ReplayEngine::replayCamera(const Camera& camera, DetectionBatcher& batcher) const {
+    ReplayReport report;
+    report.deviceId = camera.deviceId;
+    report.segments = camera.segments.size();
+    auto wallStart = std::chrono::steady_clock::now();
+
+    try {
+        // The same components, configured the same way, as the camera's device agent
+        auto config = GlobalConfig::instance().getDeviceConfig(camera.deviceId);
+        MetadataAnalyzer analyzer(camera.deviceId);
+        AnomalyDetector detector(camera.deviceId);
+        analyzer.setDetectorBackend(std::make_shared<BatchedDetectorBackend>(camera.deviceId, batcher));
+        analyzer.configure(config);
+        detector.configure(config);
+        analyzer.setFramePool(std::make_shared<FramePool>(camera.deviceId, m_options.queueCapacity + 8));
+
+        if (m_options.freshBaseline) {
+            detector.resetBaseline();
+        }
+        BaselineLearner baseline;
+        baseline.setLearning(!detector.hasTrainedModels());
+
+        FrameScheduler scheduler;
+        if (m_options.useScheduler) {
+            scheduler.configure(*config);
+        } else {
+            scheduler.configure(0, 0);
+        }
+        report.configuredThreshold = config->anomalyThreshold;
+
+        SpscQueue<ReplayFrame> queue(m_options.queueCapacity);
+        std::atomic<bool> readerDone{false};
+        std::atomic<bool> stop{false};
+        SegmentReader reader(camera.deviceId, scheduler, queue, stop);
+        std::thread readerThread([&]() {
+            try {
+                reader.read(camera.segments);
+            } catch (const std::exception& e) {
+                Logger::error("ReplayEngine", camera.deviceId + ": read failed: " + e.what());
+            }
+            readerDone = true;
+        });
+
+        try {
+            ReplayFrame frame;
+            for (;;) {
+                // Checked before popping so the last frames are not left behind
+                bool done = readerDone.load();
+                if (!queue.tryPop(frame)) {
+                    if (done) {
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    continue;
+                }
+
+                int64_t timestampUs = frame.timestampUs;
+                FrameAnalysisResult result = analyzer.processFrame(frame.image, timestampUs);
+                frame.image.release();
+
+                // Same order as the agent's analysis stage
+                bool sceneActive = !result.objects.empty() ||
+                                   result.motionInfo.overallMotionLevel > analyzer.motionThreshold();
+                scheduler.reportActivity(timestampUs, sceneActive);
+
+                BaselineStep step = baseline.process(detector, result, timestampUs, *config);
+                report.analyzedFrames++;
+                if (step.sampled) {
+                    report.baselineSamples++;
+                }
+                if (step.learningComplete) {
+                    report.learningCompleteUs = timestampUs;
+                }
+                if (step.scored) {
+                    report.scores.add(result.anomalyScore);
+                    if (step.anomaly) {
+                        report.anomalies++;
+                    }
+                }
+            }
+        } catch (...) {
+            stop = true;
+            readerThread.join();
+            throw;
+        }
+        readerThread.join();
+
+        report.frames = reader.frames;
+        report.skippedFrames = reader.skipped;
+        report.firstUs = reader.firstUs;
+        report.lastUs = reader.lastUs;
+        report.suggestedThreshold = report.scores.thresholdForRate(m_options.targetAnomalyRate);
+
+        if (m_options.saveSnapshots) {
+            report.snapshotSaved = detector.saveModel();
+        }
+    } catch (const std::exception& e) {
+        report.error = e.what();
+        Logger::error("ReplayEngine", camera.deviceId + ": replay failed: " + report.error);
+    }
+
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    Logger::info("ReplayEngine", camera.deviceId + ": " + std::to_string(report.analyzedFrames) + " of " +
+                 std::to_string(report.frames) + " frames analyzed, " +
+                 std::to_string(report.baselineSamples) + " baseline samples, " +
+                 std::to_string(static_cast<int>(report.speedup())) + "x real time");
+    return report;
+}
+
+bool ReplayEngine::writeReport(const std::string& filePath, const std::vector<ReplayReport>& reports) {
+    json cameras = json::array();
+    for (const auto& report : reports) {
+        json camera;
+        camera["deviceId"] = report.deviceId;
+        camera["segments"] = report.segments;
+        camera["frames"] = report.frames;
+        camera["skippedFrames"] = report.skippedFrames;
+        camera["analyzedFrames"] = report.analyzedFrames;
+        camera["baselineSamples"] = report.baselineSamples;
+        camera["firstUs"] = report.firstUs;
+        camera["lastUs"] = report.lastUs;
+        camera["learningCompleteUs"] = report.learningCompleteUs;
+        camera["wallSeconds"] = report.wallSeconds;
+        camera["speedup"] = report.speedup();
+        camera["snapshotSaved"] = report.snapshotSaved;
+        if (!report.error.empty()) {
+            camera["error"] = report.error;
+        }
+
+        const ScoreDistribution& scores = report.scores;
+        json distribution;
+        distribution["count"] = scores.count();
+        distribution["p50"] = scores.percentile(0.5);
+        distribution["p90"] = scores.percentile(0.9);
+        distribution["p95"] = scores.percentile(0.95);
+        distribution["p99"] = scores.percentile(0.99);
+        distribution["p999"] = scores.percentile(0.999);
+        camera["scores"] = distribution;
+
+        json threshold;
+        threshold["configured"] = report.configuredThreshold;
+        threshold["configuredRate"] = scores.fractionAbove(report.configuredThreshold);
+        threshold["anomalies"] = report.anomalies;
+        threshold["suggested"] = report.suggestedThreshold;
+        threshold["suggestedRate"] = scores.fractionAbove(report.suggestedThreshold);
+        camera["threshold"] = threshold;
+
+        cameras.push_back(camera);
+    }
+
+    json j;
+    j["cameras"] = cameras;
+
+    std::ofstream file(filePath, std::ios::trunc);
+    if (!file.is_open()) {
+        Logger::error("ReplayEngine", "Failed to open report for writing: " + filePath);
+        return false;
+    }
+    file << j.dump(4) << std::endl;
+    return static_cast<bool>(file);
+}
+
+} // namespace nx_agent
@@ -0,0 +1,785 @@
+// nx_agent_replication.cpp
+#include "nx_agent_replication.h"
+#include "nx_agent_config.h"
+#include "nx_agent_snapshot.h"
+#include "nx_agent_featurelog.h"
+#include "nx_agent_utils.h"
+
+#include <curl/curl.h>
+
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <set>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace nx_agent {
+
+static_assert(sizeof(ReplicaManifestHeader) % 8 == 0, "ReplicaManifestHeader must stay 8-byte aligned");
+
+namespace {
+
+const char* const kSnapshotKey = "/models.nxsnap";
+const char* const kManifestKey = "/manifest";
+const char* const kSegmentExtension = ".nxflog";
+
+// A failed store is left alone this long by restores
+constexpr std::chrono::seconds kStoreRetryDelay(60);
+
+bool readFile(const std::string& filePath, std::vector<uint8_t>& data) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    return data.empty() || static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), size));
+}
+
+// Durable replacement through a temporary file of its own, so servers
+// writing the same key on a shared store never share one
+bool writeReplicaFile(const std::string& filePath, const std::vector<uint8_t>& data) {
+    return writeFileAtomic(filePath, {{data.data(), data.size()}},
+                           filePath + ".tmp" + std::to_string(std::random_device{}()));
+}
+
+std::string segmentKey(const std::string& deviceId, int64_t day) {
+    return deviceId + "/features/" + std::to_string(day) + kSegmentExtension;
+}
+
+// Feature log days in modelDir, oldest first
+std::vector<int64_t> localSegmentDays(const std::string& modelDir) {
+    std::vector<int64_t> days;
+    FeatureLog log(modelDir + "/features");
+    for (const std::string& segment : log.segments()) {
+        days.push_back(std::stoll(std::filesystem::path(segment).stem().string()));
+    }
+    return days;
+}
+
+int64_t localSnapshotCreatedUs(const std::string& snapshotPath) {
+    MappedSnapshot snapshot;
+    return snapshot.open(snapshotPath) ? snapshot.header().createdUs : 0;
+}
+
+size_t appendResponse(char* data, size_t size, size_t count, void* userdata) {
+    auto* response = static_cast<std::vector<uint8_t>*>(userdata);
+    response->insert(response->end(), data, data + size * count);
+    return size * count;
+}
+
+size_t discardResponse(char*, size_t size, size_t count, void*) {
+    return size * count;
+}
+
+} // namespace
+
+// ReplicaStore implementation
+std::unique_ptr<ReplicaStore> ReplicaStore::create(const std::string& target, int timeoutMs) {
+    if (target.empty()) {
+        return nullptr;
+    }
+    if (target.rfind("http://", 0) == 0 || target.rfind("https://", 0) == 0) {
+        return std::make_unique<HttpReplicaStore>(target, timeoutMs);
+    }
+    return std::make_unique<DirectoryReplicaStore>(target);
+}
+
+// DirectoryReplicaStore implementation
+DirectoryReplicaStore::DirectoryReplicaStore(std::string rootPath)
+    : m_rootPath(std::move(rootPath)) {
+}
+
+ReplicaStore::Status DirectoryReplicaStore::put(const std::string& key, const std::vector<uint8_t>& data) {
+    std::filesystem::path path = std::filesystem::path(m_rootPath) / key;
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec) {
+        return Status::Failed;
+    }
+    return writeReplicaFile(path.string(), data) ? Status::Ok : Status::Failed;
+}
+
+ReplicaStore::Status DirectoryReplicaStore::get(const std::string& key, std::vector<uint8_t>& data) {
+    std::filesystem::path path = std::filesystem::path(m_rootPath) / key;
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        // A root that is not there is an unmounted share, not a missing replica
+        return std::filesystem::is_directory(m_rootPath, ec) ? Status::NotFound : Status::Failed;
+    }
+    return readFile(path.string(), data) ? Status::Ok : Status::Failed;
+}
+
+ReplicaStore::Status DirectoryReplicaStore::remove(const std::string& key) {
+    std::error_code ec;
+    bool removed = std::filesystem::remove(std::filesystem::path(m_rootPath) / key, ec);
+    if (ec) {
+        return Status::Failed;
+    }
+    return removed ? Status::Ok : Status::NotFound;
+}
+
+// HttpReplicaStore implementation
+HttpReplicaStore::HttpReplicaStore(std::string baseUrl, int timeoutMs)
+    : m_baseUrl(std::move(baseUrl)),
+      m_timeoutMs(std::max(1, timeoutMs)) {
+    while (!m_baseUrl.empty() && m_baseUrl.back() == '/') {
+        m_baseUrl.pop_back();
+    }
+
+    // Same once-per-process initialization as the webhook dispatcher
+    static std::once_flag curlInit;
+    std::call_once(curlInit, []() { curl_global_init(CURL_GLOBAL_ALL); });
+
+    curl_slist* headers = nullptr;
+    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+    headers = curl_slist_append(headers, "Expect:");   // No 100-continue round trip
+    m_headers = headers;
+}
+
+HttpReplicaStore::~HttpReplicaStore() {
+    if (m_handle) {
+        curl_easy_cleanup(static_cast<CURL*>(m_handle));
+    }
+    curl_slist_free_all(static_cast<curl_slist*>(m_headers));
+}
+
+ReplicaStore::Status HttpReplicaStore::put(const std::string& key, const std::vector<uint8_t>& data) {
+    return perform("PUT", key, &data, nullptr);
+}
+
+ReplicaStore::Status HttpReplicaStore::get(const std::string& key, std::vector<uint8_t>& data) {
+    data.clear();
+    return perform("GET", key, nullptr, &data);
+}
+
+ReplicaStore::Status HttpReplicaStore::remove(const std::string& key) {
+    return perform("DELETE", key, nullptr, nullptr);
+}
+
+ReplicaStore::Status HttpReplicaStore::perform(const char* method, const std::string& key,
+                                               const std::vector<uint8_t>* body,
+                                               std::vector<uint8_t>* response) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_handle) {
+        m_handle = curl_easy_init();
+        if (!m_handle) {
+            return Status::Failed;
+        }
+    }
+
+    // Reset keeps the connection to the store alive for the next request
+    CURL* handle = static_cast<CURL*>(m_handle);
+    curl_easy_reset(handle);
+    std::string url = urlFor(key);
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    if (std::strcmp(method, "GET") == 0) {
+        curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, method);
+    }
+    if (body) {
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, reinterpret_cast<const char*>(body->data()));
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, static_cast<long>(body->size()));
+        curl_easy_setopt(handle, CURLOPT_HTTPHEADER, static_cast<curl_slist*>(m_headers));
+    }
+    if (response) {
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, appendResponse);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, response);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, discardResponse);
+    }
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(m_timeoutMs));
+    curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(std::min(m_timeoutMs, 3000)));
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    CURLcode result = curl_easy_perform(handle);
+    if (result != CURLE_OK) {
+        Logger::warning("ModelReplication", std::string(method) + " " + url + " failed: " +
+                        curl_easy_strerror(result));
+        return Status::Failed;
+    }
+
+    long status = 0;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    if (status == 404) {
+        return Status::NotFound;
+    }
+    if (status < 200 || status >= 300) {
+        Logger::warning("ModelReplication", std::string(method) + " " + url + " returned HTTP " +
+                        std::to_string(status));
+        return Status::Failed;
+    }
+    return Status::Ok;
+}
+
+std::string HttpReplicaStore::urlFor(const std::string& key) const {
+    // Device IDs may hold anything; only the key's separators stay as they are
+    static const char* const kHex = "0123456789ABCDEF";
+    std::string url = m_baseUrl + "/";
+    for (unsigned char c : key) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || c == '/') {
+            url += static_cast<char>(c);
+        } else {
+            url += '%';
+            url += kHex[c >> 4];
+            url += kHex[c & 0x0f];
+        }
+    }
+    return url;
+}
+
+// ModelReplicationService implementation
+ModelReplicationService& ModelReplicationService::instance() {
+    static ModelReplicationService instance;
+    return instance;
+}
+
+ModelReplicationService::ModelReplicationService() {
+    // Make sure the config outlives us; the worker reads the pacing from it
+    GlobalConfig::instance();
+
+#ifndef _WIN32
+    char hostname[64] = {};
+    if (gethostname(hostname, sizeof(hostname) - 1) == 0) {
+        m_origin = hostname;
+    }
+#endif
+    if (m_origin.empty()) {
+        m_origin = "unknown";
+    }
+}
+
+ModelReplicationService::~ModelReplicationService() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeCv.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    reapRestores(true);
+
+    // The final saves of the detectors still go out
+    flush();
+}
+
+void ModelReplicationService::setStore(std::shared_ptr<ReplicaStore> store) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_store = std::move(store);
+    m_storeResolved = true;
+    m_storeDownUntil = Clock::time_point();
+}
+
+std::shared_ptr<ReplicaStore> ModelReplicationService::store() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_storeResolved) {
+        m_storeResolved = true;
+        const GlobalConfig& config = GlobalConfig::instance();
+        m_store = ReplicaStore::create(config.replicationTarget, config.httpTimeoutMs);
+        if (m_store) {
+            Logger::info("ModelReplication", "Replicating models to " + config.replicationTarget);
+        }
+    }
+    return m_store;
+}
+
+void ModelReplicationService::notifySaved(const std::string& deviceId, const std::string& modelDir) {
+    if (!store()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // dueAt already holds the earliest time the interval allows
+        Device& device = m_devices[deviceId];
+        device.modelDir = modelDir;
+        device.pending = true;
+        if (!m_worker.joinable() && !m_stopping) {
+            m_worker = std::thread(&ModelReplicationService::run, this);
+        }
+    }
+    m_wakeCv.notify_all();
+}
+
+bool ModelReplicationService::restore(const std::string& deviceId, const std::string& modelDir) {
+    std::shared_ptr<ReplicaStore> store = this->store();
+    if (!store) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (Clock::now() < m_storeDownUntil) {
+            return false;
+        }
+    }
+    reapRestores(false);
+
+    auto attempt = std::make_shared<RestoreAttempt>();
+    attempt->thread = std::thread([this, store, attempt, deviceId, modelDir]() {
+        restoreReplica(deviceId, modelDir, *store, *attempt);
+        {
+            std::lock_guard<std::mutex> lock(attempt->mutex);
+            attempt->done = true;
+        }
+        attempt->doneCv.notify_all();
+    });
+
+    auto timeout = std::chrono::milliseconds(std::max(1, GlobalConfig::instance().replicationRestoreTimeoutMs));
+    bool installed = false;
+    {
+        std::unique_lock<std::mutex> lock(attempt->mutex);
+        if (!attempt->doneCv.wait_for(lock, timeout, [&attempt]() { return attempt->done; })) {
+            attempt->abandoned = true;
+        }
+        installed = attempt->installed;
+    }
+
+    if (!attempt->abandoned) {
+        attempt->thread.join();
+        return installed;
+    }
+
+    Logger::warning("ModelReplication", "Replica store too slow; " + deviceId + " starts from local models");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_storeDownUntil = Clock::now() + kStoreRetryDelay;
+    m_stats.restoreTimeouts++;
+    m_restores.push_back(std::move(attempt));
+    return installed;
+}
+
+bool ModelReplicationService::restoreReplica(const std::string& deviceId, const std::string& modelDir,
+                                             ReplicaStore& store, RestoreAttempt& attempt)
+{
+    Manifest manifest;
+    ReplicaStore::Status status = getManifest(store, deviceId, manifest);
+    if (status == ReplicaStore::Status::NotFound) {
+        return false;
+    }
+    if (status == ReplicaStore::Status::Failed) {
+        Logger::warning("ModelReplication", "Replica store unavailable; " + deviceId + " starts from local models");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_storeDownUntil = Clock::now() + kStoreRetryDelay;
+        m_stats.failures++;
+        return false;
+    }
+
+    // Models at least as new as the replica stay
+    std::string snapshotPath = modelDir + kSnapshotKey;
+    int64_t localCreatedUs = localSnapshotCreatedUs(snapshotPath);
+    if (manifest.header.snapshotCreatedUs <= localCreatedUs) {
+        return false;
+    }
+
+    std::vector<uint8_t> snapshot;
+    bool installed = false;
+    bool discarded = false;
+    if (store.get(deviceId + kSnapshotKey, snapshot) == ReplicaStore::Status::Ok) {
+        std::error_code ec;
+        std::filesystem::create_directories(modelDir, ec);
+        std::string tempPath = snapshotPath + ".replica";
+        if (writeReplicaFile(tempPath, snapshot)) {
+            // Validated in full before it replaces anything
+            int64_t createdUs = localSnapshotCreatedUs(tempPath);
+            if (createdUs > localCreatedUs) {
+                // Once the detector has given up waiting it owns the directory
+                std::lock_guard<std::mutex> lock(attempt.mutex);
+                discarded = attempt.abandoned;
+                if (!discarded) {
+                    std::filesystem::rename(tempPath, snapshotPath, ec);
+                    installed = attempt.installed = !ec;
+                    syncParentDirectory(snapshotPath);
+                }
+            }
+            if (!installed) {
+                std::filesystem::remove(tempPath, ec);
+            }
+        }
+    }
+    if (discarded) {
+        Logger::info("ModelReplication", "Discarded the replica of " + deviceId + ", fetched after it started");
+        return false;
+    }
+    if (!installed) {
+        Logger::warning("ModelReplication", "Replica of " + deviceId + " could not be installed");
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.failures++;
+        return false;
+    }
+
+    std::vector<int64_t> localDays = localSegmentDays(modelDir);
+    std::vector<int64_t> missingDays;
+    for (int64_t day : manifest.days) {
+        if (!std::binary_search(localDays.begin(), localDays.end(), day)) {
+            missingDays.push_back(day);
+        }
+    }
+
+    manifest.header.origin[sizeof(manifest.header.origin) - 1] = '\0';
+    Logger::info("ModelReplication", "Restored models of " + deviceId + " replicated by " +
+                 manifest.header.origin + " (" + std::to_string(missingDays.size()) +
+                 " feature log days to fetch)");
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.restored++;
+        Device& device = m_devices[deviceId];
+        device.modelDir = modelDir;
+        device.sentChecksum = crc32(snapshot.data(), snapshot.size());
+        device.sentSnapshot = true;
+        device.sequence = std::max(device.sequence, manifest.header.sequence);
+        device.sentThroughDay = manifest.days.empty() ? -1 : manifest.days.back();
+        device.fetchDays = std::move(missingDays);
+        if (!device.fetchDays.empty() && !m_worker.joinable() && !m_stopping) {
+            m_worker = std::thread(&ModelReplicationService::run, this);
+        }
+    }
+    m_wakeCv.notify_all();
+    return true;
+}
+
+void ModelReplicationService::reapRestores(bool wait) {
+    std::vector<std::shared_ptr<RestoreAttempt>> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_restores.begin(); it != m_restores.end();) {
+            bool done = wait;
+            if (!done) {
+                std::lock_guard<std::mutex> attemptLock((*it)->mutex);
+                done = (*it)->done;
+            }
+            if (done) {
+                finished.push_back(std::move(*it));
+                it = m_restores.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto& attempt : finished) {
+        attempt->thread.join();
+    }
+}
+
+void ModelReplicationService::flush() {
+    std::shared_ptr<ReplicaStore> store = this->store();
+    if (!store) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, Device>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& pair : m_devices) {
+            Device& device = pair.second;
+            if (device.pending || !device.fetchDays.empty()) {
+                jobs.emplace_back(pair.first, device);
+                device.pending = false;
+                device.fetchDays.clear();
+            }
+        }
+    }
+
+    for (auto& job : jobs) {
+        if (!job.second.fetchDays.empty()) {
+            fetchSegments(job.first, job.second.modelDir, job.second.fetchDays, *store);
+        }
+        if (job.second.pending) {
+            replicate(job.first, job.second, *store, false);
+        }
+    }
+}
+
+ReplicationStats ModelReplicationService::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ModelReplicationService::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping) {
+        // Earliest device whose interval has passed
+        Clock::time_point now = Clock::now();
+        Clock::time_point nextDue = Clock::time_point::max();
+        auto due = m_devices.end();
+        for (auto it = m_devices.begin(); it != m_devices.end(); ++it) {
+            const Device& device = it->second;
+            if (!device.pending && device.fetchDays.empty()) {
+                continue;
+            }
+            if (!device.fetchDays.empty() || device.dueAt <= now) {
+                due = it;
+                break;
+            }
+            nextDue = std::min(nextDue, device.dueAt);
+        }
+        if (due == m_devices.end() || !m_store) {
+            if (nextDue == Clock::time_point::max()) {
+                m_wakeCv.wait(lock);
+            } else {
+                m_wakeCv.wait_until(lock, nextDue);
+            }
+            continue;
+        }
+
+        std::string deviceId = due->first;
+        Device job = due->second;
+        std::shared_ptr<ReplicaStore> store = m_store;
+        due->second.fetchDays.clear();
+        if (job.pending) {
+            int intervalSecs = std::max(0, GlobalConfig::instance().replicationIntervalSecs);
+            due->second.pending = false;
+            due->second.dueAt = now + std::chrono::seconds(intervalSecs);
+        }
+
+        lock.unlock();
+        if (!job.fetchDays.empty()) {
+            fetchSegments(deviceId, job.modelDir, job.fetchDays, *store);
+        }
+        if (job.pending) {
+            replicate(deviceId, job, *store, true);
+        }
+        lock.lock();
+    }
+}
+
+void ModelReplicationService::replicate(const std::string& deviceId, Device state, ReplicaStore& store, bool paced) {
+    std::vector<uint8_t> snapshot;
+    if (!readFile(state.modelDir + kSnapshotKey, snapshot) || snapshot.size() < sizeof(SnapshotHeader)) {
+        return;
+    }
+    SnapshotHeader snapshotHeader;
+    std::memcpy(&snapshotHeader, snapshot.data(), sizeof(snapshotHeader));
+    if (snapshotHeader.magic != kSnapshotMagic) {
+        return;
+    }
+    uint32_t checksum = crc32(snapshot.data(), snapshot.size());
+
+    // Completed days only: the newest segment is still being appended to
+    std::vector<int64_t> localDays = localSegmentDays(state.modelDir);
+    int64_t openDay = localDays.empty() ? -1 : localDays.back();
+    int64_t finishedThroughDay = localDays.size() > 1 ? localDays[localDays.size() - 2] : -1;
+
+    // Nothing new since the last replication: no round trip to the store
+    if (state.sentSnapshot && state.sentChecksum == checksum && finishedThroughDay <= state.sentThroughDay) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.unchanged++;
+        return;
+    }
+
+    // Retried once the interval (at least the store retry delay) has passed
+    auto retryLater = [&]() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.failures++;
+        Device& device = m_devices[deviceId];
+        device.pending = true;
+        device.dueAt = std::max(device.dueAt, Clock::now() + kStoreRetryDelay);
+    };
+
+    Manifest remote;
+    ReplicaStore::Status status = getManifest(store, deviceId, remote);
+    if (status == ReplicaStore::Status::Failed) {
+        retryLater();
+        return;
+    }
+    bool haveRemote = status == ReplicaStore::Status::Ok;
+    if (haveRemote && remote.header.snapshotCreatedUs > snapshotHeader.createdUs) {
+        // The camera moved on to a server with newer models; theirs stay
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.superseded++;
+        return;
+    }
+
+    bool snapshotChanged = !haveRemote || remote.header.snapshotChecksum != checksum;
+    std::set<int64_t> remoteDays(remote.days.begin(), remote.days.end());
+    std::vector<int64_t> newDays;
+    for (int64_t day : localDays) {
+        if (day != openDay && remoteDays.count(day) == 0) {
+            newDays.push_back(day);
+        }
+    }
+
+    if (!snapshotChanged && newDays.empty()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Device& device = m_devices[deviceId];
+        device.sentChecksum = checksum;
+        device.sentSnapshot = true;
+        device.sentThroughDay = std::max(device.sentThroughDay, finishedThroughDay);
+        m_stats.unchanged++;
+        return;
+    }
+
+    if (snapshotChanged && !putPaced(store, deviceId + kSnapshotKey, snapshot, paced)) {
+        retryLater();
+        return;
+    }
+
+    uint64_t segmentsSent = 0;
+    int64_t sentThroughDay = finishedThroughDay;
+    for (int64_t day : newDays) {
+        std::vector<uint8_t> segment;
+        std::string path = state.modelDir + "/features/" + std::to_string(day) + kSegmentExtension;
+        if (!readFile(path, segment)) {
+            continue;
+        }
+        if (!putPaced(store, segmentKey(deviceId, day), segment, paced)) {
+            // Sent with the next replication
+            sentThroughDay = day - 1;
+            break;
+        }
+        remoteDays.insert(day);
+        segmentsSent++;
+    }
+
+    // Days past the retention leave the store with the local log
+    int retentionDays = GlobalConfig::instance().getDeviceConfig(deviceId)->baselineDurationDays;
+    if (retentionDays > 0 && openDay >= 0) {
+        for (auto it = remoteDays.begin(); it != remoteDays.end();) {
+            if (*it < openDay - retentionDays && store.remove(segmentKey(deviceId, *it)) != ReplicaStore::Status::Failed) {
+                it = remoteDays.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // The manifest goes last, so it only lists objects already stored
+    Manifest manifest;
+    manifest.header.sequence = std::max(state.sequence, remote.header.sequence) + 1;
+    manifest.header.snapshotCreatedUs = snapshotHeader.createdUs;
+    manifest.header.snapshotChecksum = checksum;
+    std::strncpy(manifest.header.origin, m_origin.c_str(), sizeof(manifest.header.origin) - 1);
+    manifest.days.assign(remoteDays.begin(), remoteDays.end());
+    if (!putPaced(store, deviceId + kManifestKey, encodeManifest(manifest), false)) {
+        retryLater();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Device& device = m_devices[deviceId];
+    device.sentChecksum = checksum;
+    device.sentSnapshot = true;
+    device.sequence = manifest.header.sequence;
+    device.sentThroughDay = std::max(device.sentThroughDay, sentThroughDay);
+    if (snapshotChanged) {
+        m_stats.replicated++;
+    }
+    m_stats.segments += segmentsSent;
+}
+
+void ModelReplicationService::fetchSegments(const std::string& deviceId, const std::string& modelDir,
+                                            const std::vector<int64_t>& days, ReplicaStore& store) {
+    std::string directory = modelDir + "/features";
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+
+    size_t fetched = 0;
+    for (int64_t day : days) {
+        std::string path = directory + "/" + std::to_string(day) + kSegmentExtension;
+        if (std::filesystem::exists(path, ec)) {
+            continue;
+        }
+        std::vector<uint8_t> segment;
+        ReplicaStore::Status status = store.get(segmentKey(deviceId, day), segment);
+        if (status == ReplicaStore::Status::Failed) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stats.failures++;
+            break;
+        }
+        uint32_t magic = 0;
+        if (status != ReplicaStore::Status::Ok || segment.size() < sizeof(FeatureLogBlockHeader)) {
+            continue;
+        }
+        std::memcpy(&magic, segment.data(), sizeof(magic));
+        if (magic == kFeatureLogMagic && writeReplicaFile(path, segment)) {
+            fetched++;
+        }
+    }
+    if (fetched > 0) {
+        Logger::info("ModelReplication", "Fetched " + std::to_string(fetched) + " feature log days of " + deviceId);
+    }
+}
+
+bool ModelReplicationService::putPaced(ReplicaStore& store, const std::string& key,
+                                       const std::vector<uint8_t>& data, bool paced) {
+    int maxKBps = GlobalConfig::instance().replicationMaxKBps;
+    if (paced && maxKBps > 0) {
+        // Each upload books its share of the bandwidth; the next one starts after it.
+        // Stopping cuts the wait short so the final flush is not held up.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Clock::time_point start = std::max(Clock::now(), m_nextSendAt);
+        auto durationUs = static_cast<int64_t>(data.size()) * 1000000 / (static_cast<int64_t>(maxKBps) * 1024);
+        m_nextSendAt = start + std::chrono::microseconds(durationUs);
+        m_wakeCv.wait_until(lock, start, [this]() { return m_stopping; });
+    }
+
+    ReplicaStore::Status status = store.put(key, data);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (status != ReplicaStore::Status::Ok) {
+        return false;
+    }
+    m_stats.bytesSent += data.size();
+    return true;
+}
+
+ReplicaStore::Status ModelReplicationService::getManifest(ReplicaStore& store, const std::string& deviceId,
+                                                          Manifest& manifest) {
+    std::vector<uint8_t> data;
+    ReplicaStore::Status status = store.get(deviceId + kManifestKey, data);
+    if (status != ReplicaStore::Status::Ok) {
+        return status;
+    }
+
+    // A damaged manifest is no replica; the next replication rewrites it
+    if (data.size() < sizeof(ReplicaManifestHeader)) {
+        return ReplicaStore::Status::NotFound;
+    }
+    std::memcpy(&manifest.header, data.data(), sizeof(manifest.header));
+    const ReplicaManifestHeader& header = manifest.header;
+    if (header.magic != kReplicaManifestMagic || header.version != kReplicaManifestVersion ||
+        data.size() != sizeof(header) + static_cast<size_t>(header.segmentCount) * sizeof(int64_t)) {
+        return ReplicaStore::Status::NotFound;
+    }
+    uint32_t checksum = header.checksum;
+    std::memset(data.data() + offsetof(ReplicaManifestHeader, checksum), 0, sizeof(checksum));
+    if (crc32(data.data(), data.size()) != checksum) {
+        return ReplicaStore::Status::NotFound;
+    }
+
+    manifest.days.resize(header.segmentCount);
+    if (header.segmentCount > 0) {
+        std::memcpy(manifest.days.data(), data.data() + sizeof(header), header.segmentCount * sizeof(int64_t));
+    }
+    return ReplicaStore::Status::Ok;
+}
+
+std::vector<uint8_t> ModelReplicationService::encodeManifest(Manifest& manifest) {
+    ReplicaManifestHeader& header = manifest.header;
+    header.magic = kReplicaManifestMagic;
+    header.version = kReplicaManifestVersion;
+    header.checksum = 0;
+    header.segmentCount = static_cast<uint32_t>(manifest.days.size());
+    header.reserved = 0;
+
+    std::vector<uint8_t> data(sizeof(header) + manifest.days.size() * sizeof(int64_t));
+    std::memcpy(data.data(), &header, sizeof(header));
+    if (!manifest.days.empty()) {
+        std::memcpy(data.data() + sizeof(header), manifest.days.data(), manifest.days.size() * sizeof(int64_t));
+    }
+    uint32_t checksum = crc32(data.data(), data.size());
+    std::memcpy(data.data() + offsetof(ReplicaManifestHeader, checksum), &checksum, sizeof(checksum));
+    header.checksum = checksum;
+    return data;
+}
+
+} // namespace nx_agent
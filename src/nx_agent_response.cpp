@@ -2,29 +2,19 @@
 #include "nx_agent_response.h"
 #include "nx_agent_config.h"
 #include "nx_agent_metadata.h"
+#include "nx_agent_executor.h"
+#include "nx_agent_http.h"
+#include "nx_agent_incident.h"
 
 #include <iostream>
 #include <chrono>
 #include <algorithm>
 #include <cstdlib>
-#include <curl/curl.h>
 #include <thread>
 #include <future>
 
 namespace nx_agent {
 
-// Helper function for CURL response data
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* s) {
-    size_t newLength = size * nmemb;
-    try {
-        s->append((char*)contents, newLength);
-        return newLength;
-    } catch(std::bad_alloc& e) {
-        // Handle memory problem
-        return 0;
-    }
-}
-
 // ResponseProtocol implementation
 ResponseProtocol::ResponseProtocol(const std::string& deviceId)
     : m_deviceId(deviceId)
@@ -68,18 +58,17 @@ ResponseProtocol::ResponseProtocol(const std::string& deviceId)
         // Add SIP call for unknown visitor (higher priority anomaly)
         addResponseAction("UnknownVisitor", sipAction);
     }
-    
-    // Initialize CURL for HTTP requests
-    curl_global_init(CURL_GLOBAL_ALL);
 }
 
 ResponseProtocol::~ResponseProtocol() {
-    // Clean up CURL
-    curl_global_cleanup();
+    // Queued actions still reference this protocol
+    while (m_inFlightActions.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
 }
 
-void ResponseProtocol::configure(std::shared_ptr<DeviceConfig> config) {
-    m_config = config;
+void ResponseProtocol::configure(std::shared_ptr<const DeviceConfig> config) {
+    std::atomic_store(&m_config, std::move(config));
     
     // Reconfigure response actions based on new settings
     // Here you might reload actions from a config file or database
@@ -173,6 +162,19 @@ void ResponseProtocol::removeResponseAction(const std::string& anomalyType, cons
     }
 }
 
+void ResponseProtocol::setExecutor(std::shared_ptr<TaskExecutor> executor) {
+    m_executor = std::move(executor);
+}
+
+void ResponseProtocol::setHttpDispatcher(std::shared_ptr<HttpDispatcher> dispatcher) {
+    std::lock_guard<std::mutex> lock(m_httpMutex);
+    m_httpDispatcher = std::move(dispatcher);
+}
+
+void ResponseProtocol::setIncidentCorrelator(std::shared_ptr<IncidentCorrelator> correlator) {
+    m_incidentCorrelator = std::move(correlator);
+}
+
 void ResponseProtocol::setNxEventCallback(NxEventCallback callback) {
     m_nxEventCallback = callback;
 }
@@ -240,6 +242,30 @@ void ResponseProtocol::triggerResponses(const FrameAnalysisResult& result, const
             continue;
         }
         
+        // Actions that leave the VMS are shared with the other cameras of the site
+        bool external = action.type == ResponseAction::Type::HTTP_REQUEST ||
+                        action.type == ResponseAction::Type::SIP_CALL ||
+                        action.type == ResponseAction::Type::EXECUTE_COMMAND;
+        if (external && m_incidentCorrelator) {
+            // The correlator runs the action once the incident's other reports
+            // are merged in; the count keeps this protocol alive until then
+            m_inFlightActions++;
+            IncidentDecision decision = m_incidentCorrelator->report(
+                std::atomic_load(&m_config)->siteId, tracker.anomalyType, action.name, m_deviceId,
+                result.anomalyScore,
+                [this, action, result](const IncidentSummary& incident) {
+                    executeAction(action, result, &incident);
+                    m_inFlightActions--;
+                });
+            if (decision.lead) {
+                action.lastTriggeredTime = now;
+            } else {
+                // Merged into another camera's incident
+                m_inFlightActions--;
+            }
+            continue;
+        }
+        
         // Execute the action
         bool success = executeAction(action, result);
         
@@ -250,7 +276,9 @@ void ResponseProtocol::triggerResponses(const FrameAnalysisResult& result, const
     }
 }
 
-bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAnalysisResult& result) {
+bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAnalysisResult& result,
+                                     const IncidentSummary* incident)
+{
     // Execute based on action type
     switch (action.type) {
         case ResponseAction::Type::LOG_ONLY:
@@ -271,26 +299,33 @@ bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAn
             }
             
         case ResponseAction::Type::HTTP_REQUEST:
-            // Make HTTP request in a separate thread to avoid blocking
+            // Queue the HTTP request; the dispatcher never blocks the caller
             if (!action.target.empty()) {
                 // Create payload with anomaly details
                 std::string payload = action.payload;
                 if (payload.empty()) {
+                    // An incident reports every camera merged into it
+                    std::string cameras = "\"" + m_deviceId + "\"";
+                    float score = result.anomalyScore;
+                    if (incident) {
+                        cameras.clear();
+                        for (const auto& deviceId : incident->devices) {
+                            cameras += (cameras.empty() ? "\"" : ",\"") + deviceId + "\"";
+                        }
+                        score = std::max(score, incident->maxScore);
+                    }
                     payload = "{"
                         "\"anomalyType\":\"" + result.anomalyType + "\","
                         "\"description\":\"" + result.anomalyDescription + "\","
-                        "\"score\":" + std::to_string(result.anomalyScore) + ","
+                        "\"score\":" + std::to_string(score) + ","
                         "\"deviceId\":\"" + m_deviceId + "\","
+                        "\"cameras\":[" + cameras + "],"
+                        "\"incidentId\":" + std::to_string(incident ? incident->id : 0) + ","
                         "\"timestamp\":" + std::to_string(result.timestampUs) +
                         "}";
                 }
                 
-                // Launch async HTTP request
-                std::thread([this, url = action.target, payload]() {
-                    this->sendHttpRequest(url, payload);
-                }).detach();
-                
-                return true;
+                return sendHttpRequest(action.target, payload);
             }
             return false;
             
@@ -298,13 +333,15 @@ bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAn
             // Make SIP call if enabled
             if (GlobalConfig::instance().enableSipIntegration && !action.target.empty()) {
                 // Format message
-                std::string message = "Anomaly detected on camera " + m_deviceId + 
-                                     ". Type: " + result.anomalyType;
+                std::string message = incident && incident->devices.size() > 1
+                    ? "Anomaly detected on " + std::to_string(incident->devices.size()) + " cameras"
+                    : "Anomaly detected on camera " + m_deviceId;
+                message += ". Type: " + result.anomalyType;
                 
-                // Launch in separate thread
-                std::thread([this, number = action.target, message]() {
+                // Launch asynchronously
+                dispatchAsync([this, number = action.target, message]() {
                     this->makeSipCall(number, message);
-                }).detach();
+                });
                 
                 return true;
             }
@@ -313,10 +350,10 @@ bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAn
         case ResponseAction::Type::EXECUTE_COMMAND:
             // Execute local command
             if (!action.target.empty()) {
-                // Launch in separate thread
-                std::thread([this, command = action.target]() {
+                // Launch asynchronously
+                dispatchAsync([this, command = action.target]() {
                     this->executeCommand(command);
-                }).detach();
+                });
                 
                 return true;
             }
@@ -328,42 +365,37 @@ bool ResponseProtocol::executeAction(const ResponseAction& action, const FrameAn
     }
 }
 
+void ResponseProtocol::dispatchAsync(std::function<void()> action) {
+    m_inFlightActions++;
+    auto task = [this, action = std::move(action)]() {
+        try {
+            action();
+        } catch (const std::exception& e) {
+            std::cerr << "Response action failed: " << e.what() << std::endl;
+        }
+        m_inFlightActions--;
+    };
+    
+    if (m_executor) {
+        m_executor->submit(m_deviceId, TaskPriority::Alarm, std::move(task));
+    } else {
+        std::thread(std::move(task)).detach();
+    }
+}
+
 bool ResponseProtocol::sendHttpRequest(const std::string& url, const std::string& payload) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        std::cerr << "Failed to initialize CURL" << std::endl;
-        return false;
+    std::shared_ptr<HttpDispatcher> dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(m_httpMutex);
+        if (!m_httpDispatcher) {
+            m_httpDispatcher = std::make_shared<HttpDispatcher>(
+                httpDispatcherOptions(GlobalConfig::instance()));
+        }
+        dispatcher = m_httpDispatcher;
     }
     
-    std::string response;
-    
-    // Set URL
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    
-    // Set POST data
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
-    
-    // Set response callback
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    
-    // Set headers
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    
-    // Set timeout
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);
-    
-    // Perform request
-    CURLcode res = curl_easy_perform(curl);
-    
-    // Clean up
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-    
-    if (res != CURLE_OK) {
-        std::cerr << "HTTP request failed: " << curl_easy_strerror(res) << std::endl;
+    if (!dispatcher->post(url, payload)) {
+        std::cerr << "HTTP request to " << url << " dropped: dispatcher queue full" << std::endl;
         return false;
     }
     
@@ -0,0 +1,64 @@
+// nx_agent_scheduler.cpp
+#include "nx_agent_scheduler.h"
+#include "nx_agent_config.h"
+
+namespace nx_agent {
+
+// FrameScheduler implementation
+void FrameScheduler::configure(int64_t idleIntervalUs, int64_t activityHoldUs) {
+    m_idleIntervalUs = idleIntervalUs;
+    m_activityHoldUs = activityHoldUs > 0 ? activityHoldUs : 0;
+}
+
+void FrameScheduler::configure(const DeviceConfig& config) {
+    int64_t idleIntervalUs = 0;
+    if (config.enableAdaptiveFrameRate && config.idleFrameRate > 0.0f) {
+        idleIntervalUs = static_cast<int64_t>(1000000.0f / config.idleFrameRate);
+    }
+    configure(idleIntervalUs, static_cast<int64_t>(config.activityHoldSecs) * 1000000);
+}
+
+bool FrameScheduler::shouldProcess(int64_t timestampUs) {
+    m_considered++;
+
+    bool process = true;
+    if (mode(timestampUs) == Mode::Idle && m_hasProcessed) {
+        int64_t sinceLast = timestampUs - m_lastProcessedUs;
+
+        // A timestamp going backwards means the stream restarted or seeked
+        process = sinceLast < 0 || sinceLast >= m_idleIntervalUs.load();
+    }
+
+    if (!process) {
+        m_skipped++;
+        return false;
+    }
+
+    m_lastProcessedUs = timestampUs;
+    m_hasProcessed = true;
+    return true;
+}
+
+void FrameScheduler::reportActivity(int64_t timestampUs, bool active) {
+    if (active) {
+        m_lastActivityUs = timestampUs;
+        m_hasActivity = true;
+    }
+}
+
+FrameScheduler::Mode FrameScheduler::mode(int64_t timestampUs) const {
+    if (m_idleIntervalUs.load() <= 0) {
+        return Mode::Active;
+    }
+
+    if (m_hasActivity.load()) {
+        int64_t sinceActivity = timestampUs - m_lastActivityUs.load();
+        if (sinceActivity < 0 || sinceActivity < m_activityHoldUs.load()) {
+            return Mode::Active;
+        }
+    }
+
+    return Mode::Idle;
+}
+
+} // namespace nx_agent
@@ -0,0 +1,305 @@
+// nx_agent_snapshot.cpp
+#include "nx_agent_snapshot.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nx_agent {
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "SnapshotHeader must keep records 8-byte aligned");
+static_assert(sizeof(SnapshotRecord) % 8 == 0, "SnapshotRecord must keep arrays 8-byte aligned");
+
+uint32_t crc32(const void* data, size_t length, uint32_t seed) {
+    static const auto table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = ~seed;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+bool writeFileAtomic(const std::string& filePath, std::initializer_list<FileChunk> chunks,
+                     const std::string& tempPath) {
+    std::string tmpPath = tempPath.empty() ? filePath + ".tmp" : tempPath;
+
+    #ifndef _WIN32
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = true;
+    for (const FileChunk& chunk : chunks) {
+        const char* data = static_cast<const char*>(chunk.data);
+        size_t remaining = chunk.size;
+        while (written && remaining > 0) {
+            ssize_t count = ::write(fd, data, remaining);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            written = count > 0;
+            data += written ? count : 0;
+            remaining -= written ? static_cast<size_t>(count) : 0;
+        }
+    }
+    // The contents must be on disk before the rename can be
+    written = written && ::fsync(fd) == 0;
+    written = ::close(fd) == 0 && written;
+    #else
+    bool written = false;
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        for (const FileChunk& chunk : chunks) {
+            file.write(static_cast<const char*>(chunk.data), static_cast<std::streamsize>(chunk.size));
+        }
+        file.flush();
+        written = static_cast<bool>(file);
+    }
+    #endif
+
+    std::error_code ec;
+    if (written) {
+        std::filesystem::rename(tmpPath, filePath, ec);
+    }
+    if (!written || ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return syncParentDirectory(filePath);
+}
+
+bool syncParentDirectory(const std::string& filePath) {
+    #ifndef _WIN32
+    std::string directory = std::filesystem::path(filePath).parent_path().string();
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+    #else
+    // NTFS journals renames; there is no directory handle to flush
+    return true;
+    #endif
+}
+
+// Header checksum is computed with the checksum field zeroed
+static uint32_t snapshotChecksum(const SnapshotHeader& header, const uint8_t* records, size_t length) {
+    SnapshotHeader copy = header;
+    copy.checksum = 0;
+    uint32_t crc = crc32(&copy, sizeof(copy));
+    return crc32(records, length, crc);
+}
+
+// SnapshotWriter implementation
+bool SnapshotWriter::write(const std::string& filePath, const std::string& deviceId, double decay,
+                           const std::vector<SnapshotEntry>& entries) {
+    uint32_t featureCount = 0;
+    for (const auto& entry : entries) {
+        if (!entry.mean.empty()) {
+            featureCount = static_cast<uint32_t>(entry.mean.size());
+            break;
+        }
+    }
+
+    // Write the covariance layout only when some model has off-diagonal state
+    size_t coMomentCount = MappedSnapshot::coMomentCount(featureCount);
+    bool covariance = false;
+    for (const auto& entry : entries) {
+        if (coMomentCount > 0 && entry.coMoment.size() == coMomentCount) {
+            covariance = true;
+            break;
+        }
+    }
+
+    // Records are fixed-size; skip anything that does not match
+    std::vector<uint8_t> records;
+    uint32_t recordCount = 0;
+    size_t stride = MappedSnapshot::recordStride(featureCount, covariance);
+
+    for (const auto& entry : entries) {
+        if (entry.mean.size() != featureCount || entry.m2.size() != featureCount) {
+            continue;
+        }
+
+        SnapshotRecord record = {};
+        record.key = entry.key;
+        record.sampleCount = entry.sampleCount;
+        record.weight = entry.weight;
+
+        size_t offset = records.size();
+        records.resize(offset + stride);
+        std::memcpy(&records[offset], &record, sizeof(record));
+        std::memcpy(&records[offset + sizeof(record)], entry.mean.data(), featureCount * sizeof(double));
+        std::memcpy(&records[offset + sizeof(record) + featureCount * sizeof(double)],
+                    entry.m2.data(), featureCount * sizeof(double));
+        if (covariance && entry.coMoment.size() == coMomentCount) {
+            std::memcpy(&records[offset + sizeof(record) + 2 * featureCount * sizeof(double)],
+                        entry.coMoment.data(), coMomentCount * sizeof(double));
+        } else if (covariance) {
+            // Diagonal model among covariance ones: uncorrelated features
+            std::memset(&records[offset + sizeof(record) + 2 * featureCount * sizeof(double)],
+                        0, coMomentCount * sizeof(double));
+        }
+        recordCount++;
+    }
+
+    SnapshotHeader header = {};
+    header.magic = kSnapshotMagic;
+    header.version = covariance ? kSnapshotCovarianceVersion : kSnapshotVersion;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.recordCount = recordCount;
+    header.featureCount = featureCount;
+    header.createdUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    header.decay = decay;
+    std::strncpy(header.deviceId, deviceId.c_str(), sizeof(header.deviceId) - 1);
+    header.checksum = snapshotChecksum(header, records.data(), records.size());
+
+    // Readers never see a torn file, not even after a power loss
+    if (!writeFileAtomic(filePath, {{&header, sizeof(header)}, {records.data(), records.size()}})) {
+        std::cerr << "Failed to write snapshot: " << filePath << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// MappedSnapshot implementation
+MappedSnapshot::~MappedSnapshot() {
+    close();
+}
+
+bool MappedSnapshot::open(const std::string& filePath) {
+    close();
+
+    #ifndef _WIN32
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    m_data = static_cast<const uint8_t*>(addr);
+    m_size = static_cast<size_t>(st.st_size);
+    m_mapped = true;
+    #else
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    m_buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size());
+    if (!file || m_buffer.size() < sizeof(SnapshotHeader)) {
+        m_buffer.clear();
+        return false;
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    #endif
+
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(m_data);
+    bool knownVersion = header->version == kSnapshotVersion || header->version == kSnapshotCovarianceVersion;
+    if (header->magic != kSnapshotMagic || !knownVersion ||
+        header->headerSize != sizeof(SnapshotHeader)) {
+        std::cerr << "Unsupported model snapshot: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    bool covariance = header->version == kSnapshotCovarianceVersion;
+    size_t recordsSize = static_cast<size_t>(header->recordCount) * recordStride(header->featureCount, covariance);
+    if (m_size != sizeof(SnapshotHeader) + recordsSize) {
+        std::cerr << "Truncated model snapshot: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    if (snapshotChecksum(*header, m_data + sizeof(SnapshotHeader), recordsSize) != header->checksum) {
+        std::cerr << "Model snapshot checksum mismatch: " << filePath << std::endl;
+        close();
+        return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+void MappedSnapshot::close() {
+    #ifndef _WIN32
+    if (m_mapped && m_data) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+    #endif
+    m_buffer.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_mapped = false;
+}
+
+const SnapshotRecord& MappedSnapshot::record(uint32_t index) const {
+    const uint8_t* base = m_data + sizeof(SnapshotHeader) +
+                          index * recordStride(m_header->featureCount, hasCovariance());
+    return *reinterpret_cast<const SnapshotRecord*>(base);
+}
+
+const double* MappedSnapshot::mean(uint32_t index) const {
+    return reinterpret_cast<const double*>(reinterpret_cast<const uint8_t*>(&record(index)) +
+                                           sizeof(SnapshotRecord));
+}
+
+const double* MappedSnapshot::m2(uint32_t index) const {
+    return mean(index) + m_header->featureCount;
+}
+
+const double* MappedSnapshot::coMoment(uint32_t index) const {
+    return hasCovariance() ? m2(index) + m_header->featureCount : nullptr;
+}
+
+size_t MappedSnapshot::coMomentCount(uint32_t featureCount) {
+    return featureCount < 2 ? 0 : static_cast<size_t>(featureCount) * (featureCount - 1) / 2;
+}
+
+size_t MappedSnapshot::recordStride(uint32_t featureCount, bool covariance) {
+    size_t values = 2 * static_cast<size_t>(featureCount) + (covariance ? coMomentCount(featureCount) : 0);
+    return sizeof(SnapshotRecord) + values * sizeof(double);
+}
+
+} // namespace nx_agent
@@ -0,0 +1,332 @@
+// nx_agent_tracker.cpp
+#include "nx_agent_tracker.h"
+#include "nx_agent_metadata.h"
+#include "nx_agent_regions.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nx_agent {
+
+ObjectTracker::ObjectTracker()
+    : m_wheel(kWheelSlots)
+{
+}
+
+void ObjectTracker::configure(float iouThreshold, float maxDistance, int64_t maxAgeUs) {
+    int64_t slotUs = std::max<int64_t>(1000, maxAgeUs / 16);
+    if (slotUs != m_slotUs) {
+        // Wheel positions depend on the slot width
+        reset();
+    }
+    m_iouThreshold = std::clamp(iouThreshold, 0.01f, 1.0f);
+    m_maxDistance = std::max(0.0f, maxDistance);
+    m_maxAgeUs = std::max<int64_t>(1000, maxAgeUs);
+    m_slotUs = slotUs;
+}
+
+void ObjectTracker::update(std::vector<DetectedObject>& objects, int64_t timestampUs,
+                           const RegionIndex& regions, int frameWidth, int frameHeight)
+{
+    // A jump back in time (archive seek) invalidates every track
+    if (m_wheelStarted && timestampUs + m_maxAgeUs < m_lastUpdateUs) {
+        reset();
+    }
+    m_lastUpdateUs = std::max(m_lastUpdateUs, timestampUs);
+    advanceWheel(timestampUs);
+
+    float width = static_cast<float>(frameWidth > 0 ? frameWidth : 1920);
+    float height = static_cast<float>(frameHeight > 0 ? frameHeight : 1080);
+    float gatePixels = m_maxDistance * std::sqrt(width * width + height * height);
+
+    bucketTracks(timestampUs, width, height);
+    m_matched.assign(m_ids.size(), 0);
+
+    for (auto& object : objects) {
+        int slot = -1;
+        if (!object.trackId.empty()) {
+            auto it = m_idByExternalId.find(object.trackId);
+            if (it != m_idByExternalId.end()) {
+                slot = static_cast<int>(m_slotById[it->second]);
+            }
+        } else {
+            slot = findMatch(object, timestampUs, width, height, gatePixels);
+        }
+        if (slot >= 0 && m_matched[slot]) {
+            slot = -1; // Two detections with the same external id; the second starts over
+        }
+        if (slot < 0) {
+            slot = createTrack(object, timestampUs);
+        }
+        m_matched[slot] = 1;
+
+        float cx = object.boundingBox.x + object.boundingBox.width / 2.0f;
+        float cy = object.boundingBox.y + object.boundingBox.height / 2.0f;
+
+        // Smoothed velocity from the center displacement since the last sighting
+        int64_t dtUs = timestampUs - m_lastSeenUs[slot];
+        if (dtUs > 0) {
+            float dt = static_cast<float>(dtUs) / 1e6f;
+            float vx = (cx - (m_x[slot] + m_w[slot] / 2.0f)) / dt;
+            float vy = (cy - (m_y[slot] + m_h[slot] / 2.0f)) / dt;
+            bool secondSighting = m_lastSeenUs[slot] == m_firstSeenUs[slot];
+            m_vx[slot] = secondSighting ? vx : 0.5f * m_vx[slot] + 0.5f * vx;
+            m_vy[slot] = secondSighting ? vy : 0.5f * m_vy[slot] + 0.5f * vy;
+        }
+        m_x[slot] = static_cast<float>(object.boundingBox.x);
+        m_y[slot] = static_cast<float>(object.boundingBox.y);
+        m_w[slot] = static_cast<float>(object.boundingBox.width);
+        m_h[slot] = static_cast<float>(object.boundingBox.height);
+        m_lastSeenUs[slot] = std::max(m_lastSeenUs[slot], timestampUs);
+
+        if (regions.contains(cx / width, cy / height)) {
+            if (m_zoneEnteredUs[slot] == kNotInZone) {
+                m_zoneEnteredUs[slot] = timestampUs;
+            }
+        } else {
+            m_zoneEnteredUs[slot] = kNotInZone;
+        }
+
+        object.trackNumber = m_ids[slot];
+        object.dwellSecs = static_cast<float>(timestampUs - m_firstSeenUs[slot]) / 1e6f;
+        object.velocity = cv::Point2f(m_vx[slot] / width, m_vy[slot] / height);
+        object.zoneDwellSecs = m_zoneEnteredUs[slot] == kNotInZone
+            ? 0.0f : static_cast<float>(timestampUs - m_zoneEnteredUs[slot]) / 1e6f;
+    }
+}
+
+void ObjectTracker::reset() {
+    m_ids.clear();
+    m_classes.clear();
+    m_x.clear();
+    m_y.clear();
+    m_w.clear();
+    m_h.clear();
+    m_vx.clear();
+    m_vy.clear();
+    m_firstSeenUs.clear();
+    m_lastSeenUs.clear();
+    m_zoneEnteredUs.clear();
+    m_externalIds.clear();
+    m_slotById.clear();
+    m_idByExternalId.clear();
+    for (auto& bucket : m_wheel) {
+        bucket.clear();
+    }
+    m_wheelStarted = false;
+    m_lastUpdateUs = 0;
+}
+
+TrackerStats ObjectTracker::stats() const {
+    TrackerStats stats = m_stats;
+    stats.active = m_ids.size();
+    return stats;
+}
+
+// Private methods
+void ObjectTracker::advanceWheel(int64_t nowUs) {
+    if (!m_wheelStarted) {
+        m_wheelCursorUs = nowUs - nowUs % m_slotUs;
+        m_wheelStarted = true;
+        return;
+    }
+
+    // One revolution looks at every entry, however long the gap
+    std::vector<WheelEntry> due;
+    for (size_t step = 0; step < kWheelSlots && m_wheelCursorUs + m_slotUs <= nowUs; ++step) {
+        auto& bucket = m_wheel[static_cast<size_t>(m_wheelCursorUs / m_slotUs) % kWheelSlots];
+        due.insert(due.end(), bucket.begin(), bucket.end());
+        bucket.clear();
+        m_wheelCursorUs += m_slotUs;
+    }
+    if (m_wheelCursorUs + m_slotUs <= nowUs) {
+        m_wheelCursorUs = nowUs - nowUs % m_slotUs;
+    }
+
+    for (const WheelEntry& entry : due) {
+        auto it = m_slotById.find(entry.id);
+        if (it == m_slotById.end()) {
+            continue;
+        }
+        int64_t deadlineUs = m_lastSeenUs[it->second] + m_maxAgeUs;
+        if (deadlineUs <= nowUs) {
+            removeTrack(it->second);
+            m_stats.expired++;
+        } else {
+            // Seen again since the entry was armed
+            schedule(entry.id, deadlineUs);
+        }
+    }
+}
+
+void ObjectTracker::schedule(uint32_t id, int64_t deadlineUs) {
+    // Deadlines further out than one revolution fire early and are re-armed
+    int64_t slotTimeUs = std::max(deadlineUs, m_wheelCursorUs);
+    m_wheel[static_cast<size_t>(slotTimeUs / m_slotUs) % kWheelSlots].push_back({id, deadlineUs});
+}
+
+int ObjectTracker::findMatch(const DetectedObject& object, int64_t timestampUs, float frameWidth,
+                             float frameHeight, float gatePixels) const
+{
+    const cv::Rect& box = object.boundingBox;
+    float cx = box.x + box.width / 2.0f;
+    float cy = box.y + box.height / 2.0f;
+
+    // Overlapping boxes may have centers further apart than the gate
+    float radius = std::max(gatePixels, 0.5f * std::sqrt(static_cast<float>(box.width * box.width +
+                                                                            box.height * box.height)));
+    float cellWidth = frameWidth / kGridCells;
+    float cellHeight = frameHeight / kGridCells;
+    int x0 = std::clamp(static_cast<int>((cx - radius) / cellWidth), 0, kGridCells - 1);
+    int x1 = std::clamp(static_cast<int>((cx + radius) / cellWidth), 0, kGridCells - 1);
+    int y0 = std::clamp(static_cast<int>((cy - radius) / cellHeight), 0, kGridCells - 1);
+    int y1 = std::clamp(static_cast<int>((cy + radius) / cellHeight), 0, kGridCells - 1);
+
+    ObjectClass objectClass = object.typeId.objectClass();
+    int best = -1;
+    float bestScore = 0.0f;
+    for (int gy = y0; gy <= y1; ++gy) {
+        for (int gx = x0; gx <= x1; ++gx) {
+            int cell = gy * kGridCells + gx;
+            for (uint32_t k = m_cellStart[cell]; k < m_cellStart[cell + 1]; ++k) {
+                uint32_t slot = m_cellTracks[k];
+                if (m_matched[slot] || m_classes[slot] != objectClass) {
+                    continue;
+                }
+
+                // Compare against where the track should be by now
+                float dt = static_cast<float>(timestampUs - m_lastSeenUs[slot]) / 1e6f;
+                float tx = m_x[slot] + m_vx[slot] * dt;
+                float ty = m_y[slot] + m_vy[slot] * dt;
+
+                float ix = std::min(tx + m_w[slot], static_cast<float>(box.x + box.width)) - std::max(tx, static_cast<float>(box.x));
+                float iy = std::min(ty + m_h[slot], static_cast<float>(box.y + box.height)) - std::max(ty, static_cast<float>(box.y));
+                float intersection = std::max(0.0f, ix) * std::max(0.0f, iy);
+                float unionArea = m_w[slot] * m_h[slot] + static_cast<float>(box.area()) - intersection;
+                float iou = unionArea > 0.0f ? intersection / unionArea : 0.0f;
+
+                // Any IoU match beats any distance-only match
+                float score = 0.0f;
+                if (iou >= m_iouThreshold) {
+                    score = 1.0f + iou;
+                } else if (gatePixels > 0.0f) {
+                    float dx = tx + m_w[slot] / 2.0f - cx;
+                    float dy = ty + m_h[slot] / 2.0f - cy;
+                    float distance = std::sqrt(dx * dx + dy * dy);
+                    if (distance <= gatePixels) {
+                        score = 1.0f - distance / gatePixels + 1e-6f;
+                    }
+                }
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = static_cast<int>(slot);
+                }
+            }
+        }
+    }
+    return best;
+}
+
+void ObjectTracker::bucketTracks(int64_t timestampUs, float frameWidth, float frameHeight) {
+    // Counting sort of the matchable tracks by the cell of their predicted center
+    const int cells = kGridCells * kGridCells;
+    m_cellStart.assign(cells + 1, 0);
+    m_trackCell.resize(m_ids.size());
+
+    for (size_t slot = 0; slot < m_ids.size(); ++slot) {
+        if (!m_externalIds[slot].empty()) {
+            m_trackCell[slot] = cells; // Identity comes from the camera; never matched spatially
+            continue;
+        }
+        float dt = static_cast<float>(timestampUs - m_lastSeenUs[slot]) / 1e6f;
+        float cx = m_x[slot] + m_w[slot] / 2.0f + m_vx[slot] * dt;
+        float cy = m_y[slot] + m_h[slot] / 2.0f + m_vy[slot] * dt;
+        int gx = std::clamp(static_cast<int>(cx / (frameWidth / kGridCells)), 0, kGridCells - 1);
+        int gy = std::clamp(static_cast<int>(cy / (frameHeight / kGridCells)), 0, kGridCells - 1);
+        m_trackCell[slot] = static_cast<uint32_t>(gy * kGridCells + gx);
+        m_cellStart[m_trackCell[slot] + 1]++;
+    }
+    for (int cell = 0; cell < cells; ++cell) {
+        m_cellStart[cell + 1] += m_cellStart[cell];
+    }
+
+    m_cellTracks.resize(m_cellStart[cells]);
+    std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (size_t slot = 0; slot < m_ids.size(); ++slot) {
+        if (m_trackCell[slot] < static_cast<uint32_t>(cells)) {
+            m_cellTracks[fill[m_trackCell[slot]]++] = static_cast<uint32_t>(slot);
+        }
+    }
+}
+
+int ObjectTracker::createTrack(const DetectedObject& object, int64_t timestampUs) {
+    uint32_t id = m_nextId++;
+    if (m_nextId == 0) {
+        m_nextId = 1; // 0 means untracked
+    }
+
+    size_t slot = m_ids.size();
+    m_ids.push_back(id);
+    m_classes.push_back(object.typeId.objectClass());
+    m_x.push_back(static_cast<float>(object.boundingBox.x));
+    m_y.push_back(static_cast<float>(object.boundingBox.y));
+    m_w.push_back(static_cast<float>(object.boundingBox.width));
+    m_h.push_back(static_cast<float>(object.boundingBox.height));
+    m_vx.push_back(0.0f);
+    m_vy.push_back(0.0f);
+    m_firstSeenUs.push_back(timestampUs);
+    m_lastSeenUs.push_back(timestampUs);
+    m_zoneEnteredUs.push_back(kNotInZone);
+    m_externalIds.push_back(object.trackId);
+    m_matched.push_back(0);
+
+    m_slotById[id] = static_cast<uint32_t>(slot);
+    if (!object.trackId.empty()) {
+        m_idByExternalId[object.trackId] = id;
+    }
+    schedule(id, timestampUs + m_maxAgeUs);
+    m_stats.created++;
+    return static_cast<int>(slot);
+}
+
+void ObjectTracker::removeTrack(size_t index) {
+    m_slotById.erase(m_ids[index]);
+    if (!m_externalIds[index].empty()) {
+        auto it = m_idByExternalId.find(m_externalIds[index]);
+        if (it != m_idByExternalId.end() && it->second == m_ids[index]) {
+            m_idByExternalId.erase(it);
+        }
+    }
+
+    // Move the last track into the freed slot
+    size_t last = m_ids.size() - 1;
+    if (index != last) {
+        m_ids[index] = m_ids[last];
+        m_classes[index] = m_classes[last];
+        m_x[index] = m_x[last];
+        m_y[index] = m_y[last];
+        m_w[index] = m_w[last];
+        m_h[index] = m_h[last];
+        m_vx[index] = m_vx[last];
+        m_vy[index] = m_vy[last];
+        m_firstSeenUs[index] = m_firstSeenUs[last];
+        m_lastSeenUs[index] = m_lastSeenUs[last];
+        m_zoneEnteredUs[index] = m_zoneEnteredUs[last];
+        m_externalIds[index] = std::move(m_externalIds[last]);
+        m_slotById[m_ids[index]] = static_cast<uint32_t>(index);
+    }
+    m_ids.pop_back();
+    m_classes.pop_back();
+    m_x.pop_back();
+    m_y.pop_back();
+    m_w.pop_back();
+    m_h.pop_back();
+    m_vx.pop_back();
+    m_vy.pop_back();
+    m_firstSeenUs.pop_back();
+    m_lastSeenUs.pop_back();
+    m_zoneEnteredUs.pop_back();
+    m_externalIds.pop_back();
+}
+
+} // namespace nx_agent
@@ -1,5 +1,7 @@
 // nx_agent_utils.cpp
 #include "nx_agent_utils.h"
+#include "nx_agent_spsc.h"
+#include "nx_agent_framepool.h"
 
 #include <iostream>
 #include <sstream>
@@ -9,20 +11,296 @@
 #include <ctime>
 #include <cstdio>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <cstdlib>
 
 namespace nx_agent {
 
 //
 // Logger implementation
 //
-Logger::Level Logger::s_logLevel = Logger::Level::INFO;
+namespace {
+
+constexpr size_t kLogRingCapacity = 1024;
+
+struct LogRecord {
+    Logger::Level level = Logger::Level::INFO;
+    int64_t timestampUs = 0;
+    std::string context;
+    std::string message;
+};
+
+// Written by exactly one thread, drained by the writer
+struct LogRing {
+    LogRing() : queue(kLogRingCapacity) {}
+    
+    SpscQueue<LogRecord> queue;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> abandoned{false};    // Owning thread has exited
+};
+
+const char* levelName(Logger::Level level) {
+    switch (level) {
+        case Logger::Level::ERROR:
+            return "ERROR";
+        case Logger::Level::WARNING:
+            return "WARNING";
+        case Logger::Level::INFO:
+            return "INFO";
+        case Logger::Level::DEBUG:
+            return "DEBUG";
+        case Logger::Level::TRACE:
+            return "TRACE";
+    }
+    return "";
+}
+
+void appendRecord(std::string& out, const LogRecord& record) {
+    out += TimeUtils::formatTimestamp(record.timestampUs);
+    out += ' ';
+    out += levelName(record.level);
+    out += ' ';
+    if (!record.context.empty()) {
+        out += '[';
+        out += record.context;
+        out += "] ";
+    }
+    out += record.message;
+    out += '\n';
+}
+
+/**
+ * Background writer. Intentionally never destroyed: threads may log during
+ * static destruction, so at exit it drains once and switches to
+ * synchronous writes instead.
+ */
+class LogBackend {
+public:
+    static LogBackend& instance() {
+        static LogBackend* backend = []() {
+            auto* created = new LogBackend();
+            std::atexit([]() { LogBackend::instance().shutdown(); });
+            return created;
+        }();
+        return *backend;
+    }
+    
+    void submit(Logger::Level level, const std::string& context, const std::string& message);
+    void flush();
+    LoggerStats stats();
+    
+private:
+    LogBackend() : m_writer(&LogBackend::run, this) {}
+    
+    LogRing* ringForThread();
+    void run();
+    void shutdown();
+    void drain();
+    void writeNow(const LogRecord& record);
+    void wake();
+    
+    std::mutex m_ringsMutex;
+    std::vector<std::shared_ptr<LogRing>> m_rings;
+    
+    std::mutex m_outputMutex;      // Serializes draining and direct writes
+    std::string m_batch;           // Reused output buffer (m_outputMutex)
+    
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    bool m_wakeRequested = false;
+    bool m_stopping = false;
+    std::atomic<bool> m_synchronous{false};
+    std::thread m_writer;
+    
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+// The ring of the current thread, and a guard that hands it over on exit
+thread_local LogRing* t_logRing = nullptr;
+thread_local bool t_logRingClosed = false;
+
+struct LogRingGuard {
+    ~LogRingGuard() {
+        if (t_logRing) {
+            t_logRing->abandoned.store(true);
+        }
+        t_logRing = nullptr;
+        t_logRingClosed = true;    // Anything logged later is written directly
+    }
+};
+thread_local LogRingGuard t_logRingGuard;
+
+void LogBackend::submit(Logger::Level level, const std::string& context, const std::string& message) {
+    LogRecord record;
+    record.level = level;
+    record.timestampUs = TimeUtils::getCurrentTimestampUs();
+    record.context = context;
+    record.message = message;
+    
+    LogRing* ring = m_synchronous.load() ? nullptr : ringForThread();
+    if (!ring) {
+        writeNow(record);
+        return;
+    }
+    
+    if (!ring->queue.tryPush(std::move(record))) {
+        // Never lose errors; everything else is counted and reported later
+        if (level == Logger::Level::ERROR) {
+            writeNow(record);
+        } else {
+            ring->dropped++;
+        }
+        return;
+    }
+    
+    if (level == Logger::Level::ERROR || ring->queue.size() >= kLogRingCapacity / 2) {
+        wake();
+    }
+}
+
+void LogBackend::flush() {
+    drain();
+}
+
+LoggerStats LogBackend::stats() {
+    LoggerStats stats;
+    stats.written = m_written.load();
+    stats.dropped = m_dropped.load();
+    
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (const auto& ring : m_rings) {
+        stats.dropped += ring->dropped.load();
+        if (!ring->abandoned.load()) {
+            stats.threads++;
+        }
+    }
+    return stats;
+}
+
+LogRing* LogBackend::ringForThread() {
+    if (t_logRing || t_logRingClosed) {
+        return t_logRing;
+    }
+    
+    auto ring = std::make_shared<LogRing>();
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.push_back(ring);
+    }
+    (void)&t_logRingGuard;         // Make sure the guard exists for this thread
+    t_logRing = ring.get();
+    return t_logRing;
+}
+
+void LogBackend::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeCv.wait_for(lock, std::chrono::milliseconds(20), [this]() {
+                return m_wakeRequested || m_stopping;
+            });
+            m_wakeRequested = false;
+            if (m_stopping) {
+                break;
+            }
+        }
+        drain();
+    }
+}
+
+void LogBackend::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wakeCv.notify_all();
+    if (m_writer.joinable()) {
+        m_writer.join();
+    }
+    
+    m_synchronous = true;
+    drain();
+}
+
+void LogBackend::drain() {
+    std::lock_guard<std::mutex> outputLock(m_outputMutex);
+    
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+    
+    m_batch.clear();
+    uint64_t count = 0;
+    LogRecord record;
+    
+    for (const auto& ring : rings) {
+        while (ring->queue.tryPop(record)) {
+            appendRecord(m_batch, record);
+            count++;
+        }
+        
+        uint64_t dropped = ring->dropped.exchange(0);
+        if (dropped > 0) {
+            m_dropped += dropped;
+            LogRecord notice;
+            notice.level = Logger::Level::WARNING;
+            notice.timestampUs = TimeUtils::getCurrentTimestampUs();
+            notice.context = "Logger";
+            notice.message = "Dropped " + std::to_string(dropped) + " messages, log buffer full";
+            appendRecord(m_batch, notice);
+        }
+    }
+    
+    // Forget rings whose threads are gone once nothing is left in them
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<LogRing>& ring) {
+            return ring->abandoned.load() && ring->queue.empty();
+        }), m_rings.end());
+    }
+    
+    if (!m_batch.empty()) {
+        // Log to console (in a real implementation, this might go to a file)
+        std::cout.write(m_batch.data(), static_cast<std::streamsize>(m_batch.size()));
+        std::cout.flush();
+        m_written += count;
+    }
+}
+
+void LogBackend::writeNow(const LogRecord& record) {
+    std::string line;
+    appendRecord(line, record);
+    
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+    std::cout.flush();
+    m_written++;
+}
+
+void LogBackend::wake() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_wakeRequested = true;
+    }
+    m_wakeCv.notify_one();
+}
+
+} // namespace
+
+std::atomic<int> Logger::s_logLevel{static_cast<int>(Logger::Level::INFO)};
 
 void Logger::setLogLevel(Level level) {
-    s_logLevel = level;
+    s_logLevel = static_cast<int>(level);
 }
 
 Logger::Level Logger::getLogLevel() {
-    return s_logLevel;
+    return static_cast<Level>(s_logLevel.load());
 }
 
 void Logger::error(const std::string& message) {
@@ -65,48 +343,20 @@ void Logger::trace(const std::string& context, const std::string& message) {
     log(Level::TRACE, context, message);
 }
 
+void Logger::flush() {
+    LogBackend::instance().flush();
+}
+
+LoggerStats Logger::stats() {
+    return LogBackend::instance().stats();
+}
+
 void Logger::log(Level level, const std::string& context, const std::string& message) {
-    static std::mutex logMutex;
-    
-    if (level > s_logLevel) {
+    if (!isEnabled(level)) {
         return;
     }
     
-    std::lock_guard<std::mutex> lock(logMutex);
-    
-    // Get current time
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()) % 1000;
-    
-    std::stringstream timestamp;
-    timestamp << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S")
-              << '.' << std::setfill('0') << std::setw(3) << ms.count();
-    
-    std::string levelStr;
-    switch (level) {
-        case Level::ERROR:
-            levelStr = "ERROR";
-            break;
-        case Level::WARNING:
-            levelStr = "WARNING";
-            break;
-        case Level::INFO:
-            levelStr = "INFO";
-            break;
-        case Level::DEBUG:
-            levelStr = "DEBUG";
-            break;
-        case Level::TRACE:
-            levelStr = "TRACE";
-            break;
-    }
-    
-    std::string contextStr = context.empty() ? "" : "[" + context + "] ";
-    
-    // Log to console (in a real implementation, this might go to a file)
-    std::cout << timestamp.str() << " " << levelStr << " " << contextStr << message << std::endl;
+    LogBackend::instance().submit(level, context, message);
 }
 
 //
@@ -190,6 +440,153 @@ cv::Mat nxFrameToMat(const nx::sdk::analytics::IUncompressedVideoFrame* frame) {
     }
 }
 
+PixelFormat toPixelFormat(nx::sdk::analytics::UncompressedVideoFrame::Format format) {
+    switch (format) {
+        case nx::sdk::analytics::UncompressedVideoFrame::Format::rgb24:
+            return PixelFormat::rgb24;
+        case nx::sdk::analytics::UncompressedVideoFrame::Format::bgr24:
+            return PixelFormat::bgr24;
+        case nx::sdk::analytics::UncompressedVideoFrame::Format::nv12:
+            return PixelFormat::nv12;
+        case nx::sdk::analytics::UncompressedVideoFrame::Format::y800:
+            return PixelFormat::y800;
+        default:
+            return PixelFormat::unknown;
+    }
+}
+
+//
+// FrameView implementation
+//
+FrameView::FrameView(PixelFormat format, int width, int height, const void* data)
+    : m_format(format),
+      m_width(width),
+      m_height(height)
+{
+    if (!data || width <= 0 || height <= 0) {
+        return;
+    }
+
+    void* pixels = const_cast<void*>(data);
+    switch (format) {
+        case PixelFormat::rgb24:
+        case PixelFormat::bgr24:
+            m_raw = cv::Mat(height, width, CV_8UC3, pixels);
+            break;
+        case PixelFormat::nv12:
+            m_raw = cv::Mat(height * 3 / 2, width, CV_8UC1, pixels);
+            break;
+        case PixelFormat::y800:
+            m_raw = cv::Mat(height, width, CV_8UC1, pixels);
+            break;
+        default:
+            Logger::error("ImageUtils", "Unsupported frame format");
+            break;
+    }
+}
+
+FrameView::FrameView(const nx::sdk::analytics::IUncompressedVideoFrame* frame)
+    : FrameView(frame ? toPixelFormat(frame->format()) : PixelFormat::unknown,
+                frame ? frame->width() : 0,
+                frame ? frame->height() : 0,
+                frame ? frame->data() : nullptr)
+{
+}
+
+FrameView::FrameView(const cv::Mat& image)
+    : m_width(image.cols),
+      m_height(image.rows)
+{
+    if (image.type() == CV_8UC3) {
+        m_format = PixelFormat::bgr24;
+        m_raw = image;
+        m_bgr = image;
+    } else if (image.type() == CV_8UC1) {
+        m_format = PixelFormat::y800;
+        m_raw = image;
+        m_luma = image;
+    } else if (!image.empty()) {
+        Logger::error("ImageUtils", "Unsupported image type for frame view");
+    }
+}
+
+const cv::Mat& FrameView::luma() const {
+    if (m_luma.empty() && !m_raw.empty()) {
+        switch (m_format) {
+            case PixelFormat::nv12:
+            case PixelFormat::y800:
+                // The Y plane leads the buffer - expose it in place
+                m_luma = m_raw.rowRange(0, m_height);
+                break;
+            case PixelFormat::rgb24:
+                preallocate(m_luma, CV_8UC1);
+                cv::cvtColor(m_raw, m_luma, cv::COLOR_RGB2GRAY);
+                break;
+            case PixelFormat::bgr24:
+                preallocate(m_luma, CV_8UC1);
+                cv::cvtColor(m_raw, m_luma, cv::COLOR_BGR2GRAY);
+                break;
+            default:
+                break;
+        }
+    }
+    return m_luma;
+}
+
+const cv::Mat& FrameView::bgr() const {
+    if (m_bgr.empty() && !m_raw.empty()) {
+        switch (m_format) {
+            case PixelFormat::rgb24:
+                preallocate(m_bgr, CV_8UC3);
+                cv::cvtColor(m_raw, m_bgr, cv::COLOR_RGB2BGR);
+                break;
+            case PixelFormat::bgr24:
+                m_bgr = m_raw;
+                break;
+            case PixelFormat::nv12:
+                preallocate(m_bgr, CV_8UC3);
+                cv::cvtColor(m_raw, m_bgr, cv::COLOR_YUV2BGR_NV12);
+                break;
+            case PixelFormat::y800:
+                preallocate(m_bgr, CV_8UC3);
+                cv::cvtColor(m_raw, m_bgr, cv::COLOR_GRAY2BGR);
+                break;
+            default:
+                break;
+        }
+    }
+    return m_bgr;
+}
+
+FrameView FrameView::clone(const std::shared_ptr<FramePool>& pool) const {
+    FrameView copy;
+    copy.m_format = m_format;
+    copy.m_width = m_width;
+    copy.m_height = m_height;
+    copy.m_pool = pool;
+    if (pool && !m_raw.empty()) {
+        copy.m_raw = pool->acquire(m_raw.rows, m_raw.cols, m_raw.type());
+        m_raw.copyTo(copy.m_raw);
+    } else {
+        copy.m_raw = m_raw.clone();
+    }
+
+    // Re-derive cached planes so they point into the copy, not the original buffer
+    if (m_format == PixelFormat::bgr24) {
+        copy.m_bgr = copy.m_raw;
+    } else if (m_format == PixelFormat::y800) {
+        copy.m_luma = copy.m_raw;
+    }
+    return copy;
+}
+
+void FrameView::preallocate(cv::Mat& plane, int type) const {
+    // cvtColor keeps a destination that already has the right shape
+    if (m_pool) {
+        plane = m_pool->acquire(m_height, m_width, type);
+    }
+}
+
 cv::Mat enhanceContrast(const cv::Mat& input, float alpha, int beta) {
     cv::Mat enhanced;
     input.convertTo(enhanced, -1, alpha, beta);
@@ -282,23 +679,107 @@ void drawDetections(cv::Mat& image,
 //
 namespace TimeUtils {
 
-std::string formatTimestamp(int64_t timestampUs) {
-    // Convert to time_t (seconds)
-    time_t seconds = timestampUs / 1000000;
+namespace {
+
+constexpr int64_t kSecondsPerDay = 86400;
+
+int64_t floorDiv(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor < 0) ? quotient - 1 : quotient;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's algorithm)
+int64_t daysFromCivil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = floorDiv(year, 400);
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+void civilFromDays(int64_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int64_t era = floorDiv(days, 146097);
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    year = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
+
+// UTC offset in effect at a given instant, straight from the C library
+int64_t queryUtcOffset(int64_t utcSeconds) {
+    time_t seconds = static_cast<time_t>(utcSeconds);
+    std::tm timeInfo = {};
+    #ifdef _WIN32
+    localtime_s(&timeInfo, &seconds);
+    #else
+    localtime_r(&seconds, &timeInfo);
+    #endif
     
-    // Get milliseconds part
-    int milliseconds = (timestampUs % 1000000) / 1000;
+    int64_t localSeconds = daysFromCivil(timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday) *
+                           kSecondsPerDay + timeInfo.tm_hour * 3600 + timeInfo.tm_min * 60 + timeInfo.tm_sec;
+    return localSeconds - utcSeconds;
+}
+
+// Offsets for one UTC day: offsetBefore until transitionUtc, offsetAfter from then on
+struct OffsetCache {
+    int64_t dayStartUtc = 0;
+    int64_t dayEndUtc = 0;       // Empty range means nothing cached
+    int64_t transitionUtc = 0;
+    int64_t offsetBefore = 0;
+    int64_t offsetAfter = 0;
+    uint64_t generation = 0;
+};
+
+std::atomic<uint64_t> g_offsetGeneration{1};
+thread_local OffsetCache t_offsetCache;
+
+int64_t utcOffsetAt(int64_t utcSeconds) {
+    OffsetCache& cache = t_offsetCache;
+    uint64_t generation = g_offsetGeneration.load(std::memory_order_relaxed);
     
-    // Format the time part
-    std::tm* timeInfo = std::localtime(&seconds);
-    char buffer[80];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeInfo);
+    if (cache.generation != generation || utcSeconds < cache.dayStartUtc || utcSeconds >= cache.dayEndUtc) {
+        // Zones change offset at most once a day; find where within this one
+        cache.dayStartUtc = floorDiv(utcSeconds, kSecondsPerDay) * kSecondsPerDay;
+        cache.dayEndUtc = cache.dayStartUtc + kSecondsPerDay;
+        cache.offsetBefore = queryUtcOffset(cache.dayStartUtc);
+        cache.offsetAfter = queryUtcOffset(cache.dayEndUtc - 1);
+        cache.transitionUtc = cache.dayEndUtc;
+        
+        if (cache.offsetAfter != cache.offsetBefore) {
+            // Binary search for the first second on the new offset
+            int64_t low = cache.dayStartUtc;        // Known to be on offsetBefore
+            int64_t high = cache.dayEndUtc - 1;     // Known to be on offsetAfter
+            while (high - low > 1) {
+                int64_t mid = low + (high - low) / 2;
+                if (queryUtcOffset(mid) == cache.offsetBefore) {
+                    low = mid;
+                } else {
+                    high = mid;
+                }
+            }
+            cache.transitionUtc = high;
+        }
+        cache.generation = generation;
+    }
     
-    // Add milliseconds
-    std::stringstream result;
-    result << buffer << "." << std::setfill('0') << std::setw(3) << milliseconds;
+    return utcSeconds < cache.transitionUtc ? cache.offsetBefore : cache.offsetAfter;
+}
+
+} // namespace
+
+std::string formatTimestamp(int64_t timestampUs) {
+    LocalTime local = getLocalTime(timestampUs);
+    int milliseconds = static_cast<int>((timestampUs - floorDiv(timestampUs, 1000000) * 1000000) / 1000);
     
-    return result.str();
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+                  local.year, local.month, local.day, local.hour, local.minute, local.second, milliseconds);
+    return buffer;
 }
 
 int64_t getCurrentTimestampUs() {
@@ -308,12 +789,7 @@ int64_t getCurrentTimestampUs() {
 }
 
 int getTimeOfDaySeconds(int64_t timestampUs) {
-    // Convert to time_t (seconds)
-    time_t seconds = timestampUs / 1000000;
-    
-    // Extract time of day
-    std::tm* timeInfo = std::localtime(&seconds);
-    return timeInfo->tm_hour * 3600 + timeInfo->tm_min * 60 + timeInfo->tm_sec;
+    return getLocalTime(timestampUs).timeOfDaySeconds;
 }
 
 bool isTimeInRange(int timeOfDaySeconds, int startSeconds, int endSeconds) {
@@ -328,12 +804,32 @@ bool isTimeInRange(int timeOfDaySeconds, int startSeconds, int endSeconds) {
 }
 
 int getDayOfWeek(int64_t timestampUs) {
-    // Convert to time_t (seconds)
-    time_t seconds = timestampUs / 1000000;
+    return getLocalTime(timestampUs).dayOfWeek;
+}
+
+int getHourOfDay(int64_t timestampUs) {
+    return getLocalTime(timestampUs).hour;
+}
+
+LocalTime getLocalTime(int64_t timestampUs) {
+    int64_t utcSeconds = floorDiv(timestampUs, 1000000);
+    int64_t offset = utcOffsetAt(utcSeconds);
+    int64_t localSeconds = utcSeconds + offset;
+    int64_t localDay = floorDiv(localSeconds, kSecondsPerDay);
     
-    // Extract day of week (0 = Sunday, 6 = Saturday)
-    std::tm* timeInfo = std::localtime(&seconds);
-    return timeInfo->tm_wday;
+    LocalTime local;
+    local.utcOffsetSeconds = static_cast<int>(offset);
+    local.timeOfDaySeconds = static_cast<int>(localSeconds - localDay * kSecondsPerDay);
+    local.hour = local.timeOfDaySeconds / 3600;
+    local.minute = (local.timeOfDaySeconds / 60) % 60;
+    local.second = local.timeOfDaySeconds % 60;
+    local.dayOfWeek = static_cast<int>(((localDay + 4) % 7 + 7) % 7); // 1970-01-01 was a Thursday
+    civilFromDays(localDay, local.year, local.month, local.day);
+    return local;
+}
+
+void resetLocalTimeCache() {
+    g_offsetGeneration++;
 }
 
 bool TimeRange::contains(int64_t timestampUs) const {
@@ -526,13 +1022,25 @@ std::vector<uint8_t> base64Decode(const std::string& encoded) {
 //
 // ScopedTimer implementation
 //
+ScopedTimer::ScopedTimer(const char* operationName)
+    : m_enabled(Logger::isEnabled(Logger::Level::DEBUG))
+{
+    if (m_enabled) {
+        m_operationName = operationName;
+        m_startTime = std::chrono::high_resolution_clock::now();
+    }
+}
+
 ScopedTimer::ScopedTimer(const std::string& operationName)
-    : m_operationName(operationName),
-      m_startTime(std::chrono::high_resolution_clock::now())
+    : ScopedTimer(operationName.c_str())
 {
 }
 
 ScopedTimer::~ScopedTimer() {
+    if (!m_enabled) {
+        return;
+    }
+    
     auto endTime = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
         endTime - m_startTime).count();
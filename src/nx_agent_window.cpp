@@ -0,0 +1,236 @@
+// nx_agent_window.cpp
+#include "nx_agent_window.h"
+#include "nx_agent_anomaly.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace nx_agent {
+
+namespace {
+
+// Scored features: the model inputs after time of day and day of week
+constexpr int kFirstFeature = 2;
+constexpr int kFeatureCount = FeatureVector::kExtractedFeatureCount - kFirstFeature;
+
+const char* const kFeatureNames[kFeatureCount] = {
+    "motion level", "person count", "vehicle count", "unknown person ratio",
+    "dwell time", "zone dwell time", "object speed"
+};
+
+// Smallest spread a feature is judged against, so a scene that has been
+// still for half an hour does not alarm at the first small change
+const float kNoiseFloor[kFeatureCount] = {
+    0.05f, 0.5f, 0.5f, 0.25f, 5.0f, 5.0f, 0.05f
+};
+
+// Deviation, in spreads, that scores 1 - exp(-0.5)
+constexpr float kDeviationScale = 3.0f;
+
+constexpr size_t kShortWindow = 0;
+constexpr size_t kMediumWindow = 1;
+constexpr size_t kLongWindow = 2;
+
+float deviationScore(float deviation) {
+    float scaled = deviation / kDeviationScale;
+    return 1.0f - std::exp(-0.5f * scaled * scaled);
+}
+
+} // namespace
+
+// FeatureRing implementation
+FeatureRing::FeatureRing(size_t capacity, int columns)
+    : m_capacity(std::max<size_t>(1, capacity)),
+      m_columns(std::max(1, std::min(columns, kMaxColumns))),
+      m_timestamps(m_capacity),
+      m_values(m_capacity * m_columns) {
+}
+
+void FeatureRing::push(int64_t timestampUs, const float* values) {
+    size_t slot = m_head % m_capacity;
+    m_timestamps[slot] = timestampUs;
+    for (int column = 0; column < m_columns; ++column) {
+        m_values[column * m_capacity + slot] = values[column];
+    }
+    ++m_head;
+    m_size = std::min(m_size + 1, m_capacity);
+}
+
+void FeatureRing::clear() {
+    m_head = 0;
+    m_size = 0;
+}
+
+// SlidingWindowStats implementation
+SlidingWindowStats::SlidingWindowStats(int columns, const std::vector<int64_t>& windowsUs, int64_t binUs)
+    : m_binUs(std::max<int64_t>(1, binUs)),
+      m_ring(static_cast<size_t>(*std::max_element(windowsUs.begin(), windowsUs.end()) /
+                                 std::max<int64_t>(1, binUs)) + 1,
+             columns) {
+    for (int64_t durationUs : windowsUs) {
+        Window window;
+        window.durationUs = durationUs;
+        m_windows.push_back(window);
+    }
+}
+
+void SlidingWindowStats::add(int64_t timestampUs, const float* values) {
+    int64_t bin = timestampUs / m_binUs;
+    if (m_pendingCount > 0 && bin != m_pendingBin) {
+        if (bin < m_pendingBin) {
+            clear();
+        } else {
+            flushBin();
+        }
+    }
+
+    if (m_pendingCount == 0) {
+        m_pendingBin = bin;
+        m_pendingSum.fill(0.0);
+    }
+    for (int column = 0; column < m_ring.columns(); ++column) {
+        m_pendingSum[column] += values[column];
+    }
+    ++m_pendingCount;
+}
+
+void SlidingWindowStats::clear() {
+    m_ring.clear();
+    for (auto& window : m_windows) {
+        int64_t durationUs = window.durationUs;
+        window = Window();
+        window.durationUs = durationUs;
+    }
+    m_lastBinUs = 0;
+    m_pendingBin = -1;
+    m_pendingCount = 0;
+}
+
+int64_t SlidingWindowStats::coveredUs(size_t window) const {
+    const Window& w = m_windows[window];
+    return w.count == 0 ? 0 : m_lastBinUs - m_ring.timestampAt(w.tail) + m_binUs;
+}
+
+float SlidingWindowStats::variance(size_t window, int column) const {
+    const Window& w = m_windows[window];
+    return w.count < 2 ? 0.0f : static_cast<float>(w.m2[column] / static_cast<double>(w.count - 1));
+}
+
+float SlidingWindowStats::rateOfChange(size_t window, int column) const {
+    const Window& w = m_windows[window];
+    if (w.count < 2) {
+        return 0.0f;
+    }
+    double elapsedSecs = static_cast<double>(m_lastBinUs - m_ring.timestampAt(w.tail)) / 1000000.0;
+    float change = m_ring.valueAt(m_ring.head() - 1, column) - m_ring.valueAt(w.tail, column);
+    return static_cast<float>(change / elapsedSecs);
+}
+
+void SlidingWindowStats::flushBin() {
+    const int columns = m_ring.columns();
+    std::array<float, FeatureRing::kMaxColumns> values{};
+    for (int column = 0; column < columns; ++column) {
+        values[column] = static_cast<float>(m_pendingSum[column] / static_cast<double>(m_pendingCount));
+    }
+    int64_t binUs = m_pendingBin * m_binUs;
+    int64_t sinceLastUs = binUs - m_lastBinUs;
+    m_pendingCount = 0;
+
+    // A full ring overwrites its oldest bin; a window still holding it lets go first
+    if (m_ring.full()) {
+        for (auto& window : m_windows) {
+            if (window.count > 0 && window.tail == m_ring.oldest()) {
+                removeOldest(window);
+            }
+        }
+    }
+    m_ring.push(binUs, values.data());
+    uint64_t seq = m_ring.head() - 1;
+
+    for (auto& window : m_windows) {
+        bool fresh = window.count == 0;
+        if (fresh) {
+            window.tail = seq;
+        }
+        ++window.count;
+
+        double alpha = 1.0 - std::exp(-static_cast<double>(sinceLastUs) / static_cast<double>(window.durationUs));
+        for (int column = 0; column < columns; ++column) {
+            double x = values[column];
+            double delta = x - window.mean[column];
+            window.mean[column] += delta / static_cast<double>(window.count);
+            window.m2[column] += delta * (x - window.mean[column]);
+            window.ewma[column] = fresh ? x : window.ewma[column] + alpha * (x - window.ewma[column]);
+        }
+
+        while (window.tail < seq && m_ring.timestampAt(window.tail) <= binUs - window.durationUs) {
+            removeOldest(window);
+        }
+    }
+    m_lastBinUs = binUs;
+}
+
+void SlidingWindowStats::removeOldest(Window& window) {
+    uint64_t seq = window.tail++;
+    if (--window.count == 0) {
+        window.mean.fill(0.0);
+        window.m2.fill(0.0);
+        return;
+    }
+
+    for (int column = 0; column < m_ring.columns(); ++column) {
+        double x = m_ring.valueAt(seq, column);
+        double delta = x - window.mean[column];
+        window.mean[column] -= delta / static_cast<double>(window.count);
+        window.m2[column] = std::max(0.0, window.m2[column] - delta * (x - window.mean[column]));
+    }
+}
+
+// ShortTermDetector implementation
+ShortTermDetector::ShortTermDetector()
+    : m_stats(kFeatureCount, {kShortWindowUs, kMediumWindowUs, kLongWindowUs}) {
+}
+
+ShortTermScore ShortTermDetector::update(const FeatureVector& features) {
+    std::array<float, FeatureRing::kMaxColumns> values{};
+    int available = std::min(kFeatureCount, features.featureCount() - kFirstFeature);
+    for (int feature = 0; feature < available; ++feature) {
+        values[feature] = features.featureAt(kFirstFeature + feature);
+    }
+    m_stats.add(features.timestampUs, values.data());
+
+    ShortTermScore score;
+    if (m_stats.coveredUs(kLongWindow) < kMinHistoryUs) {
+        return score;
+    }
+
+    for (int feature = 0; feature < kFeatureCount; ++feature) {
+        float burst = deviationScore(deviation(kShortWindow, feature, false));
+
+        // A drift is a level that keeps moving the same way, not a swing
+        float medium = deviation(kMediumWindow, feature, true);
+        float rate = m_stats.rateOfChange(kLongWindow, feature);
+        float drift = (medium > 0.0f && rate > 0.0f) || (medium < 0.0f && rate < 0.0f)
+            ? deviationScore(medium) : 0.0f;
+
+        if (std::max(burst, drift) > std::max(score.burst, score.drift)) {
+            score.feature = feature;
+        }
+        score.burst = std::max(score.burst, burst);
+        score.drift = std::max(score.drift, drift);
+    }
+    return score;
+}
+
+const char* ShortTermDetector::featureName(int feature) {
+    return feature >= 0 && feature < kFeatureCount ? kFeatureNames[feature] : "activity";
+}
+
+float ShortTermDetector::deviation(size_t window, int feature, bool useEwma) const {
+    float recent = useEwma ? m_stats.ewma(window, feature) : m_stats.mean(window, feature);
+    float baseline = m_stats.mean(kLongWindow, feature);
+    float spread = std::max(std::sqrt(m_stats.variance(kLongWindow, feature)), kNoiseFloor[feature]);
+    return (recent - baseline) / spread;
+}
+
+} // namespace nx_agent
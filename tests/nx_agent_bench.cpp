@@ -0,0 +1,446 @@
+// tests/nx_agent_bench.cpp - Throughput and latency benchmark for the analysis path
+//
+// Runs frames through the same steps the device agent does - wrap and copy
+// the decoded frame, motion and object analysis, anomaly scoring, baseline
+// updates and the response protocol - on N simulated cameras, each on its
+// own thread, without an Nx server. Reports frames/sec, per-stage latency
+// percentiles and heap allocations per frame.
+//
+// Usage: nx_agent_bench [--cameras N] [--frames N] [--learning N]
+//                       [--resolution WxH]... [--format nv12|bgr24|y800|all]
+//                       [--video path] [--motion mog2|fast]
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+
+// Include plugin components
+#include "../nx_agent_config.h"
+#include "../nx_agent_metadata.h"
+#include "../nx_agent_anomaly.h"
+#include "../nx_agent_response.h"
+#include "../nx_agent_metrics.h"
+#include "../nx_agent_framepool.h"
+#include "../nx_agent_utils.h"
+
+using namespace nx_agent;
+
+// Count heap allocations so the report can show allocations per frame
+static std::atomic<uint64_t> g_allocations{0};
+static thread_local uint64_t t_allocations = 0;
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    t_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace bench {
+
+struct Options {
+    int cameras = 1;
+    int frames = 500;           // Measured frames per camera
+    int learningFrames = 200;   // Baseline frames per camera before measuring
+    std::vector<cv::Size> resolutions;
+    std::vector<ImageUtils::PixelFormat> formats;
+    std::string videoPath;
+    std::string motionEngine = "mog2";
+};
+
+const char* formatName(ImageUtils::PixelFormat format) {
+    switch (format) {
+        case ImageUtils::PixelFormat::rgb24: return "rgb24";
+        case ImageUtils::PixelFormat::bgr24: return "bgr24";
+        case ImageUtils::PixelFormat::nv12: return "nv12";
+        case ImageUtils::PixelFormat::y800: return "y800";
+        default: return "unknown";
+    }
+}
+
+/**
+ * A decoded frame in one of the Nx raw formats, as the SDK would deliver it
+ */
+struct RawFrame {
+    ImageUtils::PixelFormat format = ImageUtils::PixelFormat::unknown;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;
+};
+
+// Repack a BGR image into the given raw layout
+RawFrame encodeFrame(const cv::Mat& bgr, ImageUtils::PixelFormat format) {
+    RawFrame frame;
+    frame.format = format;
+    frame.width = bgr.cols & ~1;
+    frame.height = bgr.rows & ~1;
+    cv::Mat image = bgr(cv::Rect(0, 0, frame.width, frame.height));
+
+    cv::Mat packed;
+    switch (format) {
+        case ImageUtils::PixelFormat::bgr24:
+            packed = image.clone();
+            break;
+        case ImageUtils::PixelFormat::rgb24:
+            cv::cvtColor(image, packed, cv::COLOR_BGR2RGB);
+            break;
+        case ImageUtils::PixelFormat::y800:
+            cv::cvtColor(image, packed, cv::COLOR_BGR2GRAY);
+            break;
+        case ImageUtils::PixelFormat::nv12: {
+            // OpenCV produces planar I420; interleave U and V into NV12
+            cv::Mat i420;
+            cv::cvtColor(image, i420, cv::COLOR_BGR2YUV_I420);
+            size_t lumaSize = static_cast<size_t>(frame.width) * frame.height;
+            size_t chromaSize = lumaSize / 4;
+            const uint8_t* src = i420.ptr<uint8_t>();
+            frame.data.resize(lumaSize + chromaSize * 2);
+            std::memcpy(frame.data.data(), src, lumaSize);
+            for (size_t i = 0; i < chromaSize; ++i) {
+                frame.data[lumaSize + 2 * i] = src[lumaSize + i];
+                frame.data[lumaSize + 2 * i + 1] = src[lumaSize + chromaSize + i];
+            }
+            return frame;
+        }
+        default:
+            return frame;
+    }
+
+    frame.data.assign(packed.datastart, packed.dataend);
+    return frame;
+}
+
+// A few seconds of a synthetic scene: noisy background with people-sized
+// blobs walking across, so motion and contour stages see real work
+std::vector<cv::Mat> syntheticClip(cv::Size size, int frameCount) {
+    std::vector<cv::Mat> clip;
+    clip.reserve(frameCount);
+
+    cv::Mat background(size, CV_8UC3);
+    cv::randu(background, cv::Scalar(90, 90, 90), cv::Scalar(130, 130, 130));
+
+    int blobWidth = std::max(4, size.width / 12);
+    int blobHeight = std::max(8, size.height / 4);
+    for (int i = 0; i < frameCount; ++i) {
+        cv::Mat frame = background.clone();
+        for (int blob = 0; blob < 3; ++blob) {
+            int span = std::max(1, size.width - blobWidth);
+            int x = (i * (4 + blob * 3) + blob * size.width / 3) % span;
+            int y = (size.height / 5) * (blob + 1) % std::max(1, size.height - blobHeight);
+            cv::rectangle(frame, cv::Rect(x, y, blobWidth, blobHeight),
+                          cv::Scalar(30 + blob * 60, 200 - blob * 50, 80), cv::FILLED);
+        }
+        clip.push_back(frame);
+    }
+    return clip;
+}
+
+// Up to maxFrames frames of a recording, scaled to the target size
+std::vector<cv::Mat> recordedClip(const std::string& path, cv::Size size, int maxFrames) {
+    std::vector<cv::Mat> clip;
+    cv::VideoCapture capture;
+    if (!capture.open(path)) {
+        std::cerr << "Failed to open video: " << path << std::endl;
+        return clip;
+    }
+
+    cv::Mat frame;
+    while (static_cast<int>(clip.size()) < maxFrames && capture.read(frame)) {
+        cv::Mat scaled;
+        cv::resize(frame, scaled, size);
+        clip.push_back(scaled);
+    }
+    return clip;
+}
+
+/**
+ * Per-stage latency and allocation totals for one benchmark case
+ */
+struct CaseMetrics {
+    Histogram convert;
+    Histogram analyze;
+    Histogram score;
+    Histogram baseline;
+    Histogram response;
+    Histogram frame;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> anomalies{0};
+};
+
+// One simulated camera: its own analyzer, detector and response protocol,
+// exactly as one device agent would own them
+void runCamera(const Options& options, const std::string& deviceId,
+               const std::vector<RawFrame>& clip, CaseMetrics& metrics)
+{
+    auto config = GlobalConfig::instance().modifyDeviceConfig(deviceId, [&](DeviceConfig& edited) {
+        edited.enableLearning = true;
+        edited.motionEngine = options.motionEngine;
+    });
+
+    MetadataAnalyzer analyzer(deviceId);
+    AnomalyDetector detector(deviceId);
+    ResponseProtocol response(deviceId);
+    analyzer.configure(config);
+    detector.configure(config);
+    response.configure(config);
+    response.setNxEventCallback([](const FrameAnalysisResult&) {});
+
+    auto pool = std::make_shared<FramePool>(deviceId);
+    analyzer.setFramePool(pool);
+
+    // 15 fps timeline starting on a fixed weekday morning
+    const int64_t startUs = 1718010000LL * 1000000;
+    const int64_t frameIntervalUs = 1000000 / 15;
+    int total = options.learningFrames + options.frames;
+
+    for (int i = 0; i < total; ++i) {
+        const RawFrame& raw = clip[i % clip.size()];
+        int64_t timestampUs = startUs + i * frameIntervalUs;
+        bool measured = i >= options.learningFrames;
+        uint64_t allocationsBefore = t_allocations;
+        auto frameStart = std::chrono::steady_clock::now();
+
+        // Wrap the raw buffer as the agent does for an Nx frame, then take
+        // the pipeline's private copy
+        ImageUtils::FrameView frame;
+        {
+            LatencyTimer timer(measured ? &metrics.convert : nullptr);
+            ImageUtils::FrameView view(raw.format, raw.width, raw.height, raw.data.data());
+            frame = view.clone(pool);
+        }
+
+        FrameAnalysisResult result;
+        {
+            LatencyTimer timer(measured ? &metrics.analyze : nullptr);
+            result = analyzer.processFrame(frame, timestampUs);
+        }
+
+        if (!measured) {
+            detector.addToBaseline(result);
+            continue;
+        }
+
+        bool anomaly = false;
+        {
+            LatencyTimer timer(&metrics.score);
+            anomaly = detector.detectAnomaly(result);
+        }
+
+        if (!result.isAnomaly) {
+            LatencyTimer timer(&metrics.baseline);
+            detector.addToBaseline(result);
+        }
+
+        if (anomaly) {
+            LatencyTimer timer(&metrics.response);
+            if (response.processAnomaly(result)) {
+                metrics.anomalies++;
+            }
+        }
+
+        metrics.frame.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - frameStart).count()));
+        metrics.allocations += t_allocations - allocationsBefore;
+        metrics.frames++;
+    }
+}
+
+void printStage(const char* name, const Histogram& histogram) {
+    HistogramSnapshot snapshot = histogram.snapshot();
+    if (snapshot.count == 0) {
+        std::cout << "    " << std::left << std::setw(10) << name << "-" << std::endl;
+        return;
+    }
+    std::cout << "    " << std::left << std::setw(10) << name << std::right
+              << " n=" << std::setw(7) << snapshot.count
+              << "  mean " << std::setw(8) << static_cast<uint64_t>(snapshot.mean())
+              << "  p50 " << std::setw(8) << snapshot.percentile(0.5)
+              << "  p90 " << std::setw(8) << snapshot.percentile(0.9)
+              << "  p99 " << std::setw(8) << snapshot.percentile(0.99)
+              << "  max " << std::setw(8) << snapshot.max << "  us" << std::endl;
+}
+
+void runCase(const Options& options, cv::Size size, ImageUtils::PixelFormat format,
+             const std::vector<cv::Mat>& source)
+{
+    std::vector<RawFrame> clip;
+    clip.reserve(source.size());
+    for (const auto& image : source) {
+        clip.push_back(encodeFrame(image, format));
+    }
+    if (clip.empty()) {
+        return;
+    }
+
+    CaseMetrics metrics;
+    std::string prefix = "bench_" + std::to_string(size.width) + "x" + std::to_string(size.height) +
+                         "_" + formatName(format) + "_";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> cameras;
+    for (int camera = 0; camera < options.cameras; ++camera) {
+        cameras.emplace_back(runCamera, std::cref(options), prefix + std::to_string(camera),
+                             std::cref(clip), std::ref(metrics));
+    }
+    for (auto& camera : cameras) {
+        camera.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Wall time includes the learning frames, so rate the whole run
+    uint64_t framesRun = static_cast<uint64_t>(options.cameras) * (options.learningFrames + options.frames);
+    uint64_t measured = metrics.frames.load();
+
+    std::cout << size.width << "x" << size.height << " " << formatName(format)
+              << ", " << options.cameras << " camera(s): "
+              << std::fixed << std::setprecision(1) << framesRun / seconds << " frames/s total, "
+              << framesRun / seconds / options.cameras << " per camera, "
+              << (measured ? static_cast<double>(metrics.allocations.load()) / measured : 0.0)
+              << " allocations/frame, " << metrics.anomalies.load() << " responses" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+
+    printStage("convert", metrics.convert);
+    printStage("analyze", metrics.analyze);
+    printStage("score", metrics.score);
+    printStage("baseline", metrics.baseline);
+    printStage("response", metrics.response);
+    printStage("frame", metrics.frame);
+}
+
+bool parseResolution(const std::string& text, cv::Size& size) {
+    size_t x = text.find('x');
+    if (x == std::string::npos) {
+        return false;
+    }
+    size.width = std::atoi(text.substr(0, x).c_str());
+    size.height = std::atoi(text.substr(x + 1).c_str());
+    return size.width >= 16 && size.height >= 16;
+}
+
+bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--cameras" && hasValue) {
+            options.cameras = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--frames" && hasValue) {
+            options.frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--learning" && hasValue) {
+            options.learningFrames = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--resolution" && hasValue) {
+            cv::Size size;
+            if (!parseResolution(argv[++i], size)) {
+                std::cerr << "Invalid resolution: " << argv[i] << std::endl;
+                return false;
+            }
+            options.resolutions.push_back(size);
+        } else if (arg == "--format" && hasValue) {
+            std::string format = argv[++i];
+            if (format == "nv12" || format == "all") {
+                options.formats.push_back(ImageUtils::PixelFormat::nv12);
+            }
+            if (format == "bgr24" || format == "all") {
+                options.formats.push_back(ImageUtils::PixelFormat::bgr24);
+            }
+            if (format == "y800" || format == "all") {
+                options.formats.push_back(ImageUtils::PixelFormat::y800);
+            }
+            if (format == "rgb24") {
+                options.formats.push_back(ImageUtils::PixelFormat::rgb24);
+            }
+            if (options.formats.empty()) {
+                std::cerr << "Unknown format: " << format << std::endl;
+                return false;
+            }
+        } else if (arg == "--video" && hasValue) {
+            options.videoPath = argv[++i];
+        } else if (arg == "--motion" && hasValue) {
+            options.motionEngine = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--cameras N] [--frames N] [--learning N]"
+                      << " [--resolution WxH]... [--format nv12|bgr24|y800|rgb24|all] [--video path]"
+                      << " [--motion mog2|fast]" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.resolutions.empty()) {
+        options.resolutions = {cv::Size(640, 360), cv::Size(1280, 720), cv::Size(1920, 1080)};
+    }
+    if (options.formats.empty()) {
+        options.formats = {ImageUtils::PixelFormat::nv12, ImageUtils::PixelFormat::bgr24,
+                           ImageUtils::PixelFormat::y800};
+    }
+    return true;
+}
+
+} // namespace bench
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+    if (!bench::parseArguments(argc, argv, options)) {
+        return 1;
+    }
+
+    // Keep models away from the real data directory and logs off the hot path
+    auto& globalConfig = GlobalConfig::instance();
+    globalConfig.dataStoragePath = (std::filesystem::temp_directory_path() / "nx_agent_bench").string();
+    Logger::setLogLevel(Logger::Level::WARNING);
+
+    std::cout << "=== NX Agent Benchmark (motion: " << options.motionEngine;
+    if (parseMotionEngine(options.motionEngine) == MotionEngine::Fast) {
+        std::cout << ", " << RunningAverageSubtractor::kernelName() << " kernel";
+    }
+    std::cout << ") ===" << std::endl;
+    for (const auto& size : options.resolutions) {
+        std::vector<cv::Mat> source = options.videoPath.empty()
+            ? bench::syntheticClip(size, 90)
+            : bench::recordedClip(options.videoPath, size, 300);
+        if (source.empty()) {
+            return 1;
+        }
+
+        for (auto format : options.formats) {
+            bench::runCase(options, size, format, source);
+        }
+    }
+
+    Logger::flush();
+    std::error_code ec;
+    std::filesystem::remove_all(globalConfig.dataStoragePath, ec);
+    return 0;
+}
@@ -0,0 +1,147 @@
+// tests/nx_agent_replay.cpp - Offline baseline training from recorded video
+//
+// Replays archive chunks or frame dumps of one or more cameras through the
+// plugin's analysis path, writes the trained model snapshots to the data
+// directory and prints the anomaly score distribution of each camera with
+// a suggested anomalyThreshold. Cameras replay in parallel.
+//
+// Usage: nx_agent_replay [--config path] [--data dir] [--report path]
+//                        [--parallel N] [--target-rate R] [--keep-baseline]
+//                        [--no-scheduler] deviceId=path...
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#include "../nx_agent_config.h"
+#include "../nx_agent_replay.h"
+#include "../nx_agent_utils.h"
+
+using namespace nx_agent;
+
+namespace {
+
+struct Arguments {
+    std::string configPath;
+    std::string dataPath;
+    std::string reportPath;
+    ReplayOptions options;
+    std::vector<std::pair<std::string, std::string>> cameras;   // deviceId, path
+};
+
+bool parseArguments(int argc, char* argv[], Arguments& arguments) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--config" && hasValue) {
+            arguments.configPath = argv[++i];
+        } else if (arg == "--data" && hasValue) {
+            arguments.dataPath = argv[++i];
+        } else if (arg == "--report" && hasValue) {
+            arguments.reportPath = argv[++i];
+        } else if (arg == "--parallel" && hasValue) {
+            arguments.options.maxParallelCameras = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--target-rate" && hasValue) {
+            arguments.options.targetAnomalyRate = std::atof(argv[++i]);
+        } else if (arg == "--keep-baseline") {
+            arguments.options.freshBaseline = false;
+        } else if (arg == "--no-scheduler") {
+            arguments.options.useScheduler = false;
+        } else if (arg.find('=') != std::string::npos && arg[0] != '-') {
+            size_t split = arg.find('=');
+            arguments.cameras.emplace_back(arg.substr(0, split), arg.substr(split + 1));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--config path] [--data dir] [--report path]"
+                      << " [--parallel N] [--target-rate R] [--keep-baseline] [--no-scheduler]"
+                      << " deviceId=path..." << std::endl;
+            return false;
+        }
+    }
+
+    if (arguments.cameras.empty()) {
+        std::cerr << "No cameras given (deviceId=path)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Arguments arguments;
+    if (!parseArguments(argc, argv, arguments)) {
+        return 1;
+    }
+
+    // Device settings come from the plugin's configuration so the replay
+    // analyzes exactly as the cameras do in production
+    auto& globalConfig = GlobalConfig::instance();
+    if (!arguments.configPath.empty()) {
+        std::ifstream file(arguments.configPath);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        if (!file.is_open() || !globalConfig.loadFromJson(contents.str())) {
+            std::cerr << "Failed to load configuration: " << arguments.configPath << std::endl;
+            return 1;
+        }
+    }
+    if (!arguments.dataPath.empty()) {
+        globalConfig.dataStoragePath = arguments.dataPath;
+    }
+    Logger::setLogLevel(Logger::Level::INFO);
+
+    ReplayEngine engine(arguments.options);
+    for (const auto& camera : arguments.cameras) {
+        std::vector<ReplaySegment> segments = findReplaySegments(camera.second);
+        if (segments.empty()) {
+            std::cerr << "No recordings found for " << camera.first << " in " << camera.second << std::endl;
+            return 1;
+        }
+        engine.addCamera(camera.first, std::move(segments));
+    }
+
+    std::vector<ReplayReport> reports = engine.run();
+
+    bool failed = false;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const auto& report : reports) {
+        if (!report.error.empty() || !report.snapshotSaved) {
+            std::cout << report.deviceId << ": failed" << (report.error.empty() ? "" : ": " + report.error)
+                      << std::endl;
+            failed = true;
+            continue;
+        }
+
+        const ScoreDistribution& scores = report.scores;
+        std::cout << report.deviceId << ": " << report.analyzedFrames << "/" << report.frames << " frames, "
+                  << report.baselineSamples << " baseline samples, " << std::setprecision(1)
+                  << report.speedup() << "x real time" << std::setprecision(3) << std::endl;
+        if (report.learningCompleteUs == 0) {
+            std::cout << "    learning did not complete; replay more video" << std::endl;
+        }
+        if (scores.count() == 0) {
+            continue;
+        }
+        std::cout << "    scores n=" << scores.count()
+                  << "  p50 " << scores.percentile(0.5)
+                  << "  p90 " << scores.percentile(0.9)
+                  << "  p99 " << scores.percentile(0.99)
+                  << "  p99.9 " << scores.percentile(0.999) << std::endl;
+        std::cout << "    threshold " << report.configuredThreshold << " flags "
+                  << scores.fractionAbove(report.configuredThreshold) * 100.0 << "%, suggested "
+                  << report.suggestedThreshold << " flags "
+                  << scores.fractionAbove(report.suggestedThreshold) * 100.0 << "%" << std::endl;
+    }
+
+    if (!arguments.reportPath.empty() && !ReplayEngine::writeReport(arguments.reportPath, reports)) {
+        failed = true;
+    }
+
+    Logger::flush();
+    return failed ? 1 : 0;
+}
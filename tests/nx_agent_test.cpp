@@ -5,14 +5,48 @@
 #include <vector>
 #include <memory>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
 #include <opencv2/opencv.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 
 // Include plugin components
 #include "../nx_agent_config.h"
 #include "../nx_agent_metadata.h"
 #include "../nx_agent_anomaly.h"
 #include "../nx_agent_response.h"
+#include "../nx_agent_regions.h"
+#include "../nx_agent_tracker.h"
+#include "../nx_agent_replay.h"
+#include "../nx_agent_objectmeta.h"
+#include "../nx_agent_window.h"
+#include "../nx_agent_featurelog.h"
+#include "../nx_agent_replication.h"
+#include "../nx_agent_executor.h"
+#include "../nx_agent_snapshot.h"
+#include "../nx_agent_metrics.h"
+#include "../nx_agent_motion.h"
+#include "../nx_agent_spsc.h"
+#include "../nx_agent_pipeline.h"
+#include "../nx_agent_incident.h"
+#include "../nx_agent_persistence.h"
+#include "../nx_agent_scheduler.h"
+#include "../nx_agent_detector.h"
+#include "../nx_agent_http.h"
 #include "../nx_agent_utils.h"
 
 using namespace nx_agent;
@@ -167,6 +201,235 @@ private:
     std::mutex m_mutex;
 };
 
+// Tags every frame with its width so results can be matched to requests
+class RecordingDetectorBackend : public ObjectDetectorBackend {
+public:
+    std::string name() const override { return "recording"; }
+    size_t maxBatchSize() const override { return 4; }
+    
+    std::vector<std::vector<DetectedObject>> detect(
+        const std::vector<const ImageUtils::FrameView*>& frames) override
+    {
+        if (failing) {
+            throw std::runtime_error("inference failed");
+        }
+        std::vector<std::vector<DetectedObject>> results(frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            DetectedObject object;
+            object.typeId = "person";
+            object.trackId = std::to_string(frames[i]->width());
+            results[i].push_back(object);
+        }
+        return results;
+    }
+    
+    std::atomic<bool> failing{false};
+};
+
+// Captures console output; writes block while held, like a stalled terminal
+class HeldStreamBuf : public std::streambuf {
+public:
+    void hold() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_held = true;
+    }
+    
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_held = false;
+        }
+        m_cv.notify_all();
+    }
+    
+    // Wait until a writer is stuck behind hold()
+    bool waitForBlockedWriter(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cv.wait_for(lock, timeout, [this]() { return m_blocked > 0; });
+    }
+    
+    std::string text() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_text;
+    }
+    
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize count) override {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_blocked++;
+        m_cv.notify_all();
+        m_cv.wait(lock, [this]() { return !m_held; });
+        m_blocked--;
+        m_text.append(data, static_cast<size_t>(count));
+        return count;
+    }
+    
+    int overflow(int ch) override {
+        if (ch != traits_type::eof()) {
+            char c = static_cast<char>(ch);
+            xsputn(&c, 1);
+        }
+        return ch;
+    }
+    
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_held = false;
+    int m_blocked = 0;
+    std::string m_text;
+};
+
+// Minimal keep-alive HTTP server on the loopback interface. Each path
+// answers with the next status in its script, then 200 for good.
+class WebhookServer {
+public:
+    struct Request {
+        std::string path;
+        std::string body;
+    };
+    
+    explicit WebhookServer(std::map<std::string, std::vector<int>> script) : m_script(std::move(script)) {
+        m_listener = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (m_listener < 0 || bind(m_listener, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+            listen(m_listener, 16) != 0 ||
+            getsockname(m_listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            throw std::runtime_error("Cannot start the webhook server");
+        }
+        m_port = ntohs(address.sin_port);
+        m_acceptor = std::thread(&WebhookServer::acceptConnections, this);
+    }
+    
+    ~WebhookServer() {
+        ::shutdown(m_listener, SHUT_RDWR);
+        m_acceptor.join();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (int connection : m_connections) {
+                ::shutdown(connection, SHUT_RDWR);
+            }
+        }
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+        close(m_listener);
+    }
+    
+    std::string url(const std::string& path) const {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+    
+    std::vector<Request> requests() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_requests;
+    }
+    
+    size_t connections() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_connections.size();
+    }
+    
+private:
+    void acceptConnections() {
+        while (true) {
+            int connection = accept(m_listener, nullptr, nullptr);
+            if (connection < 0) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_connections.push_back(connection);
+            m_threads.emplace_back(&WebhookServer::serve, this, connection);
+        }
+    }
+    
+    void serve(int connection) {
+        std::string buffer;
+        char chunk[4096];
+        while (true) {
+            size_t headerEnd;
+            while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t received = recv(connection, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    close(connection);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            
+            std::string headers = buffer.substr(0, headerEnd);
+            for (char& c : headers) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            size_t lengthAt = headers.find("content-length:");
+            size_t bodyLength = lengthAt == std::string::npos ? 0 : std::stoul(headers.substr(lengthAt + 15));
+            while (buffer.size() < headerEnd + 4 + bodyLength) {
+                ssize_t received = recv(connection, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    close(connection);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            
+            size_t pathAt = buffer.find(' ') + 1;
+            Request request;
+            request.path = buffer.substr(pathAt, buffer.find(' ', pathAt) - pathAt);
+            request.body = buffer.substr(headerEnd + 4, bodyLength);
+            buffer.erase(0, headerEnd + 4 + bodyLength);
+            
+            int status = 200;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                std::vector<int>& script = m_script[request.path];
+                if (!script.empty()) {
+                    status = script.front();
+                    script.erase(script.begin());
+                }
+                m_requests.push_back(request);
+            }
+            std::string response = "HTTP/1.1 " + std::to_string(status) + " Scripted\r\nContent-Length: 0\r\n\r\n";
+            send(connection, response.data(), response.size(), MSG_NOSIGNAL);
+        }
+    }
+    
+    int m_listener = -1;
+    int m_port = 0;
+    std::thread m_acceptor;
+    std::mutex m_mutex;
+    std::map<std::string, std::vector<int>> m_script;
+    std::vector<Request> m_requests;
+    std::vector<int> m_connections;
+    std::vector<std::thread> m_threads;
+};
+
+// Replica store whose reads take a while, like a distant or overloaded server
+class SlowReplicaStore : public ReplicaStore {
+public:
+    SlowReplicaStore(std::shared_ptr<ReplicaStore> inner, std::chrono::milliseconds delay)
+        : m_inner(std::move(inner)), m_delay(delay) {}
+    
+    Status put(const std::string& key, const std::vector<uint8_t>& data) override {
+        return m_inner->put(key, data);
+    }
+    
+    Status get(const std::string& key, std::vector<uint8_t>& data) override {
+        std::this_thread::sleep_for(m_delay);
+        return m_inner->get(key, data);
+    }
+    
+    Status remove(const std::string& key) override {
+        return m_inner->remove(key);
+    }
+    
+private:
+    std::shared_ptr<ReplicaStore> m_inner;
+    std::chrono::milliseconds m_delay;
+};
+
 } // namespace mock
 
 // Test scenarios
@@ -175,12 +438,12 @@ void runBasicTest() {
     
     // Create test components
     std::string deviceId = "test_camera_01";
-    auto config = GlobalConfig::instance().getDeviceConfig(deviceId);
-    
     // Set test configuration
-    config->anomalyThreshold = 0.6f;
-    config->enableLearning = true;
-    config->minPersonConfidence = 0.5f;
+    auto config = GlobalConfig::instance().modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        edited.anomalyThreshold = 0.6f;
+        edited.enableLearning = true;
+        edited.minPersonConfidence = 0.5f;
+    });
     
     // Create components
     MetadataAnalyzer analyzer(deviceId);
@@ -303,13 +566,13 @@ void runUnknownVisitorTest() {
     
     // Create test components
     std::string deviceId = "test_camera_02";
-    auto config = GlobalConfig::instance().getDeviceConfig(deviceId);
-    
     // Set test configuration
-    config->anomalyThreshold = 0.5f;
-    config->enableLearning = false; // Skip learning phase for this test
-    config->enableUnknownVisitorDetection = true;
-    config->unknownVisitorThresholdSecs = 5; // Short for testing
+    auto config = GlobalConfig::instance().modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        edited.anomalyThreshold = 0.5f;
+        edited.enableLearning = false; // Skip learning phase for this test
+        edited.enableUnknownVisitorDetection = true;
+        edited.unknownVisitorThresholdSecs = 5; // Short for testing
+    });
     
     // Create components
     MetadataAnalyzer analyzer(deviceId);
@@ -402,6 +665,2001 @@ void runUnknownVisitorTest() {
     collector.printSummary();
 }
 
+// Switch the process time zone (POSIX TZ string) and drop cached offsets
+static void setTimeZone(const char* tz) {
+    #ifdef _WIN32
+    _putenv_s("TZ", tz ? tz : "");
+    _tzset();
+    #else
+    if (tz) {
+        setenv("TZ", tz, 1);
+    } else {
+        unsetenv("TZ");
+    }
+    tzset();
+    #endif
+    TimeUtils::resetLocalTimeCache();
+}
+
+void runTimeUtilsDstTest() {
+    std::cout << "=== Running TimeUtils DST Test ===" << std::endl;
+    
+    const char* previousTz = std::getenv("TZ");
+    std::string savedTz = previousTz ? previousTz : "";
+    
+    // Zones with DST in either hemisphere, plus a half-hour shift
+    const char* zones[] = {
+        "EST5EDT,M3.2.0,M11.1.0",          // US Eastern
+        "GMT0BST,M3.5.0/1,M10.5.0",        // UK
+        "AEST-10AEDT,M10.1.0,M4.1.0/3",    // Sydney
+        "LHST-10:30LHDT-11,M10.1.0,M4.1.0", // Lord Howe (30 minute DST)
+        "UTC0"
+    };
+    
+    // Sweep 2024 in 17-minute steps, and second by second around each
+    // change, comparing against the C library
+    const int64_t yearStart = 1704067200;   // 2024-01-01T00:00:00Z
+    const int64_t yearEnd = 1735689600;     // 2025-01-01T00:00:00Z
+    int checked = 0;
+    
+    for (const char* zone : zones) {
+        setTimeZone(zone);
+        
+        auto check = [&](int64_t seconds) {
+            time_t t = static_cast<time_t>(seconds);
+            std::tm expected = {};
+            #ifdef _WIN32
+            localtime_s(&expected, &t);
+            #else
+            localtime_r(&t, &expected);
+            #endif
+            
+            TimeUtils::LocalTime local = TimeUtils::getLocalTime(seconds * 1000000 + 250000);
+            int expectedTimeOfDay = expected.tm_hour * 3600 + expected.tm_min * 60 + expected.tm_sec;
+            if (local.timeOfDaySeconds != expectedTimeOfDay || local.hour != expected.tm_hour ||
+                local.dayOfWeek != expected.tm_wday || local.day != expected.tm_mday ||
+                local.month != expected.tm_mon + 1 || local.year != expected.tm_year + 1900) {
+                throw std::runtime_error(std::string("TimeUtils mismatch in ") + zone + " at " +
+                                         std::to_string(seconds));
+            }
+            checked++;
+        };
+        
+        int64_t previousOffset = TimeUtils::getLocalTime(yearStart * 1000000).utcOffsetSeconds;
+        for (int64_t seconds = yearStart; seconds < yearEnd; seconds += 17 * 60) {
+            check(seconds);
+            
+            int offset = TimeUtils::getLocalTime(seconds * 1000000).utcOffsetSeconds;
+            if (offset != previousOffset) {
+                for (int64_t s = seconds - 2 * 3600; s < seconds + 3600; ++s) {
+                    check(s);
+                }
+                previousOffset = offset;
+            }
+        }
+    }
+    
+    setTimeZone(previousTz ? savedTz.c_str() : nullptr);
+    std::cout << "Checked " << checked << " timestamps against localtime" << std::endl;
+}
+
+void runExecutorShutdownTest() {
+    std::cout << "=== Running Executor Shutdown Test ===" << std::endl;
+    
+    // Tasks keep arriving from outside and from the workers while the pool
+    // shuts down; every one of them still runs exactly once
+    const int rounds = 200;
+    for (int round = 0; round < rounds; ++round) {
+        TaskExecutor executor(2);
+        std::atomic<int> submitted{0};
+        std::atomic<int> executed{0};
+        std::atomic<bool> producing{true};
+        
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 3; ++p) {
+            producers.emplace_back([&, p]() {
+                while (producing) {
+                    submitted++;
+                    executor.submit("camera" + std::to_string(p), TaskPriority::Normal, [&]() {
+                        executed++;
+                        submitted++;
+                        executor.submit("camera", TaskPriority::Background, [&]() { executed++; });
+                    });
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        
+        executor.shutdown();
+        producing = false;
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        
+        if (executed != submitted) {
+            throw std::runtime_error("Executor dropped " + std::to_string(submitted - executed) +
+                                     " tasks during shutdown");
+        }
+        if (executor.stats().pending != 0) {
+            throw std::runtime_error("Executor reports pending tasks after shutdown");
+        }
+    }
+    
+    std::cout << "No tasks lost across " << rounds << " shutdowns" << std::endl;
+}
+
+void runSnapshotTest() {
+    std::cout << "=== Running Model Snapshot Test ===" << std::endl;
+    
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_snapshot_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root);
+    std::string path = (root / "models.nxsnap").string();
+    
+    std::vector<SnapshotEntry> entries;
+    for (int hour = 0; hour < 3; ++hour) {
+        SnapshotEntry entry;
+        entry.key = hour;
+        entry.sampleCount = 100 + hour;
+        entry.weight = 90.5 + hour;
+        entry.mean = {0.1 * hour, 1.0, 2.0};
+        entry.m2 = {0.5, 0.25, 0.125 * hour};
+        entries.push_back(entry);
+    }
+    if (!SnapshotWriter::write(path, "snapshot_camera", 0.999, entries)) {
+        throw std::runtime_error("Snapshot could not be written");
+    }
+    if (std::filesystem::exists(path + ".tmp")) {
+        throw std::runtime_error("Snapshot write left its temporary file behind");
+    }
+    
+    // Read back in place
+    {
+        MappedSnapshot snapshot;
+        if (!snapshot.open(path) || snapshot.recordCount() != 3 || snapshot.header().featureCount != 3) {
+            throw std::runtime_error("Written snapshot did not open");
+        }
+        if (snapshot.record(2).sampleCount != 102 || snapshot.mean(2)[0] != 0.2 || snapshot.m2(2)[2] != 0.25 ||
+            std::string(snapshot.header().deviceId) != "snapshot_camera") {
+            throw std::runtime_error("Snapshot read back differently");
+        }
+    }
+    
+    std::vector<char> bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    auto rewrite = [&](const std::vector<char>& data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    };
+    
+    // A flipped bit in a record fails the checksum
+    std::vector<char> corrupt = bytes;
+    corrupt[corrupt.size() - 5] ^= 0x10;
+    rewrite(corrupt);
+    if (MappedSnapshot().open(path)) {
+        throw std::runtime_error("Corrupt snapshot was accepted");
+    }
+    
+    // So does a torn write, at any length
+    for (size_t length : {size_t(0), sizeof(SnapshotHeader) - 1, sizeof(SnapshotHeader), bytes.size() - 1}) {
+        rewrite(std::vector<char>(bytes.begin(), bytes.begin() + length));
+        if (MappedSnapshot().open(path)) {
+            throw std::runtime_error("Snapshot torn at " + std::to_string(length) + " bytes was accepted");
+        }
+    }
+    
+    rewrite(bytes);
+    if (!MappedSnapshot().open(path)) {
+        throw std::runtime_error("Restored snapshot did not open");
+    }
+    std::filesystem::remove_all(root);
+    
+    std::cout << "Snapshot of " << bytes.size() << " bytes validated" << std::endl;
+}
+
+void runMetricsTest() {
+    std::cout << "=== Running Metrics Test ===" << std::endl;
+    
+    // Every value lands in a bucket whose upper bound is within 12.5% of it,
+    // and buckets are ordered like their values
+    size_t previousIndex = 0;
+    for (uint64_t value = 0; value < (uint64_t(1) << 20); value += 1 + value / 64) {
+        size_t index = Histogram::bucketIndex(value);
+        uint64_t upper = Histogram::bucketUpperBound(index);
+        if (index < previousIndex || upper < value || upper > value + value / 8) {
+            throw std::runtime_error("Histogram bucket " + std::to_string(index) + " (upper " +
+                                     std::to_string(upper) + ") is wrong for " + std::to_string(value));
+        }
+        previousIndex = index;
+    }
+    if (Histogram::bucketIndex(uint64_t(1) << 40) != Histogram::kBucketCount - 1) {
+        throw std::runtime_error("Histogram did not clamp a value above its range");
+    }
+    
+    // Concurrent writers lose nothing
+    Histogram histogram;
+    Counter counter;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&]() {
+            for (uint64_t value = 1; value <= 1000; ++value) {
+                histogram.record(value);
+                counter.increment();
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    HistogramSnapshot snapshot = histogram.snapshot();
+    if (snapshot.count != 4000 || snapshot.sum != 4 * 500500 || snapshot.max != 1000 || counter.value() != 4000) {
+        throw std::runtime_error("Concurrent metric updates were lost");
+    }
+    uint64_t p50 = snapshot.percentile(0.5);
+    uint64_t p99 = snapshot.percentile(0.99);
+    if (p50 < 500 || p50 > 563 || p99 < 990 || p99 > 1000) {
+        throw std::runtime_error("Histogram percentiles p50 " + std::to_string(p50) + ", p99 " + std::to_string(p99));
+    }
+    
+    // Registered metrics are exported under their labels
+    MetricsRegistry::instance().counter("nx_agent_test_events_total", "metrics_camera")->increment(3);
+    std::string text = MetricsRegistry::instance().renderPrometheus();
+    if (text.find("nx_agent_test_events_total{device=\"metrics_camera\"} 3") == std::string::npos) {
+        throw std::runtime_error("Registered counter missing from the Prometheus export");
+    }
+    MetricsRegistry::instance().removeDevice("metrics_camera");
+    
+    std::cout << "p50 " << p50 << " us, p99 " << p99 << " us" << std::endl;
+}
+
+void runAnalysisModeTest() {
+    std::cout << "=== Running Analysis Mode Test ===" << std::endl;
+    
+    if (parseAnalysisMode("compressed") != AnalysisMode::Compressed ||
+        parseAnalysisMode("metadataOnly") != AnalysisMode::MetadataOnly ||
+        parseAnalysisMode("decoded") != AnalysisMode::Decoded ||
+        parseAnalysisMode("bogus") != AnalysisMode::Decoded) {
+        throw std::runtime_error("Analysis mode names parsed incorrectly");
+    }
+    
+    // A static scene encodes into steady inter frames and reports no motion
+    PacketMotionEstimator estimator(0.05f);
+    CompressedFrameInfo packet;
+    packet.width = 1920;
+    packet.height = 1080;
+    for (int i = 0; i < 50; ++i) {
+        packet.sizeBytes = 4000 + (i % 3) * 10;
+        packet.keyFrame = false;
+        if (estimator.update(packet) > 0.01f) {
+            throw std::runtime_error("Static scene reported packet motion");
+        }
+    }
+    
+    // Motion grows the inter frames; a keyframe repeats the last level
+    packet.sizeBytes = 40000;
+    float moving = estimator.update(packet);
+    if (moving < 0.3f) {
+        throw std::runtime_error("Large inter frame reported motion " + std::to_string(moving));
+    }
+    packet.keyFrame = true;
+    packet.sizeBytes = 200000;
+    if (estimator.update(packet) != moving) {
+        throw std::runtime_error("Keyframe changed the packet motion level");
+    }
+    
+    // A new resolution starts over, with no level until it has warmed up
+    packet.keyFrame = false;
+    packet.width = 1280;
+    packet.height = 720;
+    packet.sizeBytes = 40000;
+    if (estimator.update(packet) != 0.0f) {
+        throw std::runtime_error("Packet motion survived a resolution change");
+    }
+    
+    std::cout << "Packet motion level " << moving << std::endl;
+}
+
+void runAttributeInternTest() {
+    std::cout << "=== Running Attribute Intern Test ===" << std::endl;
+    
+    // Threads racing on the same names agree on their ids
+    std::vector<std::thread> interners;
+    std::vector<std::vector<AttributeKey>> keys(4);
+    for (int t = 0; t < 4; ++t) {
+        interners.emplace_back([&keys, t]() {
+            for (int i = 0; i < 200; ++i) {
+                keys[t].push_back(AttributeKeys::intern("internTest" + std::to_string(i)));
+            }
+        });
+    }
+    for (auto& interner : interners) {
+        interner.join();
+    }
+    for (int i = 0; i < 200; ++i) {
+        std::string name = "internTest" + std::to_string(i);
+        for (int t = 0; t < 4; ++t) {
+            if (keys[t][i] != keys[0][i] || AttributeKeys::name(keys[t][i]) != name) {
+                throw std::runtime_error("Interning " + name + " was not stable across threads");
+            }
+        }
+    }
+    if (AttributeKeys::intern("vehicleType") != AttributeKeys::VehicleType) {
+        throw std::runtime_error("Well-known attribute name has the wrong id");
+    }
+    
+    // Past the cap names are not interned, but sets still keep them apart
+    // (this fills the table, so it runs last)
+    for (size_t i = 0; i < AttributeKeys::kCapacity; ++i) {
+        AttributeKeys::intern("internFill" + std::to_string(i));
+    }
+    if (AttributeKeys::intern("internOverflowA") != AttributeKeys::Uninterned) {
+        throw std::runtime_error("Interning did not fall back once the table was full");
+    }
+    AttributeSet attributes;
+    attributes[AttributeKeys::VehicleType] = "car";
+    attributes["internOverflowA"] = "a";
+    attributes["internOverflowB"] = "b";
+    attributes["internOverflowA"] = "a2";
+    const std::string* a = attributes.find("internOverflowA");
+    const std::string* b = attributes.find("internOverflowB");
+    std::map<std::string, std::string> copied = attributes.toMap();
+    if (attributes.size() != 3 || !a || *a != "a2" || !b || *b != "b" ||
+        attributes.find("internOverflowC") || copied["internOverflowB"] != "b") {
+        throw std::runtime_error("Uninterned attributes were mixed up");
+    }
+    
+    std::cout << "Attribute intern test passed: " << AttributeKeys::kCapacity << " names interned" << std::endl;
+}
+
+void runReplayDeterminismTest() {
+    std::cout << "=== Running Replay Determinism Test ===" << std::endl;
+    
+    auto& globalConfig = GlobalConfig::instance();
+    std::string savedStoragePath = globalConfig.dataStoragePath;
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_replay_determinism_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "dump");
+    
+    // A frame dump with a block crossing the scene, one frame every 100 ms
+    const int frameCount = 120;
+    const int64_t startUs = 1718010000000000LL;
+    for (int i = 0; i < frameCount; ++i) {
+        cv::Mat image(240, 320, CV_8UC3, cv::Scalar(40, 40, 40));
+        cv::rectangle(image, cv::Rect((i * 7) % 280, 60 + (i % 5) * 20, 40, 80), cv::Scalar(220, 220, 220), -1);
+        cv::imwrite((root / "dump" / (std::to_string(startUs + i * 100000LL) + ".png")).string(), image);
+    }
+    std::vector<ReplaySegment> segments = findReplaySegments((root / "dump").string());
+    
+    // Two cameras on the same input in parallel, twice over: every replay
+    // must learn the same statistics
+    ReplayOptions options;
+    options.maxParallelCameras = 2;
+    options.useScheduler = false;
+    options.saveSnapshots = false;
+    std::vector<ReplayReport> reports;
+    for (int run = 0; run < 2; ++run) {
+        std::filesystem::remove_all(root / "storage");
+        globalConfig.dataStoragePath = (root / "storage").string();
+        ReplayEngine engine(options);
+        engine.addCamera("replay_determinism_a", segments);
+        engine.addCamera("replay_determinism_b", segments);
+        for (ReplayReport& report : engine.run()) {
+            reports.push_back(std::move(report));
+        }
+    }
+    globalConfig.dataStoragePath = savedStoragePath;
+    std::filesystem::remove_all(root);
+    
+    const ReplayReport& first = reports.front();
+    if (!first.error.empty() || first.frames != static_cast<uint64_t>(frameCount)) {
+        throw std::runtime_error("Replay did not read the frame dump: " + first.error);
+    }
+    for (const ReplayReport& report : reports) {
+        if (report.analyzedFrames != first.analyzedFrames || report.baselineSamples != first.baselineSamples ||
+            report.anomalies != first.anomalies || report.learningCompleteUs != first.learningCompleteUs ||
+            report.scores.count() != first.scores.count() ||
+            report.scores.percentile(0.5) != first.scores.percentile(0.5) ||
+            report.scores.percentile(0.99) != first.scores.percentile(0.99) ||
+            report.suggestedThreshold != first.suggestedThreshold) {
+            throw std::runtime_error("Replay of " + report.deviceId + " learned different statistics");
+        }
+    }
+    
+    std::cout << "Replay determinism test passed: " << first.baselineSamples << " baseline samples from "
+              << first.analyzedFrames << " frames in every run" << std::endl;
+}
+
+void runFrameQueueTest() {
+    std::cout << "=== Running Frame Queue Test ===" << std::endl;
+    
+    // A capacity below the power-of-two slot count still bounds the queue,
+    // and indices keep working as they wrap around the slots
+    SpscQueue<int> queue(3);
+    int value = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 3; ++i) {
+            if (!queue.tryPush(round * 3 + i)) {
+                throw std::runtime_error("SPSC queue rejected a push below capacity");
+            }
+        }
+        if (queue.tryPush(-1) || queue.size() != 3 || *queue.front() != round * 3) {
+            throw std::runtime_error("SPSC queue accepted a push while full");
+        }
+        for (int i = 0; i < 3; ++i) {
+            if (!queue.tryPop(value) || value != round * 3 + i) {
+                throw std::runtime_error("SPSC queue lost FIFO order after wrapping");
+            }
+        }
+        if (queue.tryPop(value) || !queue.empty()) {
+            throw std::runtime_error("SPSC queue popped from an empty queue");
+        }
+    }
+    
+    // The mailbox hands back what a newer item displaced
+    LatestMailbox<int> mailbox;
+    std::unique_ptr<int> displaced = mailbox.put(std::make_unique<int>(1));
+    displaced = mailbox.put(std::make_unique<int>(2));
+    std::unique_ptr<int> taken = mailbox.take();
+    if (!displaced || *displaced != 1 || !taken || *taken != 2 || mailbox.take()) {
+        throw std::runtime_error("Mailbox did not keep only the newest item");
+    }
+    
+    // While the first stage is busy, new frames replace the waiting one
+    // instead of being rejected, so the stage moves on to the newest
+    AnalysisPipeline pipeline("frame_queue_camera", 4, FrameDropPolicy::KeepLatest);
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+    std::mutex seenMutex;
+    std::vector<int64_t> seen;
+    pipeline.addStage("analyze", [&](PipelineJob& job) {
+        {
+            std::lock_guard<std::mutex> lock(seenMutex);
+            seen.push_back(job.timestampUs);
+        }
+        entered = true;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    });
+    pipeline.start();
+    
+    auto makeJob = [](int64_t timestampUs) {
+        auto job = std::make_unique<PipelineJob>();
+        job->timestampUs = timestampUs;
+        return job;
+    };
+    pipeline.submit(makeJob(1));
+    while (!entered) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (int64_t timestampUs = 2; timestampUs <= 10; ++timestampUs) {
+        if (!pipeline.submit(makeJob(timestampUs))) {
+            throw std::runtime_error("KeepLatest rejected the newest frame");
+        }
+    }
+    release = true;
+    for (int wait = 0; wait < 2000; ++wait) {
+        std::lock_guard<std::mutex> lock(seenMutex);
+        if (seen.size() >= 2) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    PipelineStats stats = pipeline.stats();
+    pipeline.stop();
+    
+    if (seen.size() != 2 || seen[0] != 1 || seen[1] != 10 || stats.submitted != 10 || stats.dropped != 8) {
+        throw std::runtime_error("KeepLatest analyzed " + std::to_string(seen.size()) + " frames, last " +
+                                 std::to_string(seen.empty() ? 0 : seen.back()) + ", dropped " +
+                                 std::to_string(stats.dropped));
+    }
+    
+    std::cout << "Frame queue test passed: 8 stale frames replaced, newest analyzed" << std::endl;
+}
+
+void runIncidentCorrelatorTest() {
+    std::cout << "=== Running Incident Correlator Test ===" << std::endl;
+    
+    std::mutex responsesMutex;
+    std::vector<IncidentSummary> responses;
+    auto respond = [&](const IncidentSummary& incident) {
+        std::lock_guard<std::mutex> lock(responsesMutex);
+        responses.push_back(incident);
+    };
+    auto responseCount = [&]() {
+        std::lock_guard<std::mutex> lock(responsesMutex);
+        return responses.size();
+    };
+    
+    {
+        // Reports arriving while the response is held are merged into what it sends
+        IncidentCorrelator correlator(500000, 5000000, 16, 100000);
+        IncidentDecision lead = correlator.report("site", "GeneralAnomaly", "Webhook", "camera_1", 0.6f, respond);
+        IncidentDecision second = correlator.report("site", "GeneralAnomaly", "Webhook", "camera_2", 0.9f, respond);
+        IncidentDecision repeat = correlator.report("site", "GeneralAnomaly", "Webhook", "camera_2", 0.7f, respond);
+        IncidentDecision otherSite = correlator.report("other", "GeneralAnomaly", "Webhook", "camera_3", 0.5f, respond);
+        if (!lead.lead || second.lead || repeat.lead || second.incidentId != lead.incidentId ||
+            !otherSite.lead || responseCount() != 0) {
+            throw std::runtime_error("Duplicate responses were not merged into the held incident");
+        }
+        for (int wait = 0; wait < 2000 && responseCount() < 2; ++wait) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(responsesMutex);
+        const IncidentSummary& merged = responses.front().id == lead.incidentId ? responses.front() : responses.back();
+        if (responses.size() != 2 || merged.reports != 3 || merged.maxScore != 0.9f ||
+            merged.devices != std::vector<std::string>{"camera_1", "camera_2"}) {
+            throw std::runtime_error("Held response did not carry the merged reports");
+        }
+        IncidentStats stats = correlator.stats();
+        if (stats.opened != 2 || stats.merged != 2) {
+            throw std::runtime_error("Correlator counted " + std::to_string(stats.opened) + " incidents");
+        }
+    }
+    
+    // The window is measured on one clock, whatever the reporting cameras' frame times
+    responses.clear();
+    {
+        IncidentCorrelator correlator(50000, 5000000, 16);
+        correlator.report("", "GeneralAnomaly", "Webhook", "camera_1", 0.6f, respond);
+        correlator.report("", "GeneralAnomaly", "Webhook", "camera_2", 0.6f, respond);
+        if (responseCount() != 1) {
+            throw std::runtime_error("Unheld response did not run exactly once");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(120));
+        IncidentDecision later = correlator.report("", "GeneralAnomaly", "Webhook", "camera_2", 0.6f, respond);
+        if (!later.lead || responseCount() != 2 || correlator.stats().opened != 2) {
+            throw std::runtime_error("Incident did not expire after its window");
+        }
+    }
+    
+    // An incident evicted while held still sends its response, at once
+    responses.clear();
+    {
+        IncidentCorrelator correlator(5000000, 5000000, 1, 2000000);
+        correlator.report("", "GeneralAnomaly", "Webhook", "camera_1", 0.6f, respond);
+        correlator.report("", "UnknownVisitor", "Webhook", "camera_1", 0.6f, respond);
+        if (responseCount() != 1 || correlator.stats().evicted != 1) {
+            throw std::runtime_error("Evicted incident lost its held response");
+        }
+    }
+    if (responseCount() != 2) {
+        throw std::runtime_error("Held response was lost at shutdown");
+    }
+    
+    std::cout << "Incident correlator test passed" << std::endl;
+}
+
+void runFrameViewTest() {
+    std::cout << "=== Running Frame View Test ===" << std::endl;
+    
+    // An NV12 frame: the luma plane is the leading rows of the buffer
+    const int width = 8;
+    const int height = 4;
+    std::vector<uint8_t> nv12(width * height * 3 / 2, 128);
+    for (int i = 0; i < width * height; ++i) {
+        nv12[i] = static_cast<uint8_t>(i * 7);
+    }
+    
+    using ImageUtils::FrameView;
+    using ImageUtils::PixelFormat;
+    FrameView view(PixelFormat::nv12, width, height, nv12.data());
+    const cv::Mat& luma = view.luma();
+    if (view.empty() || luma.rows != height || luma.cols != width || luma.type() != CV_8UC1) {
+        throw std::runtime_error("NV12 view has the wrong luma plane shape");
+    }
+    if (luma.data != nv12.data() || luma.at<uint8_t>(2, 3) != nv12[2 * width + 3]) {
+        throw std::runtime_error("NV12 luma plane was copied instead of viewed in place");
+    }
+    
+    // A clone owns its pixels, so the source buffer can be reused
+    FrameView copy = view.clone();
+    nv12[2 * width + 3] = 0;
+    const cv::Mat& copiedLuma = copy.luma();
+    if (copiedLuma.data == nv12.data() || copiedLuma.at<uint8_t>(2, 3) != static_cast<uint8_t>(19 * 7)) {
+        throw std::runtime_error("Cloned frame still points into the source buffer");
+    }
+    
+    // Y800 is its own luma plane; the colour image is only built on request
+    FrameView gray(PixelFormat::y800, width, height, nv12.data());
+    if (gray.luma().data != nv12.data() || gray.bgr().channels() != 3 ||
+        gray.bgr().ptr<uint8_t>(1)[3] != nv12[width + 1]) {
+        throw std::runtime_error("Y800 view planes are wrong");
+    }
+    
+    // Frames the view cannot describe stay empty
+    if (!FrameView(PixelFormat::unknown, width, height, nv12.data()).empty() ||
+        !FrameView(PixelFormat::nv12, width, height, nullptr).empty()) {
+        throw std::runtime_error("Unsupported frame was not left empty");
+    }
+    
+    std::cout << "Frame view test passed" << std::endl;
+}
+
+void runOnlineModelTest() {
+    std::cout << "=== Running Online Gaussian Model Test ===" << std::endl;
+    
+    auto makeFeatures = [](float motion, int persons, int vehicles) {
+        FeatureVector features{};
+        features.timeOfDaySeconds = 43200;
+        features.dayOfWeek = 3;
+        features.motionLevel = motion;
+        features.personCount = persons;
+        features.vehicleCount = vehicles;
+        return features;
+    };
+    std::vector<FeatureVector> samples;
+    for (int i = 0; i < 200; ++i) {
+        samples.push_back(makeFeatures(0.1f + 0.002f * (i % 50), i % 4, i % 3));
+    }
+    
+    // The running moments match a two-pass computation over the same samples
+    OnlineGaussianModel model(0.0, 100);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (model.isTrained() != (i >= 100)) {
+            throw std::runtime_error("Online model trained after " + std::to_string(i) + " samples");
+        }
+        model.update(samples[i]);
+    }
+    SnapshotEntry state;
+    if (!model.exportState(state) || state.sampleCount != 200 || std::abs(state.weight - 200.0) > 1e-9) {
+        throw std::runtime_error("Online model did not count its samples");
+    }
+    for (int f = 0; f < samples.front().featureCount(); ++f) {
+        double mean = 0.0;
+        for (const auto& sample : samples) {
+            mean += sample.featureAt(f);
+        }
+        mean /= samples.size();
+        double m2 = 0.0;
+        for (const auto& sample : samples) {
+            m2 += (sample.featureAt(f) - mean) * (sample.featureAt(f) - mean);
+        }
+        if (std::abs(state.mean[f] - mean) > 1e-6 || std::abs(state.m2[f] - m2) > 1e-4 * std::max(1.0, m2)) {
+            throw std::runtime_error("Online moments of feature " + std::to_string(f) + " drifted");
+        }
+    }
+    
+    // Batch training is the same fold; a restored state scores the same
+    OnlineGaussianModel batch(0.0, 100);
+    batch.train(samples);
+    OnlineGaussianModel restored(0.0, 100);
+    restored.importState(state);
+    FeatureVector usual = makeFeatures(0.15f, 1, 1);
+    FeatureVector unusual = makeFeatures(0.9f, 12, 0);
+    if (batch.scoreAnomaly(usual) != model.scoreAnomaly(usual) ||
+        restored.scoreAnomaly(unusual) != model.scoreAnomaly(unusual) ||
+        model.scoreAnomaly(usual) > 0.5f || model.scoreAnomaly(unusual) < 0.9f) {
+        throw std::runtime_error("Online model scores are inconsistent");
+    }
+    
+    // With decay the model forgets and follows a changed scene
+    OnlineGaussianModel decaying(0.05, 10);
+    for (int i = 0; i < 200; ++i) {
+        decaying.update(makeFeatures(0.1f, 0, 0));
+    }
+    for (int i = 0; i < 200; ++i) {
+        decaying.update(makeFeatures(0.6f, 5, 2));
+    }
+    SnapshotEntry decayed;
+    decaying.exportState(decayed);
+    if (std::abs(decayed.mean[2] - 0.6) > 0.01 || decayed.weight > 21.0) {
+        throw std::runtime_error("Decaying model did not follow the new scene");
+    }
+    
+    // Samples of another length are ignored rather than corrupting the model
+    FeatureVector longer = makeFeatures(0.1f, 0, 0);
+    longer.additionalFeatures.push_back(1.0f);
+    model.update(longer);
+    if (model.sampleCount() != 200) {
+        throw std::runtime_error("Online model accepted a sample of the wrong length");
+    }
+    
+    std::cout << "Online model test passed: unusual sample scored " << model.scoreAnomaly(unusual) << std::endl;
+}
+
+void runPersistenceTest() {
+    std::cout << "=== Running Write-Behind Persistence Test ===" << std::endl;
+    
+    ModelPersistenceService& service = ModelPersistenceService::instance();
+    PersistenceStats before = service.stats();
+    
+    // Any number of changes between two writes cost one write
+    std::atomic<int> writes{0};
+    uint64_t handle = service.registerSource([&writes]() {
+        writes++;
+        return true;
+    });
+    service.markDirty(handle);
+    service.markDirty(handle);
+    service.markDirty(handle);
+    service.flushAll();
+    service.flushAll();
+    PersistenceStats after = service.stats();
+    if (writes != 1 || after.coalesced - before.coalesced != 2 || after.writes - before.writes != 1) {
+        throw std::runtime_error("Dirty marks were not coalesced into one write");
+    }
+    
+    // A failed write stays dirty and is retried
+    std::atomic<int> attempts{0};
+    uint64_t failing = service.registerSource([&attempts]() {
+        return ++attempts > 1;
+    });
+    service.markDirty(failing);
+    service.flushAll();
+    if (attempts != 1 || service.stats().failures - before.failures != 1) {
+        throw std::runtime_error("Failed write was not counted");
+    }
+    service.flushAll();
+    if (attempts != 2 || service.stats().dirty != before.dirty) {
+        throw std::runtime_error("Failed write was not retried");
+    }
+    service.unregisterSource(failing);
+    
+    // Marking dirty never waits for a write in progress
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+    uint64_t slow = service.registerSource([&]() {
+        entered = true;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    });
+    service.markDirty(slow);
+    std::thread flusher([&service]() { service.flushAll(); });
+    while (!entered) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto marked = std::async(std::launch::async, [&service, slow]() { service.markDirty(slow); });
+    bool returned = marked.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+    release = true;
+    flusher.join();
+    marked.wait();
+    if (!returned) {
+        throw std::runtime_error("markDirty blocked on a write in progress");
+    }
+    
+    // Unregistering writes what is still dirty
+    service.unregisterSource(slow);
+    service.markDirty(handle);
+    service.unregisterSource(handle);
+    if (writes != 2 || service.stats().sources != before.sources) {
+        throw std::runtime_error("Unregistering lost a pending write");
+    }
+    
+    std::cout << "Persistence test passed" << std::endl;
+}
+
+void runRegionIndexTest() {
+    std::cout << "=== Running Region Index Test ===" << std::endl;
+    
+    auto makeRegion = [](std::vector<std::pair<float, float>> points, bool exclusion) {
+        Region region;
+        region.points = std::move(points);
+        region.isExclusionZone = exclusion;
+        return region;
+    };
+    
+    // No regions: everything is of interest and callers can skip masking
+    RegionIndex everywhere;
+    if (!everywhere.coversEverything() || !everywhere.contains(0.0f, 1.0f) ||
+        !RegionIndex(std::vector<Region>()).coversEverything()) {
+        throw std::runtime_error("Empty region index does not cover the frame");
+    }
+    
+    // A triangle matches an even-odd test at every cell centre
+    std::vector<std::pair<float, float>> triangle = {{0.1f, 0.1f}, {0.9f, 0.3f}, {0.3f, 0.8f}};
+    RegionIndex included({makeRegion(triangle, false)});
+    int mismatches = 0;
+    for (int row = 0; row < RegionIndex::kResolution; ++row) {
+        for (int col = 0; col < RegionIndex::kResolution; ++col) {
+            float x = (col + 0.5f) / RegionIndex::kResolution;
+            float y = (row + 0.5f) / RegionIndex::kResolution;
+            bool inside = false;
+            for (size_t i = 0, j = triangle.size() - 1; i < triangle.size(); j = i++) {
+                const auto& a = triangle[i];
+                const auto& b = triangle[j];
+                if ((a.second > y) != (b.second > y) &&
+                    x < a.first + (y - a.second) * (b.first - a.first) / (b.second - a.second)) {
+                    inside = !inside;
+                }
+            }
+            mismatches += included.contains(x, y) != inside ? 1 : 0;
+        }
+    }
+    if (included.coversEverything() || mismatches != 0) {
+        throw std::runtime_error("Region bitmap differs from the polygon in " + std::to_string(mismatches) + " cells");
+    }
+    cv::Rect bounds = included.interestBounds(1000, 1000);
+    if (std::abs(bounds.x - 100) > 5 || std::abs(bounds.y - 100) > 5 ||
+        std::abs(bounds.x + bounds.width - 900) > 5 || std::abs(bounds.y + bounds.height - 800) > 5) {
+        throw std::runtime_error("Region interest bounds are wrong");
+    }
+    
+    // Exclusion zones alone leave the rest of interest; inclusion wins
+    // where both apply, and out-of-range points are clamped to the edge
+    std::vector<std::pair<float, float>> square = {{0.2f, 0.2f}, {0.8f, 0.2f}, {0.8f, 0.8f}, {0.2f, 0.8f}};
+    std::vector<std::pair<float, float>> inner = {{0.4f, 0.4f}, {0.6f, 0.4f}, {0.6f, 0.6f}, {0.4f, 0.6f}};
+    RegionIndex excluded({makeRegion(square, true)});
+    RegionIndex both({makeRegion(square, true), makeRegion(inner, false)});
+    if (!excluded.contains(0.1f, 0.1f) || excluded.contains(0.5f, 0.5f) || !excluded.contains(-3.0f, 7.0f) ||
+        !both.contains(0.5f, 0.5f) || both.contains(0.3f, 0.3f) || !both.contains(0.9f, 0.9f)) {
+        throw std::runtime_error("Inclusion and exclusion zones were combined wrongly");
+    }
+    
+    // Nothing of interest gives empty bounds
+    RegionIndex nothing({makeRegion({{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}}, true)});
+    if (nothing.contains(0.5f, 0.5f) || nothing.interestBounds(640, 480).area() != 0) {
+        throw std::runtime_error("Fully excluded frame still has an area of interest");
+    }
+    
+    std::cout << "Region index test passed" << std::endl;
+}
+
+void runCroppedMotionTest() {
+    std::cout << "=== Running Cropped Motion Test ===" << std::endl;
+    
+    // Only the left half is of interest; motion runs on that crop, downscaled
+    std::string deviceId = "test_camera_cropped_motion";
+    auto config = GlobalConfig::instance().modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        Region left;
+        left.points = {{0.0f, 0.0f}, {0.5f, 0.0f}, {0.5f, 1.0f}, {0.0f, 1.0f}};
+        edited.detectionRegions = {left};
+        edited.cropMotionToRegions = true;
+        edited.motionEngine = "fast";
+        edited.motionAnalysisWidth = 160;
+    });
+    MetadataAnalyzer analyzer(deviceId);
+    analyzer.configure(config);
+    
+    cv::Mat background(720, 1280, CV_8UC1, cv::Scalar(180));
+    int64_t startTime = TimeUtils::getCurrentTimestampUs();
+    for (int i = 0; i < 10; ++i) {
+        analyzer.processFrame(background, startTime + i * 100000);
+    }
+    
+    // Motion outside the regions is never looked at
+    cv::Mat outside = background.clone();
+    cv::rectangle(outside, cv::Rect(900, 300, 150, 150), cv::Scalar(40), cv::FILLED);
+    MotionInfo ignored = analyzer.processFrame(outside, startTime + 1000000).motionInfo;
+    if (ignored.overallMotionLevel != 0.0f || !ignored.motionCenters.empty()) {
+        throw std::runtime_error("Motion outside the cropped regions was reported");
+    }
+    
+    // Motion inside is measured against the region's area and its centre is
+    // mapped back to native frame coordinates
+    cv::Mat inside = background.clone();
+    cv::Rect box(200, 300, 150, 150);
+    cv::rectangle(inside, box, cv::Scalar(40), cv::FILLED);
+    MotionInfo motion = analyzer.processFrame(inside, startTime + 1100000).motionInfo;
+    float expectedLevel = static_cast<float>(box.area()) / (640 * 720);
+    if (std::abs(motion.overallMotionLevel - expectedLevel) > expectedLevel * 0.25f ||
+        motion.motionCenters.size() != 1) {
+        throw std::runtime_error("Cropped motion level " + std::to_string(motion.overallMotionLevel) +
+                                 " is wrong");
+    }
+    cv::Point center = motion.motionCenters[0];
+    if (std::abs(center.x - (box.x + box.width / 2)) > 8 || std::abs(center.y - (box.y + box.height / 2)) > 8) {
+        throw std::runtime_error("Cropped motion centre is at " + std::to_string(center.x) + "," +
+                                 std::to_string(center.y));
+    }
+    
+    std::cout << "Cropped motion level " << motion.overallMotionLevel << ", center " << center.x << ","
+              << center.y << std::endl;
+}
+
+void runFrameSchedulerTest() {
+    std::cout << "=== Running Frame Scheduler Test ===" << std::endl;
+    
+    // 15 fps stream, one frame per second while quiet, 3 s hold after activity
+    FrameScheduler scheduler;
+    scheduler.configure(1000000, 3000000);
+    const int64_t frameUs = 1000000 / 15;
+    const int64_t startUs = 1718010000LL * 1000000;
+    
+    // A quiet scene: the first frame, then one per idle interval
+    int processed = 0;
+    for (int i = 0; i < 60; ++i) {
+        processed += scheduler.shouldProcess(startUs + i * frameUs) ? 1 : 0;
+    }
+    if (processed != 4 || scheduler.mode(startUs + 60 * frameUs) != FrameScheduler::Mode::Idle) {
+        throw std::runtime_error("Quiet scene analyzed " + std::to_string(processed) + " of 60 frames");
+    }
+    
+    // Activity switches to every frame until the hold has passed
+    int64_t activeUs = startUs + 60 * frameUs;
+    scheduler.reportActivity(activeUs, true);
+    processed = 0;
+    int frame = 61;
+    for (; startUs + frame * frameUs < activeUs + 3000000; ++frame) {
+        processed += scheduler.shouldProcess(startUs + frame * frameUs) ? 1 : 0;
+    }
+    int activeFrames = frame - 61;
+    if (processed != activeFrames || scheduler.mode(activeUs + 2999999) != FrameScheduler::Mode::Active) {
+        throw std::runtime_error("Active scene skipped frames");
+    }
+    if (scheduler.shouldProcess(startUs + frame * frameUs + frameUs) ||
+        scheduler.mode(activeUs + 3000000) != FrameScheduler::Mode::Idle) {
+        throw std::runtime_error("Scheduler stayed active past the hold");
+    }
+    
+    // Quiet reports do not extend the hold; a stream that jumps back is analyzed
+    scheduler.reportActivity(activeUs + 5000000, false);
+    if (scheduler.mode(activeUs + 5000000) != FrameScheduler::Mode::Idle || !scheduler.shouldProcess(startUs)) {
+        throw std::runtime_error("Scheduler mishandled a quiet report or a seek");
+    }
+    if (scheduler.consideredFrames() != static_cast<uint64_t>(60 + activeFrames + 2) ||
+        scheduler.skippedFrames() != 57) {
+        throw std::runtime_error("Scheduler counted " + std::to_string(scheduler.skippedFrames()) + " skips");
+    }
+    
+    // A disabled scheduler analyzes everything
+    FrameScheduler disabled;
+    disabled.configure(0, 0);
+    for (int i = 0; i < 10; ++i) {
+        if (!disabled.shouldProcess(startUs + i * frameUs)) {
+            throw std::runtime_error("Disabled scheduler skipped a frame");
+        }
+    }
+    
+    std::cout << "Frame scheduler test passed: " << scheduler.skippedFrames() << " of "
+              << scheduler.consideredFrames() << " frames skipped" << std::endl;
+}
+
+void runDetectionBatcherTest() {
+    std::cout << "=== Running Detection Batcher Test ===" << std::endl;
+    
+    uint8_t pixels[64] = {};
+    std::vector<ImageUtils::FrameView> frames;
+    for (int i = 1; i <= 10; ++i) {
+        frames.emplace_back(ImageUtils::PixelFormat::y800, i, 1, pixels);
+    }
+    
+    // Frames queued together share inferences, capped at the backend's batch size
+    auto backend = std::make_shared<mock::RecordingDetectorBackend>();
+    DetectionBatcher batcher(backend, 8, std::chrono::milliseconds(200));
+    std::mutex answersMutex;
+    std::map<int, std::pair<std::string, bool>> answers;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        int width = frames[i].width();
+        batcher.submit(i % 2 ? "camera_a" : "camera_b", frames[i],
+                       [&, width](std::vector<DetectedObject> objects, bool ok) {
+            std::lock_guard<std::mutex> lock(answersMutex);
+            answers[width] = {objects.size() == 1 ? objects[0].trackId : "", ok};
+        });
+    }
+    for (int wait = 0; wait < 2000; ++wait) {
+        std::lock_guard<std::mutex> lock(answersMutex);
+        if (answers.size() == frames.size()) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    {
+        std::lock_guard<std::mutex> lock(answersMutex);
+        for (int width = 1; width <= 10; ++width) {
+            if (!answers[width].second || answers[width].first != std::to_string(width)) {
+                throw std::runtime_error("Frame " + std::to_string(width) + " got another frame's detections");
+            }
+        }
+    }
+    DetectionBatcherStats stats = batcher.stats();
+    if (stats.frames != 10 || stats.maxBatchSize != 4 || stats.batches != 3 || stats.failures != 0) {
+        throw std::runtime_error("Batcher ran " + std::to_string(stats.batches) + " batches of up to " +
+                                 std::to_string(stats.maxBatchSize));
+    }
+    
+    // A failed inference still answers every frame in the batch
+    backend->failing = true;
+    std::atomic<int> failed{0};
+    for (int i = 0; i < 3; ++i) {
+        batcher.submit("camera_a", frames[i], [&failed](std::vector<DetectedObject> objects, bool ok) {
+            if (!ok && objects.empty()) {
+                failed++;
+            }
+        });
+    }
+    for (int wait = 0; wait < 2000 && failed < 3; ++wait) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (failed != 3 || batcher.stats().failures != 1) {
+        throw std::runtime_error("Failed inference was not reported to its frames");
+    }
+    
+    // Once stopped, requests are answered at once
+    batcher.stop();
+    bool answered = false;
+    batcher.submit("camera_a", frames[0], [&answered](std::vector<DetectedObject>, bool ok) {
+        answered = !ok;
+    });
+    if (!answered) {
+        throw std::runtime_error("Stopped batcher left a request unanswered");
+    }
+    
+    std::cout << "Detection batcher test passed: " << stats.batches << " batches for "
+              << stats.frames << " frames" << std::endl;
+}
+
+void runFrameSummaryTest() {
+    std::cout << "=== Running Frame Summary Test ===" << std::endl;
+    
+    auto makeObject = [](const std::string& type, int x, bool unknown) {
+        DetectedObject object;
+        object.typeId = type;
+        object.confidence = 0.9f;
+        object.boundingBox = cv::Rect(x, 400, 100, 200);
+        if (unknown) {
+            object.attributes[AttributeKeys::RecognitionStatus] = "unknown";
+        }
+        return object;
+    };
+    
+    FrameAnalysisResult result;
+    result.timestampUs = 1718010000LL * 1000000;
+    result.frameWidth = 1920;
+    result.frameHeight = 1080;
+    result.objects = {makeObject("person", 200, true), makeObject("person", 1500, false),
+                      makeObject("vehicle", 1200, false), makeObject("bag", 600, false)};
+    TimeUtils::LocalTime local = TimeUtils::getLocalTime(result.timestampUs);
+    
+    // The left half of the frame is of interest, and business hours bracket the frame
+    DeviceConfig config("summary_camera");
+    Region left;
+    left.points = {{0.0f, 0.0f}, {0.5f, 0.0f}, {0.5f, 1.0f}, {0.0f, 1.0f}};
+    config.detectionRegions = {left};
+    config.businessHours = {{local.timeOfDaySeconds - 60, local.timeOfDaySeconds + 60}};
+    MetadataAnalyzer analyzer("summary_camera");
+    analyzer.configure(DeviceConfig::freeze(config));
+    analyzer.summarize(result);
+    
+    const FrameSummary& summary = result.summary;
+    if (!summary.valid || summary.personCount != 2 || summary.unknownPersonCount != 1 ||
+        summary.vehicleCount != 1 || summary.otherCount != 1) {
+        throw std::runtime_error("Frame summary miscounted objects");
+    }
+    if (summary.objectsInRegions != 2 || summary.objectsOutsideRegions != 2 || summary.personsOutsideRegions != 1) {
+        throw std::runtime_error("Frame summary placed objects in the wrong regions");
+    }
+    if (!summary.duringBusinessHours || summary.hourOfDay != local.hour || summary.dayOfWeek != local.dayOfWeek) {
+        throw std::runtime_error("Frame summary calendar fields do not follow the frame timestamp");
+    }
+    
+    // Outside business hours; the object counts are unchanged
+    config.businessHours = {{local.timeOfDaySeconds + 60, local.timeOfDaySeconds + 120}};
+    analyzer.configure(DeviceConfig::freeze(config));
+    analyzer.summarize(result);
+    if (result.summary.duringBusinessHours || result.summary.personCount != 2) {
+        throw std::runtime_error("Frame summary ignored the configured business hours");
+    }
+    
+    // Without a configuration only counts and calendar fields are filled
+    FrameSummary counts = FrameSummary::fromObjects(result.objects, result.timestampUs);
+    if (!counts.valid || counts.personCount != 2 || counts.objectsInRegions != 0 ||
+        counts.timeOfDaySeconds != local.timeOfDaySeconds) {
+        throw std::runtime_error("Summary from objects alone is wrong");
+    }
+    
+    std::cout << "Frame summary test passed: " << summary.objectsInRegions << " objects in regions, "
+              << summary.objectsOutsideRegions << " outside" << std::endl;
+}
+
+void runLoggerOverflowTest() {
+    std::cout << "=== Running Logger Overflow Test ===" << std::endl;
+    
+    Logger::flush();
+    uint64_t droppedBefore = Logger::stats().dropped;
+    
+    // Stall the background writer on its first write, so a thread's buffer fills
+    mock::HeldStreamBuf console;
+    console.hold();
+    std::streambuf* previous = std::cout.rdbuf(&console);
+    
+    const int messages = 3000;
+    const int capacity = 1024;      // Log buffer size per thread
+    std::atomic<bool> flooded{false};
+    std::atomic<bool> stalled{false};
+    std::atomic<uint64_t> pending{0};
+    std::thread producer([&]() {
+        Logger::error("LoggerTest", "first");
+        stalled = console.waitForBlockedWriter(std::chrono::seconds(5));
+        for (int i = 0; i < messages; ++i) {
+            Logger::warning("LoggerTest", "flood " + std::to_string(i));
+        }
+        pending = Logger::stats().dropped - droppedBefore;
+        flooded = true;
+        
+        // The buffer is full, but errors are written rather than dropped
+        Logger::error("LoggerTest", "must survive");
+    });
+    while (!flooded) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    console.release();
+    producer.join();
+    Logger::flush();
+    std::cout.rdbuf(previous);
+    
+    uint64_t dropped = Logger::stats().dropped - droppedBefore;
+    std::string output = console.text();
+    if (!stalled || pending != static_cast<uint64_t>(messages - capacity) || dropped != pending) {
+        throw std::runtime_error("Logger dropped " + std::to_string(dropped) + " messages from a full buffer");
+    }
+    if (output.find("must survive") == std::string::npos ||
+        output.find("flood " + std::to_string(capacity - 1)) == std::string::npos ||
+        output.find("flood " + std::to_string(capacity) + "\n") != std::string::npos ||
+        output.find("Dropped " + std::to_string(dropped) + " messages") == std::string::npos) {
+        throw std::runtime_error("Logger output is missing queued messages, the error or the drop notice");
+    }
+    
+    std::cout << "Logger overflow test passed: " << dropped << " of " << messages << " messages dropped" << std::endl;
+}
+
+void runHttpDispatcherTest() {
+    std::cout << "=== Running HTTP Dispatcher Test ===" << std::endl;
+    
+    // One 503 to retry, a hard 400, and a receiver that never recovers
+    mock::WebhookServer server({
+        {"/alerts", {503}},
+        {"/rejected", {400}},
+        {"/down", {500, 500, 500, 500}}
+    });
+    
+    HttpDispatcherOptions options;
+    options.maxRetries = 3;
+    options.retryBackoff = std::chrono::milliseconds(10);
+    options.batchWindow = std::chrono::milliseconds(100);
+    HttpDispatcher dispatcher(options);
+    
+    // Alerts for the same URL within the window share a request
+    for (int i = 1; i <= 3; ++i) {
+        dispatcher.post(server.url("/alerts"), "{\"n\":" + std::to_string(i) + "}");
+    }
+    dispatcher.post(server.url("/single"), "{\"n\":4}");
+    dispatcher.post(server.url("/rejected"), "{\"n\":5}");
+    dispatcher.post(server.url("/down"), "{\"n\":6}");
+    auto posted = std::chrono::steady_clock::now();
+    
+    HttpDispatcherStats stats;
+    for (int wait = 0; wait < 500; ++wait) {
+        stats = dispatcher.stats();
+        if (stats.delivered + stats.failed == 6) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (stats.posted != 6 || stats.delivered != 4 || stats.requests != 2 || stats.failed != 2 ||
+        stats.retried != 4) {
+        throw std::runtime_error("Dispatcher delivered " + std::to_string(stats.delivered) + ", failed " +
+                                 std::to_string(stats.failed) + ", retried " + std::to_string(stats.retried));
+    }
+    
+    // Three backoffs of 10, 20 and 40 ms after a 100 ms window
+    if (std::chrono::steady_clock::now() - posted > std::chrono::seconds(1)) {
+        throw std::runtime_error("Dispatcher waited longer than its retry backoff");
+    }
+    
+    std::map<std::string, std::vector<std::string>> bodies;
+    for (const auto& request : server.requests()) {
+        bodies[request.path].push_back(request.body);
+    }
+    std::vector<std::string> batch(2, "[{\"n\":1},{\"n\":2},{\"n\":3}]");
+    if (bodies["/alerts"] != batch || bodies["/single"] != std::vector<std::string>{"{\"n\":4}"}) {
+        throw std::runtime_error("Dispatcher did not batch and retry alerts per URL");
+    }
+    if (bodies["/rejected"].size() != 1 || bodies["/down"].size() != 4) {
+        throw std::runtime_error("Dispatcher retried a rejected alert or gave up early");
+    }
+    
+    // Connections are reused between requests
+    if (server.connections() >= server.requests().size()) {
+        throw std::runtime_error("Dispatcher opened a connection per request");
+    }
+    
+    dispatcher.stop();
+    if (dispatcher.post(server.url("/alerts"), "{}") || dispatcher.stats().dropped != 0) {
+        throw std::runtime_error("Stopped dispatcher accepted an alert");
+    }
+    
+    std::cout << "HTTP dispatcher test passed: " << server.requests().size() << " requests over "
+              << server.connections() << " connections" << std::endl;
+}
+
+void runMotionKernelParityTest() {
+    std::cout << "=== Running Motion Kernel Parity Test (" << RunningAverageSubtractor::kernelName()
+              << " kernel) ===" << std::endl;
+    
+    // Widths around every vector length, so each kernel's scalar tail runs too
+    const int widths[] = {1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 130};
+    const int parameters[][2] = {{1, 0}, {20, 6}, {254, 14}, {8, 3}};
+    const int height = 5;
+    std::minstd_rand noise(12345);
+    int pixels = 0;
+    
+    for (int width : widths) {
+        for (const auto& parameter : parameters) {
+            RunningAverageSubtractor subtractor(parameter[0], parameter[1]);
+            
+            // Frames are windows into a larger image, so rows are not contiguous
+            cv::Mat canvas(height + 4, width + 9, CV_8UC1, cv::Scalar(0));
+            cv::Mat frame = canvas(cv::Rect(5, 2, width, height));
+            std::vector<int16_t> background(static_cast<size_t>(width * height));
+            
+            for (int step = 0; step < 12; ++step) {
+                for (int y = 0; y < height; ++y) {
+                    uint8_t* row = frame.ptr<uint8_t>(y);
+                    for (int x = 0; x < width; ++x) {
+                        // Mostly small drift with the occasional jump to either extreme
+                        int value = step == 0 ? static_cast<int>(noise() % 256)
+                                              : row[x] + static_cast<int>(noise() % 9) - 4;
+                        if (noise() % 10 == 0) {
+                            value = noise() % 2 ? 0 : 255;
+                        }
+                        row[x] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+                    }
+                }
+                
+                cv::Mat mask;
+                subtractor.apply(frame, mask);
+                
+                // Reference model: 7 fractional bits, arithmetic shift towards the frame
+                for (int y = 0; y < height; ++y) {
+                    const uint8_t* luma = frame.ptr<uint8_t>(y);
+                    const uint8_t* bits = mask.ptr<uint8_t>(y);
+                    for (int x = 0; x < width; ++x) {
+                        int16_t& value = background[static_cast<size_t>(y * width + x)];
+                        int expected = 0;
+                        if (step == 0) {
+                            value = static_cast<int16_t>(luma[x] << 7);
+                        } else {
+                            int diff = (luma[x] << 7) - value;
+                            expected = std::abs(diff) > (parameter[0] << 7) ? 255 : 0;
+                            value = static_cast<int16_t>(value + (diff >> parameter[1]));
+                        }
+                        if (bits[x] != expected) {
+                            throw std::runtime_error("Motion kernel differs from the scalar model at width " +
+                                                     std::to_string(width) + ", pixel " + std::to_string(x) +
+                                                     "," + std::to_string(y) + ", frame " + std::to_string(step));
+                        }
+                        pixels++;
+                    }
+                }
+            }
+        }
+    }
+    
+    std::cout << "Motion kernel parity test passed: " << pixels << " pixels match" << std::endl;
+}
+
+void runLegacyModelImportTest() {
+    std::cout << "=== Running Legacy Model Import Test ===" << std::endl;
+    
+    auto& globalConfig = GlobalConfig::instance();
+    std::string savedStoragePath = globalConfig.dataStoragePath;
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_legacy_import_test";
+    std::filesystem::remove_all(root);
+    globalConfig.dataStoragePath = root.string();
+    
+    // Per-hour XML models as GaussianModel wrote them
+    auto writeLegacyModel = [&](const std::string& deviceId, int hour, int featureCount) {
+        std::filesystem::create_directories(root / deviceId);
+        cv::FileStorage fs((root / deviceId / ("model_hour_" + std::to_string(hour) + ".xml")).string(),
+                           cv::FileStorage::WRITE);
+        fs << "trained" << true;
+        fs << "mean" << cv::Mat(1, featureCount, CV_32F, cv::Scalar(1.0f));
+        fs << "stdDev" << cv::Mat(1, featureCount, CV_32F, cv::Scalar(0.5f));
+        fs.release();
+    };
+    const int64_t midnightUs = 1718000000LL * 1000000;
+    auto makeResult = [&](int hour, int sample) {
+        FrameAnalysisResult result;
+        result.timestampUs = midnightUs + (hour * 3600LL + sample) * 1000000;
+        result.summary.valid = true;
+        result.summary.timeOfDaySeconds = hour * 3600 + sample;
+        result.summary.hourOfDay = hour;
+        result.summary.personCount = sample % 3;
+        result.motionInfo.overallMotionLevel = 0.1f + 0.01f * (sample % 10);
+        return result;
+    };
+    
+    // Models from before the track features are discarded, so the device learns again
+    writeLegacyModel("legacy_camera", 3, 6);
+    {
+        AnomalyDetector detector("legacy_camera");
+        if (detector.hasTrainedModels() || std::filesystem::exists(root / "legacy_camera" / "models.nxsnap")) {
+            throw std::runtime_error("Detector imported a model with the old feature layout");
+        }
+        for (int i = 0; i < 150; ++i) {
+            detector.addToBaseline(makeResult(3, i));
+        }
+        if (!detector.hasTrainedModels()) {
+            throw std::runtime_error("Detector did not relearn the hour of a discarded legacy model");
+        }
+    }
+    
+    // Models of the current layout are converted to a snapshot
+    writeLegacyModel("current_camera", 4, FeatureVector::kExtractedFeatureCount);
+    {
+        AnomalyDetector detector("current_camera");
+        if (!detector.hasTrainedModels() || !std::filesystem::exists(root / "current_camera" / "models.nxsnap")) {
+            throw std::runtime_error("Detector did not import a legacy model of the current layout");
+        }
+    }
+    
+    globalConfig.dataStoragePath = savedStoragePath;
+    std::filesystem::remove_all(root);
+    
+    std::cout << "Legacy model import test passed" << std::endl;
+}
+
+void runFastMotionTest() {
+    std::cout << "=== Running Fast Motion Engine Test (" << RunningAverageSubtractor::kernelName()
+              << " kernel) ===" << std::endl;
+    
+    std::string deviceId = "test_camera_03";
+    auto config = GlobalConfig::instance().modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        edited.motionEngine = "fast";
+        edited.motionAnalysisWidth = 320;
+    });
+    
+    MetadataAnalyzer analyzer(deviceId);
+    analyzer.configure(config);
+    
+    // A static scene, then a dark box appears in it
+    cv::Mat background(720, 1280, CV_8UC1, cv::Scalar(180));
+    cv::Rect box(640, 240, 200, 200);
+    int64_t startTime = TimeUtils::getCurrentTimestampUs();
+    
+    for (int i = 0; i < 10; ++i) {
+        FrameAnalysisResult result = analyzer.processFrame(background, startTime + i * 100000);
+        if (result.motionInfo.overallMotionLevel != 0.0f) {
+            throw std::runtime_error("Fast motion engine reported motion in a static scene");
+        }
+    }
+    
+    cv::Mat frame = background.clone();
+    cv::rectangle(frame, box, cv::Scalar(40), cv::FILLED);
+    FrameAnalysisResult result = analyzer.processFrame(frame, startTime + 1000000);
+    
+    const MotionInfo& motion = result.motionInfo;
+    if (motion.overallMotionLevel <= 0.0f || motion.motionCenters.size() != 1) {
+        throw std::runtime_error("Fast motion engine missed the box");
+    }
+    cv::Point center = motion.motionCenters[0];
+    if (std::abs(center.x - (box.x + box.width / 2)) > 8 || std::abs(center.y - (box.y + box.height / 2)) > 8) {
+        throw std::runtime_error("Fast motion engine placed the box at " + std::to_string(center.x) +
+                                 "," + std::to_string(center.y));
+    }
+    
+    std::cout << "Motion level " << motion.overallMotionLevel << ", center " << center.x << ","
+              << center.y << std::endl;
+}
+
+void runTrackerTest() {
+    std::cout << "=== Running Object Tracker Test ===" << std::endl;
+    
+    ObjectTracker tracker;
+    tracker.configure(0.3f, 0.1f, 2000000);
+    RegionIndex everywhere;
+    
+    // Two people walking towards each other without camera track ids
+    auto makePerson = [](int x, int y) {
+        DetectedObject person;
+        person.typeId = "person";
+        person.confidence = 0.9f;
+        person.boundingBox = cv::Rect(x, y, 80, 200);
+        return person;
+    };
+    
+    uint32_t left = 0;
+    uint32_t right = 0;
+    int64_t startTime = 1718010000LL * 1000000;
+    for (int i = 0; i < 20; ++i) {
+        std::vector<DetectedObject> objects = {makePerson(200 + i * 20, 400), makePerson(1600 - i * 20, 420)};
+        tracker.update(objects, startTime + i * 100000, everywhere, 1920, 1080);
+        if (i == 0) {
+            left = objects[0].trackNumber;
+            right = objects[1].trackNumber;
+        } else if (objects[0].trackNumber != left || objects[1].trackNumber != right) {
+            throw std::runtime_error("Tracker swapped or lost a track at frame " + std::to_string(i));
+        }
+        if (i == 19 && (objects[0].dwellSecs < 1.8f || objects[0].velocity.x <= 0.0f ||
+                        objects[1].velocity.x >= 0.0f)) {
+            throw std::runtime_error("Tracker dwell time or velocity is wrong");
+        }
+    }
+    
+    // Both vanish; after the maximum age they are expired, and a person
+    // appearing in the same place starts a new track
+    std::vector<DetectedObject> none;
+    tracker.update(none, startTime + 5000000, everywhere, 1920, 1080);
+    TrackerStats stats = tracker.stats();
+    if (stats.active != 0 || stats.expired != 2) {
+        throw std::runtime_error("Tracker kept " + std::to_string(stats.active) + " expired tracks");
+    }
+    std::vector<DetectedObject> again = {makePerson(580, 400)};
+    tracker.update(again, startTime + 5100000, everywhere, 1920, 1080);
+    if (again[0].trackNumber == left || again[0].dwellSecs != 0.0f) {
+        throw std::runtime_error("Tracker revived an expired track");
+    }
+    
+    std::cout << "Created " << tracker.stats().created << " tracks" << std::endl;
+}
+
+void runCovarianceModelTest() {
+    std::cout << "=== Running Full-Covariance Model Test ===" << std::endl;
+    
+    auto makeFeatures = [](float motion, int persons, float extra) {
+        FeatureVector features = {};
+        features.timeOfDaySeconds = 10 * 3600;
+        features.dayOfWeek = 2;
+        features.motionLevel = motion;
+        features.personCount = persons;
+        features.additionalFeatures.assign(FeatureVector::kExtractedFeatureCount - 5, 0.0f);
+        features.additionalFeatures[0] = extra;
+        return features;
+    };
+    
+    // In this scene the number of people follows the amount of motion
+    OnlineGaussianModel diagonal;
+    CovarianceGaussianModel full;
+    for (int i = 0; i < 2000; ++i) {
+        float motion = static_cast<float>(i % 101) / 100.0f;
+        int persons = static_cast<int>(std::lround(motion * 6.0f)) + i % 3 - 1;
+        FeatureVector features = makeFeatures(motion, persons, static_cast<float>((i * 37) % 100) / 100.0f);
+        diagonal.update(features);
+        full.update(features);
+    }
+    
+    // Lots of motion and nobody there: each feature is ordinary on its own
+    FeatureVector usual = makeFeatures(0.9f, 5, 0.5f);
+    FeatureVector unusual = makeFeatures(0.9f, 0, 0.5f);
+    float fullUnusual = full.scoreAnomaly(unusual);
+    if (fullUnusual <= diagonal.scoreAnomaly(unusual) || fullUnusual <= full.scoreAnomaly(usual) + 0.3f) {
+        throw std::runtime_error("Covariance model missed a combination the baseline never showed");
+    }
+    
+    std::vector<FeatureVector> batch;
+    for (int i = 0; i < 21; ++i) {
+        batch.push_back(makeFeatures(static_cast<float>(i) / 20.0f, i % 7, 0.5f));
+    }
+    std::vector<float> scores(batch.size());
+    full.scoreBatch(batch.data(), batch.size(), scores.data());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (std::abs(scores[i] - full.scoreAnomaly(batch[i])) > 1e-5f) {
+            throw std::runtime_error("Batch score differs for sample " + std::to_string(i));
+        }
+    }
+    
+    SnapshotEntry entry;
+    CovarianceGaussianModel restored;
+    if (!full.exportState(entry) || !restored.importState(entry) ||
+        restored.scoreAnomaly(unusual) != fullUnusual) {
+        throw std::runtime_error("Covariance model state did not survive a snapshot");
+    }
+    
+    std::cout << "Unusual combination scored " << fullUnusual << " (diagonal "
+              << diagonal.scoreAnomaly(unusual) << ")" << std::endl;
+}
+
+void runReplayTest() {
+    std::cout << "=== Running Replay Segments and Score Distribution Test ===" << std::endl;
+    
+    // An archive directory: two chunks out of order, a frame dump and a stray file
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_replay_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "dump");
+    for (const char* name : {"1718013600000_60000.mkv", "1718010000000_60000.mkv", "notes.mkv",
+                             "dump/1718020000000000.jpg", "dump/1718020000066666.jpg"}) {
+        std::ofstream(root / name) << "x";
+    }
+    
+    std::vector<ReplaySegment> segments = findReplaySegments(root.string());
+    std::filesystem::remove_all(root);
+    if (segments.size() != 3 || segments[0].startUs != 1718010000000000LL ||
+        segments[1].startUs != 1718013600000000LL || segments[2].kind != ReplaySegment::Kind::FrameDump ||
+        segments[2].startUs != 1718020000000000LL) {
+        throw std::runtime_error("Replay segments were not found in event time order");
+    }
+    
+    // 99% ordinary scores and a 1% tail
+    ScoreDistribution scores;
+    for (int i = 0; i < 990; ++i) {
+        scores.add(0.1f + 0.2f * static_cast<float>(i % 10) / 10.0f);
+    }
+    for (int i = 0; i < 10; ++i) {
+        scores.add(0.9f);
+    }
+    float suggested = scores.thresholdForRate(0.01);
+    if (suggested < 0.28f || suggested > 0.9f || scores.fractionAbove(suggested) > 0.01 ||
+        scores.fractionAbove(0.5f) != 0.01 || scores.percentile(0.5) > 0.21f) {
+        throw std::runtime_error("Score distribution suggested threshold " + std::to_string(suggested));
+    }
+    
+    std::cout << "Suggested threshold for a 1% anomaly rate: " << suggested << std::endl;
+}
+
+void runModelCacheTest() {
+    std::cout << "=== Running Hour Model Cache Test ===" << std::endl;
+    
+    auto& globalConfig = GlobalConfig::instance();
+    std::string savedStoragePath = globalConfig.dataStoragePath;
+    int savedBudget = globalConfig.modelCacheBudgetKB;
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_model_cache_test";
+    std::filesystem::remove_all(root);
+    globalConfig.dataStoragePath = root.string();
+    globalConfig.modelCacheBudgetKB = 1;    // Below a single model: only the pinned hours stay
+    
+    const std::string deviceId = "cache_test_camera";
+    const int64_t midnightUs = 1718000000LL * 1000000;
+    auto makeResult = [&](int hour, int sample, float motion, int persons) {
+        FrameAnalysisResult result;
+        result.timestampUs = midnightUs + (hour * 3600LL + sample) * 1000000;
+        result.summary.valid = true;
+        result.summary.timeOfDaySeconds = hour * 3600 + sample;
+        result.summary.hourOfDay = hour;
+        result.summary.personCount = persons;
+        result.motionInfo.overallMotionLevel = motion;
+        return result;
+    };
+    
+    {
+        AnomalyDetector detector(deviceId);
+        for (int hour = 2; hour <= 6; ++hour) {
+            int samples = hour == 2 ? 150 : 10;
+            for (int i = 0; i < samples; ++i) {
+                detector.addToBaseline(makeResult(hour, i, 0.1f + 0.01f * (i % 10), i % 3));
+            }
+        }
+        
+        // Hour 2 left memory unsaved; it must still count and reach the snapshot
+        if (detector.residentModelCount() > 2 || !detector.hasTrainedModels()) {
+            throw std::runtime_error("Evicted hours were kept resident or lost");
+        }
+        if (!detector.saveModel()) {
+            throw std::runtime_error("Model snapshot was not saved");
+        }
+    }
+    
+    {
+        // A restart maps the snapshot without loading any hour
+        AnomalyDetector detector(deviceId);
+        if (detector.residentModelCount() != 0 || !detector.hasTrainedModels()) {
+            throw std::runtime_error("Stored hours were loaded eagerly or not found");
+        }
+        
+        // Event time back in hour 2 pages its model in
+        FrameAnalysisResult usual = makeResult(2, 75, 0.15f, 1);
+        FrameAnalysisResult unusual = makeResult(2, 76, 0.9f, 12);
+        detector.detectAnomaly(usual);
+        detector.detectAnomaly(unusual);
+        if (unusual.anomalyScore <= usual.anomalyScore || AnomalyDetector::residentModelBytes() <= 0) {
+            throw std::runtime_error("Paged-in model did not score like the trained one");
+        }
+        std::cout << "Paged-in hour scored " << usual.anomalyScore << " / " << unusual.anomalyScore
+                  << " with " << detector.residentModelCount() << " models resident" << std::endl;
+    }
+    
+    globalConfig.dataStoragePath = savedStoragePath;
+    globalConfig.modelCacheBudgetKB = savedBudget;
+    std::filesystem::remove_all(root);
+}
+
+void runConfigSnapshotTest() {
+    std::cout << "=== Running Configuration Snapshot Test ===" << std::endl;
+    
+    auto& globalConfig = GlobalConfig::instance();
+    const std::string deviceId = "test_camera_snapshot";
+    
+    // A snapshot keeps its settings and compiled regions after newer ones are published
+    auto before = globalConfig.getDeviceConfig(deviceId);
+    auto after = globalConfig.modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        Region region;
+        region.points = {{0.0f, 0.0f}, {0.5f, 0.0f}, {0.5f, 0.5f}, {0.0f, 0.5f}};
+        edited.detectionRegions = {region};
+    });
+    if (!before->detectionRegions.empty() || !before->regionIndex->contains(0.9f, 0.9f) ||
+        after->regionIndex->contains(0.9f, 0.9f) || !after->regionIndex->contains(0.25f, 0.25f) ||
+        globalConfig.getDeviceConfig(deviceId) != after) {
+        throw std::runtime_error("Published settings changed an earlier snapshot");
+    }
+    
+    // Concurrent edits are all kept, and a reader never sees half of one
+    globalConfig.modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+        edited.activityHoldSecs = 0;
+        edited.idleFrameRate = 0.0f;
+    });
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::thread reader([&]() {
+        while (!stop) {
+            auto config = globalConfig.getDeviceConfig(deviceId);
+            if (config->idleFrameRate != static_cast<float>(config->activityHoldSecs)) {
+                ++torn;
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; ++w) {
+        writers.emplace_back([&]() {
+            for (int i = 0; i < 100; ++i) {
+                globalConfig.modifyDeviceConfig(deviceId, [](DeviceConfig& edited) {
+                    edited.activityHoldSecs += 1;
+                    edited.idleFrameRate = static_cast<float>(edited.activityHoldSecs);
+                });
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    stop = true;
+    reader.join();
+    
+    int holdSecs = globalConfig.getDeviceConfig(deviceId)->activityHoldSecs;
+    if (holdSecs != 400 || torn > 0) {
+        throw std::runtime_error("Concurrent edits: " + std::to_string(holdSecs) + " of 400 kept, " +
+                                 std::to_string(torn.load()) + " torn reads");
+    }
+    
+    std::cout << "Snapshots stayed consistent across " << holdSecs << " concurrent edits" << std::endl;
+}
+
+void runObjectMetadataTest() {
+    std::cout << "=== Running Object Metadata Test ===" << std::endl;
+    
+    // Attribute types come from the manifest's object types
+    auto schema = std::make_shared<const AttributeSchema>(AttributeSchema::fromManifest(R"({
+        "supportedMetadataTypes": [{"objectTypes": [
+            {"id": "nx.base.Person", "attributes": [
+                {"id": "recognitionStatus", "type": "string"},
+                {"id": "durationSecs", "type": "int"}]}]}]})"));
+    if (schema->type("nx.base.Person", AttributeKeys::DurationSecs) != AttributeType::Int ||
+        schema->type("nx.base.Person", AttributeKeys::RecognitionStatus) != AttributeType::String ||
+        schema->type("nx.base.Vehicle", AttributeKeys::VehicleType) != AttributeType::Unknown ||
+        !AttributeSchema::fromManifest("{not json").empty()) {
+        throw std::runtime_error("Manifest attribute types were not read");
+    }
+    
+    float number = -1.0f;
+    if (!parseAttributeNumber("12.5", number) || number != 12.5f ||
+        parseAttributeNumber("12abc", number) || parseAttributeNumber("", number) ||
+        parseAttributeNumber("nan", number) || number != 12.5f) {
+        throw std::runtime_error("Attribute numbers were not parsed whole");
+    }
+    std::string formatted;
+    formatAttributeNumber(41.6f, AttributeType::Int, formatted);
+    if (formatted != "42") {
+        throw std::runtime_error("Int attribute formatted as " + formatted);
+    }
+    
+    // A track's unchanged attributes are sent once; untracked objects always carry theirs
+    DetectedObject tracked;
+    tracked.typeId = "nx.base.Person";
+    tracked.trackId = "track-1";
+    tracked.confidence = 0.9f;
+    tracked.attributes.set(AttributeKeys::RecognitionStatus, "unknown");
+    tracked.attributes.set(AttributeKeys::DurationSecs, "3");
+    DetectedObject untracked = tracked;
+    untracked.trackId.clear();
+    
+    ObjectMetadataWriter writer(schema);
+    const int64_t startUs = 1718000000LL * 1000000;
+    for (int frame = 0; frame < 10; ++frame) {
+        if (frame == 5) {
+            tracked.attributes.set(AttributeKeys::DurationSecs, "4");
+        }
+        const auto& metadata = writer.write({tracked, untracked}, startUs + frame * 100000LL);
+        if (metadata.size() != 2) {
+            throw std::runtime_error("Object metadata missing for a frame");
+        }
+    }
+    ObjectMetadataStats stats = writer.stats();
+    if (stats.objects != 20 || stats.attributesSent != 23 || stats.attributesSkipped != 17) {
+        throw std::runtime_error("Attributes sent " + std::to_string(stats.attributesSent) + ", skipped " +
+                                 std::to_string(stats.attributesSkipped));
+    }
+    
+    // Track state ends with the track
+    writer.write({untracked}, startUs + ObjectMetadataWriter::kTrackStateTtlUs + 2000000);
+    if (writer.trackCount() != 0) {
+        throw std::runtime_error("State of an ended track was kept");
+    }
+    
+    std::cout << "Sent " << stats.attributesSent << " attributes, skipped " << stats.attributesSkipped
+              << " unchanged" << std::endl;
+}
+
+void runShortTermTest() {
+    std::cout << "=== Running Short-Term Detection Test ===" << std::endl;
+    
+    // Windowed statistics match a direct computation over the same bins
+    SlidingWindowStats stats(1, {10 * 1000000LL, 60 * 1000000LL});
+    std::vector<float> bins;
+    for (int second = 0; second < 200; ++second) {
+        float value = static_cast<float>((second * 37) % 11);
+        bins.push_back(value);
+        stats.add(second * 1000000LL, &value);
+        stats.add(second * 1000000LL + 500000, &value);
+    }
+    // The bin of the last second is still open
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (int i = 189; i < 199; ++i) {
+        sum += bins[i];
+        sumSquares += bins[i] * bins[i];
+    }
+    double mean = sum / 10.0;
+    double variance = (sumSquares - 10.0 * mean * mean) / 9.0;
+    if (stats.count(0) != 10 || stats.count(1) != 60 || std::abs(stats.mean(0, 0) - mean) > 1e-4 ||
+        std::abs(stats.variance(0, 0) - variance) > 1e-3 ||
+        std::abs(stats.rateOfChange(0, 0) - (bins[198] - bins[189]) / 9.0f) > 1e-4) {
+        throw std::runtime_error("Sliding window statistics drifted from the samples");
+    }
+    
+    // A quiet half hour, then a crowd for a minute
+    ShortTermDetector detector;
+    auto makeFeatures = [](int64_t timestampUs, int persons, float motion) {
+        FeatureVector features;
+        features.timestampUs = timestampUs;
+        features.timeOfDaySeconds = static_cast<int>((timestampUs / 1000000) % 86400);
+        features.dayOfWeek = 2;
+        features.motionLevel = motion;
+        features.personCount = persons;
+        features.unknownPersonCount = 0;
+        features.vehicleCount = 0;
+        features.additionalFeatures.assign(FeatureVector::kExtractedFeatureCount - 5, 0.0f);
+        return features;
+    };
+    const int64_t startUs = 1718000000LL * 1000000;
+    int64_t nowUs = startUs;
+    float quietMax = 0.0f;
+    for (int frame = 0; frame < 30 * 60 * 2; ++frame, nowUs += 500000) {
+        ShortTermScore score = detector.update(makeFeatures(nowUs, frame % 40 == 0 ? 1 : 0, 0.1f + 0.01f * (frame % 5)));
+        quietMax = std::max(quietMax, std::max(score.burst, score.drift));
+    }
+    ShortTermScore burst;
+    for (int frame = 0; frame < 60 * 2; ++frame, nowUs += 500000) {
+        burst = detector.update(makeFeatures(nowUs, 6, 0.4f));
+    }
+    if (quietMax > 0.3f || burst.burst < 0.7f ||
+        std::string(ShortTermDetector::featureName(burst.feature)) != "person count") {
+        throw std::runtime_error("Burst scored " + std::to_string(burst.burst) + " after a quiet scene scoring " +
+                                 std::to_string(quietMax));
+    }
+    
+    std::cout << "Quiet scene scored at most " << quietMax << ", burst " << burst.burst << std::endl;
+}
+
+void runFeatureLogTest() {
+    std::cout << "=== Running Feature Log Test ===" << std::endl;
+    
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_feature_log_test";
+    std::filesystem::remove_all(root);
+    const int64_t dayUs = 86400LL * 1000000;
+    const int64_t startUs = 19900 * dayUs;
+    auto makeSample = [&](int i) {
+        FeatureVector features;
+        features.timestampUs = startUs + i * 60LL * 1000000 + (i % 4) * 1000;
+        features.timeOfDaySeconds = (i * 60) % 86400;
+        features.dayOfWeek = (i / 1440) % 7;
+        features.motionLevel = 0.1f + 0.01f * (i % 7);
+        features.personCount = i % 3;
+        features.unknownPersonCount = i % 5 == 0 ? 1 : 0;
+        features.vehicleCount = 0;
+        features.additionalFeatures = {0.0f, 12.5f * (i % 2), 0.0f, 0.03f * (i % 11)};
+        return features;
+    };
+    
+    // Three and a half days, flushed as the model saves would; two days are kept
+    const int total = 1440 * 3 + 720;
+    {
+        FeatureLog log((root / "camera" / "features").string());
+        log.setRetentionDays(2);
+        for (int i = 0; i < total; ++i) {
+            log.append(makeSample(i));
+            if (i % 60 == 59) {
+                log.flush();
+            }
+        }
+        log.flush();
+        if (log.segments().size() != 3) {
+            throw std::runtime_error("Expected 3 retained segments, found " + std::to_string(log.segments().size()));
+        }
+    }
+    
+    // The log reads back exactly, from the first retained day
+    uint64_t diskBytes = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        diskBytes += entry.is_regular_file() ? entry.file_size() : 0;
+    }
+    FeatureLogReader reader((root / "camera" / "features").string());
+    FeatureVector features;
+    int index = 1440;
+    while (reader.next(features)) {
+        FeatureVector expected = makeSample(index++);
+        if (features.timestampUs != expected.timestampUs || features.timeOfDaySeconds != expected.timeOfDaySeconds ||
+            features.personCount != expected.personCount || features.motionLevel != expected.motionLevel ||
+            features.additionalFeatures != expected.additionalFeatures) {
+            throw std::runtime_error("Feature log sample " + std::to_string(index - 1) + " read back differently");
+        }
+    }
+    int samples = index - 1440;
+    if (index != total || reader.corruptBlocks() != 0 || diskBytes > static_cast<uint64_t>(samples) * 24) {
+        throw std::runtime_error("Feature log read " + std::to_string(samples) + " samples from " +
+                                 std::to_string(diskBytes) + " bytes");
+    }
+    
+    // A torn append loses only itself
+    std::string newest = FeatureLog((root / "camera" / "features").string()).segments().back();
+    {
+        std::ofstream file(newest, std::ios::binary | std::ios::app);
+        file << "NXFL torn";
+    }
+    FeatureLogReader torn((root / "camera" / "features").string());
+    int tornCount = 0;
+    while (torn.next(features)) {
+        ++tornCount;
+    }
+    if (tornCount != samples || torn.corruptBlocks() != 1) {
+        throw std::runtime_error("A torn block hid logged samples");
+    }
+    
+    // Over quota, the oldest days go and the newest segment stays
+    FeatureLog::enforceQuota(root.string(), 1);
+    std::vector<std::string> segments = FeatureLog((root / "camera" / "features").string()).segments();
+    if (segments.size() != 1 || segments.back() != newest) {
+        throw std::runtime_error("Quota eviction kept " + std::to_string(segments.size()) + " segments");
+    }
+    std::filesystem::remove_all(root);
+    
+    // A lost snapshot is retrained from the log
+    auto& globalConfig = GlobalConfig::instance();
+    std::string savedStoragePath = globalConfig.dataStoragePath;
+    globalConfig.dataStoragePath = root.string();
+    const std::string deviceId = "feature_log_camera";
+    {
+        AnomalyDetector detector(deviceId);
+        for (int i = 0; i < 150; ++i) {
+            FrameAnalysisResult result;
+            result.timestampUs = startUs + (3 * 3600LL + i) * 1000000;
+            result.summary.valid = true;
+            result.summary.timeOfDaySeconds = 3 * 3600 + i;
+            result.summary.hourOfDay = 3;
+            result.summary.personCount = i % 3;
+            result.motionInfo.overallMotionLevel = 0.1f + 0.01f * (i % 10);
+            detector.addToBaseline(result);
+        }
+        detector.saveModel();
+    }
+    std::filesystem::remove(root / deviceId / "models.nxsnap");
+    {
+        AnomalyDetector detector(deviceId);
+        if (!detector.hasTrainedModels()) {
+            throw std::runtime_error("Baseline was not retrained from the feature log");
+        }
+    }
+    globalConfig.dataStoragePath = savedStoragePath;
+    std::filesystem::remove_all(root);
+    
+    std::cout << "Logged " << samples << " samples in " << diskBytes << " bytes" << std::endl;
+}
+
+void runReplicationTest() {
+    std::cout << "=== Running Model Replication Test ===" << std::endl;
+    
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "nx_agent_replication_test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "store");
+    auto& replication = ModelReplicationService::instance();
+    replication.setStore(std::make_shared<DirectoryReplicaStore>((root / "store").string()));
+    
+    // Sends may be picked up by the background worker or the flush, whichever comes first
+    auto waitFor = [&](auto predicate, const std::string& what) {
+        replication.flush();
+        for (int i = 0; i < 100 && !predicate(replication.stats()); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        if (!predicate(replication.stats())) {
+            throw std::runtime_error(what);
+        }
+    };
+    
+    auto& globalConfig = GlobalConfig::instance();
+    std::string savedStoragePath = globalConfig.dataStoragePath;
+    const std::string deviceId = "replicated camera";
+    const int64_t startUs = 19900LL * 86400 * 1000000;
+    ReplicationStats before = replication.stats();
+    
+    // Server A trains and saves; the snapshot and manifest reach the store
+    globalConfig.dataStoragePath = (root / "serverA").string();
+    {
+        AnomalyDetector detector(deviceId);
+        for (int i = 0; i < 150; ++i) {
+            FrameAnalysisResult result;
+            result.timestampUs = startUs + (3 * 3600LL + i) * 1000000;
+            result.summary.valid = true;
+            result.summary.timeOfDaySeconds = 3 * 3600 + i;
+            result.summary.hourOfDay = 3;
+            result.summary.personCount = i % 3;
+            result.motionInfo.overallMotionLevel = 0.1f + 0.01f * (i % 10);
+            detector.addToBaseline(result);
+        }
+        detector.saveModel();
+    }
+    waitFor([&](const ReplicationStats& stats) { return stats.replicated > before.replicated; },
+            "Saved models were not replicated");
+    if (!std::filesystem::exists(root / "store" / deviceId / "manifest") ||
+        !std::filesystem::exists(root / "store" / deviceId / "models.nxsnap")) {
+        throw std::runtime_error("Replica store is missing the manifest or the snapshot");
+    }
+    
+    // An unchanged snapshot is not sent again
+    ReplicationStats sent = replication.stats();
+    replication.notifySaved(deviceId, (root / "serverA" / deviceId).string());
+    waitFor([&](const ReplicationStats& stats) { return stats.unchanged > sent.unchanged; },
+            "An unchanged snapshot was not recognized");
+    if (replication.stats().bytesSent != sent.bytesSent) {
+        throw std::runtime_error("An unchanged snapshot was sent again");
+    }
+    
+    // The camera fails over to server B, which starts in detection mode
+    globalConfig.dataStoragePath = (root / "serverB").string();
+    {
+        AnomalyDetector detector(deviceId);
+        if (replication.stats().restored != before.restored + 1 || !detector.hasTrainedModels()) {
+            throw std::runtime_error("Failed-over camera did not warm-start from the replica");
+        }
+        detector.saveModel();
+    }
+    waitFor([&](const ReplicationStats& stats) { return stats.replicated > sent.replicated; },
+            "Server B's models were not replicated");
+    
+    // Server A's older models no longer replace them
+    ReplicationStats takenOver = replication.stats();
+    replication.notifySaved(deviceId, (root / "serverA" / deviceId).string());
+    waitFor([&](const ReplicationStats& stats) { return stats.superseded > takenOver.superseded; },
+            "Server A's older save was not recognized");
+    if (replication.stats().replicated != takenOver.replicated) {
+        throw std::runtime_error("Older models replaced a newer replica");
+    }
+    
+    // A slow store does not hold up a camera failing over to server C; it
+    // learns locally and the late replica is discarded
+    int savedRestoreTimeout = globalConfig.replicationRestoreTimeoutMs;
+    globalConfig.replicationRestoreTimeoutMs = 100;
+    replication.setStore(std::make_shared<mock::SlowReplicaStore>(
+        std::make_shared<DirectoryReplicaStore>((root / "store").string()), std::chrono::milliseconds(300)));
+    globalConfig.dataStoragePath = (root / "serverC").string();
+    {
+        ReplicationStats slow = replication.stats();
+        auto started = std::chrono::steady_clock::now();
+        AnomalyDetector detector(deviceId);
+        if (std::chrono::steady_clock::now() - started > std::chrono::milliseconds(250) ||
+            replication.stats().restoreTimeouts != slow.restoreTimeouts + 1 || detector.hasTrainedModels()) {
+            throw std::runtime_error("A slow replica store held up the detector");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        if (std::filesystem::exists(root / "serverC" / deviceId / "models.nxsnap") ||
+            replication.stats().restored != slow.restored) {
+            throw std::runtime_error("A replica fetched after the detector started was installed");
+        }
+    }
+    globalConfig.replicationRestoreTimeoutMs = savedRestoreTimeout;
+    
+    globalConfig.dataStoragePath = savedStoragePath;
+    replication.setStore(nullptr);
+    std::filesystem::remove_all(root);
+    
+    std::cout << "Replicated " << (replication.stats().bytesSent - before.bytesSent) << " bytes" << std::endl;
+}
+
 int main(int argc, char** argv) {
     // Set up logging
     Logger::setLogLevel(Logger::Level::DEBUG);
@@ -410,6 +2668,37 @@ int main(int argc, char** argv) {
     try {
         runBasicTest();
         runUnknownVisitorTest();
+        runIncidentCorrelatorTest();
+        runHttpDispatcherTest();
+        runTimeUtilsDstTest();
+        runFrameViewTest();
+        runExecutorShutdownTest();
+        runSnapshotTest();
+        runPersistenceTest();
+        runMetricsTest();
+        runLoggerOverflowTest();
+        runFrameQueueTest();
+        runAnalysisModeTest();
+        runFrameSummaryTest();
+        runFrameSchedulerTest();
+        runFastMotionTest();
+        runMotionKernelParityTest();
+        runCroppedMotionTest();
+        runRegionIndexTest();
+        runTrackerTest();
+        runDetectionBatcherTest();
+        runCovarianceModelTest();
+        runOnlineModelTest();
+        runReplayTest();
+        runReplayDeterminismTest();
+        runModelCacheTest();
+        runLegacyModelImportTest();
+        runConfigSnapshotTest();
+        runObjectMetadataTest();
+        runShortTermTest();
+        runFeatureLogTest();
+        runReplicationTest();
+        runAttributeInternTest();
         
         std::cout << "All tests completed." << std::endl;
     } catch (const std::exception& e) {